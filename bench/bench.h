@@ -0,0 +1,230 @@
+/* -------------------------------------------------------------
+
+bench.h
+    Essential Notepad - A basic Notepad implementation for Windows
+    Shared header file for the benchmarks of the portable core
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "esncore.h"
+
+// How much of each corpus is generated, and how many times each stage
+// runs, unless the command line says otherwise
+#define BENCH_DATA_MB       32
+#define BENCH_RUNS          5
+
+// The most text the stages run on in memory, and the largest corpus
+// file --generate writes
+#define BENCH_MAX_DATA_MB   1024
+#define BENCH_MAX_FILE_MB   4096
+
+// The most runs of a stage, so its latencies fit in a fixed array
+#define BENCH_MAX_RUNS      1000
+
+// The most results a benchmark run has, for every corpus and stage
+#define BENCH_MAX_RESULTS   256
+
+// The number of sizes the scaling stages are measured at, each four
+// times the one before, up to the size of the corpora
+#define BENCH_SCALING_STEPS 4
+
+// The lines the edit control shows at once, on a large monitor
+#define BENCH_VISIBLE_LINES 60
+
+// The pages scrolled through, and the keys typed into a visible line,
+// by the highlighting stages
+#define BENCH_SCROLL_PAGES  50
+#define BENCH_EDIT_KEYS     50
+
+// What's typed between two autosaves, at 50 keys a second, and the
+// most characters pasted at once
+#define BENCH_TYPED_TEXT    L"Typing a new line at fifty keys a second, 50 keys."
+#define BENCH_PASTE_CHARS   (1024 * 1024)
+
+// The files in the tree Find in Files is measured on, unless the command
+// line says otherwise, and the most it can have. Each folder has
+// BENCH_TREE_FOLDER_FILES of them, of up to BENCH_TREE_FILE_BYTES each.
+#define BENCH_TREE_FILES    100000
+#define BENCH_MAX_TREE_FILES 1000000
+#define BENCH_TREE_FOLDER_FILES 100
+#define BENCH_TREE_FILE_BYTES 1024
+
+// The max length of a corpus or stage name
+#define CCH_BENCH_NAME      32
+
+// Compare flags a stage whose throughput drops, or whose 90th percentile
+// latency grows, by more than this percentage, unless told otherwise
+#define BENCH_THRESHOLD_PERCENT 10.0
+
+// The version of the layout of the JSON results
+#define BENCH_RESULTS_VERSION 1
+
+// Fills data with whole records of a corpus, up to dataSize bytes, and
+// returns how many bytes it wrote. record counts the records written so
+// far, so a large corpus can be generated a piece at a time.
+typedef size_t (*GENERATE_CORPUS)(BYTE * data, size_t dataSize, ULONGLONG * record);
+
+// A kind of text the benchmarks run on
+typedef struct _BENCH_CORPUS
+{
+    const char * name;
+    const char * fileName;      // when it's written by --generate
+    GENERATE_CORPUS generate;
+} BENCH_CORPUS;
+
+// A corpus, and what the stages that run on it need: its text as the
+// edit control holds it, and as a save encodes it
+typedef struct _BENCH_INPUT
+{
+    const BYTE * data;
+    size_t dataSize;
+    DOCUMENT_TEXT document;
+    DOCUMENT_INFO info;
+    WCHAR * saveText;           // with the file's own line endings
+    size_t saveLength;
+    WCHAR * work;               // room for a copy of the document text
+    DWORD * lineStarts;         // the line table of the document text
+    DWORD lineCount;
+    BYTE * chunk;               // CB_WRITE_CHUNK bytes to encode into
+    WCHAR * edited;             // the document text the autosave stages edit,
+    size_t editedLength;        // with room for BENCH_PASTE_CHARS more
+    WCHAR * journaled;          // the same, as of the last autosave
+    size_t journaledLength;
+    DIRTY_RANGE dirty;          // where it was edited since then
+    const char * problem;       // set when a stage doesn't do what it should
+} BENCH_INPUT;
+
+// Runs a stage once, and returns something it computed, so the work
+// can't be optimized away
+typedef size_t (*RUN_BENCH_STAGE)(BENCH_INPUT * input);
+
+// A stage of opening, searching, or saving a file
+typedef struct _BENCH_STAGE
+{
+    const char * name;
+    RUN_BENCH_STAGE run;
+} BENCH_STAGE;
+
+// How one stage did on one corpus
+typedef struct _BENCH_RESULT
+{
+    char corpus[CCH_BENCH_NAME];
+    char stage[CCH_BENCH_NAME];
+    double mbPerSecond;         // of the corpus bytes, at the median latency
+    double p50Ms;
+    double p90Ms;
+    double p99Ms;
+    ULONGLONG peakMemoryBytes;  // of the process, once the stage was done
+} BENCH_RESULT;
+
+// The results of a whole benchmark run
+typedef struct _BENCH_RESULTS
+{
+    ULONGLONG corpusBytes;
+    int runs;
+    ULONGLONG peakMemoryBytes;
+    int resultCount;
+    BENCH_RESULT results[BENCH_MAX_RESULTS];
+} BENCH_RESULTS;
+
+// Function prototypes - main.c
+double GetSeconds(void);
+size_t FormatHexRows(const BYTE * data, size_t dataSize);
+ULONGLONG GetEncodedSize(LPCWSTR text, size_t textLength, int encoding, BYTE * chunk);
+ULONGLONG SaveInPlace(const BYTE * data, size_t dataSize, LPCWSTR text, size_t textLength, BYTE * chunk);
+ULONGLONG SaveCopy(LPCWSTR text, size_t textLength, BYTE * chunk);
+BOOL WriteBenchSaveFile(const BYTE * data, size_t dataSize);
+void MeasureSaves(const BYTE * data, size_t dataSize);
+BOOL OpenWithCache(void);
+size_t RunOpenStage(BENCH_INPUT * input);
+size_t RunCachedOpenStage(BENCH_INPUT * input);
+size_t RunDecodeStage(BENCH_INPUT * input);
+size_t RunCachedDecodeStage(BENCH_INPUT * input);
+size_t SearchDocument(BENCH_INPUT * input, BOOL matchCase);
+size_t RunSearchStage(BENCH_INPUT * input);
+size_t RunCaseSearchStage(BENCH_INPUT * input);
+size_t RunLineEndingStage(BENCH_INPUT * input);
+size_t RunPasteLineEndingStage(BENCH_INPUT * input);
+size_t RunCompareStage(BENCH_INPUT * input);
+size_t RunEncodeStage(BENCH_INPUT * input);
+size_t RunHexStage(BENCH_INPUT * input);
+size_t RunScratchStage(BENCH_INPUT * input);
+void PrintScratchStats(void);
+void FreeBenchInput(BENCH_INPUT * input);
+BOOL PrepareBenchInput(BENCH_INPUT * input, const BYTE * data, size_t dataSize);
+void MeasureStage(BENCH_RESULTS * results, const char * corpus, const BENCH_STAGE * stage,
+    BENCH_INPUT * input, int runs);
+BOOL MeasureScaling(BENCH_RESULTS * results, BYTE * data, size_t dataBytes, int runs);
+int RunBenchmarks(size_t dataBytes, int runs, DWORD treeFiles, const char * jsonPath);
+int RunCompare(const char * baselinePath, const char * currentPath, double thresholdPercent);
+int PrintUsage(void);
+
+// Function prototypes - corpus.c
+int FormatMixedScriptLine(char * line, size_t lineSize, ULONGLONG record);
+size_t GenerateUtf16(BYTE * data, size_t dataSize, ULONGLONG * record, BOOL bigEndian);
+size_t GenerateAsciiLog(BYTE * data, size_t dataSize, ULONGLONG * record);
+size_t GenerateMixedScript(BYTE * data, size_t dataSize, ULONGLONG * record);
+size_t GenerateUtf16Le(BYTE * data, size_t dataSize, ULONGLONG * record);
+size_t GenerateUtf16Be(BYTE * data, size_t dataSize, ULONGLONG * record);
+size_t GenerateSingleLine(BYTE * data, size_t dataSize, ULONGLONG * record);
+const BENCH_CORPUS * GetBenchCorpora(int * count);
+BOOL GetBenchPath(const char * path, WCHAR * widePath);
+BOOL WriteCorpusFiles(const char * directory, ULONGLONG fileBytes);
+
+// Function prototypes - editing.c
+BOOL GetBenchLineText(void * context, DWORD line, const WCHAR ** text, DWORD * length);
+size_t PaintBenchLines(BENCH_INPUT * input, HIGHLIGHT_CACHE * cache, DWORD firstLine);
+size_t RunRepaintStage(BENCH_INPUT * input);
+size_t RunRecreateStage(BENCH_INPUT * input);
+size_t RunScrollStage(BENCH_INPUT * input);
+size_t PaintChangedLines(BENCH_INPUT * input, HIGHLIGHT_CACHE * cache, DWORD line, DWORD lastChanged,
+    DWORD windowEnd);
+size_t RunHighlightEditStage(BENCH_INPUT * input);
+size_t FilterBenchLines(BENCH_INPUT * input, const FILTER * filter, DWORD expected);
+size_t RunLevelFilterStage(BENCH_INPUT * input);
+size_t RunTextFilterStage(BENCH_INPUT * input);
+size_t RunColumnStage(BENCH_INPUT * input);
+size_t WriteBenchLines(BENCH_INPUT * input, const DWORD * order, DWORD count);
+DWORD * SortBenchLines(BENCH_INPUT * input, DWORD ** temp);
+size_t RunSortStage(BENCH_INPUT * input);
+size_t RunSortUniqueStage(BENCH_INPUT * input);
+size_t RunRemoveDuplicatesStage(BENCH_INPUT * input);
+size_t RunTrimStage(BENCH_INPUT * input);
+BOOL PrepareAutosaveText(BENCH_INPUT * input);
+void EditBenchText(BENCH_INPUT * input, size_t start, size_t removed, LPCWSTR inserted, size_t insertedLength,
+    BOOL tracked);
+size_t AutosaveBenchText(BENCH_INPUT * input);
+size_t RunAutosaveEdits(BENCH_INPUT * input, size_t position, LPCWSTR keys, size_t keyLength, size_t keyCount,
+    BOOL tracked);
+size_t RunTypingStage(BENCH_INPUT * input);
+size_t RunTypingScanStage(BENCH_INPUT * input);
+size_t RunPasteStage(BENCH_INPUT * input);
+size_t RunPasteScanStage(BENCH_INPUT * input);
+
+// Function prototypes - files.c
+BOOL WriteBenchTreeFile(const char * path, const BYTE * data, size_t size);
+BOOL CreateBenchTreeFolder(const char * path);
+size_t WriteBenchTree(DWORD fileCount);
+size_t RunFindFilesStage(BENCH_INPUT * input);
+BOOL MeasureFileSearch(BENCH_RESULTS * results, DWORD fileCount, int runs);
+
+// Function prototypes - results.c
+int CompareLatencies(const void * a, const void * b);
+double GetPercentile(const double * latencies, int count, double percent);
+const char * FindJsonValue(const char * start, const char * end, const char * key);
+BOOL ReadJsonString(const char * start, const char * end, const char * key, char * value);
+double ReadJsonNumber(const char * start, const char * end, const char * key);
+double GetPercentChange(double baseline, double current);
+void AddBenchResult(BENCH_RESULTS * results, const char * corpus, const char * stage,
+    double * latencies, int runs, ULONGLONG corpusBytes);
+BOOL WriteBenchResults(const char * path, const BENCH_RESULTS * results);
+BOOL ReadBenchResults(const char * path, BENCH_RESULTS * results);
+int CompareBenchResults(const BENCH_RESULTS * baseline, const BENCH_RESULTS * current, double thresholdPercent);
+
+#endif // _BENCH_H_
@@ -0,0 +1,284 @@
+/* -------------------------------------------------------------
+
+corpus.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Generators for the text the benchmarks run on: ASCII logs,
+    UTF-8 in several scripts, the same in UTF-16 of both byte
+    orders, and a file that's all one line. Each one can also be
+    written to disk, at any size, to try out in the app.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "bench.h"
+
+// The most bytes a generator writes at once when writing a corpus file
+#define CB_CORPUS_CHUNK     (1024 * 1024)
+
+// Room for one generated line, in bytes or characters
+#define CCH_CORPUS_LINE     256
+
+//
+// globals
+//
+
+// Words in several scripts, as UTF-8: Latin with accents, Cyrillic,
+// Greek, Chinese, Japanese, Arabic, and emoji outside the BMP
+const char * g_corpusWords[] =
+{
+    "Gr\xC3\xBC\xC3\x9F" "e",
+    "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82",
+    "\xCE\x93\xCE\xB5\xCE\xB9\xCE\xAC",
+    "\xE4\xBD\xA0\xE5\xA5\xBD",
+    "\xE3\x81\x93\xE3\x82\x93\xE3\x81\xAB\xE3\x81\xA1\xE3\x81\xAF",
+    "\xD9\x85\xD8\xB1\xD8\xAD\xD8\xA8\xD8\xA7",
+    "\xF0\x9F\x99\x82\xF0\x9F\x9A\x80",
+    "caf\xC3\xA9",
+};
+
+// The corpora, in the order they're measured
+const BENCH_CORPUS g_corpora[] =
+{
+    { "ascii-log",   "ascii-log.log",     GenerateAsciiLog },
+    { "mixed-utf8",  "mixed-utf8.txt",    GenerateMixedScript },
+    { "utf16-le",    "utf16-le.txt",      GenerateUtf16Le },
+    { "utf16-be",    "utf16-be.txt",      GenerateUtf16Be },
+    { "single-line", "single-line.json",  GenerateSingleLine },
+};
+
+//
+// GenerateAsciiLog
+// Fills data with LF terminated log lines, like a service writes
+//
+size_t GenerateAsciiLog(BYTE * data, size_t dataSize, ULONGLONG * record)
+{
+    static const char * levels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+    char line[CCH_CORPUS_LINE];
+    size_t length = 0;
+
+    for(;;)
+    {
+        unsigned int n = (unsigned int)*record;
+        int written = _snprintf_s(line, sizeof(line), _TRUNCATE,
+            "2024-05-01 12:%02u:%02u.%03u %s [worker-%u] request %u handled in %u ms\n",
+            (n / 60000) % 60, (n / 1000) % 60, n % 1000, levels[n % 4], n % 16, n, n % 997);
+
+        if(written <= 0 || length + (size_t)written > dataSize)
+        {
+            break;
+        }
+
+        memcpy(data + length, line, (size_t)written);
+        length += (size_t)written;
+        (*record)++;
+    }
+
+    return length;
+}
+
+//
+// FormatMixedScriptLine
+// Formats one CRLF terminated line of words in several scripts, as
+// UTF-8, and returns its length in bytes
+//
+int FormatMixedScriptLine(char * line, size_t lineSize, ULONGLONG record)
+{
+    unsigned int n = (unsigned int)record;
+
+    return _snprintf_s(line, lineSize, _TRUNCATE, "%u %s %s: %s, %s (%u)\r\n",
+        n, g_corpusWords[n % ARRAYSIZE(g_corpusWords)], g_corpusWords[(n / 3) % ARRAYSIZE(g_corpusWords)],
+        g_corpusWords[(n / 7) % ARRAYSIZE(g_corpusWords)], g_corpusWords[(n + 5) % ARRAYSIZE(g_corpusWords)],
+        n % 1009);
+}
+
+//
+// GenerateMixedScript
+// Fills data with UTF-8 lines that mix scripts, with no BOM
+//
+size_t GenerateMixedScript(BYTE * data, size_t dataSize, ULONGLONG * record)
+{
+    char line[CCH_CORPUS_LINE];
+    size_t length = 0;
+
+    for(;;)
+    {
+        int written = FormatMixedScriptLine(line, sizeof(line), *record);
+
+        if(written <= 0 || length + (size_t)written > dataSize)
+        {
+            break;
+        }
+
+        memcpy(data + length, line, (size_t)written);
+        length += (size_t)written;
+        (*record)++;
+    }
+
+    return length;
+}
+
+//
+// GenerateUtf16
+// Fills data with the same lines as GenerateMixedScript, encoded as
+// UTF-16 in either byte order, with a BOM at the start
+//
+size_t GenerateUtf16(BYTE * data, size_t dataSize, ULONGLONG * record, BOOL bigEndian)
+{
+    char line[CCH_CORPUS_LINE];
+    WCHAR wideLine[CCH_CORPUS_LINE];
+    size_t length = 0;
+
+    if(*record == 0)
+    {
+        if(dataSize < UTF16_BOM_BYTES)
+        {
+            return 0;
+        }
+
+        data[0] = bigEndian ? 0xFE : 0xFF;
+        data[1] = bigEndian ? 0xFF : 0xFE;
+        length = UTF16_BOM_BYTES;
+    }
+
+    for(;;)
+    {
+        int written = FormatMixedScriptLine(line, sizeof(line), *record);
+        int wideLength = (written > 0) ? DecodeUtf8((const BYTE *)line, written, wideLine, ARRAYSIZE(wideLine)) : 0;
+
+        if(wideLength <= 0 || length + (size_t)wideLength * sizeof(WCHAR) > dataSize)
+        {
+            break;
+        }
+
+        for(int i = 0; i < wideLength; i++)
+        {
+            data[length++] = (BYTE)(bigEndian ? wideLine[i] >> 8 : wideLine[i]);
+            data[length++] = (BYTE)(bigEndian ? wideLine[i] : wideLine[i] >> 8);
+        }
+        (*record)++;
+    }
+
+    return length;
+}
+
+//
+// GenerateUtf16Le
+//
+size_t GenerateUtf16Le(BYTE * data, size_t dataSize, ULONGLONG * record)
+{
+    return GenerateUtf16(data, dataSize, record, FALSE);
+}
+
+//
+// GenerateUtf16Be
+//
+size_t GenerateUtf16Be(BYTE * data, size_t dataSize, ULONGLONG * record)
+{
+    return GenerateUtf16(data, dataSize, record, TRUE);
+}
+
+//
+// GenerateSingleLine
+// Fills data with JSON records and no line breaks at all, like a
+// minified export. It's the worst case for anything that works a
+// line at a time.
+//
+size_t GenerateSingleLine(BYTE * data, size_t dataSize, ULONGLONG * record)
+{
+    char item[CCH_CORPUS_LINE];
+    size_t length = 0;
+
+    for(;;)
+    {
+        unsigned int n = (unsigned int)*record;
+        int written = _snprintf_s(item, sizeof(item), _TRUNCATE,
+            "{\"id\":%u,\"level\":\"%s\",\"latency\":%u.%02u,\"tags\":[\"worker-%u\",\"zone-%c\"]},",
+            n, (n % 5 == 0) ? "warn" : "info", n % 997, n % 100, n % 16, 'a' + n % 4);
+
+        if(written <= 0 || length + (size_t)written > dataSize)
+        {
+            break;
+        }
+
+        memcpy(data + length, item, (size_t)written);
+        length += (size_t)written;
+        (*record)++;
+    }
+
+    return length;
+}
+
+//
+// GetBenchCorpora
+// Returns the corpora the benchmarks run on, and how many there are
+//
+const BENCH_CORPUS * GetBenchCorpora(int * count)
+{
+    *count = ARRAYSIZE(g_corpora);
+    return g_corpora;
+}
+
+//
+// GetBenchPath
+// Converts a UTF-8 path from the command line to a wide path.
+// Returns FALSE if it's too long.
+//
+BOOL GetBenchPath(const char * path, WCHAR * widePath)
+{
+    int length = DecodeUtf8((const BYTE *)path, (int)strlen(path), widePath, MAX_PATH - 1);
+
+    if(length <= 0)
+    {
+        return FALSE;
+    }
+
+    widePath[length] = 0;
+    return TRUE;
+}
+
+//
+// WriteCorpusFiles
+// Writes a file of about fileBytes bytes for each corpus to directory,
+// a piece at a time, so they can be as large as the disk allows
+//
+BOOL WriteCorpusFiles(const char * directory, ULONGLONG fileBytes)
+{
+    BYTE * chunk = malloc(CB_CORPUS_CHUNK);
+    char path[MAX_PATH];
+    WCHAR widePath[MAX_PATH];
+    BOOL success = (chunk != NULL);
+
+    for(size_t i = 0; success && i < ARRAYSIZE(g_corpora); i++)
+    {
+        HANDLE hFile;
+        ULONGLONG record = 0;
+        ULONGLONG written = 0;
+        size_t chunkBytes;
+        DWORD bytesWritten;
+
+        _snprintf_s(path, sizeof(path), _TRUNCATE, "%s/%s", directory, g_corpora[i].fileName);
+        hFile = GetBenchPath(path, widePath) ?
+            CreateFile(widePath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL) :
+            INVALID_HANDLE_VALUE;
+        if(hFile == INVALID_HANDLE_VALUE)
+        {
+            fprintf(stderr, "Couldn't create %s\n", path);
+            success = FALSE;
+            break;
+        }
+
+        do
+        {
+            chunkBytes = g_corpora[i].generate(chunk, (size_t)min(fileBytes - written, CB_CORPUS_CHUNK), &record);
+            success = WriteFile(hFile, chunk, (DWORD)chunkBytes, &bytesWritten, NULL) && bytesWritten == chunkBytes;
+            written += chunkBytes;
+        } while(success && chunkBytes > 0 && written < fileBytes);
+
+        CloseHandle(hFile);
+        printf("%-40s %12llu bytes\n", path, written);
+    }
+
+    free(chunk);
+    return success;
+}
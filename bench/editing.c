@@ -0,0 +1,630 @@
+/* -------------------------------------------------------------
+
+editing.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    The stages of the benchmarks that measure what happens to a
+    document once it's open: repainting and highlighting its lines,
+    filtering them, editing a column of them, sorting and trimming
+    them, and journaling edits for recovery. They run on the document
+    text and its line table, the way the app runs them on the text of
+    the edit control.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "bench.h"
+
+//
+// GetBenchLineText
+// Gets the text of a line of the document, for the highlight cache.
+// context is a BENCH_INPUT.
+//
+BOOL GetBenchLineText(void * context, DWORD line, const WCHAR ** text, DWORD * length)
+{
+    BENCH_INPUT * input = context;
+
+    if(line >= input->lineCount)
+    {
+        return FALSE;
+    }
+
+    *text = input->document.text + input->lineStarts[line];
+    *length = GetLineLength(input->lineStarts, line);
+
+    return TRUE;
+}
+
+//
+// PaintBenchLines
+// Tokenizes a window of BENCH_VISIBLE_LINES lines from firstLine, like
+// PaintHighlights does for the lines the edit control shows. Returns
+// the number of characters in highlighted tokens.
+//
+size_t PaintBenchLines(BENCH_INPUT * input, HIGHLIGHT_CACHE * cache, DWORD firstLine)
+{
+    TOKEN tokens[MAX_LINE_TOKENS];
+    size_t highlighted = 0;
+
+    for(DWORD line = firstLine; line < input->lineCount && line - firstLine < BENCH_VISIBLE_LINES; line++)
+    {
+        DWORD tokenCount = TokenizeHighlightLine(cache, line, GetBenchLineText, input, tokens, MAX_LINE_TOKENS);
+
+        for(DWORD token = 0; token < tokenCount; token++)
+        {
+            highlighted += (tokens[token].type != TOKEN_TEXT) ? tokens[token].length : 0;
+        }
+    }
+
+    return highlighted;
+}
+
+//
+// RunRepaintStage
+// Switches the theme while the middle of the document is shown. The
+// text stays in the edit control, so only the visible lines are painted
+// again. The highlight cache starts out empty, which is the worst case.
+//
+size_t RunRepaintStage(BENCH_INPUT * input)
+{
+    HIGHLIGHT_CACHE cache;
+
+    InitHighlightCache(&cache, GetLogLexer());
+
+    return PaintBenchLines(input, &cache, input->lineCount / 2);
+}
+
+//
+// RunRecreateStage
+// Switches the theme the way it was done before it was a repaint: the
+// edit control was recreated, and all of its text copied out and back in
+//
+size_t RunRecreateStage(BENCH_INPUT * input)
+{
+    memcpy(input->work, input->document.text, input->document.length * sizeof(WCHAR));
+    memcpy(input->document.text, input->work, input->document.length * sizeof(WCHAR));
+
+    return RunRepaintStage(input);
+}
+
+//
+// RunScrollStage
+// Scrolls down BENCH_SCROLL_PAGES pages from the middle of the document,
+// painting each one. The highlight cache starts out empty, and slides
+// down with the window.
+//
+size_t RunScrollStage(BENCH_INPUT * input)
+{
+    HIGHLIGHT_CACHE cache;
+    DWORD firstLine = input->lineCount / 2;
+    size_t highlighted = 0;
+
+    InitHighlightCache(&cache, GetLogLexer());
+
+    for(DWORD page = 0; page < BENCH_SCROLL_PAGES && firstLine < input->lineCount; page++)
+    {
+        highlighted += PaintBenchLines(input, &cache, firstLine);
+        firstLine += BENCH_VISIBLE_LINES;
+    }
+
+    return highlighted;
+}
+
+//
+// PaintChangedLines
+// Paints the lines an edit to line changed the highlighting of, up to
+// lastChanged, like the rectangle HighlightOnEdit invalidates. Only the
+// ones before windowEnd are visible.
+//
+size_t PaintChangedLines(BENCH_INPUT * input, HIGHLIGHT_CACHE * cache, DWORD line, DWORD lastChanged,
+    DWORD windowEnd)
+{
+    TOKEN tokens[MAX_LINE_TOKENS];
+    size_t tokenCount = 0;
+
+    for(; line <= lastChanged && line < windowEnd && line < input->lineCount; line++)
+    {
+        tokenCount += TokenizeHighlightLine(cache, line, GetBenchLineText, input, tokens, MAX_LINE_TOKENS);
+    }
+
+    return tokenCount;
+}
+
+//
+// RunHighlightEditStage
+// Shows the middle of the document, then types BENCH_EDIT_KEYS keys
+// over the end of a visible line, alternating with a brace that starts
+// a JSON payload on the next lines. After each key the cache is resynced
+// from that line, and the lines that changed are painted again.
+//
+size_t RunHighlightEditStage(BENCH_INPUT * input)
+{
+    HIGHLIGHT_CACHE cache;
+    DWORD firstLine = input->lineCount / 2;
+    DWORD windowEnd = firstLine + BENCH_VISIBLE_LINES;
+    DWORD line = firstLine + BENCH_VISIBLE_LINES / 2;
+    DWORD lastChanged;
+    WCHAR * lastChar;
+    WCHAR original;
+    size_t painted;
+
+    if(line >= input->lineCount || GetLineLength(input->lineStarts, line) == 0)
+    {
+        input->problem = "there's no line to edit in the middle of the corpus";
+        return 0;
+    }
+
+    InitHighlightCache(&cache, GetLogLexer());
+    painted = PaintBenchLines(input, &cache, firstLine);
+
+    lastChar = input->document.text + input->lineStarts[line] + GetLineLength(input->lineStarts, line) - 1;
+    original = *lastChar;
+
+    for(DWORD key = 0; key < BENCH_EDIT_KEYS; key++)
+    {
+        *lastChar = (key % 2 == 0) ? L'{' : original;
+
+        lastChanged = InvalidateHighlightCache(&cache, line, line, 0, GetBenchLineText, input);
+        painted += PaintChangedLines(input, &cache, line, lastChanged, windowEnd);
+    }
+
+    *lastChar = original;
+
+    return painted;
+}
+
+//
+// FilterBenchLines
+// Filters all of the document's lines as one chunk, the way each
+// thread of BuildFilterMatches filters its part of the text. The
+// generated log's lines are numbered, so expected gives how many of
+// them should match for each line. Returns the number of matches.
+//
+size_t FilterBenchLines(BENCH_INPUT * input, const FILTER * filter, DWORD expected)
+{
+    FILTER_CHUNK chunk = {0};
+
+    chunk.text = input->document.text;
+    chunk.start = 0;
+    chunk.end = (DWORD)input->document.length;
+    chunk.filter = filter;
+
+    if(!FilterTextChunk(&chunk) || chunk.matchCount != expected)
+    {
+        input->problem = "the filter didn't match the lines it should have";
+    }
+
+    if(chunk.matches)
+    {
+        HeapFree(GetProcessHeap(), 0, chunk.matches);
+    }
+
+    return chunk.matchCount;
+}
+
+//
+// RunLevelFilterStage
+// Shows only the error and warning lines, which are half of the log
+//
+size_t RunLevelFilterStage(BENCH_INPUT * input)
+{
+    FILTER filter = { FILTER_LEVELS, NULL, FALSE };
+    DWORD lines = input->lineCount - 1;
+
+    // Every fourth line is a warning, and the one after it an error
+    return FilterBenchLines(input, &filter, (lines / 4) * 2 + (lines % 4 > 2 ? 1 : 0));
+}
+
+//
+// RunTextFilterStage
+// Shows only the lines of one worker, a sixteenth of the log,
+// ignoring case
+//
+size_t RunTextFilterStage(BENCH_INPUT * input)
+{
+    FILTER filter = { FILTER_TEXT, L"WORKER-7]", FALSE };
+    DWORD lines = input->lineCount - 1;
+
+    return FilterBenchLines(input, &filter, (lines + 8) / 16);
+}
+
+//
+// RunColumnStage
+// Inserts a column of text after the timestamp of every line of the
+// log, the way MainWndOnEditColumn does for a selection of all of it:
+// once to measure the result, then again to write it to scratch memory
+//
+size_t RunColumnStage(BENCH_INPUT * input)
+{
+    static const WCHAR inserted[] = L"| ";
+    DWORD lines = input->lineCount - 1;
+    DWORD column = 24;
+    size_t insertedLength = ARRAYSIZE(inserted) - 1;
+    size_t outputLength;
+    WCHAR * output;
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    outputLength = ApplyColumnEdit(input->document.text, input->lineStarts, lines, column, 0,
+        inserted, insertedLength, NULL);
+    output = ScratchAlloc((outputLength + 1) * sizeof(WCHAR));
+    if(!output)
+    {
+        input->problem = "there's no memory for the column edit";
+        ScratchEnd(scratch);
+        return 0;
+    }
+
+    ApplyColumnEdit(input->document.text, input->lineStarts, lines, column, 0,
+        inserted, insertedLength, output);
+    output[outputLength] = 0;
+
+    // Every line but the empty last one gets the column, and loses its CRLF
+    if(outputLength != input->document.length - 2 + lines * insertedLength ||
+        wmemcmp(output + column, inserted, insertedLength) != 0)
+    {
+        input->problem = "the column edit didn't insert the column on every line";
+    }
+
+    ScratchEnd(scratch);
+
+    return outputLength;
+}
+
+//
+// WriteBenchLines
+// Writes the document's lines in order to scratch memory, measuring the
+// result first like MainWndOnEditTransform does. The log's lines are
+// all different, so every one of them should still be there.
+//
+size_t WriteBenchLines(BENCH_INPUT * input, const DWORD * order, DWORD count)
+{
+    size_t outputLength;
+    WCHAR * output;
+
+    if(count != input->lineCount - 1)
+    {
+        input->problem = "a transform removed lines that weren't duplicates";
+        return 0;
+    }
+
+    outputLength = WriteLinesInOrder(input->document.text, input->lineStarts, order, count, NULL);
+    output = ScratchAlloc((outputLength + 1) * sizeof(WCHAR));
+    if(!output)
+    {
+        input->problem = "there's no memory for the transformed lines";
+        return 0;
+    }
+
+    WriteLinesInOrder(input->document.text, input->lineStarts, order, count, output);
+    output[outputLength] = 0;
+
+    return outputLength;
+}
+
+//
+// SortBenchLines
+// Sorts the line numbers of every line of the document but the empty
+// last one, on as many threads as Edit > Transform would, and checks
+// they're in order. Both arrays are in scratch memory. Returns the
+// order, or NULL if there wasn't enough memory.
+//
+DWORD * SortBenchLines(BENCH_INPUT * input, DWORD ** temp)
+{
+    DWORD lines = input->lineCount - 1;
+    DWORD * order = ScratchAlloc((size_t)lines * sizeof(DWORD));
+
+    *temp = ScratchAlloc((size_t)lines * sizeof(DWORD));
+    if(!order || !*temp)
+    {
+        input->problem = "there's no memory to sort the lines";
+        return NULL;
+    }
+
+    for(DWORD i = 0; i < lines; i++)
+    {
+        order[i] = i;
+    }
+
+    SortLinesInParallel(input->document.text, input->lineStarts, order, *temp, lines);
+
+    for(DWORD i = 1; i < lines; i++)
+    {
+        if(CompareLines(input->document.text, input->lineStarts, order[i - 1], order[i]) > 0)
+        {
+            input->problem = "the lines weren't sorted";
+            return NULL;
+        }
+    }
+
+    return order;
+}
+
+//
+// RunSortStage
+// Sorts all of the log's lines, and writes them in their new order
+//
+size_t RunSortStage(BENCH_INPUT * input)
+{
+    size_t length = 0;
+    DWORD * order;
+    DWORD * temp;
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    order = SortBenchLines(input, &temp);
+    if(order)
+    {
+        length = WriteBenchLines(input, order, input->lineCount - 1);
+    }
+
+    ScratchEnd(scratch);
+
+    return length;
+}
+
+//
+// RunSortUniqueStage
+// Sorts the log's lines, removes the lines that are the same as the
+// one before them, and writes the rest
+//
+size_t RunSortUniqueStage(BENCH_INPUT * input)
+{
+    size_t length = 0;
+    DWORD * order;
+    DWORD * temp;
+    DWORD count;
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    order = SortBenchLines(input, &temp);
+    if(order)
+    {
+        count = RemoveAdjacentDuplicates(input->document.text, input->lineStarts, order, input->lineCount - 1);
+        length = WriteBenchLines(input, order, count);
+    }
+
+    ScratchEnd(scratch);
+
+    return length;
+}
+
+//
+// RunRemoveDuplicatesStage
+// Removes each line of the log that's the same as one before it,
+// keeping the rest in their order
+//
+size_t RunRemoveDuplicatesStage(BENCH_INPUT * input)
+{
+    size_t length = 0;
+    DWORD lines = input->lineCount - 1;
+    DWORD * order;
+    DWORD * temp;
+    BYTE * keep;
+    DWORD count;
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    order = SortBenchLines(input, &temp);
+    keep = order ? ScratchAlloc(lines) : NULL;
+    if(keep)
+    {
+        count = RemoveLaterDuplicates(input->document.text, input->lineStarts, order, lines, keep, temp);
+        length = WriteBenchLines(input, temp, count);
+    }
+    else if(order)
+    {
+        input->problem = "there's no memory to remove the duplicate lines";
+    }
+
+    ScratchEnd(scratch);
+
+    return length;
+}
+
+//
+// RunTrimStage
+// Trims the whitespace from the end of each of the log's lines. There
+// isn't any, so the result is the lines as they were.
+//
+size_t RunTrimStage(BENCH_INPUT * input)
+{
+    DWORD lines = input->lineCount - 1;
+    size_t outputLength;
+    WCHAR * output;
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    outputLength = TrimTrailingWhitespace(input->document.text, input->lineStarts, lines, NULL);
+    output = ScratchAlloc((outputLength + 1) * sizeof(WCHAR));
+    if(output)
+    {
+        TrimTrailingWhitespace(input->document.text, input->lineStarts, lines, output);
+        output[outputLength] = 0;
+    }
+
+    if(!output || outputLength != input->document.length - 2)
+    {
+        input->problem = "trimming the lines changed them";
+    }
+
+    ScratchEnd(scratch);
+
+    return outputLength;
+}
+
+//
+// PrepareAutosaveText
+// Makes the copies of the document text the autosave stages edit and
+// journal, the first time one of them runs
+//
+BOOL PrepareAutosaveText(BENCH_INPUT * input)
+{
+    size_t capacity = input->document.length + BENCH_PASTE_CHARS + 1;
+
+    if(input->edited)
+    {
+        return TRUE;
+    }
+
+    input->edited = malloc(capacity * sizeof(WCHAR));
+    input->journaled = malloc(capacity * sizeof(WCHAR));
+    if(!input->edited || !input->journaled)
+    {
+        free(input->edited);
+        free(input->journaled);
+        input->edited = NULL;
+        input->journaled = NULL;
+        return FALSE;
+    }
+
+    memcpy(input->edited, input->document.text, input->document.length * sizeof(WCHAR));
+    memcpy(input->journaled, input->document.text, input->document.length * sizeof(WCHAR));
+    input->editedLength = input->document.length;
+    input->journaledLength = input->document.length;
+    ClearDirtyRange(&input->dirty);
+
+    return TRUE;
+}
+
+//
+// EditBenchText
+// Replaces removed characters at start with inserted, and leaves the
+// caret after them, like the edit control does for a key or a paste.
+// The edit is tracked the way RecoveryEditProc tracks it, or not at all,
+// the way every edit was before it.
+//
+void EditBenchText(BENCH_INPUT * input, size_t start, size_t removed, LPCWSTR inserted, size_t insertedLength,
+    BOOL tracked)
+{
+    size_t oldLength = input->editedLength;
+
+    memmove(input->edited + start + insertedLength, input->edited + start + removed,
+        (oldLength - start - removed) * sizeof(WCHAR));
+    if(insertedLength > 0)
+    {
+        memcpy(input->edited + start, inserted, insertedLength * sizeof(WCHAR));
+    }
+
+    input->editedLength = oldLength - removed + insertedLength;
+
+    if(tracked)
+    {
+        AddDirtyEdit(&input->dirty, oldLength, start, start + removed,
+            input->editedLength, start + insertedLength, start + insertedLength);
+    }
+    else
+    {
+        MarkAllDirty(&input->dirty);
+    }
+}
+
+//
+// AutosaveBenchText
+// Catches the journaled copy up with the edited text, like
+// AutosaveRecoveryJournal does on each tick. Returns the number
+// of characters in the change it found.
+//
+size_t AutosaveBenchText(BENCH_INPUT * input)
+{
+    size_t prefix;
+    size_t suffix;
+    size_t removed;
+    size_t inserted;
+
+    if(!FindChangedRange(input->journaled, input->journaledLength, input->edited, input->editedLength,
+        &input->dirty, &prefix, &suffix))
+    {
+        ClearDirtyRange(&input->dirty);
+        return 0;
+    }
+
+    removed = input->journaledLength - prefix - suffix;
+    inserted = input->editedLength - prefix - suffix;
+
+    memmove(input->journaled + prefix + inserted, input->journaled + prefix + removed, suffix * sizeof(WCHAR));
+    memcpy(input->journaled + prefix, input->edited + prefix, inserted * sizeof(WCHAR));
+    input->journaledLength = input->editedLength;
+    ClearDirtyRange(&input->dirty);
+
+    return removed + inserted;
+}
+
+//
+// RunAutosaveEdits
+// Inserts keyCount keys of keyLength characters each at position,
+// and autosaves, then deletes them again and autosaves, so the text
+// is the same for the next run. Returns the characters autosaved.
+//
+size_t RunAutosaveEdits(BENCH_INPUT * input, size_t position, LPCWSTR keys, size_t keyLength, size_t keyCount,
+    BOOL tracked)
+{
+    size_t changed;
+
+    if(!PrepareAutosaveText(input))
+    {
+        input->problem = "there wasn't enough memory for the autosave stages";
+        return 0;
+    }
+
+    for(size_t key = 0; key < keyCount; key++)
+    {
+        EditBenchText(input, position + key * keyLength, 0, keys + key * keyLength, keyLength, tracked);
+    }
+
+    changed = AutosaveBenchText(input);
+
+    // Backspace over them
+    for(size_t key = keyCount; key > 0; key--)
+    {
+        EditBenchText(input, position + (key - 1) * keyLength, keyLength, NULL, 0, tracked);
+    }
+
+    changed += AutosaveBenchText(input);
+
+    if(changed != 2 * keyCount * keyLength || input->journaledLength != input->document.length)
+    {
+        input->problem = "an autosave didn't find the edits made since the last one";
+    }
+
+    return changed;
+}
+
+//
+// RunTypingStage
+// Types a line at the end of the document for a second, between two
+// autosaves. The end is where the edit control doesn't have to move
+// the text after the caret, so only the autosave grows with the document.
+//
+size_t RunTypingStage(BENCH_INPUT * input)
+{
+    return RunAutosaveEdits(input, input->document.length, BENCH_TYPED_TEXT, 1,
+        ARRAYSIZE(BENCH_TYPED_TEXT) - 1, TRUE);
+}
+
+//
+// RunTypingScanStage
+// Types the same line, but autosaves by comparing the whole document,
+// the way it was done before edits were tracked
+//
+size_t RunTypingScanStage(BENCH_INPUT * input)
+{
+    return RunAutosaveEdits(input, input->document.length, BENCH_TYPED_TEXT, 1,
+        ARRAYSIZE(BENCH_TYPED_TEXT) - 1, FALSE);
+}
+
+//
+// RunPasteStage
+// Pastes up to BENCH_PASTE_CHARS of the document into its middle line,
+// between two autosaves
+//
+size_t RunPasteStage(BENCH_INPUT * input)
+{
+    return RunAutosaveEdits(input, input->lineStarts[input->lineCount / 2], input->document.text,
+        min(input->document.length, BENCH_PASTE_CHARS), 1, TRUE);
+}
+
+//
+// RunPasteScanStage
+// Pastes the same text, autosaving by comparing the whole document
+//
+size_t RunPasteScanStage(BENCH_INPUT * input)
+{
+    return RunAutosaveEdits(input, input->lineStarts[input->lineCount / 2], input->document.text,
+        min(input->document.length, BENCH_PASTE_CHARS), 1, FALSE);
+}
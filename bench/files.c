@@ -0,0 +1,225 @@
+/* -------------------------------------------------------------
+
+files.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Measures Find in Files on a generated tree of small logs, a
+    hundred to a folder, the way it searches a folder of them in
+    the app.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "bench.h"
+
+// The files the tree search looks in, and what it looks for: the line
+// of one record in 997 of the ASCII log, which has it once
+#define BENCH_TREE_PATTERN      L"*.log;*.txt"
+#define BENCH_TREE_SEARCH_TEXT  L"handled in 996 ms"
+
+// What's in the files of the tree the pattern doesn't match, which a
+// search that ignored the pattern would find
+#define BENCH_TREE_OTHER_TEXT   "2024-05-01 12:00:00.000 INFO request handled in 996 ms\n"
+
+//
+// globals
+//
+
+// The tree the find-files stage searches, and what it should find there
+WCHAR g_benchTreeFolder[MAX_PATH];
+LONG g_benchTreeFiles;      // that match BENCH_TREE_PATTERN
+LONG g_benchTreeMatches;
+
+//
+// WriteBenchTreeFile
+// Creates a file of the tree that holds size bytes of data
+//
+BOOL WriteBenchTreeFile(const char * path, const BYTE * data, size_t size)
+{
+    WCHAR widePath[MAX_PATH];
+    HANDLE hFile;
+    DWORD bytesWritten = 0;
+    BOOL success;
+
+    hFile = GetBenchPath(path, widePath) ?
+        CreateFile(widePath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL) :
+        INVALID_HANDLE_VALUE;
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        fprintf(stderr, "Couldn't create %s\n", path);
+        return FALSE;
+    }
+
+    success = WriteFile(hFile, data, (DWORD)size, &bytesWritten, NULL) && bytesWritten == size;
+    CloseHandle(hFile);
+
+    return success;
+}
+
+//
+// CreateBenchTreeFolder
+// Creates a folder of the tree, unless it's already there
+//
+BOOL CreateBenchTreeFolder(const char * path)
+{
+    WCHAR widePath[MAX_PATH];
+
+    if(!GetBenchPath(path, widePath) ||
+        (!CreateDirectory(widePath, NULL) && GetLastError() != ERROR_ALREADY_EXISTS))
+    {
+        fprintf(stderr, "Couldn't create %s\n", path);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// WriteBenchTree
+// Writes fileCount files into a tree in the current directory, with
+// BENCH_TREE_FOLDER_FILES in each folder and a hundred folders in
+// each folder above them. Every tenth file doesn't match the search's
+// pattern. The rest are BENCH_TREE_FILE_BYTES of the ASCII log, which
+// goes on from one file to the next. Returns the bytes of the files
+// the search reads, or 0 if the tree couldn't be written.
+//
+size_t WriteBenchTree(DWORD fileCount)
+{
+    BYTE data[BENCH_TREE_FILE_BYTES];
+    char folder[MAX_PATH];
+    char path[MAX_PATH];
+    ULONGLONG record = 0;
+    size_t treeBytes = 0;
+    size_t dataSize;
+
+    // The tree is named by its size, so one left from a run with more files isn't searched
+    _snprintf_s(folder, sizeof(folder), _TRUNCATE, "bench-tree-%u", fileCount);
+    if(!GetBenchPath(folder, g_benchTreeFolder) || !CreateBenchTreeFolder(folder))
+    {
+        return 0;
+    }
+
+    g_benchTreeFiles = 0;
+
+    for(DWORD i = 0; i < fileCount; i++)
+    {
+        DWORD group = i / BENCH_TREE_FOLDER_FILES;
+
+        if(i % (BENCH_TREE_FOLDER_FILES * 100) == 0)
+        {
+            _snprintf_s(path, sizeof(path), _TRUNCATE, "%s/%02u", folder, group / 100);
+            if(!CreateBenchTreeFolder(path))
+            {
+                return 0;
+            }
+        }
+
+        if(i % BENCH_TREE_FOLDER_FILES == 0)
+        {
+            _snprintf_s(path, sizeof(path), _TRUNCATE, "%s/%02u/%02u", folder, group / 100, group % 100);
+            if(!CreateBenchTreeFolder(path))
+            {
+                return 0;
+            }
+        }
+
+        if(i % 10 == 9)
+        {
+            _snprintf_s(path, sizeof(path), _TRUNCATE, "%s/%02u/%02u/file-%06u.dat",
+                folder, group / 100, group % 100, i);
+            if(!WriteBenchTreeFile(path, (const BYTE *)BENCH_TREE_OTHER_TEXT, strlen(BENCH_TREE_OTHER_TEXT)))
+            {
+                return 0;
+            }
+            continue;
+        }
+
+        _snprintf_s(path, sizeof(path), _TRUNCATE, "%s/%02u/%02u/file-%06u.log",
+            folder, group / 100, group % 100, i);
+        dataSize = GenerateAsciiLog(data, sizeof(data), &record);
+        if(!WriteBenchTreeFile(path, data, dataSize))
+        {
+            return 0;
+        }
+
+        treeBytes += dataSize;
+        g_benchTreeFiles++;
+    }
+
+    // Record n is found when n % 997 is 996
+    g_benchTreeMatches = (LONG)((record + 1) / 997);
+
+    return treeBytes;
+}
+
+//
+// RunFindFilesStage
+// Searches every log in the tree, the way Find in Files does
+//
+size_t RunFindFilesStage(BENCH_INPUT * input)
+{
+    static FILE_SEARCH search;
+    size_t resultCount;
+
+    ZeroMemory(&search, sizeof(search));
+    CopyMemory(search.folder, g_benchTreeFolder, sizeof(search.folder));
+    CopyMemory(search.pattern, BENCH_TREE_PATTERN, sizeof(BENCH_TREE_PATTERN));
+    CopyMemory(search.searchText, BENCH_TREE_SEARCH_TEXT, sizeof(BENCH_TREE_SEARCH_TEXT));
+    search.subfolders = TRUE;
+
+    if(!InitFileSearch(&search))
+    {
+        input->problem = "find-files couldn't allocate its buffers";
+        return 0;
+    }
+
+    RunFileSearch(&search);
+
+    if(search.fileCount != g_benchTreeFiles || search.resultCount != g_benchTreeMatches)
+    {
+        input->problem = "find-files didn't search every log, or find every match in them";
+    }
+
+    resultCount = (size_t)search.resultCount;
+    CloseFileSearch(&search);
+
+    return resultCount;
+}
+
+//
+// MeasureFileSearch
+// Writes a tree of fileCount files, and measures searching it. The
+// results are named by the number of files, like tree-100k.
+//
+BOOL MeasureFileSearch(BENCH_RESULTS * results, DWORD fileCount, int runs)
+{
+    static const BENCH_STAGE stage = { "find-files", RunFindFilesStage };
+    BENCH_INPUT input = {0};
+    char corpus[CCH_BENCH_NAME];
+
+    input.dataSize = WriteBenchTree(fileCount);
+    if(input.dataSize == 0)
+    {
+        fprintf(stderr, "Couldn't write a tree of %u files\n", fileCount);
+        return FALSE;
+    }
+
+    if(fileCount < 10000)
+    {
+        _snprintf_s(corpus, sizeof(corpus), _TRUNCATE, "tree-%u", fileCount);
+    }
+    else
+    {
+        _snprintf_s(corpus, sizeof(corpus), _TRUNCATE, "tree-%uk", fileCount / 1000);
+    }
+
+    MeasureStage(results, corpus, &stage, &input, runs);
+
+    if(input.problem)
+    {
+        fprintf(stderr, "%s: %s\n", corpus, input.problem);
+        return FALSE;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,947 @@
+/* -------------------------------------------------------------
+
+main.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Measures the stages of opening, searching, and saving a file
+    with the portable core, on each generated corpus, and reports
+    the throughput and latency percentiles of each one, as a table
+    and as JSON. It can also write the corpora to disk, and compare
+    the JSON of two runs to find regressions.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "bench.h"
+
+// The files opening is measured with, in the current directory
+#define BENCH_OPEN_FILE     L"bench-open.txt"
+#define BENCH_CACHE_FILE    L"bench-open-cache.bin"
+
+// The files saving is measured with, named like the app names them
+#define BENCH_SAVE_FILE     L"bench-save.txt"
+#define BENCH_SAVE_JOURNAL  L"bench-save.txt.esnpad-save"
+#define BENCH_SAVE_TEMP     L"bench-save.txt.esnpad-tmp"
+
+// Text that isn't in any corpus, so a search reads all of it
+#define BENCH_SEARCH_TEXT   L"timeout"
+
+//
+// globals
+//
+
+// Where the stages put what they computed, so it can't be optimized away
+volatile size_t g_benchSink;
+
+// The stages, in the order they're measured. They follow
+// SetEditTextFromFile, FindTextInEditControl, and SaveEditTextToActiveFile.
+const BENCH_STAGE g_stages[] =
+{
+    { "open",           RunOpenStage },
+    { "open-cached",    RunCachedOpenStage },
+    { "decode",         RunDecodeStage },
+    { "decode-cached",  RunCachedDecodeStage },
+    { "search",         RunSearchStage },
+    { "search-case",    RunCaseSearchStage },
+    { "line-endings",   RunLineEndingStage },
+    { "paste",          RunPasteLineEndingStage },
+    { "compare",        RunCompareStage },
+    { "encode",         RunEncodeStage },
+    { "hex",            RunHexStage },
+    { "scratch",        RunScratchStage },
+};
+
+// The stages measured on the ASCII log at growing sizes, to show how
+// their cost grows with the size of the document, if it does at all
+const BENCH_STAGE g_scalingStages[] =
+{
+    { "repaint",        RunRepaintStage },
+    { "recreate",       RunRecreateStage },
+    { "scroll",         RunScrollStage },
+    { "highlight-edit", RunHighlightEditStage },
+    { "filter-levels",  RunLevelFilterStage },
+    { "filter-text",    RunTextFilterStage },
+    { "column",         RunColumnStage },
+    { "sort",           RunSortStage },
+    { "sort-unique",    RunSortUniqueStage },
+    { "remove-duplicates", RunRemoveDuplicatesStage },
+    { "trim",           RunTrimStage },
+    { "autosave-typing", RunTypingStage },
+    { "autosave-typing-scan", RunTypingScanStage },
+    { "autosave-paste", RunPasteStage },
+    { "autosave-paste-scan", RunPasteScanStage },
+};
+
+//
+// GetSeconds
+// Returns the performance counter as seconds
+//
+double GetSeconds(void)
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+
+    return (double)now.QuadPart / (double)frequency.QuadPart;
+}
+
+//
+// FormatHexRows
+// Formats every row of data, like scrolling through the whole file in
+// the hex view. Returns the total length of the rows, so the work can't
+// be optimized away.
+//
+size_t FormatHexRows(const BYTE * data, size_t dataSize)
+{
+    WCHAR line[CCH_HEX_ROW];
+    int offsetDigits = GetHexOffsetDigits(dataSize);
+    size_t total = 0;
+
+    for(size_t offset = 0; offset < dataSize; offset += HEX_BYTES_PER_ROW)
+    {
+        total += (size_t)FormatHexRow(line, offset, data + offset,
+            min(dataSize - offset, HEX_BYTES_PER_ROW), offsetDigits);
+    }
+
+    return total;
+}
+
+//
+// GetEncodedSize
+// Returns the number of bytes text is encoded as, a chunk at a time
+//
+ULONGLONG GetEncodedSize(LPCWSTR text, size_t textLength, int encoding, BYTE * chunk)
+{
+    ULONGLONG size = 0;
+    size_t charsEncoded;
+
+    while(textLength > 0)
+    {
+        size += EncodeWideTextChunk(text, textLength, encoding, chunk, CB_WRITE_CHUNK, &charsEncoded);
+        if(charsEncoded == 0)
+        {
+            break;
+        }
+
+        text += charsEncoded;
+        textLength -= charsEncoded;
+    }
+
+    return size;
+}
+
+//
+// SaveInPlace
+// Saves text over BENCH_SAVE_FILE, which holds data, the way
+// SaveIncremental does: the first changed chunk is found, the bytes
+// from there are journaled, and the end of the file is rewritten.
+// Returns the number of bytes written, journal included, or 0 if
+// the save failed.
+//
+ULONGLONG SaveInPlace(const BYTE * data, size_t dataSize, LPCWSTR text, size_t textLength, BYTE * chunk)
+{
+    HANDLE hFile;
+    ULONGLONG offset;
+    size_t charsSame;
+    size_t bytesWritten = 0;
+    BOOL success = FALSE;
+
+    offset = FindFirstChangedChunk(text, textLength, ENCODING_UTF_8, data, dataSize, chunk, &charsSame);
+
+    hFile = CreateFile(BENCH_SAVE_FILE, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        success = WriteSaveJournal(BENCH_SAVE_JOURNAL, data, offset, dataSize) &&
+            RewriteFileTail(hFile, offset, text + charsSame, textLength - charsSame,
+                ENCODING_UTF_8, chunk, &bytesWritten);
+
+        CloseHandle(hFile);
+        DeleteFile(BENCH_SAVE_JOURNAL);
+    }
+
+    return success ? sizeof(SAVE_JOURNAL_HEADER) + (dataSize - offset) + bytesWritten : 0;
+}
+
+//
+// SaveCopy
+// Saves text over BENCH_SAVE_FILE the way SaveFullCopy does: it's
+// written to a temporary file that then replaces the original.
+// Returns the number of bytes written, or 0 if the save failed.
+//
+ULONGLONG SaveCopy(LPCWSTR text, size_t textLength, BYTE * chunk)
+{
+    HANDLE hFile;
+    size_t bytesWritten = 0;
+    BOOL success;
+
+    hFile = CreateFile(BENCH_SAVE_TEMP, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+
+    success = WriteEncodedText(hFile, text, textLength, ENCODING_UTF_8, chunk, &bytesWritten) &&
+        FlushFileBuffers(hFile);
+
+    CloseHandle(hFile);
+
+    success = success && MoveFileEx(BENCH_SAVE_TEMP, BENCH_SAVE_FILE, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    if(!success)
+    {
+        DeleteFile(BENCH_SAVE_TEMP);
+    }
+
+    return success ? bytesWritten : 0;
+}
+
+//
+// WriteBenchSaveFile
+// Puts the original bytes of the file being saved back on disk
+//
+BOOL WriteBenchSaveFile(const BYTE * data, size_t dataSize)
+{
+    HANDLE hFile;
+    DWORD bytesWritten;
+    BOOL success = TRUE;
+
+    hFile = CreateFile(BENCH_SAVE_FILE, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    for(size_t offset = 0; success && offset < dataSize; offset += bytesWritten)
+    {
+        DWORD chunkBytes = (DWORD)min(dataSize - offset, CB_WRITE_CHUNK);
+
+        success = WriteFile(hFile, data + offset, chunkBytes, &bytesWritten, NULL) && bytesWritten == chunkBytes;
+    }
+
+    CloseHandle(hFile);
+    return success;
+}
+
+//
+// MeasureSaves
+// Inserts a character into a copy of the text at several places, and
+// saves each edit to disk both ways: rewriting the file in place from
+// the first changed chunk, journal included, and writing a full copy.
+// Prints the bytes each one wrote and how long it took. The save that
+// IsIncrementalSaveWorthwhile chooses is marked.
+//
+void MeasureSaves(const BYTE * data, size_t dataSize)
+{
+    static const double positions[] = { 1.0, 0.99, 0.9, 0.75, 0.5, 0.1, 0.0 };
+    WCHAR * text = malloc(((size_t)dataSize + 2) * sizeof(WCHAR));
+    BYTE * chunk = malloc(CB_WRITE_CHUNK);
+    int textLength;
+
+    if(!text || !chunk)
+    {
+        free(text);
+        free(chunk);
+        return;
+    }
+
+    // The text as it was read, before its line endings are converted
+    textLength = DecodeUtf8(data, (int)dataSize, text, (int)dataSize);
+
+    printf("edit at   first change         in place               full copy\n");
+    for(size_t i = 0; i < ARRAYSIZE(positions); i++)
+    {
+        size_t position = (size_t)(textLength * positions[i]);
+        int editLength = textLength + 1;
+        ULONGLONG offset;
+        ULONGLONG inPlace = 0;
+        ULONGLONG copy = 0;
+        size_t charsSame;
+        double start;
+        double inPlaceSeconds = 0;
+        double copySeconds = 0;
+        BOOL incremental;
+
+        // Insert one character, which moves everything after it
+        memmove(text + position + 1, text + position, (textLength - position) * sizeof(WCHAR));
+        text[position] = L'#';
+
+        offset = FindFirstChangedChunk(text, editLength, ENCODING_UTF_8, data, dataSize, chunk, &charsSame);
+        incremental = IsIncrementalSaveWorthwhile(dataSize, offset);
+
+        if(WriteBenchSaveFile(data, dataSize))
+        {
+            start = GetSeconds();
+            inPlace = SaveInPlace(data, dataSize, text, editLength, chunk);
+            inPlaceSeconds = GetSeconds() - start;
+        }
+
+        if(WriteBenchSaveFile(data, dataSize))
+        {
+            start = GetSeconds();
+            copy = SaveCopy(text, editLength, chunk);
+            copySeconds = GetSeconds() - start;
+        }
+
+        printf("%6.1f%%  %10.1f MB  %8.1f MB %8.1f ms%s %8.1f MB %8.1f ms%s\n",
+            positions[i] * 100, offset / 1e6, inPlace / 1e6, inPlaceSeconds * 1000, incremental ? "*" : " ",
+            copy / 1e6, copySeconds * 1000, incremental ? " " : "*");
+
+        memmove(text + position, text + position + 1, (textLength - position) * sizeof(WCHAR));
+    }
+
+    DeleteFile(BENCH_SAVE_FILE);
+
+    free(text);
+    free(chunk);
+}
+
+//
+// OpenWithCache
+// Opens BENCH_OPEN_FILE the way the app does: it's fingerprinted, read,
+// and decoded, with what the open cache knows about it if anything.
+// A file the cache didn't know is added to it. Returns whether the
+// cache knew the file.
+//
+BOOL OpenWithCache(void)
+{
+    static OPEN_CACHE cache;
+    HANDLE hFile;
+    LARGE_INTEGER fileSize;
+    FILE_FINGERPRINT fingerprint;
+    DOCUMENT_INFO known;
+    DOCUMENT_INFO info;
+    DOCUMENT_TEXT document = {0};
+    BYTE * data;
+    size_t dataSize = 0;
+    BOOL cached = FALSE;
+
+    hFile = CreateFile(BENCH_OPEN_FILE, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    if(GetFileFingerprint(hFile, &fingerprint) && GetFileSizeEx(hFile, &fileSize))
+    {
+        data = malloc((size_t)fileSize.QuadPart);
+        if(data && ReadAllFileBytes(hFile, data, (size_t)fileSize.QuadPart, &dataSize))
+        {
+            ReadOpenCache(BENCH_CACHE_FILE, &cache);
+            cached = FindOpenCacheEntry(&cache, BENCH_OPEN_FILE, &fingerprint, &known);
+
+            if(DecodeDocument(data, dataSize, FALSE, cached ? &known : NULL, &document) && !cached)
+            {
+                GetDocumentInfo(&document, FALSE, &info);
+                AddOpenCacheEntry(&cache, BENCH_OPEN_FILE, &fingerprint, &info);
+            }
+            WriteOpenCache(BENCH_CACHE_FILE, &cache);
+            HeapFree(GetProcessHeap(), 0, document.text);
+        }
+        free(data);
+    }
+
+    CloseHandle(hFile);
+
+    return cached;
+}
+
+//
+// RunOpenStage
+// Opens the corpus file when the open cache doesn't know it yet
+//
+size_t RunOpenStage(BENCH_INPUT * input)
+{
+    DeleteFile(BENCH_CACHE_FILE);
+
+    if(OpenWithCache())
+    {
+        input->problem = "the open cache knew a file it was never told about";
+    }
+
+    return input->dataSize;
+}
+
+//
+// RunCachedOpenStage
+// Opens the corpus file again, when the open cache knows it
+//
+size_t RunCachedOpenStage(BENCH_INPUT * input)
+{
+    if(!OpenWithCache())
+    {
+        input->problem = "the open cache didn't know a file it was told about";
+    }
+
+    return input->dataSize;
+}
+
+//
+// RunDecodeStage
+// Decodes the corpus the first time, finding out its encoding,
+// length, and line endings
+//
+size_t RunDecodeStage(BENCH_INPUT * input)
+{
+    DOCUMENT_TEXT document = {0};
+
+    DecodeDocument(input->data, input->dataSize, FALSE, NULL, &document);
+    HeapFree(GetProcessHeap(), 0, document.text);
+
+    return document.length;
+}
+
+//
+// RunCachedDecodeStage
+// Decodes the corpus with what the open cache knows about it
+//
+size_t RunCachedDecodeStage(BENCH_INPUT * input)
+{
+    DOCUMENT_TEXT document = {0};
+
+    DecodeDocument(input->data, input->dataSize, FALSE, &input->info, &document);
+    HeapFree(GetProcessHeap(), 0, document.text);
+
+    return document.length;
+}
+
+//
+// SearchDocument
+// Searches all of the document text for text that isn't in it
+//
+size_t SearchDocument(BENCH_INPUT * input, BOOL matchCase)
+{
+    DWORD found = FindTextInBuffer(input->document.text, (DWORD)input->document.length,
+        BENCH_SEARCH_TEXT, matchCase, TRUE, 0);
+
+    if(found != FIND_NOT_FOUND)
+    {
+        input->problem = "the search found text that isn't in the corpus";
+    }
+
+    return found;
+}
+
+//
+// RunSearchStage
+//
+size_t RunSearchStage(BENCH_INPUT * input)
+{
+    return SearchDocument(input, FALSE);
+}
+
+//
+// RunCaseSearchStage
+//
+size_t RunCaseSearchStage(BENCH_INPUT * input)
+{
+    return SearchDocument(input, TRUE);
+}
+
+//
+// RunLineEndingStage
+// Puts the file's own line endings back into a copy of the document
+// text, the way a save does with the text from the edit control
+//
+size_t RunLineEndingStage(BENCH_INPUT * input)
+{
+    memcpy(input->work, input->document.text, input->document.length * sizeof(WCHAR));
+
+    return ConvertLineEndingsFromCRLF(input->work, input->document.length,
+        GetDominantLineEnding(&input->document.lineEndings));
+}
+
+//
+// RunPasteLineEndingStage
+// Converts text with the file's own line endings to CRLF, the way
+// PasteIntoEdit does with text from the clipboard that another app
+// put there. Text that's all CRLF already is pasted as it is.
+//
+size_t RunPasteLineEndingStage(BENCH_INPUT * input)
+{
+    LINE_ENDING_COUNTS lineEndings;
+    size_t length;
+
+    CountLineEndings(input->saveText, input->saveLength, &lineEndings);
+    if(lineEndings.lf == 0 && lineEndings.cr == 0)
+    {
+        return input->saveLength;
+    }
+
+    memcpy(input->work, input->saveText, input->saveLength * sizeof(WCHAR));
+    input->work[input->saveLength] = 0;
+    length = ConvertLineEndingsToCRLF(input->work, input->saveLength, &lineEndings);
+    ReplaceControlChars(input->work, length, FALSE);
+
+    if(length != input->document.length)
+    {
+        input->problem = "pasting the text didn't give back the text of the document";
+    }
+
+    return length;
+}
+
+//
+// RunCompareStage
+// Compares the text a save encodes with the file, which is all the
+// same when nothing was edited
+//
+size_t RunCompareStage(BENCH_INPUT * input)
+{
+    size_t charsSame;
+    ULONGLONG offset = FindFirstChangedChunk(input->saveText, input->saveLength, input->document.encoding,
+        input->data, input->dataSize, input->chunk, &charsSame);
+
+    if(offset != input->dataSize)
+    {
+        input->problem = "the text a save writes isn't the same as the corpus";
+    }
+
+    return (size_t)offset;
+}
+
+//
+// RunEncodeStage
+// Encodes the text a save writes, a chunk at a time
+//
+size_t RunEncodeStage(BENCH_INPUT * input)
+{
+    return (size_t)GetEncodedSize(input->saveText, input->saveLength, input->document.encoding, input->chunk);
+}
+
+//
+// RunHexStage
+//
+size_t RunHexStage(BENCH_INPUT * input)
+{
+    return FormatHexRows(input->data, input->dataSize);
+}
+
+//
+// RunScratchStage
+// Finds text, then encodes the text for a save, each as its own scratch
+// operation, the way FindTextInEditControl and SaveWideTextToFile use
+// the arena: the search copies the text into a scratch buffer, and the
+// save encodes into a scratch chunk. After the first run, both reuse
+// the arena's blocks instead of allocating from the OS.
+//
+size_t RunScratchStage(BENCH_INPUT * input)
+{
+    SCRATCH_MARK scratch;
+    WCHAR * text;
+    BYTE * chunk;
+    DWORD found = FIND_NOT_FOUND;
+    size_t encoded = 0;
+
+    scratch = ScratchBegin();
+    text = ScratchAlloc((input->document.length + 1) * sizeof(WCHAR));
+    if(text)
+    {
+        memcpy(text, input->document.text, input->document.length * sizeof(WCHAR));
+        text[input->document.length] = 0;
+        found = FindTextInBuffer(text, (DWORD)input->document.length, BENCH_SEARCH_TEXT, FALSE, TRUE, 0);
+    }
+    ScratchEnd(scratch);
+
+    scratch = ScratchBegin();
+    chunk = ScratchAlloc(CB_WRITE_CHUNK);
+    if(chunk)
+    {
+        encoded = (size_t)GetEncodedSize(input->saveText, input->saveLength, input->document.encoding, chunk);
+    }
+    ScratchEnd(scratch);
+
+    if(!text || !chunk || found != FIND_NOT_FOUND)
+    {
+        input->problem = "the search and save in the scratch arena didn't run";
+    }
+
+    return encoded;
+}
+
+//
+// PrintScratchStats
+// Prints how the scratch arena was used, so blocks made for each
+// operation instead of reused would show up
+//
+void PrintScratchStats(void)
+{
+    SCRATCH_STATS stats;
+
+    GetScratchStats(&stats);
+    printf("scratch arena: %llu allocations, %llu blocks made, %llu reused, peak %llu MB, %llu MB kept\n",
+        stats.allocations, stats.blocksCreated, stats.blocksReused,
+        stats.peakBytes / (1024 * 1024), stats.retainedBytes / (1024 * 1024));
+}
+
+//
+// FreeBenchInput
+//
+void FreeBenchInput(BENCH_INPUT * input)
+{
+    HeapFree(GetProcessHeap(), 0, input->document.text);
+    free(input->saveText);
+    free(input->work);
+    free(input->chunk);
+    free(input->lineStarts);
+    free(input->edited);
+    free(input->journaled);
+    ZeroMemory(input, sizeof(*input));
+
+    DeleteFile(BENCH_CACHE_FILE);
+    DeleteFile(BENCH_OPEN_FILE);
+}
+
+//
+// PrepareBenchInput
+// Decodes a corpus, makes the text a save of it encodes, and writes
+// it to the file the open stages read
+//
+BOOL PrepareBenchInput(BENCH_INPUT * input, const BYTE * data, size_t dataSize)
+{
+    HANDLE hFile;
+    DWORD bytesWritten = 0;
+    BOOL success;
+
+    ZeroMemory(input, sizeof(*input));
+    input->data = data;
+    input->dataSize = dataSize;
+
+    if(!DecodeDocument(data, dataSize, FALSE, NULL, &input->document))
+    {
+        return FALSE;
+    }
+
+    GetDocumentInfo(&input->document, FALSE, &input->info);
+    input->lineCount = CountTextLines(input->document.text, (DWORD)input->document.length);
+    input->lineStarts = malloc(((size_t)input->lineCount + 1) * sizeof(DWORD));
+    input->saveText = malloc((input->document.length + 1) * sizeof(WCHAR));
+    input->work = malloc((input->document.length + 1) * sizeof(WCHAR));
+    input->chunk = malloc(CB_WRITE_CHUNK);
+    if(!input->lineStarts || !input->saveText || !input->work || !input->chunk)
+    {
+        FreeBenchInput(input);
+        return FALSE;
+    }
+
+    FillLineTable(input->document.text, (DWORD)input->document.length, input->lineStarts);
+
+    memcpy(input->saveText, input->document.text, input->document.length * sizeof(WCHAR));
+    input->saveLength = ConvertLineEndingsFromCRLF(input->saveText, input->document.length,
+        GetDominantLineEnding(&input->document.lineEndings));
+
+    hFile = CreateFile(BENCH_OPEN_FILE, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    success = (hFile != INVALID_HANDLE_VALUE);
+    if(success)
+    {
+        success = WriteFile(hFile, data, (DWORD)dataSize, &bytesWritten, NULL) && bytesWritten == dataSize;
+        CloseHandle(hFile);
+    }
+
+    if(!success)
+    {
+        FreeBenchInput(input);
+    }
+
+    return success;
+}
+
+//
+// MeasureStage
+// Runs a stage once to warm up, then runs times more, and adds how
+// long those took to results
+//
+void MeasureStage(BENCH_RESULTS * results, const char * corpus, const BENCH_STAGE * stage,
+    BENCH_INPUT * input, int runs)
+{
+    double latencies[BENCH_MAX_RUNS];
+    const BENCH_RESULT * result;
+
+    g_benchSink += stage->run(input);
+
+    for(int run = 0; run < runs; run++)
+    {
+        double start = GetSeconds();
+
+        g_benchSink += stage->run(input);
+        latencies[run] = GetSeconds() - start;
+    }
+
+    AddBenchResult(results, corpus, stage->name, latencies, runs, input->dataSize);
+
+    result = &results->results[results->resultCount - 1];
+    printf("%-12s %-20s %10.1f %10.3f %10.3f %10.3f\n", result->corpus, result->stage,
+        result->mbPerSecond, result->p50Ms, result->p90Ms, result->p99Ms);
+}
+
+//
+// MeasureScaling
+// Measures the scaling stages on the ASCII log at BENCH_SCALING_STEPS
+// sizes, up to dataBytes. The results of each size are named by its
+// number of lines, like log-410k.
+//
+BOOL MeasureScaling(BENCH_RESULTS * results, BYTE * data, size_t dataBytes, int runs)
+{
+    for(int step = BENCH_SCALING_STEPS - 1; step >= 0; step--)
+    {
+        BENCH_INPUT input;
+        ULONGLONG record = 0;
+        char corpus[CCH_BENCH_NAME];
+        size_t dataSize = GenerateAsciiLog(data, dataBytes >> (2 * step), &record);
+
+        if(!PrepareBenchInput(&input, data, dataSize))
+        {
+            fprintf(stderr, "Couldn't prepare %zu bytes of the ascii-log corpus\n", dataSize);
+            return FALSE;
+        }
+
+        if(input.lineCount < 10000)
+        {
+            _snprintf_s(corpus, sizeof(corpus), _TRUNCATE, "log-%u", input.lineCount);
+        }
+        else
+        {
+            _snprintf_s(corpus, sizeof(corpus), _TRUNCATE, "log-%uk", input.lineCount / 1000);
+        }
+
+        for(size_t stage = 0; stage < ARRAYSIZE(g_scalingStages); stage++)
+        {
+            MeasureStage(results, corpus, &g_scalingStages[stage], &input, runs);
+        }
+
+        if(input.problem)
+        {
+            fprintf(stderr, "%s: %s\n", corpus, input.problem);
+            FreeBenchInput(&input);
+            return FALSE;
+        }
+
+        FreeBenchInput(&input);
+    }
+
+    return TRUE;
+}
+
+//
+// RunBenchmarks
+// Generates dataBytes of each corpus, measures every stage on it, then
+// Find in Files on a tree of treeFiles files, and writes the results
+// to jsonPath if it isn't NULL
+//
+int RunBenchmarks(size_t dataBytes, int runs, DWORD treeFiles, const char * jsonPath)
+{
+    BENCH_RESULTS * results = calloc(1, sizeof(BENCH_RESULTS));
+    BYTE * data = malloc(dataBytes);
+    const BENCH_CORPUS * corpora;
+    int corpusCount;
+    BOOL success = TRUE;
+
+    if(!results || !data)
+    {
+        fprintf(stderr, "Not enough memory for %zu MB of text\n", dataBytes / (1024 * 1024));
+        free(results);
+        free(data);
+        return 1;
+    }
+
+    corpora = GetBenchCorpora(&corpusCount);
+    results->corpusBytes = dataBytes;
+    results->runs = runs;
+
+    printf("%-12s %-20s %10s %10s %10s %10s\n", "corpus", "stage", "MB/s", "p50 ms", "p90 ms", "p99 ms");
+
+    for(int i = 0; i < corpusCount && success; i++)
+    {
+        BENCH_INPUT input;
+        ULONGLONG record = 0;
+        size_t dataSize = corpora[i].generate(data, dataBytes, &record);
+
+        success = PrepareBenchInput(&input, data, dataSize);
+        if(!success)
+        {
+            fprintf(stderr, "Couldn't prepare the %s corpus\n", corpora[i].name);
+            break;
+        }
+
+        for(size_t stage = 0; stage < ARRAYSIZE(g_stages); stage++)
+        {
+            MeasureStage(results, corpora[i].name, &g_stages[stage], &input, runs);
+        }
+
+        if(input.problem)
+        {
+            fprintf(stderr, "%s: %s\n", corpora[i].name, input.problem);
+            success = FALSE;
+        }
+
+        FreeBenchInput(&input);
+    }
+
+    if(success)
+    {
+        success = MeasureScaling(results, data, dataBytes, runs);
+    }
+
+    if(success)
+    {
+        success = MeasureFileSearch(results, treeFiles, runs);
+    }
+
+    // The bytes each way of saving an edited log writes, and how long it takes
+    if(success)
+    {
+        ULONGLONG record = 0;
+
+        MeasureSaves(data, corpora[0].generate(data, dataBytes, &record));
+    }
+
+    PrintScratchStats();
+
+    results->peakMemoryBytes = GetPeakMemoryUsage();
+    printf("peak memory %llu MB\n", results->peakMemoryBytes / (1024 * 1024));
+
+    if(success && jsonPath && !WriteBenchResults(jsonPath, results))
+    {
+        fprintf(stderr, "Couldn't write %s\n", jsonPath);
+        success = FALSE;
+    }
+
+    free(data);
+    free(results);
+
+    return success ? 0 : 1;
+}
+
+//
+// RunCompare
+// Compares the results in two JSON files. Returns 1 if anything
+// regressed by more than thresholdPercent.
+//
+int RunCompare(const char * baselinePath, const char * currentPath, double thresholdPercent)
+{
+    BENCH_RESULTS * baseline = malloc(sizeof(BENCH_RESULTS));
+    BENCH_RESULTS * current = malloc(sizeof(BENCH_RESULTS));
+    int exitCode = 1;
+
+    if(!baseline || !current)
+    {
+        fprintf(stderr, "Not enough memory\n");
+    }
+    else if(!ReadBenchResults(baselinePath, baseline))
+    {
+        fprintf(stderr, "Couldn't read results from %s\n", baselinePath);
+    }
+    else if(!ReadBenchResults(currentPath, current))
+    {
+        fprintf(stderr, "Couldn't read results from %s\n", currentPath);
+    }
+    else
+    {
+        exitCode = (CompareBenchResults(baseline, current, thresholdPercent) > 0) ? 1 : 0;
+    }
+
+    free(baseline);
+    free(current);
+
+    return exitCode;
+}
+
+//
+// PrintUsage
+//
+int PrintUsage(void)
+{
+    fprintf(stderr,
+        "usage: esncore_bench [--size MB] [--runs N] [--files N] [--json PATH]\n"
+        "       esncore_bench --generate DIRECTORY [--size MB]\n"
+        "       esncore_bench --compare BASELINE CURRENT [--threshold PERCENT]\n"
+        "\n"
+        "  --size       MB of each corpus: up to %d in memory, or %d written by --generate (default %d)\n"
+        "  --runs       times each stage is measured, up to %d (default %d)\n"
+        "  --files      files in the tree Find in Files searches, up to %d (default %d)\n"
+        "  --json       writes the results to PATH as JSON\n"
+        "  --generate   writes each corpus to DIRECTORY instead of measuring\n"
+        "  --compare    flags the stages that regressed between two JSON results\n"
+        "  --threshold  percentage a stage may get slower before it's flagged (default %.0f)\n",
+        BENCH_MAX_DATA_MB, BENCH_MAX_FILE_MB, BENCH_DATA_MB, BENCH_MAX_RUNS, BENCH_RUNS,
+        BENCH_MAX_TREE_FILES, BENCH_TREE_FILES, BENCH_THRESHOLD_PERCENT);
+
+    return 2;
+}
+
+//
+// main
+//
+int main(int argc, char * argv[])
+{
+    int sizeMb = BENCH_DATA_MB;
+    int runs = BENCH_RUNS;
+    int treeFiles = BENCH_TREE_FILES;
+    double thresholdPercent = BENCH_THRESHOLD_PERCENT;
+    const char * jsonPath = NULL;
+    const char * generateDirectory = NULL;
+    const char * baselinePath = NULL;
+    const char * currentPath = NULL;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            sizeMb = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+        {
+            runs = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--files") == 0 && i + 1 < argc)
+        {
+            treeFiles = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+        {
+            jsonPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--generate") == 0 && i + 1 < argc)
+        {
+            generateDirectory = argv[++i];
+        }
+        else if(strcmp(argv[i], "--compare") == 0 && i + 2 < argc)
+        {
+            baselinePath = argv[++i];
+            currentPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            thresholdPercent = strtod(argv[++i], NULL);
+        }
+        else
+        {
+            return PrintUsage();
+        }
+    }
+
+    if(baselinePath)
+    {
+        return RunCompare(baselinePath, currentPath, thresholdPercent);
+    }
+
+    if(generateDirectory)
+    {
+        if(sizeMb < 1 || sizeMb > BENCH_MAX_FILE_MB)
+        {
+            return PrintUsage();
+        }
+
+        return WriteCorpusFiles(generateDirectory, (ULONGLONG)sizeMb * 1024 * 1024) ? 0 : 1;
+    }
+
+    if(sizeMb < 1 || sizeMb > BENCH_MAX_DATA_MB || runs < 1 || runs > BENCH_MAX_RUNS ||
+        treeFiles < 1 || treeFiles > BENCH_MAX_TREE_FILES)
+    {
+        return PrintUsage();
+    }
+
+    return RunBenchmarks((size_t)sizeMb * 1024 * 1024, runs, (DWORD)treeFiles, jsonPath);
+}
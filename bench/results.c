@@ -0,0 +1,336 @@
+/* -------------------------------------------------------------
+
+results.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the results of a benchmark run: the latency percentiles
+    and throughput of each stage, writing them as JSON and reading
+    them back, and comparing two runs to find what got slower.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "bench.h"
+
+// Room for the JSON of a whole run
+#define CB_BENCH_JSON       (BENCH_MAX_RESULTS * 512 + CB_BUFFER)
+
+// The most bytes read from a file of JSON results
+#define CB_BENCH_JSON_READ  (1024 * 1024)
+
+//
+// CompareLatencies
+// qsort callback that orders latencies from the shortest
+//
+int CompareLatencies(const void * a, const void * b)
+{
+    double first = *(const double *)a;
+    double second = *(const double *)b;
+
+    return (first > second) - (first < second);
+}
+
+//
+// GetPercentile
+// Returns the latency that percent of the sorted latencies are at or
+// below, by the nearest rank
+//
+double GetPercentile(const double * latencies, int count, double percent)
+{
+    int rank = (int)((percent / 100.0) * count + 0.999999);
+
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+
+    return latencies[min(rank, count) - 1];
+}
+
+//
+// AddBenchResult
+// Adds how a stage did on a corpus, from the seconds each of its runs
+// took. latencies is sorted in place.
+//
+void AddBenchResult(BENCH_RESULTS * results, const char * corpus, const char * stage,
+    double * latencies, int runs, ULONGLONG corpusBytes)
+{
+    BENCH_RESULT * result;
+
+    if(results->resultCount >= BENCH_MAX_RESULTS || runs <= 0)
+    {
+        return;
+    }
+
+    result = &results->results[results->resultCount++];
+    ZeroMemory(result, sizeof(*result));
+    _snprintf_s(result->corpus, sizeof(result->corpus), _TRUNCATE, "%s", corpus);
+    _snprintf_s(result->stage, sizeof(result->stage), _TRUNCATE, "%s", stage);
+
+    qsort(latencies, (size_t)runs, sizeof(double), CompareLatencies);
+    result->p50Ms = GetPercentile(latencies, runs, 50) * 1000;
+    result->p90Ms = GetPercentile(latencies, runs, 90) * 1000;
+    result->p99Ms = GetPercentile(latencies, runs, 99) * 1000;
+    result->mbPerSecond = (result->p50Ms > 0) ? (double)corpusBytes / (result->p50Ms / 1000) / 1e6 : 0;
+    result->peakMemoryBytes = GetPeakMemoryUsage();
+}
+
+//
+// WriteBenchResults
+// Writes results to path as JSON, one result to a line
+//
+BOOL WriteBenchResults(const char * path, const BENCH_RESULTS * results)
+{
+    char * json = malloc(CB_BENCH_JSON);
+    size_t length = 0;
+    WCHAR widePath[MAX_PATH];
+    HANDLE hFile;
+    DWORD bytesWritten = 0;
+    BOOL success = FALSE;
+
+    if(!json)
+    {
+        return FALSE;
+    }
+
+    length += (size_t)_snprintf_s(json, CB_BENCH_JSON, _TRUNCATE,
+        "{\n\"version\":%d,\n\"corpusBytes\":%llu,\n\"runs\":%d,\n\"peakMemoryBytes\":%llu,\n\"results\":[\n",
+        BENCH_RESULTS_VERSION, results->corpusBytes, results->runs, results->peakMemoryBytes);
+
+    for(int i = 0; i < results->resultCount; i++)
+    {
+        const BENCH_RESULT * result = &results->results[i];
+
+        length += (size_t)_snprintf_s(json + length, CB_BENCH_JSON - length, _TRUNCATE,
+            "{\"corpus\":\"%s\",\"stage\":\"%s\",\"mbPerSecond\":%.1f,\"p50Ms\":%.3f,\"p90Ms\":%.3f,\"p99Ms\":%.3f,\"peakMemoryBytes\":%llu}%s\n",
+            result->corpus, result->stage, result->mbPerSecond, result->p50Ms, result->p90Ms, result->p99Ms,
+            result->peakMemoryBytes, (i + 1 < results->resultCount) ? "," : "");
+    }
+
+    length += (size_t)_snprintf_s(json + length, CB_BENCH_JSON - length, _TRUNCATE, "]\n}\n");
+
+    hFile = GetBenchPath(path, widePath) ?
+        CreateFile(widePath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL) :
+        INVALID_HANDLE_VALUE;
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        success = WriteFile(hFile, json, (DWORD)length, &bytesWritten, NULL) && bytesWritten == length;
+        CloseHandle(hFile);
+    }
+
+    free(json);
+    return success;
+}
+
+//
+// FindJsonValue
+// Returns where the value of "key" starts, in the JSON between start
+// and end, or NULL if it isn't there. Only the JSON WriteBenchResults
+// writes needs to be read, so this doesn't handle escapes.
+//
+const char * FindJsonValue(const char * start, const char * end, const char * key)
+{
+    char pattern[CCH_BENCH_NAME + 4];
+    const char * found;
+
+    _snprintf_s(pattern, sizeof(pattern), _TRUNCATE, "\"%s\":", key);
+    found = strstr(start, pattern);
+    if(!found || found >= end)
+    {
+        return NULL;
+    }
+
+    found += strlen(pattern);
+    while(*found == ' ')
+    {
+        found++;
+    }
+
+    return found;
+}
+
+//
+// ReadJsonString
+// Copies the string value of "key" to value, which holds CCH_BENCH_NAME chars
+//
+BOOL ReadJsonString(const char * start, const char * end, const char * key, char * value)
+{
+    const char * found = FindJsonValue(start, end, key);
+    size_t length = 0;
+
+    if(!found || *found != '"')
+    {
+        return FALSE;
+    }
+
+    found++;
+    while(found + length < end && found[length] != '"' && length + 1 < CCH_BENCH_NAME)
+    {
+        value[length] = found[length];
+        length++;
+    }
+    value[length] = 0;
+
+    return TRUE;
+}
+
+//
+// ReadJsonNumber
+// Returns the number value of "key", or 0 if it isn't there
+//
+double ReadJsonNumber(const char * start, const char * end, const char * key)
+{
+    const char * found = FindJsonValue(start, end, key);
+
+    return found ? strtod(found, NULL) : 0;
+}
+
+//
+// ReadBenchResults
+// Reads the results WriteBenchResults wrote to path
+//
+BOOL ReadBenchResults(const char * path, BENCH_RESULTS * results)
+{
+    char * json = malloc(CB_BENCH_JSON_READ);
+    WCHAR widePath[MAX_PATH];
+    HANDLE hFile;
+    size_t length = 0;
+    const char * resultsStart;
+    const char * object;
+    BOOL success = FALSE;
+
+    ZeroMemory(results, sizeof(*results));
+
+    hFile = GetBenchPath(path, widePath) ?
+        CreateFile(widePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL) :
+        INVALID_HANDLE_VALUE;
+    if(json && hFile != INVALID_HANDLE_VALUE)
+    {
+        success = ReadAllFileBytes(hFile, (BYTE *)json, CB_BENCH_JSON_READ - 1, &length);
+    }
+
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hFile);
+    }
+
+    if(!success)
+    {
+        free(json);
+        return FALSE;
+    }
+
+    json[length] = 0;
+    resultsStart = FindJsonValue(json, json + length, "results");
+    success = (resultsStart != NULL) &&
+        (int)ReadJsonNumber(json, resultsStart, "version") == BENCH_RESULTS_VERSION;
+
+    if(success)
+    {
+        results->corpusBytes = (ULONGLONG)ReadJsonNumber(json, resultsStart, "corpusBytes");
+        results->runs = (int)ReadJsonNumber(json, resultsStart, "runs");
+        results->peakMemoryBytes = (ULONGLONG)ReadJsonNumber(json, resultsStart, "peakMemoryBytes");
+
+        for(object = strchr(resultsStart, '{'); object && results->resultCount < BENCH_MAX_RESULTS;
+            object = strchr(object + 1, '{'))
+        {
+            const char * objectEnd = strchr(object, '}');
+            BENCH_RESULT * result = &results->results[results->resultCount];
+
+            if(!objectEnd)
+            {
+                break;
+            }
+
+            ZeroMemory(result, sizeof(*result));
+            if(ReadJsonString(object, objectEnd, "corpus", result->corpus) &&
+                ReadJsonString(object, objectEnd, "stage", result->stage))
+            {
+                result->mbPerSecond = ReadJsonNumber(object, objectEnd, "mbPerSecond");
+                result->p50Ms = ReadJsonNumber(object, objectEnd, "p50Ms");
+                result->p90Ms = ReadJsonNumber(object, objectEnd, "p90Ms");
+                result->p99Ms = ReadJsonNumber(object, objectEnd, "p99Ms");
+                result->peakMemoryBytes = (ULONGLONG)ReadJsonNumber(object, objectEnd, "peakMemoryBytes");
+                results->resultCount++;
+            }
+        }
+    }
+
+    free(json);
+    return success;
+}
+
+//
+// GetPercentChange
+// Returns how much current differs from baseline, as a percentage of baseline
+//
+double GetPercentChange(double baseline, double current)
+{
+    return (baseline > 0) ? (current - baseline) * 100 / baseline : 0;
+}
+
+//
+// CompareBenchResults
+// Prints how each stage in current did against the same stage in
+// baseline. A stage whose throughput dropped, or whose 90th percentile
+// latency grew, by more than thresholdPercent is flagged as a regression,
+// and so is a peak memory that grew by more than that.
+// Returns the number of regressions.
+//
+int CompareBenchResults(const BENCH_RESULTS * baseline, const BENCH_RESULTS * current, double thresholdPercent)
+{
+    int regressions = 0;
+    double memoryChange;
+
+    if(baseline->corpusBytes != current->corpusBytes)
+    {
+        printf("The runs used different corpus sizes, %llu and %llu bytes\n",
+            baseline->corpusBytes, current->corpusBytes);
+    }
+
+    printf("%-12s %-20s %10s %10s %8s %10s %10s %8s\n",
+        "corpus", "stage", "base MB/s", "MB/s", "change", "base p90", "p90 ms", "change");
+
+    for(int i = 0; i < current->resultCount; i++)
+    {
+        const BENCH_RESULT * result = &current->results[i];
+        const BENCH_RESULT * base = NULL;
+        double throughputChange;
+        double latencyChange;
+        BOOL regressed;
+
+        for(int j = 0; j < baseline->resultCount && !base; j++)
+        {
+            if(strcmp(baseline->results[j].corpus, result->corpus) == 0 &&
+                strcmp(baseline->results[j].stage, result->stage) == 0)
+            {
+                base = &baseline->results[j];
+            }
+        }
+
+        if(!base)
+        {
+            printf("%-12s %-20s %10s %10.1f\n", result->corpus, result->stage, "new", result->mbPerSecond);
+            continue;
+        }
+
+        throughputChange = GetPercentChange(base->mbPerSecond, result->mbPerSecond);
+        latencyChange = GetPercentChange(base->p90Ms, result->p90Ms);
+        regressed = (throughputChange < -thresholdPercent) || (latencyChange > thresholdPercent);
+        regressions += regressed;
+
+        printf("%-12s %-20s %10.1f %10.1f %+7.1f%% %10.3f %10.3f %+7.1f%%%s\n",
+            result->corpus, result->stage, base->mbPerSecond, result->mbPerSecond, throughputChange,
+            base->p90Ms, result->p90Ms, latencyChange, regressed ? "  REGRESSION" : "");
+    }
+
+    memoryChange = GetPercentChange((double)baseline->peakMemoryBytes, (double)current->peakMemoryBytes);
+    printf("peak memory %llu MB, was %llu MB, %+.1f%%%s\n",
+        current->peakMemoryBytes / (1024 * 1024), baseline->peakMemoryBytes / (1024 * 1024), memoryChange,
+        (memoryChange > thresholdPercent) ? "  REGRESSION" : "");
+    regressions += (memoryChange > thresholdPercent);
+
+    printf("%d regression%s over %.1f%%\n", regressions, (regressions == 1) ? "" : "s", thresholdPercent);
+
+    return regressions;
+}
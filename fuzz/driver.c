@@ -0,0 +1,271 @@
+/* -------------------------------------------------------------
+
+driver.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    A standalone driver for the fuzz targets, for compilers without
+    libFuzzer. It runs a target on each seed file, then on mutated
+    copies of it, from a seeded random number generator so a run
+    can be repeated.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "fuzz.h"
+
+// The most seed files a run takes
+#define FUZZ_MAX_SEEDS      64
+
+// The most mutations made to one input
+#define FUZZ_MAX_MUTATIONS  4
+
+//
+// globals
+//
+
+// The state of the random number generator, which is never 0
+ULONGLONG g_fuzzRandom = 1;
+
+// Byte sequences that decoders get wrong: BOMs, surrogates encoded as
+// UTF-8 or as UTF-16 of either byte order, overlong and out of range
+// UTF-8, truncated sequences, line endings, and a null
+const char * g_fuzzTokens[] =
+{
+    "\xFF\xFE",
+    "\xFE\xFF",
+    "\xEF\xBB\xBF",
+    "\xED\xA0\x80",
+    "\xED\xBF\xBF",
+    "\xF0\x9F\x99\x82",
+    "\xF4\x90\x80\x80",
+    "\xC0\x80",
+    "\xE0\x80",
+    "\xE2\x82",
+    "\xF0\x9F",
+    "\x3D\xD8",
+    "\xD8\x3D",
+    "\x02\xDE",
+    "\xDE\x02",
+    "\r\n",
+    "\r",
+    "\n",
+};
+
+//
+// NextFuzzRandom
+// Returns the next number from a xorshift64* generator
+//
+ULONGLONG NextFuzzRandom(void)
+{
+    g_fuzzRandom ^= g_fuzzRandom >> 12;
+    g_fuzzRandom ^= g_fuzzRandom << 25;
+    g_fuzzRandom ^= g_fuzzRandom >> 27;
+
+    return g_fuzzRandom * 0x2545F4914F6CDD1DULL;
+}
+
+//
+// GetFuzzRandom
+// Returns a random number from 0 to limit - 1, or 0 if limit is 0
+//
+size_t GetFuzzRandom(size_t limit)
+{
+    return (limit > 0) ? (size_t)(NextFuzzRandom() % limit) : 0;
+}
+
+//
+// ReadFuzzSeed
+// Reads a seed file, with room to grow it to CB_FUZZ_INPUT_MAX bytes.
+// Returns NULL if it can't be read.
+//
+BYTE * ReadFuzzSeed(const char * path, size_t * size)
+{
+    WCHAR widePath[MAX_PATH];
+    HANDLE hFile;
+    BYTE * data = NULL;
+    int length = DecodeUtf8((const BYTE *)path, (int)strlen(path), widePath, MAX_PATH - 1);
+
+    *size = 0;
+    if(length <= 0)
+    {
+        return NULL;
+    }
+    widePath[length] = 0;
+
+    hFile = CreateFile(widePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    data = malloc(CB_FUZZ_INPUT_MAX);
+    if(data && !ReadAllFileBytes(hFile, data, CB_FUZZ_INPUT_MAX, size))
+    {
+        free(data);
+        data = NULL;
+    }
+
+    CloseHandle(hFile);
+    return data;
+}
+
+//
+// MutateFuzzInput
+// Makes a few random changes to input, which has room for
+// CB_FUZZ_INPUT_MAX bytes: flipping bits, writing, inserting or
+// deleting bytes, inserting one of g_fuzzTokens, repeating a range,
+// cutting the end off, or splicing in part of other.
+// Returns the new size.
+//
+size_t MutateFuzzInput(BYTE * input, size_t size, const BYTE * other, size_t otherSize)
+{
+    size_t mutations = 1 + GetFuzzRandom(FUZZ_MAX_MUTATIONS);
+
+    for(size_t i = 0; i < mutations; i++)
+    {
+        size_t position = GetFuzzRandom(size + 1);
+        size_t room = CB_FUZZ_INPUT_MAX - size;
+        size_t length = 1 + GetFuzzRandom(4);
+        const char * token;
+
+        switch(GetFuzzRandom(8))
+        {
+        case 0:
+            if(position < size)
+            {
+                input[position] ^= (BYTE)(1 << GetFuzzRandom(8));
+            }
+            break;
+        case 1:
+            if(position < size)
+            {
+                input[position] = (BYTE)NextFuzzRandom();
+            }
+            break;
+        case 2:
+            if(room > 0)
+            {
+                memmove(input + position + 1, input + position, size - position);
+                input[position] = (BYTE)NextFuzzRandom();
+                size++;
+            }
+            break;
+        case 3:
+            length = min(length, size - position);
+            memmove(input + position, input + position + length, size - position - length);
+            size -= length;
+            break;
+        case 4:
+            token = g_fuzzTokens[GetFuzzRandom(ARRAYSIZE(g_fuzzTokens))];
+            length = strlen(token);
+            if(length <= room)
+            {
+                memmove(input + position + length, input + position, size - position);
+                memcpy(input + position, token, length);
+                size += length;
+            }
+            break;
+        case 5:
+            // Repeat the bytes before position, which makes long runs
+            length = GetFuzzRandom(position + 1);
+            length = min(length, room);
+            memmove(input + position + length, input + position, size - position);
+            memcpy(input + position, input + position - length, length);
+            size += length;
+            break;
+        case 6:
+            size = position;
+            break;
+        default:
+            if(otherSize > 0)
+            {
+                size_t start = GetFuzzRandom(otherSize);
+
+                length = GetFuzzRandom(otherSize - start) + 1;
+                length = min(length, CB_FUZZ_INPUT_MAX - position);
+                memcpy(input + position, other + start, length);
+                size = max(size, position + length);
+            }
+            break;
+        }
+    }
+
+    return size;
+}
+
+//
+// main
+//
+int main(int argc, char * argv[])
+{
+    BYTE * seeds[FUZZ_MAX_SEEDS];
+    size_t seedSizes[FUZZ_MAX_SEEDS];
+    int seedCount = 0;
+    int runs = FUZZ_RUNS;
+    ULONGLONG randomSeed = 1;
+    BYTE * input = malloc(CB_FUZZ_INPUT_MAX);
+    ULONGLONG inputCount = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+        {
+            runs = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            randomSeed = strtoull(argv[++i], NULL, 10);
+        }
+        else if(seedCount < FUZZ_MAX_SEEDS)
+        {
+            seeds[seedCount] = ReadFuzzSeed(argv[i], &seedSizes[seedCount]);
+            if(!seeds[seedCount])
+            {
+                fprintf(stderr, "Couldn't read %s\n", argv[i]);
+                return 2;
+            }
+            seedCount++;
+        }
+    }
+
+    if(!input || seedCount == 0 || runs < 0)
+    {
+        fprintf(stderr, "usage: %s [--runs N] [--seed N] SEED_FILE...\n", argv[0]);
+        return 2;
+    }
+
+    g_fuzzRandom = randomSeed ? randomSeed : 1;
+    g_fuzzInput = input;
+
+    // An empty input, then each seed as it is, then mutated copies of it
+    g_fuzzInputSize = 0;
+    LLVMFuzzerTestOneInput(input, 0);
+    inputCount++;
+
+    for(int seed = 0; seed < seedCount; seed++)
+    {
+        for(int run = 0; run <= runs; run++)
+        {
+            size_t other = GetFuzzRandom((size_t)seedCount);
+
+            memcpy(input, seeds[seed], seedSizes[seed]);
+            g_fuzzInputSize = seedSizes[seed];
+            if(run > 0)
+            {
+                g_fuzzInputSize = MutateFuzzInput(input, g_fuzzInputSize, seeds[other], seedSizes[other]);
+            }
+
+            LLVMFuzzerTestOneInput(input, g_fuzzInputSize);
+            inputCount++;
+        }
+    }
+
+    printf("%llu inputs from %d seeds passed, with --seed %llu\n", inputCount, seedCount, randomSeed);
+
+    for(int seed = 0; seed < seedCount; seed++)
+    {
+        free(seeds[seed]);
+    }
+    free(input);
+
+    return 0;
+}
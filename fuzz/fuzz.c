@@ -0,0 +1,53 @@
+/* -------------------------------------------------------------
+
+fuzz.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code that every fuzz target shares, whether it runs under
+    libFuzzer or the standalone driver
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "fuzz.h"
+
+//
+// globals
+//
+const BYTE * g_fuzzInput = NULL;
+size_t g_fuzzInputSize = 0;
+
+//
+// FuzzFail
+// Reports a check that failed and aborts, which libFuzzer and the
+// sanitizers treat as a crash. Under the standalone driver, the input
+// is saved to FUZZ_FAILURE_FILE first, so it can be run again.
+//
+void FuzzFail(const char * expression, const char * file, int line)
+{
+    HANDLE hFile;
+    DWORD bytesWritten;
+
+    fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+
+    if(g_fuzzInput)
+    {
+        hFile = CreateFile(FUZZ_FAILURE_FILE, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(hFile != INVALID_HANDLE_VALUE)
+        {
+            WriteFile(hFile, g_fuzzInput, (DWORD)g_fuzzInputSize, &bytesWritten, NULL);
+            CloseHandle(hFile);
+            fprintf(stderr, "The input was saved to fuzz-failure.bin\n");
+        }
+    }
+
+    abort();
+}
+
+//
+// FuzzTextEquals
+// Returns whether two wide strings have the same length and characters
+//
+BOOL FuzzTextEquals(const WCHAR * a, size_t aLength, const WCHAR * b, size_t bLength)
+{
+    return aLength == bLength && (aLength == 0 || memcmp(a, b, aLength * sizeof(WCHAR)) == 0);
+}
@@ -0,0 +1,47 @@
+/* -------------------------------------------------------------
+
+fuzz.h
+    Essential Notepad - A basic Notepad implementation for Windows
+    Shared header file for the fuzz targets of the decoders
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#ifndef _FUZZ_H_
+#define _FUZZ_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esncore.h"
+
+// Stops the run, the way a fuzzer notices, if condition is false
+#define FUZZ_CHECK(condition) ((condition) ? (void)0 : FuzzFail(#condition, __FILE__, __LINE__))
+
+// The largest input the standalone driver makes from a seed
+#define CB_FUZZ_INPUT_MAX   (64 * 1024)
+
+// How many times the standalone driver mutates each seed, unless told otherwise
+#define FUZZ_RUNS           1000
+
+// Where the standalone driver saves the input a check failed on
+#define FUZZ_FAILURE_FILE   L"fuzz-failure.bin"
+
+// The input the standalone driver is running, so a failure can save it
+extern const BYTE * g_fuzzInput;
+extern size_t g_fuzzInputSize;
+
+// Function prototypes - the target, which libFuzzer or driver.c calls
+int LLVMFuzzerTestOneInput(const BYTE * data, size_t size);
+
+// Function prototypes - fuzz.c
+void FuzzFail(const char * expression, const char * file, int line);
+BOOL FuzzTextEquals(const WCHAR * a, size_t aLength, const WCHAR * b, size_t bLength);
+
+// Function prototypes - driver.c
+ULONGLONG NextFuzzRandom(void);
+size_t GetFuzzRandom(size_t limit);
+BYTE * ReadFuzzSeed(const char * path, size_t * size);
+size_t MutateFuzzInput(BYTE * input, size_t size, const BYTE * other, size_t otherSize);
+
+#endif // _FUZZ_H_
@@ -0,0 +1,104 @@
+/* -------------------------------------------------------------
+
+fuzz_decode.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Fuzz target for DecodeBytes. The bytes after the BOM are decoded
+    all at once, and again a piece at a time the way a text stream
+    reads them, keeping the bytes after GetWholeCharBytes for the next
+    piece. Both must give the same text, for every piece size.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "fuzz.h"
+
+// The most bytes held back from one piece for the next
+#define CB_FUZZ_CARRY_MAX   3
+
+//
+// globals
+//
+
+// The sizes of the pieces the bytes are decoded in: every split of a
+// UTF-8 sequence or surrogate pair, and pieces larger than the seeds
+const size_t g_fuzzPieceSizes[] = { 1, 2, 3, 4, 5, 7, 61, 4096 };
+
+//
+// DecodeInPieces
+// Decodes data a piece at a time into text, which holds capacity chars.
+// Returns the length of the text.
+//
+size_t DecodeInPieces(const BYTE * data, size_t size, int encoding, size_t pieceSize,
+    WCHAR * text, size_t capacity)
+{
+    BYTE * pending = malloc(pieceSize + CB_FUZZ_CARRY_MAX);
+    size_t carried = 0;
+    size_t offset = 0;
+    size_t length = 0;
+
+    FUZZ_CHECK(pending != NULL);
+
+    while(offset < size)
+    {
+        size_t pieceBytes = min(pieceSize, size - offset);
+        size_t pendingSize;
+        size_t whole;
+        size_t pieceLength;
+
+        memcpy(pending + carried, data + offset, pieceBytes);
+        pendingSize = carried + pieceBytes;
+        offset += pieceBytes;
+
+        // The last piece is decoded whole, like the end of a file
+        whole = (offset < size) ? GetWholeCharBytes(pending, pendingSize, encoding) : pendingSize;
+        FUZZ_CHECK(whole <= pendingSize);
+        FUZZ_CHECK(pendingSize - whole <= CB_FUZZ_CARRY_MAX);
+
+        if(whole > 0)
+        {
+            FUZZ_CHECK(DecodeBytes(pending, whole, encoding, text + length,
+                (capacity - length) * sizeof(WCHAR), &pieceLength));
+            FUZZ_CHECK(text[length + pieceLength] == 0);
+            length += pieceLength;
+        }
+
+        carried = pendingSize - whole;
+        memmove(pending, pending + whole, carried);
+    }
+
+    free(pending);
+    return length;
+}
+
+//
+// LLVMFuzzerTestOneInput
+//
+int LLVMFuzzerTestOneInput(const BYTE * data, size_t size)
+{
+    size_t bomSize;
+    int encoding = GetEncodingFromBom(data, size, &bomSize);
+    size_t capacity = size + 1;
+    WCHAR * whole = malloc(capacity * sizeof(WCHAR));
+    WCHAR * pieces = malloc(capacity * sizeof(WCHAR));
+    size_t wholeLength;
+
+    FUZZ_CHECK(whole && pieces);
+
+    data += bomSize;
+    size -= bomSize;
+
+    FUZZ_CHECK(DecodeBytes(data, size, encoding, whole, capacity * sizeof(WCHAR), &wholeLength));
+    FUZZ_CHECK(wholeLength < capacity && whole[wholeLength] == 0);
+
+    for(size_t i = 0; i < ARRAYSIZE(g_fuzzPieceSizes); i++)
+    {
+        size_t piecesLength = DecodeInPieces(data, size, encoding, g_fuzzPieceSizes[i], pieces, capacity);
+
+        FUZZ_CHECK(FuzzTextEquals(pieces, piecesLength, whole, wholeLength));
+    }
+
+    free(whole);
+    free(pieces);
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/* -------------------------------------------------------------
+
+fuzz_detect.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Fuzz target for detecting the encoding of a file and decoding
+    it the way opening does: GetEncodingFromBom must agree with
+    GetEncodingBom and ConvertBytesToString, and decoding with what
+    the open cache knows must give the same text as decoding cold.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "fuzz.h"
+
+//
+// CheckDocumentDecode
+// Decodes data with and without what the open cache would know about
+// it, and checks that both give the same document
+//
+void CheckDocumentDecode(const BYTE * data, size_t size, BOOL showControlChars)
+{
+    DOCUMENT_TEXT cold;
+    DOCUMENT_TEXT known;
+    DOCUMENT_INFO info;
+
+    if(!DecodeDocument(data, size, showControlChars, NULL, &cold))
+    {
+        HeapFree(GetProcessHeap(), 0, cold.text);
+        return;
+    }
+
+    FUZZ_CHECK(cold.text[cold.length] == 0);
+    FUZZ_CHECK(cold.lineEndings.crlf + cold.lineEndings.lf + cold.lineEndings.cr <= cold.length);
+
+    GetDocumentInfo(&cold, showControlChars, &info);
+    FUZZ_CHECK(DecodeDocument(data, size, showControlChars, &info, &known));
+    FUZZ_CHECK(known.encoding == cold.encoding);
+    FUZZ_CHECK(known.replacedChars == cold.replacedChars);
+    FUZZ_CHECK(known.lineEndings.crlf == cold.lineEndings.crlf);
+    FUZZ_CHECK(known.lineEndings.lf == cold.lineEndings.lf);
+    FUZZ_CHECK(known.lineEndings.cr == cold.lineEndings.cr);
+    FUZZ_CHECK(FuzzTextEquals(known.text, known.length, cold.text, cold.length));
+
+    HeapFree(GetProcessHeap(), 0, cold.text);
+    HeapFree(GetProcessHeap(), 0, known.text);
+}
+
+//
+// LLVMFuzzerTestOneInput
+//
+int LLVMFuzzerTestOneInput(const BYTE * data, size_t size)
+{
+    size_t bomSize;
+    size_t expectedBomSize;
+    const BYTE * bom;
+    int encoding = GetEncodingFromBom(data, size, &bomSize);
+    WCHAR * text = malloc((size + 1) * sizeof(WCHAR));
+    size_t textLength;
+    int convertedEncoding;
+
+    // The BOM that was found is the one a save writes back
+    bom = GetEncodingBom(encoding, &expectedBomSize);
+    FUZZ_CHECK(bomSize == expectedBomSize);
+    FUZZ_CHECK(bomSize <= size);
+    FUZZ_CHECK(bomSize == 0 || memcmp(data, bom, bomSize) == 0);
+
+    if(text)
+    {
+        if(ConvertBytesToString(data, size, text, (size + 1) * sizeof(WCHAR), &textLength, &convertedEncoding))
+        {
+            FUZZ_CHECK(convertedEncoding == encoding);
+            FUZZ_CHECK(textLength <= size);
+            FUZZ_CHECK(text[textLength] == 0);
+        }
+        free(text);
+    }
+
+    CheckDocumentDecode(data, size, FALSE);
+    CheckDocumentDecode(data, size, TRUE);
+
+    return 0;
+}
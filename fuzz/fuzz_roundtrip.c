@@ -0,0 +1,132 @@
+/* -------------------------------------------------------------
+
+fuzz_roundtrip.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Fuzz target for saving text and opening it again. The input is
+    taken as wide text, encoded with EncodeWideTextChunk in chunks of
+    several sizes, and decoded with DecodeBytes, both a chunk at a time
+    and all at once. UTF-16 must come back unchanged, and UTF-8 too,
+    except that a lone surrogate becomes U+FFFD.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "fuzz.h"
+
+//
+// globals
+//
+
+// The encodings a save writes
+const int g_fuzzEncodings[] = { ENCODING_UTF_8, ENCODING_UTF_16_LE, ENCODING_UTF_16_BE };
+
+// The sizes of the chunks text is encoded in, from the smallest
+// EncodeWideTextChunk allows
+const size_t g_fuzzChunkSizes[] = { 6, 7, 8, 64, CB_WRITE_CHUNK };
+
+//
+// ReplaceLoneSurrogates
+// Replaces each surrogate that isn't part of a pair with U+FFFD,
+// which is what UTF-8 can hold of it
+//
+void ReplaceLoneSurrogates(WCHAR * text, size_t length)
+{
+    for(size_t i = 0; i < length; i++)
+    {
+        if(IS_HIGH_SURROGATE(text[i]) && i + 1 < length && IS_LOW_SURROGATE(text[i + 1]))
+        {
+            i++;
+        }
+        else if(IS_HIGH_SURROGATE(text[i]) || IS_LOW_SURROGATE(text[i]))
+        {
+            text[i] = UNICODE_REPLACEMENT_CHAR;
+        }
+    }
+}
+
+//
+// CheckRoundTrip
+// Encodes text in chunks of chunkSize bytes, and checks that decoding
+// each chunk, and all of them together, gives back expected
+//
+void CheckRoundTrip(LPCWSTR text, size_t length, int encoding, size_t chunkSize,
+    LPCWSTR expected, BYTE * encoded, WCHAR * decoded)
+{
+    BYTE * chunk = malloc(chunkSize);
+    size_t encodedSize = 0;
+    size_t encodedChars = 0;
+    size_t decodedLength = 0;
+    size_t chunkLength;
+
+    FUZZ_CHECK(chunk != NULL);
+
+    while(encodedChars < length)
+    {
+        size_t charsEncoded;
+        size_t chunkBytes = EncodeWideTextChunk(text + encodedChars, length - encodedChars, encoding,
+            chunk, chunkSize, &charsEncoded);
+
+        FUZZ_CHECK(charsEncoded > 0 && charsEncoded <= length - encodedChars);
+        FUZZ_CHECK(chunkBytes > 0 && chunkBytes <= chunkSize);
+
+        // Each chunk is valid on its own, so it can be written to a file as it is
+        FUZZ_CHECK(DecodeBytes(chunk, chunkBytes, encoding, decoded + decodedLength,
+            (length * 2 + 1 - decodedLength) * sizeof(WCHAR), &chunkLength));
+        decodedLength += chunkLength;
+
+        memcpy(encoded + encodedSize, chunk, chunkBytes);
+        encodedSize += chunkBytes;
+        encodedChars += charsEncoded;
+    }
+
+    // UTF-16 chunks can split a surrogate pair, which only comes back whole
+    // when the chunks are put together, so they're only checked that way
+    if(encoding == ENCODING_UTF_8)
+    {
+        FUZZ_CHECK(FuzzTextEquals(decoded, decodedLength, expected, length));
+    }
+
+    FUZZ_CHECK(DecodeBytes(encoded, encodedSize, encoding, decoded, (length * 2 + 1) * sizeof(WCHAR), &decodedLength));
+    FUZZ_CHECK(FuzzTextEquals(decoded, decodedLength, expected, length));
+
+    free(chunk);
+}
+
+//
+// LLVMFuzzerTestOneInput
+//
+int LLVMFuzzerTestOneInput(const BYTE * data, size_t size)
+{
+    size_t length = size / sizeof(WCHAR);
+    WCHAR * text = malloc((length + 1) * sizeof(WCHAR));
+    WCHAR * utf8Text = malloc((length + 1) * sizeof(WCHAR));
+    WCHAR * decoded = malloc((length * 2 + 1) * sizeof(WCHAR));
+    BYTE * encoded = malloc(length * 3 + 1);
+
+    FUZZ_CHECK(text && utf8Text && decoded && encoded);
+
+    // The input as UTF-16 LE, the way the edit control holds text
+    for(size_t i = 0; i < length; i++)
+    {
+        text[i] = (WCHAR)(data[2 * i] | (data[2 * i + 1] << 8));
+    }
+
+    memcpy(utf8Text, text, length * sizeof(WCHAR));
+    ReplaceLoneSurrogates(utf8Text, length);
+
+    for(size_t i = 0; length > 0 && i < ARRAYSIZE(g_fuzzEncodings); i++)
+    {
+        for(size_t j = 0; j < ARRAYSIZE(g_fuzzChunkSizes); j++)
+        {
+            CheckRoundTrip(text, length, g_fuzzEncodings[i], g_fuzzChunkSizes[j],
+                (g_fuzzEncodings[i] == ENCODING_UTF_8) ? utf8Text : text, encoded, decoded);
+        }
+    }
+
+    free(text);
+    free(utf8Text);
+    free(decoded);
+    free(encoded);
+
+    return 0;
+}
@@ -1,14 +1,22 @@
 set OUTPUT_PATH=bin
 set OUTPUT_EXE=esnpad.exe
+set CORE_LIB=esncore.lib
 
 rmdir /s /q %OUTPUT_PATH%
 mkdir %OUTPUT_PATH%
 rc.exe /fo %OUTPUT_PATH%/resources.res resources.rc
 
-cl.exe main.c file.c edit.c find.c utility.c ^
+REM The portable core, the same sources CMake builds and tests
+cl.exe /c cli.c compress.c document.c encoding.c fileio.c filesearch.c hexformat.c lexer.c opencache.c savejournal.c saveplan.c scratch.c search.c stream.c textdiff.c trace.c transform.c platform_win32.c ^
+/DUNICODE /D_UNICODE /DDEBUG /WX /W4 /EHsc /Zi ^
+/Fo%OUTPUT_PATH%\ /Fd%OUTPUT_PATH%\vc140.pdb
+lib.exe /nologo /out:%OUTPUT_PATH%\%CORE_LIB% %OUTPUT_PATH%\*.obj
+del %OUTPUT_PATH%\*.obj
+
+cl.exe main.c file.c edit.c find.c findfiles.c filter.c statusbar.c clipboard.c column.c lines.c save.c recovery.c highlight.c theme.c hexview.c utility.c ^
 /DUNICODE /D_UNICODE /DDEBUG /WX /W4 /EHsc /Zi ^
 /Fe%OUTPUT_PATH%\%OUTPUT_EXE% /Fo%OUTPUT_PATH%\ /Fd%OUTPUT_PATH%\vc140.pdb ^
-/link /SUBSYSTEM:WINDOWS user32.lib gdi32.lib comctl32.lib comdlg32.lib shell32.lib shlwapi.lib %OUTPUT_PATH%\resources.res
+/link /SUBSYSTEM:WINDOWS user32.lib gdi32.lib comctl32.lib comdlg32.lib shell32.lib shlwapi.lib %OUTPUT_PATH%\%CORE_LIB% %OUTPUT_PATH%\resources.res
 
 del %OUTPUT_PATH%\*.obj
 del %OUTPUT_PATH%\*.ilk
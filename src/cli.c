@@ -0,0 +1,768 @@
+/* -------------------------------------------------------------
+
+cli.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for running a command from the command line, without
+    showing a window. The commands use the same code to detect,
+    decode, encode, convert line endings, and search as the editor.
+    Nothing in here touches windows, so the same commands also build
+    on their own as esncli, on any platform the core supports.
+
+    Files are read a piece at a time and written out as each piece is
+    done, so a command uses the same amount of memory for any size of
+    file. "-" in place of a file name means standard input or output.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <stdarg.h>
+#include <wchar.h>
+#include "esncore.h"
+
+// Output is gathered into a buffer this size before it's written
+#define CCH_OUTPUT_BUFFER (16 * 1024)
+
+//
+// globals
+//
+HANDLE g_hStdOut = NULL;
+HANDLE g_hStdErr = NULL;
+BYTE * g_outputChunk = NULL;    // CB_WRITE_CHUNK bytes for encoding output
+WCHAR g_outputText[CCH_OUTPUT_BUFFER];
+size_t g_outputLength = 0;
+
+// The lines of the usage. WriteUsageLine fills in the program's name
+// and the option character.
+LPCWSTR g_usageLines[] =
+{
+    APP_TITLE_W,
+    L"",
+    L"  % /detect file...",
+    L"      Shows the encoding and line endings of each file.",
+    L"  % /convert input output [/encoding:name] [/eol:crlf|lf|cr]",
+    L"      Copies input to output with a new encoding or line endings.",
+    L"      name is utf-8, utf-8-bom, utf-16le or utf-16be.",
+    L"  % /find [/matchcase] text file...",
+    L"  % /find /levels file...",
+    L"      Shows the lines that contain text, or are errors and warnings.",
+    L"      text is matched as it's typed. Regular expressions aren't supported.",
+    L"  % /count [/matchcase] text file...",
+    L"  % /count /levels file...",
+    L"      Shows how many lines /find would show.",
+    L"",
+    L"  Use - for a file to read standard input or write standard output.",
+    L"  /find and /count exit with 0 if a line matched, 1 if none did, or 2 on an error.",
+};
+
+//
+// IsOptionNamed
+// Returns TRUE if arg is the option called name, like /detect on
+// Windows or -detect elsewhere, ignoring case
+//
+BOOL IsOptionNamed(LPCWSTR arg, LPCWSTR name)
+{
+    return arg[0] == CLI_OPTION_CHAR && _wcsicmp(arg + 1, name) == 0;
+}
+
+//
+// GetCommandLineCommand
+// Returns which CLI_COMMAND_ arg names, or CLI_COMMAND_NONE
+// if it isn't one, and the app should show its window.
+//
+int GetCommandLineCommand(LPCWSTR arg)
+{
+    if(IsOptionNamed(arg, L"detect"))
+    {
+        return CLI_COMMAND_DETECT;
+    }
+    else if(IsOptionNamed(arg, L"convert"))
+    {
+        return CLI_COMMAND_CONVERT;
+    }
+    else if(IsOptionNamed(arg, L"find"))
+    {
+        return CLI_COMMAND_FIND;
+    }
+    else if(IsOptionNamed(arg, L"count"))
+    {
+        return CLI_COMMAND_COUNT;
+    }
+    else if(IsOptionNamed(arg, L"?") || IsOptionNamed(arg, L"help"))
+    {
+        return CLI_COMMAND_HELP;
+    }
+
+    return CLI_COMMAND_NONE;
+}
+
+//
+// OpenStdHandle
+// Returns a standard handle. An app with a window doesn't get a console's
+// handles, unless they were redirected, so the console it was started from
+// is opened instead. Returns NULL if there's neither.
+//
+HANDLE OpenStdHandle(DWORD stdHandle)
+{
+    HANDLE handle = GetStdHandle(stdHandle);
+
+    if(handle == NULL || handle == INVALID_HANDLE_VALUE)
+    {
+        handle = CreateFile((stdHandle == STD_INPUT_HANDLE) ? L"CONIN$" : L"CONOUT$",
+            GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    }
+
+    return (handle == INVALID_HANDLE_VALUE) ? NULL : handle;
+}
+
+//
+// WriteTextToHandle
+// Writes text to a console as it is, or to anything else as UTF-8
+//
+BOOL WriteTextToHandle(HANDLE hOut, LPCWSTR text, size_t length)
+{
+    DWORD consoleMode;
+    DWORD written;
+    DWORD pieceLength;
+    size_t bytesWritten = 0;
+
+    if(!hOut)
+    {
+        return FALSE;
+    }
+
+    if(GetConsoleMode(hOut, &consoleMode))
+    {
+        while(length > 0)
+        {
+            pieceLength = (DWORD)min(length, CCH_OUTPUT_BUFFER);
+            if(!WriteConsoleW(hOut, text, pieceLength, &written, NULL) || written == 0)
+            {
+                return FALSE;
+            }
+            text += written;
+            length -= written;
+        }
+        return TRUE;
+    }
+
+    return WriteEncodedText(hOut, text, length, ENCODING_UTF_8, g_outputChunk, &bytesWritten);
+}
+
+//
+// FlushOutput
+// Writes out the output that's been gathered in g_outputText
+//
+BOOL FlushOutput(void)
+{
+    BOOL success = WriteTextToHandle(g_hStdOut, g_outputText, g_outputLength);
+
+    g_outputLength = 0;
+    return success;
+}
+
+//
+// WriteOutput
+// Adds text to the output, which is written to standard output
+// when the buffer fills up or FlushOutput is called
+//
+BOOL WriteOutput(LPCWSTR text, size_t length)
+{
+    if(g_outputLength + length > CCH_OUTPUT_BUFFER)
+    {
+        if(!FlushOutput())
+        {
+            return FALSE;
+        }
+
+        if(length > CCH_OUTPUT_BUFFER)
+        {
+            return WriteTextToHandle(g_hStdOut, text, length);
+        }
+    }
+
+    CopyMemory(g_outputText + g_outputLength, text, length * sizeof(WCHAR));
+    g_outputLength += length;
+    return TRUE;
+}
+
+//
+// WriteOutputFormat
+// A printf style function that adds to the output
+//
+BOOL WriteOutputFormat(const WCHAR * format, ...)
+{
+    va_list vaArgs;
+    WCHAR buffer[CB_BUFFER];
+    size_t length = 0;
+
+    va_start(vaArgs, format);
+    StringCchVPrintfW(buffer, ARRAYSIZE(buffer), format, vaArgs);
+    va_end(vaArgs);
+
+    StringCchLengthW(buffer, ARRAYSIZE(buffer), &length);
+    return WriteOutput(buffer, length);
+}
+
+//
+// WriteErrorFormat
+// A printf style function that writes a message to standard error,
+// after any output that came before it
+//
+void WriteErrorFormat(const WCHAR * format, ...)
+{
+    va_list vaArgs;
+    WCHAR buffer[CB_BUFFER];
+    size_t length = 0;
+
+    FlushOutput();
+
+    va_start(vaArgs, format);
+    StringCchVPrintfW(buffer, ARRAYSIZE(buffer), format, vaArgs);
+    va_end(vaArgs);
+
+    StringCchLengthW(buffer, ARRAYSIZE(buffer), &length);
+    WriteTextToHandle(g_hStdErr, buffer, length);
+}
+
+//
+// CloseInputStream
+// Closes the file an input stream was reading, unless it's standard input
+//
+void CloseInputStream(TEXT_STREAM * stream)
+{
+    CloseTextStream(stream);
+    if(stream->hFile && stream->hFile != GetStdHandle(STD_INPUT_HANDLE))
+    {
+        CloseHandle(stream->hFile);
+    }
+}
+
+//
+// OpenInputStream
+// Opens filePath, or standard input if it's "-", to be read as a
+// TEXT_STREAM. The stream's buffers come from scratch memory.
+// Returns FALSE if the file can't be opened.
+//
+BOOL OpenInputStream(LPCWSTR filePath, TEXT_STREAM * stream)
+{
+    HANDLE hFile;
+    BYTE * bytes = ScratchAlloc(CB_STREAM_CHUNK);
+    WCHAR * text = ScratchAlloc(CCH_STREAM_TEXT * sizeof(WCHAR));
+
+    if(wcscmp(filePath, L"-") == 0)
+    {
+        hFile = OpenStdHandle(STD_INPUT_HANDLE);
+    }
+    else
+    {
+        hFile = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ,
+            NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if(hFile == INVALID_HANDLE_VALUE)
+        {
+            hFile = NULL;
+        }
+    }
+
+    InitTextStream(stream, hFile, bytes, text);
+
+    if(hFile == NULL || bytes == NULL || text == NULL)
+    {
+        CloseInputStream(stream);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// WriteReadError
+// Writes why an input stream stopped before its end
+//
+void WriteReadError(LPCWSTR filePath, const TEXT_STREAM * stream)
+{
+    if(stream->compression == COMPRESSION_ZSTD)
+    {
+        WriteErrorFormat(L"Unable to read %s: Zstandard compressed files aren't supported" NEWLINE_W, filePath);
+    }
+    else if(stream->compression == COMPRESSION_GZIP)
+    {
+        WriteErrorFormat(L"Unable to read %s: the compressed data isn't valid" NEWLINE_W, filePath);
+    }
+    else
+    {
+        WriteErrorFormat(L"Unable to read %s" NEWLINE_W, filePath);
+    }
+}
+
+//
+// GetEncodingName
+// Returns the name an ENCODING_ constant is shown with
+//
+LPCWSTR GetEncodingName(int encoding)
+{
+    switch(encoding)
+    {
+    case ENCODING_UTF_8_BOM:
+        return L"UTF-8 with BOM";
+    case ENCODING_UTF_16_LE:
+        return L"UTF-16 LE";
+    case ENCODING_UTF_16_BE:
+        return L"UTF-16 BE";
+    default:
+        return L"UTF-8";
+    }
+}
+
+//
+// DetectFiles
+// Handles /detect by writing the encoding and line endings of each file
+//
+int DetectFiles(LPWSTR * files, int fileCount)
+{
+    int exitCode = CLI_EXIT_SUCCESS;
+    TEXT_STREAM stream;
+    LINE_ENDING_COUNTS total;
+    LINE_ENDING_COUNTS counts;
+    LPCWSTR lines;
+    size_t linesLength;
+    SCRATCH_MARK scratch;
+
+    for(int i = 0; i < fileCount; i++)
+    {
+        scratch = ScratchBegin();
+
+        if(!OpenInputStream(files[i], &stream))
+        {
+            WriteErrorFormat(L"Unable to open %s" NEWLINE_W, files[i]);
+            exitCode = CLI_EXIT_ERROR;
+            ScratchEnd(scratch);
+            continue;
+        }
+
+        ZeroMemory(&total, sizeof(total));
+        while(ReadStreamLines(&stream, &lines, &linesLength))
+        {
+            CountLineEndings(lines, linesLength, &counts);
+            total.crlf += counts.crlf;
+            total.lf += counts.lf;
+            total.cr += counts.cr;
+        }
+
+        if(stream.failed)
+        {
+            WriteReadError(files[i], &stream);
+            exitCode = CLI_EXIT_ERROR;
+        }
+        else if(total.crlf + total.lf + total.cr == 0)
+        {
+            WriteOutputFormat(L"%s: %s, no line breaks" NEWLINE_W, files[i], GetEncodingName(stream.encoding));
+        }
+        else if(HasMixedLineEndings(&total))
+        {
+            WriteOutputFormat(L"%s: %s, mixed line endings (%Iu CRLF, %Iu LF, %Iu CR)" NEWLINE_W, files[i],
+                GetEncodingName(stream.encoding), total.crlf, total.lf, total.cr);
+        }
+        else
+        {
+            WriteOutputFormat(L"%s: %s, %s" NEWLINE_W, files[i], GetEncodingName(stream.encoding),
+                (total.crlf > 0) ? L"CRLF" : (total.lf > 0) ? L"LF" : L"CR");
+        }
+
+        CloseInputStream(&stream);
+        ScratchEnd(scratch);
+    }
+
+    return exitCode;
+}
+
+//
+// WriteBomForEncoding
+// Writes the BOM of encoding to hOut, if it has one
+//
+BOOL WriteBomForEncoding(HANDLE hOut, int encoding)
+{
+    const BYTE * bom;
+    size_t bomSize;
+    DWORD bomWritten;
+
+    bom = GetEncodingBom(encoding, &bomSize);
+
+    return !bom || WriteFile(hOut, bom, (DWORD)bomSize, &bomWritten, NULL);
+}
+
+//
+// ConvertFile
+// Handles /convert by copying inputPath to outputPath, changing the
+// encoding and line endings along the way. ENCODING_UNSPECIFIED keeps
+// the input's encoding, and LINE_ENDING_UNSPECIFIED keeps its line endings.
+//
+int ConvertFile(LPCWSTR inputPath, LPCWSTR outputPath, int encoding, int lineEnding)
+{
+    BOOL success = TRUE;
+    BOOL started = FALSE;
+    BOOL toStdOut = (wcscmp(outputPath, L"-") == 0);
+    TEXT_STREAM stream;
+    HANDLE hOut;
+    LPCWSTR lines;
+    size_t linesLength;
+    WCHAR * converted = NULL;
+    size_t bytesWritten = 0;
+    TRACE_SCOPE scope = {0};
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    if(!OpenInputStream(inputPath, &stream))
+    {
+        WriteErrorFormat(L"Unable to open %s" NEWLINE_W, inputPath);
+        ScratchEnd(scratch);
+        return CLI_EXIT_ERROR;
+    }
+
+    // Converting line endings can double the length of the text
+    if(lineEnding != LINE_ENDING_UNSPECIFIED)
+    {
+        converted = ScratchAlloc(2 * CCH_STREAM_TEXT * sizeof(WCHAR));
+    }
+
+    if(toStdOut)
+    {
+        hOut = OpenStdHandle(STD_OUTPUT_HANDLE);
+    }
+    else
+    {
+        hOut = CreateFile(outputPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    }
+
+    if(hOut == NULL || hOut == INVALID_HANDLE_VALUE || (lineEnding != LINE_ENDING_UNSPECIFIED && !converted))
+    {
+        WriteErrorFormat(L"Unable to create %s" NEWLINE_W, outputPath);
+        CloseInputStream(&stream);
+        ScratchEnd(scratch);
+        return CLI_EXIT_ERROR;
+    }
+
+    TRACE_BEGIN(scope, "convert");
+
+    while(success && ReadStreamLines(&stream, &lines, &linesLength))
+    {
+        if(!started)
+        {
+            // The input's encoding is known once its first lines are read
+            started = TRUE;
+            encoding = (encoding == ENCODING_UNSPECIFIED) ? stream.encoding : encoding;
+            success = WriteBomForEncoding(hOut, encoding);
+        }
+
+        if(converted)
+        {
+            linesLength = CopyWithLineEnding(lines, linesLength, lineEnding, converted);
+            lines = converted;
+        }
+
+        success = success && WriteEncodedText(hOut, lines, linesLength, encoding, g_outputChunk, &bytesWritten);
+    }
+
+    if(success && !started && !stream.failed)
+    {
+        // The input was empty, but the output still gets a BOM
+        encoding = (encoding == ENCODING_UNSPECIFIED) ? stream.encoding : encoding;
+        success = WriteBomForEncoding(hOut, encoding);
+    }
+
+    if(stream.failed)
+    {
+        WriteReadError(inputPath, &stream);
+        success = FALSE;
+    }
+    else if(!success)
+    {
+        WriteErrorFormat(L"Unable to write %s" NEWLINE_W, outputPath);
+    }
+
+    TRACE_BYTES(scope, bytesWritten);
+
+    if(!toStdOut)
+    {
+        CloseHandle(hOut);
+    }
+    CloseInputStream(&stream);
+    ScratchEnd(scratch);
+    TRACE_END(scope);
+
+    return success ? CLI_EXIT_SUCCESS : CLI_EXIT_ERROR;
+}
+
+//
+// FindInFiles
+// Handles /find and /count by writing each line of the files that
+// matches filter, with its line number, or just how many lines match.
+// The file name comes first when there's more than one file.
+//
+int FindInFiles(const FILTER * filter, LPWSTR * files, int fileCount, BOOL countOnly)
+{
+    BOOL found = FALSE;
+    BOOL failed = FALSE;
+    TEXT_STREAM stream;
+    LPCWSTR line;
+    size_t lineLength;
+    ULONGLONG matchCount;
+    ULONGLONG matchLine;
+    SCRATCH_MARK scratch;
+    TRACE_SCOPE scope = {0};
+
+    TRACE_BEGIN(scope, countOnly ? "count" : "find");
+
+    for(int i = 0; i < fileCount; i++)
+    {
+        scratch = ScratchBegin();
+
+        if(!OpenInputStream(files[i], &stream))
+        {
+            WriteErrorFormat(L"Unable to open %s" NEWLINE_W, files[i]);
+            failed = TRUE;
+            ScratchEnd(scratch);
+            continue;
+        }
+
+        matchCount = 0;
+        matchLine = 0;
+        while(ReadStreamLine(&stream, &line, &lineLength))
+        {
+            TRACE_BYTES(scope, lineLength * sizeof(WCHAR));
+
+            // A line too long to read at once comes in pieces, and each
+            // piece is matched on its own, but the line only counts once
+            if(stream.lineNumber != matchLine && lineLength <= MAXDWORD &&
+                LineMatchesFilter(line, (DWORD)lineLength, filter))
+            {
+                matchLine = stream.lineNumber;
+                matchCount++;
+                if(!countOnly)
+                {
+                    if(fileCount > 1)
+                    {
+                        WriteOutputFormat(L"%s:", files[i]);
+                    }
+                    WriteOutputFormat(L"%I64u:", stream.lineNumber);
+                    WriteOutput(line, lineLength);
+                    WriteOutput(NEWLINE_W, ARRAYSIZE(NEWLINE_W) - 1);
+                }
+            }
+        }
+
+        if(stream.failed)
+        {
+            WriteReadError(files[i], &stream);
+            failed = TRUE;
+        }
+        else if(countOnly && fileCount > 1)
+        {
+            WriteOutputFormat(L"%s: %I64u" NEWLINE_W, files[i], matchCount);
+        }
+        else if(countOnly)
+        {
+            WriteOutputFormat(L"%I64u" NEWLINE_W, matchCount);
+        }
+
+        found = found || (matchCount > 0);
+
+        CloseInputStream(&stream);
+        ScratchEnd(scratch);
+    }
+
+    TRACE_END(scope);
+
+    if(failed)
+    {
+        return CLI_EXIT_ERROR;
+    }
+
+    return found ? CLI_EXIT_SUCCESS : CLI_EXIT_NOT_FOUND;
+}
+
+//
+// WriteUsageLine
+// Writes a line of the usage, with the program's name in place of
+// each % and this platform's option character in place of each /
+//
+void WriteUsageLine(LPCWSTR line, LPCWSTR programName, size_t programNameLength)
+{
+    WCHAR optionChar = CLI_OPTION_CHAR;
+
+    for(; *line != 0; line++)
+    {
+        if(*line == L'%')
+        {
+            WriteOutput(programName, programNameLength);
+        }
+        else
+        {
+            WriteOutput((*line == L'/') ? &optionChar : line, 1);
+        }
+    }
+
+    WriteOutput(NEWLINE_W, ARRAYSIZE(NEWLINE_W) - 1);
+}
+
+//
+// WriteUsage
+// Writes the commands that can be run from the command line.
+// programPath is argv[0], which the program's name is taken from.
+//
+void WriteUsage(LPCWSTR programPath)
+{
+    LPCWSTR programName = programPath;
+    size_t programNameLength;
+
+    for(LPCWSTR p = programPath; *p != 0; p++)
+    {
+        if(*p == L'\\' || *p == L'/')
+        {
+            programName = p + 1;
+        }
+    }
+
+    // Leave off an extension, like .exe
+    for(programNameLength = 0; programName[programNameLength] != 0 &&
+        programName[programNameLength] != L'.'; programNameLength++);
+
+    for(size_t i = 0; i < ARRAYSIZE(g_usageLines); i++)
+    {
+        WriteUsageLine(g_usageLines[i], programName, programNameLength);
+    }
+}
+
+//
+// RunCommandLineCommand
+// Runs the command in argv[1], which GetCommandLineCommand recognizes,
+// without showing a window. Output goes to standard output, which for
+// the app is the console it was started from, or wherever it was
+// redirected to. Without a command, the usage is shown.
+// Returns the exit code for the process.
+//
+int RunCommandLineCommand(int argc, LPWSTR * argv)
+{
+    int exitCode = CLI_EXIT_ERROR;
+    int command = (argc > 1) ? GetCommandLineCommand(argv[1]) : CLI_COMMAND_NONE;
+    int encoding = ENCODING_UNSPECIFIED;
+    int lineEnding = LINE_ENDING_UNSPECIFIED;
+    FILTER filter = { FILTER_TEXT, NULL, FALSE };
+    LPWSTR * args;
+    int argCount = 0;
+    BOOL badArgs = FALSE;
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    g_hStdOut = OpenStdHandle(STD_OUTPUT_HANDLE);
+    g_hStdErr = OpenStdHandle(STD_ERROR_HANDLE);
+
+    g_outputChunk = ScratchAlloc(CB_WRITE_CHUNK);
+    args = ScratchAlloc((size_t)argc * sizeof(LPWSTR));
+    if(!g_outputChunk || !args)
+    {
+        ScratchEnd(scratch);
+        return CLI_EXIT_ERROR;
+    }
+
+    // Split the options from the other args. "-" isn't an option, it's a file.
+    for(int i = 2; i < argc; i++)
+    {
+        if(argv[i][0] != CLI_OPTION_CHAR || argv[i][1] == 0)
+        {
+            args[argCount++] = argv[i];
+        }
+        else if(IsOptionNamed(argv[i], L"matchcase"))
+        {
+            filter.matchCase = TRUE;
+        }
+        else if(IsOptionNamed(argv[i], L"levels"))
+        {
+            filter.type = FILTER_LEVELS;
+        }
+        else if(IsOptionNamed(argv[i], L"encoding:utf-8"))
+        {
+            encoding = ENCODING_UTF_8;
+        }
+        else if(IsOptionNamed(argv[i], L"encoding:utf-8-bom"))
+        {
+            encoding = ENCODING_UTF_8_BOM;
+        }
+        else if(IsOptionNamed(argv[i], L"encoding:utf-16le"))
+        {
+            encoding = ENCODING_UTF_16_LE;
+        }
+        else if(IsOptionNamed(argv[i], L"encoding:utf-16be"))
+        {
+            encoding = ENCODING_UTF_16_BE;
+        }
+        else if(IsOptionNamed(argv[i], L"eol:crlf"))
+        {
+            lineEnding = LINE_ENDING_CRLF;
+        }
+        else if(IsOptionNamed(argv[i], L"eol:lf"))
+        {
+            lineEnding = LINE_ENDING_LF;
+        }
+        else if(IsOptionNamed(argv[i], L"eol:cr"))
+        {
+            lineEnding = LINE_ENDING_CR;
+        }
+        else
+        {
+            WriteErrorFormat(L"Unknown option %s" NEWLINE_W, argv[i]);
+            badArgs = TRUE;
+        }
+    }
+
+    switch(command)
+    {
+    case CLI_COMMAND_DETECT:
+        badArgs = badArgs || (argCount == 0);
+        if(!badArgs)
+        {
+            exitCode = DetectFiles(args, argCount);
+        }
+        break;
+    case CLI_COMMAND_CONVERT:
+        badArgs = badArgs || (argCount != 2);
+        if(!badArgs)
+        {
+            exitCode = ConvertFile(args[0], args[1], encoding, lineEnding);
+        }
+        break;
+    case CLI_COMMAND_FIND:
+    case CLI_COMMAND_COUNT:
+        // The search text comes before the files, unless the filter is for levels
+        if(filter.type == FILTER_TEXT && argCount > 0)
+        {
+            filter.searchText = args[0];
+            args++;
+            argCount--;
+        }
+        badArgs = badArgs || (argCount == 0) || (filter.searchText && filter.searchText[0] == 0);
+        if(!badArgs)
+        {
+            exitCode = FindInFiles(&filter, args, argCount, (command == CLI_COMMAND_COUNT));
+        }
+        break;
+    case CLI_COMMAND_HELP:
+        WriteUsage(argv[0]);
+        exitCode = CLI_EXIT_SUCCESS;
+        break;
+    default:
+        if(argc > 1)
+        {
+            WriteErrorFormat(L"Unknown command %s" NEWLINE_W, argv[1]);
+        }
+        badArgs = TRUE;
+        break;
+    }
+
+    if(badArgs)
+    {
+        WriteUsage(argv[0]);
+    }
+
+    FlushOutput();
+    ScratchEnd(scratch);
+
+    return exitCode;
+}
@@ -0,0 +1,75 @@
+/* -------------------------------------------------------------
+
+climain.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    The entry point of esncli, which runs the app's command line
+    commands, like /convert, on their own. It builds on any platform
+    the core supports, so the commands can be used and tested
+    without the app.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <stdlib.h>
+#include "esncore.h"
+
+#ifdef _WIN32
+
+//
+// wmain
+// program entry point
+//
+int wmain(int argc, wchar_t ** argv)
+{
+    int exitCode;
+
+    InitTrace();
+    exitCode = RunCommandLineCommand(argc, argv);
+    WriteTraceFile();
+
+    return exitCode;
+}
+
+#else // _WIN32
+
+//
+// main
+// program entry point. The args are UTF-8, and are converted to the
+// UTF-16 the commands take.
+//
+int main(int argc, char ** argv)
+{
+    int exitCode;
+    LPWSTR * wideArgv = calloc((size_t)argc + 1, sizeof(LPWSTR));
+
+    if(!wideArgv)
+    {
+        return CLI_EXIT_ERROR;
+    }
+
+    for(int i = 0; i < argc; i++)
+    {
+        int length = (int)strlen(argv[i]);
+
+        // A UTF-8 byte never becomes more than one UTF-16 character
+        wideArgv[i] = calloc((size_t)length + 1, sizeof(WCHAR));
+        if(!wideArgv[i] || (length > 0 && DecodeUtf8((const BYTE *)argv[i], length, wideArgv[i], length) == 0))
+        {
+            return CLI_EXIT_ERROR;
+        }
+    }
+
+    InitTrace();
+    exitCode = RunCommandLineCommand(argc, wideArgv);
+    WriteTraceFile();
+
+    for(int i = 0; i < argc; i++)
+    {
+        free(wideArgv[i]);
+    }
+    free(wideArgv);
+
+    return exitCode;
+}
+
+#endif // _WIN32
@@ -0,0 +1,244 @@
+/* -------------------------------------------------------------
+
+clipboard.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for cut, copy, and paste in the edit control.
+
+    The edit control's own handlers are replaced so that a copy
+    moves the selection straight from the edit control's text into
+    the clipboard's memory, and a paste inserts straight from the
+    clipboard's memory unless its line endings need converting.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <windows.h>
+#include <commctrl.h>
+#include "esnpad.h"
+
+// The ID of the edit control subclass
+#define CLIPBOARD_SUBCLASS_ID 2
+
+extern BOOL g_showControlChars;
+
+//
+// CopyEditSelection
+// Puts the text selected in the edit control on the clipboard.
+// The selection is copied once, from the edit control's text into
+// the memory that's handed to the clipboard.
+// Returns FALSE if nothing was copied.
+//
+BOOL CopyEditSelection(HWND hwnd)
+{
+    BOOL success = FALSE;
+    DWORD selStart = 0;
+    DWORD selEnd = 0;
+    DWORD textLength;
+    size_t copyLength;
+    HLOCAL hText;
+    LPCWSTR text;
+    HGLOBAL hCopy;
+    WCHAR * copy;
+    TRACE_SCOPE scope = {0};
+
+    SendMessage(hwnd, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+    textLength = (DWORD)GetWindowTextLength(hwnd);
+    selEnd = min(selEnd, textLength);
+    if(selStart >= selEnd)
+    {
+        return FALSE;
+    }
+
+    TRACE_BEGIN(scope, "copy");
+    copyLength = selEnd - selStart;
+    TRACE_BYTES(scope, copyLength * sizeof(WCHAR));
+
+    hCopy = GlobalAlloc(GMEM_MOVEABLE, (copyLength + 1) * sizeof(WCHAR));
+    if(hCopy)
+    {
+        copy = GlobalLock(hCopy);
+        hText = (HLOCAL)SendMessage(hwnd, EM_GETHANDLE, 0, 0);
+        text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+
+        if(copy && text)
+        {
+            CopyMemory(copy, text + selStart, copyLength * sizeof(WCHAR));
+            copy[copyLength] = 0;
+            success = TRUE;
+        }
+
+        if(text)
+        {
+            LocalUnlock(hText);
+        }
+        if(copy)
+        {
+            GlobalUnlock(hCopy);
+        }
+    }
+
+    if(success)
+    {
+        success = FALSE;
+        if(OpenClipboard(hwnd))
+        {
+            // Once SetClipboardData succeeds, the clipboard owns the memory
+            if(EmptyClipboard() && SetClipboardData(CF_UNICODETEXT, hCopy))
+            {
+                hCopy = NULL;
+                success = TRUE;
+            }
+            CloseClipboard();
+        }
+    }
+
+    if(hCopy)
+    {
+        DebugLog(L"Unable to copy %Iu characters to the clipboard", copyLength);
+        GlobalFree(hCopy);
+    }
+
+    TRACE_END(scope);
+    return success;
+}
+
+//
+// NeedsControlCharsReplaced
+// Returns TRUE if ReplaceControlChars would change text
+//
+BOOL NeedsControlCharsReplaced(LPCWSTR text, size_t length)
+{
+    if(!g_showControlChars)
+    {
+        // The length was found from the null terminator, so there are no nulls
+        return FALSE;
+    }
+
+    for(size_t i = 0; i < length; i++)
+    {
+        if((text[i] < 0x20 && text[i] != L'\t' && text[i] != L'\r' && text[i] != L'\n') || text[i] == 0x7F)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+//
+// PasteIntoEdit
+// Replaces the selection in the edit control with the text on the
+// clipboard, as one step that can be undone. The clipboard's text is
+// inserted where it is when it already uses CRLF. Otherwise it's copied
+// once, and its line endings are converted the same way as a file's.
+// Returns FALSE if nothing was pasted.
+//
+BOOL PasteIntoEdit(HWND hwnd)
+{
+    BOOL success = FALSE;
+    HGLOBAL hClip;
+    LPCWSTR clipText;
+    size_t clipLength;
+    LINE_ENDING_COUNTS lineEndings;
+    WCHAR * text;
+    size_t textLength;
+    TRACE_SCOPE scope = {0};
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    if(!IsClipboardFormatAvailable(CF_UNICODETEXT) || !OpenClipboard(hwnd))
+    {
+        ScratchEnd(scratch);
+        return FALSE;
+    }
+
+    TRACE_BEGIN(scope, "paste");
+
+    hClip = GetClipboardData(CF_UNICODETEXT);
+    clipText = hClip ? (LPCWSTR)GlobalLock(hClip) : NULL;
+    if(clipText)
+    {
+        // The text should end with a null, but don't read past the memory if it doesn't
+        clipLength = wcsnlen(clipText, GlobalSize(hClip) / sizeof(WCHAR));
+        TRACE_BYTES(scope, clipLength * sizeof(WCHAR));
+
+        CountLineEndings(clipText, clipLength, &lineEndings);
+        if(lineEndings.lf == 0 && lineEndings.cr == 0 &&
+            clipLength < GlobalSize(hClip) / sizeof(WCHAR) && !NeedsControlCharsReplaced(clipText, clipLength))
+        {
+            SendMessageW(hwnd, EM_REPLACESEL, TRUE, (LPARAM)clipText);
+            success = TRUE;
+        }
+        else
+        {
+            // Each lone CR or LF grows by a character when it's converted, plus a null terminator
+            text = ScratchAlloc((clipLength + lineEndings.lf + lineEndings.cr + 1) * sizeof(WCHAR));
+            if(text)
+            {
+                CopyMemory(text, clipText, clipLength * sizeof(WCHAR));
+                text[clipLength] = 0;
+                textLength = ConvertLineEndingsToCRLF(text, clipLength, &lineEndings);
+                ReplaceControlChars(text, textLength, g_showControlChars);
+                text[textLength] = 0;
+
+                SendMessageW(hwnd, EM_REPLACESEL, TRUE, (LPARAM)text);
+                success = TRUE;
+            }
+            else
+            {
+                DebugLog(L"Unable to allocate memory to paste %Iu characters", clipLength);
+            }
+        }
+
+        GlobalUnlock(hClip);
+    }
+
+    CloseClipboard();
+    ScratchEnd(scratch);
+    TRACE_END(scope);
+
+    return success;
+}
+
+//
+// ClipboardEditProc
+// The subclass procedure for the edit control that handles
+// cut, copy, and paste, including their keyboard shortcuts.
+//
+LRESULT CALLBACK ClipboardEditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam,
+    UINT_PTR idSubclass, DWORD_PTR refData)
+{
+    UNREFERENCED_PARAMETER(refData);
+
+    switch(msg)
+    {
+    case WM_COPY:
+        CopyEditSelection(hwnd);
+        return 0;
+    case WM_CUT:
+        if(CopyEditSelection(hwnd))
+        {
+            SendMessage(hwnd, WM_CLEAR, 0, 0);
+        }
+        return 0;
+    case WM_PASTE:
+        PasteIntoEdit(hwnd);
+        return 0;
+    case WM_NCDESTROY:
+        RemoveWindowSubclass(hwnd, ClipboardEditProc, idSubclass);
+        break;
+    }
+
+    return DefSubclassProc(hwnd, msg, wParam, lParam);
+}
+
+//
+// AttachClipboardHandling
+// Subclasses a new edit control to handle cut, copy, and paste
+//
+void AttachClipboardHandling(HWND hwndEdit)
+{
+    if(!SetWindowSubclass(hwndEdit, ClipboardEditProc, CLIPBOARD_SUBCLASS_ID, 0))
+    {
+        DebugLog(L"Unable to subclass the edit control for the clipboard");
+    }
+}
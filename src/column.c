@@ -0,0 +1,204 @@
+/* -------------------------------------------------------------
+
+column.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the column edit dialog, which inserts or removes text
+    at the same column of every selected line.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <windows.h>
+#include "esnpad.h"
+
+// What the column edit dialog asks for
+typedef struct _COLUMN_EDIT
+{
+    DWORD column;       // counting from 0
+    DWORD width;        // the number of characters to remove
+    WCHAR text[CCH_COLUMN_TEXT];
+} COLUMN_EDIT;
+
+extern HWND g_hwndMain;
+extern HWND g_hwndEdit;
+extern HINSTANCE g_hinst;
+
+//
+// ColumnDlgProc
+// Dialog procedure for the Column Edit dialog.
+// lparam of WM_INITDIALOG is the COLUMN_EDIT that's filled in.
+//
+INT_PTR CALLBACK ColumnDlgProc(HWND hdlg, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    COLUMN_EDIT * columnEdit = (COLUMN_EDIT *)GetWindowLongPtr(hdlg, DWLP_USER);
+    BOOL translated = FALSE;
+    UINT column;
+
+    switch(msg)
+    {
+    case WM_INITDIALOG:
+        SetWindowLongPtr(hdlg, DWLP_USER, lparam);
+        columnEdit = (COLUMN_EDIT *)lparam;
+
+        // Columns are shown counting from 1, like the rest of Windows
+        SetDlgItemInt(hdlg, IDC_COLUMN_NUMBER, columnEdit->column + 1, FALSE);
+        SetDlgItemInt(hdlg, IDC_COLUMN_WIDTH, 0, FALSE);
+        return TRUE;
+    case WM_COMMAND:
+        switch(LOWORD(wparam))
+        {
+        case IDOK:
+            column = GetDlgItemInt(hdlg, IDC_COLUMN_NUMBER, &translated, FALSE);
+            if(!translated || column == 0)
+            {
+                MessageBox(hdlg, L"Enter a column number of 1 or more.", APP_TITLE_W, MB_OK | MB_ICONINFORMATION);
+                return TRUE;
+            }
+
+            columnEdit->column = column - 1;
+            columnEdit->width = GetDlgItemInt(hdlg, IDC_COLUMN_WIDTH, &translated, FALSE);
+            GetDlgItemText(hdlg, IDC_COLUMN_TEXT, columnEdit->text, CCH_COLUMN_TEXT);
+
+            EndDialog(hdlg, IDOK);
+            return TRUE;
+        case IDCANCEL:
+            EndDialog(hdlg, IDCANCEL);
+            return TRUE;
+        }
+        break;
+    }
+
+    return FALSE;
+}
+
+//
+// GetSelectedLines
+// Finds the lines the selection in the edit control covers. spanStart is
+// set to the start of the first line, and spanEnd to the end of the last
+// one, before its line break. A selection that ends at the very start of
+// a line doesn't include that line. Word wrap doesn't matter, since only
+// CRLF ends a line. Returns the offset of the selection start.
+//
+DWORD GetSelectedLines(LPCWSTR text, DWORD textLength, DWORD * spanStart, DWORD * spanEnd)
+{
+    DWORD selStart = 0;
+    DWORD selEnd = 0;
+    DWORD start;
+    DWORD end;
+
+    SendMessage(g_hwndEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+    selStart = min(selStart, textLength);
+    selEnd = min(selEnd, textLength);
+
+    start = selStart;
+    while(start >= 2 && !(text[start - 1] == L'\n' && text[start - 2] == L'\r'))
+    {
+        start--;
+    }
+    if(start < 2)
+    {
+        start = 0;
+    }
+
+    end = selEnd;
+    if(end > selStart && end >= 2 && text[end - 1] == L'\n' && text[end - 2] == L'\r')
+    {
+        end -= 2;
+    }
+    while(end < textLength && !(text[end] == L'\r' && end + 1 < textLength && text[end + 1] == L'\n'))
+    {
+        end++;
+    }
+
+    *spanStart = start;
+    *spanEnd = max(end, start);
+
+    return selStart;
+}
+
+//
+// MainWndOnEditColumn
+// Handles IDM_EDIT_COLUMN by asking for a column and the text to insert
+// there, then rewriting all of the selected lines at once. The lines are
+// replaced with one EM_REPLACESEL, so the whole edit is a single undo.
+//
+void MainWndOnEditColumn(void)
+{
+    COLUMN_EDIT columnEdit = {0};
+    HLOCAL hText;
+    LPCWSTR text;
+    DWORD textLength;
+    DWORD spanStart = 0;
+    DWORD spanEnd = 0;
+    DWORD lineCount;
+    DWORD * lineStarts;
+    WCHAR * output = NULL;
+    size_t outputLength = 0;
+    TRACE_SCOPE scope = {0};
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    hText = (HLOCAL)SendMessage(g_hwndEdit, EM_GETHANDLE, 0, 0);
+    text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+    if(!text)
+    {
+        ScratchEnd(scratch);
+        return;
+    }
+
+    textLength = (DWORD)GetWindowTextLength(g_hwndEdit);
+    columnEdit.column = GetSelectedLines(text, textLength, &spanStart, &spanEnd) - spanStart;
+    LocalUnlock(hText);
+
+    if(DialogBoxParam(g_hinst, MAKEINTRESOURCE(IDD_COLUMN), g_hwndMain, ColumnDlgProc, (LPARAM)&columnEdit) != IDOK)
+    {
+        ScratchEnd(scratch);
+        return;
+    }
+
+    TRACE_BEGIN(scope, "column edit");
+
+    // The text can change while the dialog is open, when the file is reloaded
+    // after the app is activated again. Find the selected lines again, in the
+    // text as it is now, so the spans are never past its end.
+    hText = (HLOCAL)SendMessage(g_hwndEdit, EM_GETHANDLE, 0, 0);
+    text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+    if(text)
+    {
+        textLength = (DWORD)GetWindowTextLength(g_hwndEdit);
+        GetSelectedLines(text, textLength, &spanStart, &spanEnd);
+        TRACE_BYTES(scope, (spanEnd - spanStart) * sizeof(WCHAR));
+
+        lineCount = CountTextLines(text + spanStart, spanEnd - spanStart);
+        lineStarts = ScratchAlloc(((size_t)lineCount + 1) * sizeof(DWORD));
+        if(lineStarts)
+        {
+            FillLineTable(text + spanStart, spanEnd - spanStart, lineStarts);
+
+            outputLength = ApplyColumnEdit(text + spanStart, lineStarts, lineCount, columnEdit.column,
+                columnEdit.width, columnEdit.text, wcslen(columnEdit.text), NULL);
+            output = ScratchAlloc((outputLength + 1) * sizeof(WCHAR));
+            if(output)
+            {
+                ApplyColumnEdit(text + spanStart, lineStarts, lineCount, columnEdit.column,
+                    columnEdit.width, columnEdit.text, wcslen(columnEdit.text), output);
+                output[outputLength] = 0;
+            }
+        }
+
+        LocalUnlock(hText);
+    }
+
+    if(output)
+    {
+        SendMessage(g_hwndEdit, EM_SETSEL, spanStart, spanEnd);
+        SendMessageW(g_hwndEdit, EM_REPLACESEL, TRUE, (LPARAM)output);
+        SendMessage(g_hwndEdit, EM_SETSEL, spanStart, spanStart + outputLength);
+    }
+    else
+    {
+        MessageBox(g_hwndMain, L"Unable to edit the selected lines.", APP_TITLE_W, MB_OK | MB_ICONERROR);
+    }
+
+    ScratchEnd(scratch);
+    TRACE_END(scope);
+}
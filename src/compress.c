@@ -0,0 +1,792 @@
+/* -------------------------------------------------------------
+
+compress.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for reading gzip compressed files, like rotated logs.
+
+    Decompression runs on a thread of its own, and writes to a pipe.
+    Whatever reads the other end of the pipe decodes the text while
+    the next part is still being decompressed, and can read it just
+    like a file. Only the last 32 KB of output is kept, which is as
+    far back as a deflate stream can refer.
+
+    Zstandard files are recognized, so they can be reported clearly,
+    but they can't be decompressed.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+// The furthest back a deflate stream can copy from
+#define CB_INFLATE_WINDOW     32768
+
+// The longest Huffman code in a deflate stream
+#define MAX_CODE_BITS         15
+
+// Codes up to this long are decoded with one table lookup
+#define FAST_CODE_BITS        9
+
+// The most literal/length and distance codes
+#define MAX_LITERAL_CODES     288
+#define MAX_DISTANCE_CODES    30
+
+// How far past the end of the input the bit reader can look ahead
+#define MAX_PADDING_BYTES     4
+
+// The gzip header flags
+#define GZIP_FLAG_HCRC        0x02
+#define GZIP_FLAG_EXTRA       0x04
+#define GZIP_FLAG_NAME        0x08
+#define GZIP_FLAG_COMMENT     0x10
+#define GZIP_FLAG_RESERVED    0xE0
+
+// A canonical Huffman code, as counts of codes of each length and
+// the symbols in code order, plus a table to decode short codes at once.
+// Each fast entry is the code's length << 9 | its symbol, or 0 for a longer code.
+typedef struct _HUFFMAN_TABLE
+{
+    WORD counts[MAX_CODE_BITS + 1];
+    WORD symbols[MAX_LITERAL_CODES];
+    WORD fast[1 << FAST_CODE_BITS];
+} HUFFMAN_TABLE;
+
+// Everything the decompression thread needs
+typedef struct _INFLATE_STATE
+{
+    HANDLE hInput;
+    HANDLE hOutput;
+    BOOL failed;
+
+    // Input, read a chunk at a time, and a bit at a time from bitBuffer
+    DWORD inputLength;
+    DWORD inputPosition;
+    DWORD paddingBytes;     // zero bytes added to bitBuffer past the end of the input
+    DWORD bitBuffer;
+    DWORD bitCount;
+    BYTE input[CB_STREAM_CHUNK];
+
+    // Output since the start of the current gzip member
+    DWORD windowPosition;
+    DWORD flushedPosition;
+    ULONGLONG memberSize;
+    DWORD crc;
+    DWORD crcTable[256];
+    BYTE window[CB_INFLATE_WINDOW];
+
+    HUFFMAN_TABLE literals;
+    HUFFMAN_TABLE distances;
+} INFLATE_STATE;
+
+//
+// globals
+//
+const WORD g_lengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const BYTE g_lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const WORD g_distanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const BYTE g_distanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// The order the lengths of the code length code are stored in
+const BYTE g_codeLengthOrder[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+//
+// GetCompressionFormat
+// Returns the COMPRESSION_ format of data, from its first bytes
+//
+int GetCompressionFormat(const BYTE * data, size_t size)
+{
+    if(size >= 2 && data[0] == 0x1F && data[1] == 0x8B)
+    {
+        return COMPRESSION_GZIP;
+    }
+
+    if(size >= 4 && data[0] == 0x28 && data[1] == 0xB5 && data[2] == 0x2F && data[3] == 0xFD)
+    {
+        return COMPRESSION_ZSTD;
+    }
+
+    return COMPRESSION_NONE;
+}
+
+//
+// FillBits
+// Makes sure there are at least count bits in the bit buffer, reading
+// more input if needed. Past the end of the input, zero bytes are added,
+// so a short code at the very end can still be looked up. Reading much
+// further than that fails.
+//
+BOOL FillBits(INFLATE_STATE * state, DWORD count)
+{
+    DWORD bytesRead;
+
+    while(state->bitCount < count)
+    {
+        if(state->inputPosition == state->inputLength)
+        {
+            bytesRead = 0;
+            if(state->paddingBytes == 0 && state->hInput &&
+                !ReadFile(state->hInput, state->input, CB_STREAM_CHUNK, &bytesRead, NULL) &&
+                GetLastError() != ERROR_BROKEN_PIPE)
+            {
+                state->failed = TRUE;
+                return FALSE;
+            }
+
+            state->inputLength = bytesRead;
+            state->inputPosition = 0;
+        }
+
+        if(state->inputPosition < state->inputLength)
+        {
+            state->bitBuffer |= (DWORD)state->input[state->inputPosition++] << state->bitCount;
+        }
+        else if(++state->paddingBytes > MAX_PADDING_BYTES)
+        {
+            state->failed = TRUE;
+            return FALSE;
+        }
+        state->bitCount += 8;
+    }
+
+    return TRUE;
+}
+
+//
+// GetBits
+// Returns the next count bits of the input, up to 16 of them.
+// Returns 0 and sets state->failed if there aren't enough.
+//
+DWORD GetBits(INFLATE_STATE * state, DWORD count)
+{
+    DWORD bits;
+
+    if(count == 0 || !FillBits(state, count))
+    {
+        return 0;
+    }
+
+    bits = state->bitBuffer & ((1UL << count) - 1);
+    state->bitBuffer >>= count;
+    state->bitCount -= count;
+
+    return bits;
+}
+
+//
+// IsInputFinished
+// Returns TRUE once every byte of the input has been used
+//
+BOOL IsInputFinished(INFLATE_STATE * state)
+{
+    if(state->bitCount > state->paddingBytes * 8)
+    {
+        return FALSE;
+    }
+
+    if(state->paddingBytes > 0)
+    {
+        return TRUE;
+    }
+
+    // Look for one more byte, without using it
+    if(!FillBits(state, 8))
+    {
+        state->failed = FALSE;
+        return TRUE;
+    }
+
+    return (state->paddingBytes > 0);
+}
+
+//
+// FlushWindow
+// Writes the output that hasn't been written yet, and adds it to the CRC
+//
+BOOL FlushWindow(INFLATE_STATE * state)
+{
+    DWORD length = state->windowPosition - state->flushedPosition;
+    BYTE * data = state->window + state->flushedPosition;
+    DWORD bytesWritten;
+
+    for(DWORD i = 0; i < length; i++)
+    {
+        state->crc = state->crcTable[(state->crc ^ data[i]) & 0xFF] ^ (state->crc >> 8);
+    }
+
+    // The write fails when the reader closes the pipe early, which stops decompression
+    if(length > 0 && !WriteFile(state->hOutput, data, length, &bytesWritten, NULL))
+    {
+        state->failed = TRUE;
+        return FALSE;
+    }
+
+    state->flushedPosition = state->windowPosition;
+    if(state->windowPosition == CB_INFLATE_WINDOW)
+    {
+        state->windowPosition = 0;
+        state->flushedPosition = 0;
+    }
+
+    return TRUE;
+}
+
+//
+// PutByte
+// Adds a byte to the output
+//
+BOOL PutByte(INFLATE_STATE * state, BYTE value)
+{
+    state->window[state->windowPosition++] = value;
+    state->memberSize++;
+
+    return (state->windowPosition < CB_INFLATE_WINDOW) || FlushWindow(state);
+}
+
+//
+// BuildHuffmanTable
+// Builds the table for a canonical Huffman code from the length of
+// each symbol's code, where 0 means the symbol isn't used.
+// Returns FALSE if the lengths have more codes than can exist.
+//
+BOOL BuildHuffmanTable(HUFFMAN_TABLE * table, const BYTE * lengths, DWORD count)
+{
+    WORD offsets[MAX_CODE_BITS + 1];
+    DWORD code = 0;
+    DWORD reversed;
+    DWORD length;
+    DWORD index = 0;
+    int left = 1;
+
+    ZeroMemory(table, sizeof(HUFFMAN_TABLE));
+
+    for(DWORD symbol = 0; symbol < count; symbol++)
+    {
+        table->counts[lengths[symbol]]++;
+    }
+    table->counts[0] = 0;
+
+    // Each length has twice as many codes as the one before, less the ones that are used
+    for(length = 1; length <= MAX_CODE_BITS; length++)
+    {
+        left = left * 2 - table->counts[length];
+        if(left < 0)
+        {
+            return FALSE;
+        }
+    }
+
+    offsets[1] = 0;
+    for(length = 1; length < MAX_CODE_BITS; length++)
+    {
+        offsets[length + 1] = (WORD)(offsets[length] + table->counts[length]);
+    }
+
+    for(DWORD symbol = 0; symbol < count; symbol++)
+    {
+        if(lengths[symbol] != 0)
+        {
+            table->symbols[offsets[lengths[symbol]]++] = (WORD)symbol;
+        }
+    }
+
+    // Codes are stored from their first bit to their last, so the
+    // fast table is indexed by each short code with its bits reversed,
+    // repeated for every value of the bits that follow it
+    for(length = 1; length <= FAST_CODE_BITS; length++)
+    {
+        for(DWORD i = 0; i < table->counts[length]; i++, code++, index++)
+        {
+            reversed = 0;
+            for(DWORD bit = 0; bit < length; bit++)
+            {
+                reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+            }
+
+            for(DWORD entry = reversed; entry < (1 << FAST_CODE_BITS); entry += (1UL << length))
+            {
+                table->fast[entry] = (WORD)((length << 9) | table->symbols[index]);
+            }
+        }
+        code <<= 1;
+    }
+
+    return TRUE;
+}
+
+//
+// DecodeSymbol
+// Returns the next symbol of the input, using a Huffman table.
+// Sets state->failed if the input isn't a valid code.
+//
+DWORD DecodeSymbol(INFLATE_STATE * state, const HUFFMAN_TABLE * table)
+{
+    WORD entry;
+    DWORD code = 0;
+    DWORD first = 0;
+    DWORD index = 0;
+
+    if(!FillBits(state, FAST_CODE_BITS))
+    {
+        return 0;
+    }
+
+    entry = table->fast[state->bitBuffer & ((1 << FAST_CODE_BITS) - 1)];
+    if(entry != 0)
+    {
+        state->bitBuffer >>= (entry >> 9);
+        state->bitCount -= (entry >> 9);
+        return entry & 0x1FF;
+    }
+
+    // A longer code is found a bit at a time
+    for(DWORD length = 1; length <= MAX_CODE_BITS; length++)
+    {
+        code |= GetBits(state, 1);
+        if(code - first < table->counts[length])
+        {
+            return table->symbols[index + (code - first)];
+        }
+        index += table->counts[length];
+        first = (first + table->counts[length]) << 1;
+        code <<= 1;
+    }
+
+    state->failed = TRUE;
+    return 0;
+}
+
+//
+// InflateStoredBlock
+// Copies a block that's stored without compression
+//
+BOOL InflateStoredBlock(INFLATE_STATE * state)
+{
+    DWORD length;
+    DWORD check;
+
+    // The length starts at the next byte
+    GetBits(state, state->bitCount % 8);
+    length = GetBits(state, 16);
+    check = GetBits(state, 16);
+    if(state->failed || length != (~check & 0xFFFF))
+    {
+        return FALSE;
+    }
+
+    while(length-- > 0)
+    {
+        if(!PutByte(state, (BYTE)GetBits(state, 8)) || state->failed)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+//
+// InflateCodes
+// Decodes the literals and copies of a compressed block, until its end
+//
+BOOL InflateCodes(INFLATE_STATE * state)
+{
+    DWORD symbol;
+    DWORD length;
+    DWORD distance;
+    DWORD from;
+
+    for(;;)
+    {
+        symbol = DecodeSymbol(state, &state->literals);
+        if(state->failed)
+        {
+            return FALSE;
+        }
+
+        if(symbol < 256)
+        {
+            if(!PutByte(state, (BYTE)symbol))
+            {
+                return FALSE;
+            }
+        }
+        else if(symbol == 256)
+        {
+            return TRUE;
+        }
+        else
+        {
+            symbol -= 257;
+            if(symbol >= ARRAYSIZE(g_lengthBase))
+            {
+                return FALSE;
+            }
+            length = g_lengthBase[symbol] + GetBits(state, g_lengthExtra[symbol]);
+
+            symbol = DecodeSymbol(state, &state->distances);
+            if(state->failed || symbol >= MAX_DISTANCE_CODES)
+            {
+                return FALSE;
+            }
+            distance = g_distanceBase[symbol] + GetBits(state, g_distanceExtra[symbol]);
+            if(state->failed || distance > state->memberSize)
+            {
+                return FALSE;
+            }
+
+            // The copy can overlap the bytes it makes, so it goes a byte at a time
+            from = (state->windowPosition + CB_INFLATE_WINDOW - distance) % CB_INFLATE_WINDOW;
+            while(length-- > 0)
+            {
+                if(!PutByte(state, state->window[from]))
+                {
+                    return FALSE;
+                }
+                from = (from + 1) % CB_INFLATE_WINDOW;
+            }
+        }
+    }
+}
+
+//
+// InflateFixedBlock
+// Decodes a block that uses the fixed Huffman codes
+//
+BOOL InflateFixedBlock(INFLATE_STATE * state)
+{
+    BYTE lengths[MAX_LITERAL_CODES];
+    DWORD symbol;
+
+    for(symbol = 0; symbol < 144; symbol++)
+    {
+        lengths[symbol] = 8;
+    }
+    for(; symbol < 256; symbol++)
+    {
+        lengths[symbol] = 9;
+    }
+    for(; symbol < 280; symbol++)
+    {
+        lengths[symbol] = 7;
+    }
+    for(; symbol < MAX_LITERAL_CODES; symbol++)
+    {
+        lengths[symbol] = 8;
+    }
+    BuildHuffmanTable(&state->literals, lengths, MAX_LITERAL_CODES);
+
+    for(symbol = 0; symbol < MAX_DISTANCE_CODES; symbol++)
+    {
+        lengths[symbol] = 5;
+    }
+    BuildHuffmanTable(&state->distances, lengths, MAX_DISTANCE_CODES);
+
+    return InflateCodes(state);
+}
+
+//
+// InflateDynamicBlock
+// Reads the Huffman codes stored at the start of a block,
+// then decodes the block with them
+//
+BOOL InflateDynamicBlock(INFLATE_STATE * state)
+{
+    BYTE lengths[MAX_LITERAL_CODES + MAX_DISTANCE_CODES] = {0};
+    DWORD literalCount;
+    DWORD distanceCount;
+    DWORD codeLengthCount;
+    DWORD index = 0;
+    DWORD symbol;
+    DWORD repeat;
+    BYTE value;
+
+    literalCount = GetBits(state, 5) + 257;
+    distanceCount = GetBits(state, 5) + 1;
+    codeLengthCount = GetBits(state, 4) + 4;
+    if(state->failed || literalCount > MAX_LITERAL_CODES || distanceCount > MAX_DISTANCE_CODES)
+    {
+        return FALSE;
+    }
+
+    // The lengths of the two codes are themselves Huffman coded
+    for(DWORD i = 0; i < codeLengthCount; i++)
+    {
+        lengths[g_codeLengthOrder[i]] = (BYTE)GetBits(state, 3);
+    }
+    if(state->failed || !BuildHuffmanTable(&state->literals, lengths, ARRAYSIZE(g_codeLengthOrder)))
+    {
+        return FALSE;
+    }
+    ZeroMemory(lengths, sizeof(lengths));
+
+    while(index < literalCount + distanceCount)
+    {
+        symbol = DecodeSymbol(state, &state->literals);
+        if(state->failed)
+        {
+            return FALSE;
+        }
+
+        if(symbol < 16)
+        {
+            lengths[index++] = (BYTE)symbol;
+            continue;
+        }
+
+        if(symbol == 16)
+        {
+            // Repeat the last length 3 to 6 times
+            if(index == 0)
+            {
+                return FALSE;
+            }
+            value = lengths[index - 1];
+            repeat = 3 + GetBits(state, 2);
+        }
+        else
+        {
+            // Repeat a zero length 3 to 10, or 11 to 138 times
+            value = 0;
+            repeat = (symbol == 17) ? 3 + GetBits(state, 3) : 11 + GetBits(state, 7);
+        }
+
+        if(state->failed || index + repeat > literalCount + distanceCount)
+        {
+            return FALSE;
+        }
+        while(repeat-- > 0)
+        {
+            lengths[index++] = value;
+        }
+    }
+
+    // A block that can't end can't be valid
+    if(lengths[256] == 0 ||
+        !BuildHuffmanTable(&state->literals, lengths, literalCount) ||
+        !BuildHuffmanTable(&state->distances, lengths + literalCount, distanceCount))
+    {
+        return FALSE;
+    }
+
+    return InflateCodes(state);
+}
+
+//
+// InflateGzipMember
+// Decompresses one gzip member: a header, deflate blocks, and a trailer
+// with the CRC and size of the output, which are checked.
+// A gzip file can be several members, one after another.
+//
+BOOL InflateGzipMember(INFLATE_STATE * state)
+{
+    DWORD flags;
+    DWORD length;
+    DWORD last;
+    DWORD type;
+    DWORD crc;
+    DWORD size;
+    BOOL success;
+
+    if(GetBits(state, 8) != 0x1F || GetBits(state, 8) != 0x8B || GetBits(state, 8) != 8)
+    {
+        return FALSE;
+    }
+
+    flags = GetBits(state, 8);
+    if(flags & GZIP_FLAG_RESERVED)
+    {
+        return FALSE;
+    }
+
+    // Skip the time, extra flags and OS
+    for(DWORD i = 0; i < 6; i++)
+    {
+        GetBits(state, 8);
+    }
+
+    if(flags & GZIP_FLAG_EXTRA)
+    {
+        length = GetBits(state, 16);
+        while(length-- > 0 && !state->failed)
+        {
+            GetBits(state, 8);
+        }
+    }
+    if(flags & GZIP_FLAG_NAME)
+    {
+        while(GetBits(state, 8) != 0 && !state->failed)
+        {
+        }
+    }
+    if(flags & GZIP_FLAG_COMMENT)
+    {
+        while(GetBits(state, 8) != 0 && !state->failed)
+        {
+        }
+    }
+    if(flags & GZIP_FLAG_HCRC)
+    {
+        GetBits(state, 16);
+    }
+
+    state->memberSize = 0;
+    state->crc = 0xFFFFFFFF;
+
+    do
+    {
+        last = GetBits(state, 1);
+        type = GetBits(state, 2);
+        if(state->failed)
+        {
+            return FALSE;
+        }
+
+        switch(type)
+        {
+        case 0:
+            success = InflateStoredBlock(state);
+            break;
+        case 1:
+            success = InflateFixedBlock(state);
+            break;
+        case 2:
+            success = InflateDynamicBlock(state);
+            break;
+        default:
+            success = FALSE;
+            break;
+        }
+    } while(success && !last);
+
+    if(!success || !FlushWindow(state))
+    {
+        return FALSE;
+    }
+
+    // The trailer starts at the next byte
+    GetBits(state, state->bitCount % 8);
+    crc = GetBits(state, 16);
+    crc |= GetBits(state, 16) << 16;
+    size = GetBits(state, 16);
+    size |= GetBits(state, 16) << 16;
+
+    // Zero bytes added past the end of the input mean it was cut short
+    return !state->failed && state->bitCount >= state->paddingBytes * 8 &&
+        crc == ~state->crc && size == (DWORD)state->memberSize;
+}
+
+//
+// InflateThreadProc
+// Decompresses the input to the output pipe, then closes the pipe,
+// so the reader sees the end of the data.
+// Returns 0 if all the input was valid, and 1 if it wasn't.
+//
+DWORD WINAPI InflateThreadProc(LPVOID param)
+{
+    INFLATE_STATE * state = (INFLATE_STATE *)param;
+    BOOL success;
+
+    do
+    {
+        success = InflateGzipMember(state);
+    } while(success && !IsInputFinished(state) &&
+        FillBits(state, 16) && (state->bitBuffer & 0xFFFF) == 0x8B1F);
+
+    // Anything else after the last member is ignored, like gzip does.
+    // It's often zeros, from a log that was rotated while it was written.
+    if(!success)
+    {
+        DebugLog(L"InflateThreadProc: the compressed data isn't valid\n");
+    }
+
+    CloseHandle(state->hOutput);
+    HeapFree(GetProcessHeap(), 0, state);
+
+    return success ? 0 : 1;
+}
+
+//
+// StartDecompression
+// Starts decompressing gzip data on a new thread. The data starts with
+// the prefix bytes, which are no more than CB_STREAM_CHUNK, and goes on
+// with the rest of hInput, which must stay open until it's finished.
+// Returns a handle to read the decompressed bytes from, and the thread
+// in hThread. Pass both to FinishDecompression when done reading.
+// Returns INVALID_HANDLE_VALUE if decompression can't be started.
+//
+HANDLE StartDecompression(HANDLE hInput, const BYTE * prefix, size_t prefixSize, HANDLE * hThread)
+{
+    INFLATE_STATE * state;
+    HANDLE hRead = INVALID_HANDLE_VALUE;
+    HANDLE hWrite = INVALID_HANDLE_VALUE;
+    DWORD crc;
+
+    *hThread = NULL;
+    if(prefixSize > CB_STREAM_CHUNK)
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    state = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(INFLATE_STATE));
+    if(!state)
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    if(!CreatePipe(&hRead, &hWrite, NULL, CB_STREAM_CHUNK))
+    {
+        HeapFree(GetProcessHeap(), 0, state);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    for(DWORD i = 0; i < 256; i++)
+    {
+        crc = i;
+        for(DWORD bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        }
+        state->crcTable[i] = crc;
+    }
+
+    state->hInput = hInput;
+    state->hOutput = hWrite;
+    if(prefixSize > 0)
+    {
+        CopyMemory(state->input, prefix, prefixSize);
+    }
+    state->inputLength = (DWORD)prefixSize;
+
+    *hThread = CreateThread(NULL, 0, InflateThreadProc, state, 0, NULL);
+    if(!*hThread)
+    {
+        CloseHandle(hRead);
+        CloseHandle(hWrite);
+        HeapFree(GetProcessHeap(), 0, state);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return hRead;
+}
+
+//
+// FinishDecompression
+// Closes the handle returned by StartDecompression, and waits for its
+// thread, which stops early if not everything was read.
+// Returns TRUE if all the data was read and it was valid.
+//
+BOOL FinishDecompression(HANDLE hRead, HANDLE hThread)
+{
+    DWORD exitCode = 1;
+
+    CloseHandle(hRead);
+    WaitForSingleObject(hThread, INFINITE);
+    GetExitCodeThread(hThread, &exitCode);
+    CloseHandle(hThread);
+
+    return (exitCode == 0);
+}
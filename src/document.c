@@ -0,0 +1,187 @@
+/* -------------------------------------------------------------
+
+document.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for turning the bytes of a file into the text of a document.
+    Nothing in here touches windows or app globals, so opening a
+    file can be measured without the edit control.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// FailKnownDocument
+// Frees the text DecodeKnownDocument made, when the data isn't what
+// the open cache knew, and ends its trace scope
+//
+void FailKnownDocument(DOCUMENT_TEXT * document, TRACE_SCOPE * scope)
+{
+    HeapFree(GetProcessHeap(), 0, document->text);
+    ZeroMemory(document, sizeof(*document));
+    document->encoding = ENCODING_UNSPECIFIED;
+    TRACE_END(*scope);
+}
+
+//
+// DecodeKnownDocument
+// Decodes data like DecodeDocument does, using what the open cache
+// knows about it from the last time it was decoded. The text is allocated
+// at its known length, so the bytes aren't scanned to size it, and the
+// encoding isn't detected again. The line endings and control characters
+// are still counted, which is cheap next to decoding, since an entry for
+// a file that changed without changing its fingerprint would be wrong.
+// Returns FALSE with no text if the data doesn't decode to the known
+// length, or its counts don't match, so the caller can decode it the
+// usual way.
+//
+BOOL DecodeKnownDocument(const BYTE * data, size_t dataSize, BOOL showControlChars, const DOCUMENT_INFO * known,
+    DOCUMENT_TEXT * document)
+{
+    size_t bomSize;
+    size_t decodedLength = 0;
+    ULONGLONG loneEndings = known->lf + known->cr;
+    TRACE_SCOPE scope = {0};
+
+    ZeroMemory(document, sizeof(*document));
+    document->encoding = ENCODING_UNSPECIFIED;
+
+    // The BOM is checked anyway, since it costs nothing
+    if(known->length >= (SIZE_T)-1 / sizeof(WCHAR) || loneEndings > known->length ||
+        GetEncodingFromBom(data, dataSize, &bomSize) != known->encoding)
+    {
+        return FALSE;
+    }
+
+    document->capacity = (size_t)known->length + 1;
+    document->text = HeapAlloc(GetProcessHeap(), 0, document->capacity * sizeof(WCHAR));
+    if(!document->text)
+    {
+        return FALSE;
+    }
+
+    TRACE_BEGIN(scope, "decode");
+    TRACE_BYTES(scope, dataSize);
+
+    // A buffer that's too small makes the decode fail, so the line endings
+    // can only be converted when there's exactly as much room as they need
+    if(!DecodeBytes(data + bomSize, dataSize - bomSize, known->encoding, document->text,
+        document->capacity * sizeof(WCHAR), &decodedLength) ||
+        decodedLength + loneEndings != known->length)
+    {
+        FailKnownDocument(document, &scope);
+        return FALSE;
+    }
+
+    // Converting the line endings with the wrong counts would overwrite
+    // text before it's read, so they must be the ones the text has
+    document->length = decodedLength;
+    CountLineEndings(document->text, document->length, &document->lineEndings);
+    if(document->lineEndings.crlf != known->crlf || document->lineEndings.lf != known->lf ||
+        document->lineEndings.cr != known->cr)
+    {
+        FailKnownDocument(document, &scope);
+        return FALSE;
+    }
+
+    if(loneEndings > 0)
+    {
+        document->length = ConvertLineEndingsToCRLF(document->text, document->length, &document->lineEndings);
+    }
+
+    // Counted the same way, the same text replaces the same characters
+    document->replacedChars = ReplaceControlChars(document->text, document->length, showControlChars);
+    if(showControlChars == known->showControlChars && document->replacedChars != known->replacedChars)
+    {
+        FailKnownDocument(document, &scope);
+        return FALSE;
+    }
+
+    document->encoding = known->encoding;
+    TRACE_END(scope);
+
+    return TRUE;
+}
+
+//
+// DecodeDocument
+// Decodes data, the bytes of a file, into the text the edit control
+// shows: the encoding is detected, every line ending becomes CRLF, and
+// control characters are replaced as ReplaceControlChars describes.
+// known is what the open cache knows about the file, or NULL.
+// The text is allocated from the process heap, and the caller frees it.
+// If the bytes can't be decoded, the text is empty, and FALSE is returned.
+// Returns FALSE with no text if the memory can't be allocated.
+//
+BOOL DecodeDocument(const BYTE * data, size_t dataSize, BOOL showControlChars, const DOCUMENT_INFO * known,
+    DOCUMENT_TEXT * document)
+{
+    BOOL success = FALSE;
+    size_t textSize;
+    TRACE_SCOPE scope = {0};
+
+    if(known && DecodeKnownDocument(data, dataSize, showControlChars, known, document))
+    {
+        return TRUE;
+    }
+
+    ZeroMemory(document, sizeof(*document));
+    document->encoding = ENCODING_UNSPECIFIED;
+
+    // Worst-case each UTF-8 byte expands to a wide char. Then each lone CR
+    // or LF line ending grows by a wide char when it's converted to CRLF,
+    // and there can't be more of those than CR and LF bytes in the data.
+    // Plus a wide null terminator.
+    document->capacity = dataSize + CountLineBreakBytes(data, dataSize) + 1;
+    textSize = document->capacity * sizeof(WCHAR);
+
+    // It isn't zeroed, since the decoder writes every character and a terminator.
+    document->text = HeapAlloc(GetProcessHeap(), 0, textSize);
+    if(!document->text)
+    {
+        return FALSE;
+    }
+
+    TRACE_BEGIN(scope, "decode");
+    TRACE_BYTES(scope, dataSize);
+
+    success = ConvertBytesToString(data, dataSize, document->text, textSize, &document->length, &document->encoding);
+    if(!success)
+    {
+        document->text[0] = 0;
+        document->length = 0;
+    }
+
+    // The edit control only breaks lines at CRLF, so convert any other
+    // line endings in place. Text that is all CRLF is left as it is.
+    CountLineEndings(document->text, document->length, &document->lineEndings);
+    if(document->lineEndings.lf > 0 || document->lineEndings.cr > 0)
+    {
+        document->length = ConvertLineEndingsToCRLF(document->text, document->length, &document->lineEndings);
+    }
+
+    // Make sure nulls don't cut the text short in the edit control
+    document->replacedChars = ReplaceControlChars(document->text, document->length, showControlChars);
+
+    TRACE_END(scope);
+
+    return success;
+}
+
+//
+// GetDocumentInfo
+// Gets what the open cache keeps about a document that was decoded
+// with showControlChars
+//
+void GetDocumentInfo(const DOCUMENT_TEXT * document, BOOL showControlChars, DOCUMENT_INFO * info)
+{
+    ZeroMemory(info, sizeof(*info));
+    info->encoding = document->encoding;
+    info->showControlChars = showControlChars;
+    info->length = document->length;
+    info->crlf = document->lineEndings.crlf;
+    info->lf = document->lineEndings.lf;
+    info->cr = document->lineEndings.cr;
+    info->replacedChars = document->replacedChars;
+}
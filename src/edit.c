@@ -11,6 +11,11 @@ by: Matthew Justice
 #include <stdbool.h>
 #include "esnpad.h"
 
+//
+// globals
+//
+BOOL g_showControlChars = FALSE;    // show control characters as symbols
+
 extern HWND g_hwndMain;
 extern HWND g_hwndEdit;
 extern HINSTANCE g_hinst;
@@ -23,6 +28,7 @@ extern HINSTANCE g_hinst;
 BOOL CreateEditControl(HWND hwndParent, BOOL wordWrap)
 {
     LPWSTR textBuffer = NULL;
+    SCRATCH_MARK scratch = ScratchBegin();
 
     // These width & height values are defaults, only used when these isn't an existing edit control.
     // And even when they are used, the actual width and height will be set by a WM_SIZE message.
@@ -36,10 +42,11 @@ BOOL CreateEditControl(HWND hwndParent, BOOL wordWrap)
         int textLength = GetWindowTextLength(g_hwndEdit);
 
         // Allocate a buffer to hold the text
-        textBuffer = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (textLength + 1) * sizeof(WCHAR));
+        textBuffer = ScratchAlloc((textLength + 1) * sizeof(WCHAR));
         if(textBuffer)
         {
             // Copy the text to the buffer
+            textBuffer[0] = 0;
             GetWindowText(g_hwndEdit, textBuffer, textLength + 1);
         }
 
@@ -61,6 +68,13 @@ BOOL CreateEditControl(HWND hwndParent, BOOL wordWrap)
         style &= ~ES_AUTOHSCROLL;
     }
 
+    // Keep the edit control hidden while the hex view or the filter view is shown in its place
+    BOOL otherView = IsHexViewVisible() || IsFilterViewVisible();
+    if(otherView)
+    {
+        style &= ~WS_VISIBLE;
+    }
+
     // Create the edit control
     g_hwndEdit = CreateWindowEx(0, L"Edit", textBuffer,
         style, 0, 0, editWidth, editHeight, hwndParent, (HMENU)IDC_EDIT, g_hinst, NULL);
@@ -68,90 +82,136 @@ BOOL CreateEditControl(HWND hwndParent, BOOL wordWrap)
     if(g_hwndEdit)
     {
         // Set the focus to the edit control
-        SetFocus(g_hwndEdit);
+        if(!otherView)
+        {
+            SetFocus(g_hwndEdit);
+        }
 
         // Set the font for the edit control based on the current DPI
         UINT dpi = GetDpiForWindow(hwndParent);
-        HFONT hFont = CreateScaledFont(dpi);
+        HFONT hFont = GetEditFont(dpi);
         SendMessage(g_hwndEdit, WM_SETFONT, (WPARAM)hFont, TRUE);
-    }
 
-    // If we allocated a text buffer, free it now
-    if(textBuffer)
-    {
-        HeapFree(GetProcessHeap(), 0, textBuffer);
+        AttachHighlighting(g_hwndEdit);
+        AttachClipboardHandling(g_hwndEdit);
+        AttachStatusTracking(g_hwndEdit);
+        AttachRecoveryTracking(g_hwndEdit);
     }
 
+    // Free the text buffer, if we allocated one
+    ScratchEnd(scratch);
+
     // Return TRUE if the edit control was created successfully
     return (g_hwndEdit != NULL);
 }
 
 //
 // Set the text in g_hwndEdit to the characters specified in data.
+// known is what the open cache knows about data, or NULL. What decoding
+// it found, like its encoding and line endings, is returned in info.
 //
-BOOL SetEditText(BYTE * data, size_t dataSize)
+BOOL SetEditText(BYTE * data, size_t dataSize, const DOCUMENT_INFO * known, DOCUMENT_INFO * info)
 {
-    BOOL success = FALSE;
-    WCHAR * wideText;
-    size_t wideTextSize;
+    BOOL success;
+    DOCUMENT_TEXT document;
+    TRACE_SCOPE layoutScope = {0};
 
-    // Allocate a buffer for holding our text as wide characters.
-    // It needs to be 2 times the size of the file, since worst-case
-    // each UTF-8 byte expands to a wide char.
-    wideTextSize = dataSize * 2;
-    wideText = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, wideTextSize);
-    if(wideText)
+    // Convert the data to CRLF text without nulls.
+    // Treat the function as successful if we're able to convert the
+    // bytes to a string. If not, the text is empty.
+    success = DecodeDocument(data, dataSize, g_showControlChars, known, &document);
+    GetDocumentInfo(&document, g_showControlChars, info);
+
+    if(document.text)
     {
-        // Convert the data to a wide string.
-        if(ConvertBytesToString(data, dataSize, wideText, wideTextSize))
-        {
-            // Treat the function as successful if we're able to convert the
-            // bytes to a string.
-            success = TRUE;
-        }
-        else 
+        if(document.replacedChars > 0)
         {
-            // If the conversion failed, set wideText to an empty string
-            wideText[0] = 0;
+            DebugLog(L"Replaced control characters in the text\n");
         }
 
         // Select all current text in the edit control
         SendMessage(g_hwndEdit, EM_SETSEL, 0, -1);
 
         // Replace the selected text in the edit control, or append if none selected 
-        SendMessageW(g_hwndEdit, EM_REPLACESEL, FALSE, (LPARAM)wideText);
+        TRACE_BEGIN(layoutScope, "layout");
+        TRACE_BYTES(layoutScope, document.length * sizeof(WCHAR));
+        SendMessageW(g_hwndEdit, EM_REPLACESEL, FALSE, (LPARAM)document.text);
+        TRACE_END(layoutScope);
 
         // Scroll the edit control to the top
         SendMessage(g_hwndEdit, EM_SETSEL, 0, 0);
         SendMessage(g_hwndEdit, EM_SCROLLCARET, 0, 0);
 
-        HeapFree(GetProcessHeap(), 0, wideText);
+        // Keep the text as the baseline that edits are journaled against
+        SetRecoveryBaseline(document.text, document.length, document.capacity);
     }
 
     return success;
 }
 
+//
+// AppendEditText
+// Decode data, which is text in the specified encoding with no BOM, and
+// add it to the end of the text in g_hwndEdit. The selection and scroll
+// position are left alone, so appending to a long file is cheap.
+//
+BOOL AppendEditText(BYTE * data, size_t dataSize, int encoding)
+{
+    BOOL success = FALSE;
+    WCHAR * wideText;
+    size_t wideTextSize;
+    size_t wideTextLength = 0;
+    LINE_ENDING_COUNTS lineEndings;
+    DWORD selStart = 0;
+    DWORD selEnd = 0;
+    int textLength;
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    // Sized the same way as in SetEditText
+    wideTextSize = (dataSize + CountLineBreakBytes(data, dataSize) + 1) * sizeof(WCHAR);
+    wideText = ScratchAlloc(wideTextSize);
+    if(wideText)
+    {
+        if(DecodeBytes(data, dataSize, encoding, wideText, wideTextSize, &wideTextLength))
+        {
+            CountLineEndings(wideText, wideTextLength, &lineEndings);
+            if(lineEndings.lf > 0 || lineEndings.cr > 0)
+            {
+                wideTextLength = ConvertLineEndingsToCRLF(wideText, wideTextLength, &lineEndings);
+            }
+
+            ReplaceControlChars(wideText, wideTextLength, g_showControlChars);
+
+            // Insert the text at the end, then put the selection back
+            SendMessage(g_hwndEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+            textLength = GetWindowTextLength(g_hwndEdit);
+            SendMessage(g_hwndEdit, EM_SETSEL, textLength, textLength);
+            SendMessageW(g_hwndEdit, EM_REPLACESEL, FALSE, (LPARAM)wideText);
+            SendMessage(g_hwndEdit, EM_SETSEL, selStart, selEnd);
+
+            AppendToRecoveryBaseline(wideText, wideTextLength);
+            success = TRUE;
+        }
+    }
+
+    ScratchEnd(scratch);
+    return success;
+}
+
 //
 // MainWndOnControlColorEdit
 // Handles the WM_CTLCOLOREDIT message for the edit control.
 //
 LRESULT MainWndOnControlColorEdit(HDC hdc)
 {
-    COLORREF textColor;
-    COLORREF backgroundColor;
-
-    HMENU hMenu = GetMenu(g_hwndMain);
-    UINT darkModeMenuState = GetMenuState(hMenu, IDM_VIEW_DARKMODE, MF_BYCOMMAND);
-
-    textColor = (darkModeMenuState & MF_CHECKED) ? DARK_MODE_TEXT_COLOR : LIGHT_MODE_TEXT_COLOR;
-    backgroundColor = (darkModeMenuState & MF_CHECKED) ? DARK_MODE_BACKGROUND_COLOR : LIGHT_MODE_BACKGROUND_COLOR;
+    const THEME * theme = GetCurrentTheme();
 
     // Set the text color
-    SetTextColor(hdc, textColor);
+    SetTextColor(hdc, theme->textColor);
 
     // Set the background color
-    SetBkColor(hdc, backgroundColor); // Dark color
+    SetBkColor(hdc, theme->backgroundColor);
 
-    // Return a brush with the new background color
-    return (LRESULT) CreateSolidBrush(backgroundColor);
+    // Return the cached brush for the background color
+    return (LRESULT) theme->backgroundBrush;
 }
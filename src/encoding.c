@@ -0,0 +1,590 @@
+/* -------------------------------------------------------------
+
+encoding.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for detecting text encodings and converting text between them.
+    Nothing in here touches windows or app globals, so it can be
+    used by any code that works with text in memory.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <limits.h>
+#include "esncore.h"
+
+//
+// HashBytes
+// Computes a 32-bit FNV-1a hash of the specified bytes.
+//
+DWORD HashBytes(const BYTE * data, size_t dataSize)
+{
+    DWORD hash = 2166136261;
+
+    for(size_t i = 0; i < dataSize; i++)
+    {
+        hash ^= data[i];
+        hash *= 16777619;
+    }
+
+    return hash;
+}
+
+//
+// DecodeBytes
+// Convert data, which is text in the specified encoding with no BOM,
+// to a wide character string. Used directly when the encoding is already
+// known, like for text appended to a file that's open.
+//
+// data does not need to be null-terminated. Exactly dataSize bytes are
+// decoded, and nothing is read past them. wideText is always
+// null-terminated, as long as wideTextSize is large enough to hold a
+// terminator. The number of characters written to wideText, not counting
+// the terminator, is returned in wideTextLength.
+//
+BOOL DecodeBytes(const BYTE * data, size_t dataSize, int encoding, WCHAR * wideText, size_t wideTextSize,
+    size_t * wideTextLength)
+{
+    BOOL success = FALSE;
+    size_t wideTextCapacity = wideTextSize / sizeof(WCHAR); // in characters, including the terminator
+    size_t length = 0;
+
+    *wideTextLength = 0;
+
+    if(wideTextCapacity == 0)
+    {
+        // There isn't even room for a terminator
+        return FALSE;
+    }
+
+    if(encoding == ENCODING_UTF_16_LE)
+    {
+        // UTF-16 LE is already wide text, so just copy it into the output buffer.
+        size_t charCount = dataSize / sizeof(WCHAR);
+        BOOL oddByte = (dataSize % sizeof(WCHAR)) != 0;
+
+        if(charCount + oddByte < wideTextCapacity)
+        {
+            memcpy(wideText, data, charCount * sizeof(WCHAR));
+            length = charCount;
+
+            // A trailing odd byte can't be a whole character, so
+            // mark it as invalid rather than silently dropping it.
+            if(oddByte)
+            {
+                wideText[length++] = UNICODE_REPLACEMENT_CHAR;
+            }
+
+            success = TRUE;
+        }
+    }
+    else if(encoding == ENCODING_UTF_16_BE)
+    {
+        // Same as UTF-16 LE, but each character's bytes are swapped
+        size_t charCount = dataSize / sizeof(WCHAR);
+        BOOL oddByte = (dataSize % sizeof(WCHAR)) != 0;
+
+        if(charCount + oddByte < wideTextCapacity)
+        {
+            for(size_t i = 0; i < charCount; i++)
+            {
+                wideText[i] = (WCHAR)((data[2 * i] << 8) | data[2 * i + 1]);
+            }
+            length = charCount;
+
+            if(oddByte)
+            {
+                wideText[length++] = UNICODE_REPLACEMENT_CHAR;
+            }
+
+            success = TRUE;
+        }
+    }
+    else if(dataSize == 0)
+    {
+        // DecodeUtf8 fails on empty input, but empty text is fine
+        success = TRUE;
+    }
+    else if(dataSize <= INT_MAX)
+    {
+        // DecodeUtf8 is given the length, so it doesn't stop at a null
+        // or need a terminator. Leave room for the terminator, which we add ourselves.
+        int capacity = (wideTextCapacity - 1 > INT_MAX) ? INT_MAX : (int)(wideTextCapacity - 1);
+        int converted = DecodeUtf8(data, (int)dataSize, wideText, capacity);
+        if(converted > 0)
+        {
+            length = converted;
+            success = TRUE;
+        }
+    }
+
+    wideText[length] = 0;
+    *wideTextLength = length;
+
+    return success;
+}
+
+//
+// GetEncodingFromBom
+// Detects the encoding of data from its byte order mark. Data without
+// a BOM is treated as UTF-8, which ANSI text is also decoded as.
+// The length of the BOM, which is 0 if there isn't one, is returned in bomSize.
+//
+int GetEncodingFromBom(const BYTE * data, size_t dataSize, size_t * bomSize)
+{
+    if(dataSize >= UTF16_BOM_BYTES && data[0] == 0xFF && data[1] == 0xFE)
+    {
+        // The BOM says this is UTF-16 LE (or UTF-32, but ignore that)
+        DebugLog(L"UTF-16 LE detected");
+        *bomSize = UTF16_BOM_BYTES;
+        return ENCODING_UTF_16_LE;
+    }
+    else if(dataSize >= UTF16_BOM_BYTES && data[0] == 0xFE && data[1] == 0xFF)
+    {
+        DebugLog(L"UTF-16 BE detected");
+        *bomSize = UTF16_BOM_BYTES;
+        return ENCODING_UTF_16_BE;
+    }
+    else if(dataSize >= UTF8_BOM_BYTES && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+    {
+        DebugLog(L"UTF-8 with BOM detected");
+        *bomSize = UTF8_BOM_BYTES;
+        return ENCODING_UTF_8_BOM;
+    }
+
+    // Treat both ANSI and UTF-8 as ENCODING_UTF_8
+    DebugLog(L"Treating data as UTF-8 or ANSI");
+    *bomSize = 0;
+    return ENCODING_UTF_8;
+}
+
+//
+// ConvertBytesToString
+// Given a data buffer of bytes that contains string data
+// that may be ANSI, UTF-8, or UTF-16, convert the data
+// to a wide character string.
+//
+// The encoding is detected from the BOM, if there is one, and the
+// rest of the data is decoded as DecodeBytes describes.
+// The detected encoding is returned in encoding.
+//
+BOOL ConvertBytesToString(const BYTE * data, size_t dataSize, WCHAR * wideText, size_t wideTextSize,
+    size_t * wideTextLength, int * encoding)
+{
+    size_t bomSize;
+
+    *encoding = GetEncodingFromBom(data, dataSize, &bomSize);
+
+    if(!DecodeBytes(data + bomSize, dataSize - bomSize, *encoding, wideText, wideTextSize, wideTextLength))
+    {
+        // Callers expect no encoding when the data can't be decoded
+        *encoding = ENCODING_UNSPECIFIED;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// GetWholeCharBytes
+// Returns how many bytes at the start of data hold whole characters in
+// the specified encoding, for decoding text that's read a piece at a time.
+// The bytes after that are the start of a character, or of a UTF-16
+// surrogate pair, that continues in the next piece.
+//
+size_t GetWholeCharBytes(const BYTE * data, size_t dataSize, int encoding)
+{
+    size_t whole;
+    size_t lead;
+    size_t sequenceLength;
+    WCHAR last;
+
+    if(encoding == ENCODING_UTF_16_LE || encoding == ENCODING_UTF_16_BE)
+    {
+        whole = dataSize & ~(size_t)1;
+        if(whole >= sizeof(WCHAR))
+        {
+            last = (encoding == ENCODING_UTF_16_LE) ?
+                (WCHAR)(data[whole - 2] | (data[whole - 1] << 8)) :
+                (WCHAR)((data[whole - 2] << 8) | data[whole - 1]);
+            if(IS_HIGH_SURROGATE(last))
+            {
+                whole -= sizeof(WCHAR);
+            }
+        }
+        return whole;
+    }
+
+    // Find the lead byte of the last UTF-8 sequence, which is at most
+    // 3 continuation bytes (10xxxxxx) back from the end
+    lead = dataSize;
+    while(lead > 0 && dataSize - lead < 3 && (data[lead - 1] & 0xC0) == 0x80)
+    {
+        lead--;
+    }
+
+    if(lead == 0 || (data[lead - 1] & 0xC0) != 0xC0)
+    {
+        // The data ends with a whole sequence, or with bytes that aren't
+        // valid UTF-8, which are decoded as they are either way
+        return dataSize;
+    }
+
+    if((data[lead - 1] & 0xE0) == 0xC0)
+    {
+        sequenceLength = 2;
+    }
+    else if((data[lead - 1] & 0xF0) == 0xE0)
+    {
+        sequenceLength = 3;
+    }
+    else
+    {
+        sequenceLength = 4;
+    }
+
+    return (dataSize - (lead - 1) < sequenceLength) ? lead - 1 : dataSize;
+}
+
+//
+// ReplaceControlChars
+// The edit control treats a null as the end of its text, so any nulls in
+// decoded text must be replaced, or everything after them would be lost.
+// Nulls become spaces, unless showControlChars is TRUE. In that case every
+// control character other than tab, CR and LF is replaced with its Unicode
+// control picture (U+2400 to U+2421), so binary content can be inspected.
+// Returns the number of characters that were replaced.
+//
+size_t ReplaceControlChars(WCHAR * text, size_t length, BOOL showControlChars)
+{
+    size_t replaced = 0;
+    WCHAR * end = text + length;
+
+    if(!showControlChars)
+    {
+        // Text files rarely contain nulls, and wmemchr skips
+        // over long runs without one much faster than a loop.
+        WCHAR * found = text;
+        while((found = wmemchr(found, 0, (size_t)(end - found))) != NULL)
+        {
+            *found++ = L' ';
+            replaced++;
+        }
+    }
+    else
+    {
+        for(WCHAR * c = text; c < end; c++)
+        {
+            if((*c < 0x20 && *c != L'\t' && *c != L'\r' && *c != L'\n') || *c == 0x7F)
+            {
+                *c = (*c == 0x7F) ? CONTROL_PICTURE_DELETE : (WCHAR)(CONTROL_PICTURE_NULL + *c);
+                replaced++;
+            }
+        }
+    }
+
+    return replaced;
+}
+
+//
+// CountLineBreakBytes
+// Counts the CR and LF bytes in data. Whatever the encoding, every line
+// break character contains at least one of those bytes, so this is an
+// upper bound on the number of line breaks in the decoded text.
+// memchr skips over the bytes in between much faster than a loop.
+//
+size_t CountLineBreakBytes(const BYTE * data, size_t dataSize)
+{
+    const BYTE * end = data + dataSize;
+    const BYTE * found;
+    size_t count = 0;
+
+    for(found = data; (found = memchr(found, '\n', (size_t)(end - found))) != NULL; found++)
+    {
+        count++;
+    }
+
+    for(found = data; (found = memchr(found, '\r', (size_t)(end - found))) != NULL; found++)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+//
+// CountLineEndings
+// Counts the CRLF, LF and CR line endings in text.
+// Like CountLineBreakBytes, this uses wmemchr to find each one.
+//
+void CountLineEndings(const WCHAR * text, size_t length, LINE_ENDING_COUNTS * counts)
+{
+    const WCHAR * end = text + length;
+    const WCHAR * found;
+    size_t crCount = 0;
+
+    ZeroMemory(counts, sizeof(*counts));
+
+    // Every LF is either part of a CRLF or on its own
+    for(found = text; (found = wmemchr(found, L'\n', (size_t)(end - found))) != NULL; found++)
+    {
+        if(found > text && found[-1] == L'\r')
+        {
+            counts->crlf++;
+        }
+        else
+        {
+            counts->lf++;
+        }
+    }
+
+    // Every CR that isn't part of a CRLF is on its own
+    for(found = text; (found = wmemchr(found, L'\r', (size_t)(end - found))) != NULL; found++)
+    {
+        crCount++;
+    }
+
+    counts->cr = crCount - counts->crlf;
+
+    return;
+}
+
+//
+// GetDominantLineEnding
+// Returns the LINE_ENDING_ constant for the most common kind of line ending.
+// Text with no line endings, or with a tie, is treated as CRLF.
+//
+int GetDominantLineEnding(const LINE_ENDING_COUNTS * counts)
+{
+    if(counts->lf > counts->crlf && counts->lf >= counts->cr)
+    {
+        return LINE_ENDING_LF;
+    }
+
+    if(counts->cr > counts->crlf && counts->cr > counts->lf)
+    {
+        return LINE_ENDING_CR;
+    }
+
+    return LINE_ENDING_CRLF;
+}
+
+//
+// HasMixedLineEndings
+// Returns TRUE if the text has more than one kind of line ending
+//
+BOOL HasMixedLineEndings(const LINE_ENDING_COUNTS * counts)
+{
+    return ((counts->crlf > 0) + (counts->lf > 0) + (counts->cr > 0)) > 1;
+}
+
+//
+// ConvertLineEndingsToCRLF
+// Converts every LF and CR line ending in text to CRLF, in place.
+// counts must come from CountLineEndings for the same text, and the
+// buffer must have room for length + counts->lf + counts->cr characters,
+// plus a terminator. The text must already be null-terminated, since a CR
+// at the end is told apart from a CRLF by the character after it. The
+// text is converted from the end backwards, so nothing is overwritten
+// before it's read. Returns the new length.
+//
+size_t ConvertLineEndingsToCRLF(WCHAR * text, size_t length, const LINE_ENDING_COUNTS * counts)
+{
+    size_t newLength = length + counts->lf + counts->cr;
+    WCHAR * src = text + length;
+    WCHAR * dst = text + newLength;
+
+    *dst = 0;
+
+    // When the source and destination meet, everything before them is already CRLF
+    while(src > text && dst > src)
+    {
+        WCHAR c = *--src;
+
+        if(c == L'\n' && !(src > text && src[-1] == L'\r'))
+        {
+            // A lone LF
+            *--dst = L'\n';
+            *--dst = L'\r';
+        }
+        else if(c == L'\r' && src[1] != L'\n')
+        {
+            // A lone CR. The character after it is still in place, or is the terminator.
+            *--dst = L'\n';
+            *--dst = L'\r';
+        }
+        else
+        {
+            *--dst = c;
+        }
+    }
+
+    return newLength;
+}
+
+//
+// ConvertLineEndingsFromCRLF
+// Converts every CRLF in text to the specified line ending, in place.
+// The text only gets shorter, so it's converted from the start forwards.
+// Returns the new length.
+//
+size_t ConvertLineEndingsFromCRLF(WCHAR * text, size_t length, int lineEnding)
+{
+    const WCHAR * src = text;
+    const WCHAR * end = text + length;
+    WCHAR * dst = text;
+
+    if(lineEnding == LINE_ENDING_CRLF)
+    {
+        return length;
+    }
+
+    while(src < end)
+    {
+        if(src[0] == L'\r' && src + 1 < end && src[1] == L'\n')
+        {
+            *dst++ = (lineEnding == LINE_ENDING_LF) ? L'\n' : L'\r';
+            src += 2;
+        }
+        else
+        {
+            *dst++ = *src++;
+        }
+    }
+
+    *dst = 0;
+
+    return (size_t)(dst - text);
+}
+
+//
+// CopyWithLineEnding
+// Copies text to dst with every line ending, whether CRLF, LF or CR,
+// changed to the specified one. dst must have room for twice length
+// characters. Returns the length of the copy, which isn't null-terminated.
+//
+size_t CopyWithLineEnding(const WCHAR * text, size_t length, int lineEnding, WCHAR * dst)
+{
+    WCHAR * start = dst;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        if(text[i] == L'\r' || text[i] == L'\n')
+        {
+            if(text[i] == L'\r' && i + 1 < length && text[i + 1] == L'\n')
+            {
+                i++;
+            }
+
+            if(lineEnding != LINE_ENDING_LF)
+            {
+                *dst++ = L'\r';
+            }
+            if(lineEnding != LINE_ENDING_CR)
+            {
+                *dst++ = L'\n';
+            }
+        }
+        else
+        {
+            *dst++ = text[i];
+        }
+    }
+
+    return (size_t)(dst - start);
+}
+
+//
+// GetEncodingBom
+// Returns the byte order mark that a file saved with the specified
+// encoding starts with, and its length in bomSize.
+// Returns NULL with a bomSize of 0 if the encoding has no BOM.
+//
+const BYTE * GetEncodingBom(int encoding, size_t * bomSize)
+{
+    static const BYTE utf16Bom[UTF16_BOM_BYTES] = { 0xFF, 0xFE };
+    static const BYTE utf16BeBom[UTF16_BOM_BYTES] = { 0xFE, 0xFF };
+    static const BYTE utf8Bom[UTF8_BOM_BYTES] = { 0xEF, 0xBB, 0xBF };
+
+    switch(encoding)
+    {
+    case ENCODING_UTF_16_LE:
+        *bomSize = sizeof(utf16Bom);
+        return utf16Bom;
+    case ENCODING_UTF_16_BE:
+        *bomSize = sizeof(utf16BeBom);
+        return utf16BeBom;
+    case ENCODING_UTF_8_BOM:
+        *bomSize = sizeof(utf8Bom);
+        return utf8Bom;
+    default:
+        *bomSize = 0;
+        return NULL;
+    }
+}
+
+//
+// EncodeWideTextChunk
+// Encodes as much of wideText as fits in dst, for writing to a file
+// a chunk at a time. UTF-16 LE is copied as-is, UTF-16 BE has each
+// character's bytes swapped, and anything else is saved as UTF-8.
+// No BOM is written; see GetEncodingBom.
+//
+// textLength is the number of wide characters in wideText. It does not
+// need to be null-terminated.
+// dst receives the encoded bytes, and must hold at least 6 bytes.
+// charsEncoded is an output param, the number of wide characters consumed.
+//
+// Returns the number of bytes written to dst. A surrogate pair is never
+// split across chunks, so each chunk is valid on its own.
+//
+size_t EncodeWideTextChunk(LPCWSTR wideText, size_t textLength, int encoding,
+    BYTE * dst, size_t dstSize, size_t * charsEncoded)
+{
+    size_t chunkLength;
+    int byteCount;
+
+    if(encoding == ENCODING_UTF_16_LE)
+    {
+        chunkLength = min(textLength, dstSize / sizeof(WCHAR));
+        memcpy(dst, wideText, chunkLength * sizeof(WCHAR));
+        *charsEncoded = chunkLength;
+        return chunkLength * sizeof(WCHAR);
+    }
+
+    if(encoding == ENCODING_UTF_16_BE)
+    {
+        chunkLength = min(textLength, dstSize / sizeof(WCHAR));
+        for(size_t i = 0; i < chunkLength; i++)
+        {
+            dst[2 * i] = (BYTE)(wideText[i] >> 8);
+            dst[2 * i + 1] = (BYTE)(wideText[i] & 0xFF);
+        }
+        *charsEncoded = chunkLength;
+        return chunkLength * sizeof(WCHAR);
+    }
+
+    // A wide char is at most 3 bytes of UTF-8 (a surrogate pair is 4 bytes
+    // for 2 wide chars), so this many always fit without asking for a size.
+    chunkLength = min(textLength, dstSize / 3);
+    chunkLength = min(chunkLength, INT_MAX);
+
+    // Leave a trailing high surrogate for the next chunk, with its pair
+    if(chunkLength > 0 && chunkLength < textLength && IS_HIGH_SURROGATE(wideText[chunkLength - 1]))
+    {
+        chunkLength--;
+    }
+
+    byteCount = 0;
+    if(chunkLength > 0)
+    {
+        byteCount = EncodeUtf8(wideText, (int)chunkLength, dst, (int)min(dstSize, INT_MAX));
+        if(byteCount == 0)
+        {
+            DebugLog(L"Unable to convert text to UTF-8, error %u", GetLastError());
+            chunkLength = 0;
+        }
+    }
+
+    *charsEncoded = chunkLength;
+    return (size_t)byteCount;
+}
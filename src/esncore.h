@@ -0,0 +1,592 @@
+/* -------------------------------------------------------------
+
+esncore.h
+   Essential Notepad - A basic Notepad implementation for Windows
+   Shared header file for the portable core: the encoding, search,
+   document and file code that doesn't use windows, and builds on
+   any platform that platform.h supports.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#ifndef _ESNCORE_H_
+#define _ESNCORE_H_
+
+#include "platform.h"
+
+// General Constants
+#define CB_BUFFER          512
+#define FIND_NOT_FOUND     ((DWORD)-1)
+
+#define APP_TITLE_A        "Essential Notepad"
+#define APP_TITLE_W        L"Essential Notepad"
+
+// The commands that run from the command line without a window
+#define CLI_COMMAND_NONE      0
+#define CLI_COMMAND_DETECT    1
+#define CLI_COMMAND_CONVERT   2
+#define CLI_COMMAND_FIND      3
+#define CLI_COMMAND_COUNT     4
+#define CLI_COMMAND_HELP      5
+
+// The exit codes of the command line commands, which match findstr's
+#define CLI_EXIT_SUCCESS      0
+#define CLI_EXIT_NOT_FOUND    1     // /find or /count matched no lines
+#define CLI_EXIT_ERROR        2
+
+// File related constants
+#define ENCODING_UNSPECIFIED -1
+#define ENCODING_ANSI         0
+#define ENCODING_UTF_8        1
+#define ENCODING_UTF_8_BOM    2
+#define ENCODING_UTF_16_LE    3
+#define ENCODING_UTF_16_BE    4
+
+#define UTF16_BOM_BYTES       2
+#define UTF8_BOM_BYTES        3
+
+// Line ending constants
+// The edit control always uses CRLF. Files that use another style
+// are converted on load, and converted back on save.
+#define LINE_ENDING_UNSPECIFIED -1
+#define LINE_ENDING_CRLF      0
+#define LINE_ENDING_LF        1
+#define LINE_ENDING_CR        2
+
+// Stands in for bytes that can't be decoded as a character
+#define UNICODE_REPLACEMENT_CHAR  0xFFFD
+
+// Unicode control pictures, used to show control characters
+#define CONTROL_PICTURE_NULL      0x2400
+#define CONTROL_PICTURE_DELETE    0x2421
+
+// The number of bytes hashed in each sampled block of a file when
+// computing its fingerprint, and the number of blocks: the head,
+// the middle, and the tail of the file.
+#define CB_FINGERPRINT_BLOCK  4096
+#define FINGERPRINT_BLOCK_COUNT 3
+
+// The number of files the open cache remembers. Files smaller than
+// CB_OPEN_CACHE_MIN are decoded too quickly for it to be worth it.
+#define OPEN_CACHE_ENTRIES    64
+#define CB_OPEN_CACHE_MIN     (1024 * 1024)
+
+// Marks the start of the open cache file, "ESNO", and the version of its layout
+#define OPEN_CACHE_MAGIC      0x4F4E5345
+#define OPEN_CACHE_VERSION    1
+
+// The kinds of tokens the lexers find, each highlighted in its own color
+#define TOKEN_TEXT            0     // not highlighted
+#define TOKEN_TIMESTAMP       1
+#define TOKEN_ERROR           2
+#define TOKEN_WARNING         3
+#define TOKEN_INFO            4
+#define TOKEN_DEBUG           5
+#define TOKEN_KEY             6
+#define TOKEN_STRING          7
+#define TOKEN_NUMBER          8
+#define TOKEN_KEYWORD         9
+#define TOKEN_PUNCTUATION     10
+#define TOKEN_TYPE_COUNT      11
+
+// The most tokens highlighted in one line
+#define MAX_LINE_TOKENS       256
+
+// The state every lexer starts the text in
+#define LEXER_STATE_INITIAL   0
+
+// The number of lines whose start state is cached, and how far back
+// from a line that isn't cached tokenizing starts over.
+#define HIGHLIGHT_CACHE_LINES 1024
+#define HIGHLIGHT_SYNC_LINES  64
+
+// Returned by InvalidateHighlightCache when every line after an edit might have changed
+#define HIGHLIGHT_ALL_LINES   ((DWORD)-1)
+
+// The kinds of filters for the filter view
+#define FILTER_LEVELS         0     // error and warning lines
+#define FILTER_TEXT           1     // lines with the find text
+
+// Runs of this many lines are sorted by insertion before they're merged
+#define SORT_RUN_LINES        16
+
+// The fewest lines worth sorting on a thread of their own
+#define MIN_SORT_TASK_LINES   65536
+
+// The most bytes a TEXT_STREAM reads from a file at once
+#define CB_STREAM_CHUNK       (256 * 1024)
+
+// Room for the decoded text of a read, plus the unfinished line before it
+#define CCH_STREAM_TEXT       (4 * CB_STREAM_CHUNK)
+
+// The most files a file search reads at once, each with its own stream buffers
+#define FILE_SEARCH_TASKS     8
+
+// The longest text a file search looks for, and list of file names it searches
+#define CCH_FILE_SEARCH_TEXT  256
+
+// The most folders deep a file search goes. Each folder adds at least
+// two characters to a path, so a deeper one can't fit in MAX_PATH.
+#define MAX_FILE_SEARCH_DEPTH (MAX_PATH / 2)
+
+// How a file is compressed, from GetCompressionFormat
+#define COMPRESSION_NONE      0
+#define COMPRESSION_GZIP      1
+#define COMPRESSION_ZSTD      2
+
+// Enough bytes to tell how a file is compressed
+#define CB_COMPRESSION_MAGIC  4
+
+// The number of file bytes shown on each row of the hex view
+#define HEX_BYTES_PER_ROW     16
+
+// The max length of a formatted hex row, in characters:
+// a 16 digit offset, 2 spaces, 16 bytes as "XX ", an extra space
+// between the two groups of 8 bytes, a space, and 16 characters.
+#define CCH_HEX_ROW           (16 + 2 + (HEX_BYTES_PER_ROW * 3) + 1 + 1 + HEX_BYTES_PER_ROW)
+
+// The most bytes requested from ReadFile at once
+#define CB_READ_CHUNK         (1024 * 1024)
+
+// The most encoded bytes handed to WriteFile at once
+#define CB_WRITE_CHUNK        (1024 * 1024)
+
+// Files smaller than this are always saved with a full copy
+#define CB_INCREMENTAL_SAVE_MIN   (4 * CB_WRITE_CHUNK)
+
+// A changed tail up to this size is always rewritten in place, even when
+// it's most of the file. Its journal and rewrite take a bounded time, and
+// unlike a full copy, they don't need room on the disk for a second copy.
+#define CB_INCREMENTAL_SAVE_TAIL  (8 * CB_WRITE_CHUNK)
+
+// Marks a complete save journal header, "ESNJ"
+#define SAVE_JOURNAL_MAGIC    0x4A4E5345
+
+// The number of each kind of line ending in some text
+typedef struct _LINE_ENDING_COUNTS
+{
+    size_t crlf;
+    size_t lf;      // LF without a CR before it
+    size_t cr;      // CR without an LF after it
+} LINE_ENDING_COUNTS;
+
+// A cheap identity for the contents of a file on disk.
+// Computing it costs the same regardless of the file size.
+typedef struct _FILE_FINGERPRINT
+{
+    ULONGLONG size;
+    FILETIME lastWriteTime;
+    DWORD blockHashes[FINGERPRINT_BLOCK_COUNT];
+} FILE_FINGERPRINT;
+
+// What decoding a file found out about its text. The open cache keeps
+// it, so opening the same file again can size the text without scanning
+// the bytes, and skip detecting the encoding.
+// The counts are ULONGLONG so the cache file is the same on every build.
+typedef struct _DOCUMENT_INFO
+{
+    int encoding;
+    BOOL showControlChars;      // how replacedChars was counted
+    ULONGLONG length;           // of the text, with CRLF line endings
+    ULONGLONG crlf;             // the line endings, as they were in the file
+    ULONGLONG lf;
+    ULONGLONG cr;
+    ULONGLONG replacedChars;
+} DOCUMENT_INFO;
+
+// A file the open cache remembers, as it was when it was decoded
+typedef struct _OPEN_CACHE_ENTRY
+{
+    DWORD pathHash;
+    DWORD lastUsed;         // the cache's use count when it was last found or added
+    FILE_FINGERPRINT fingerprint;
+    DOCUMENT_INFO info;
+} OPEN_CACHE_ENTRY;
+
+// The files the open cache remembers, most of them recently opened
+typedef struct _OPEN_CACHE
+{
+    DWORD useCount;
+    DWORD entryCount;
+    OPEN_CACHE_ENTRY entries[OPEN_CACHE_ENTRIES];
+} OPEN_CACHE;
+
+// The start of the open cache file. The entries follow it.
+typedef struct _OPEN_CACHE_HEADER
+{
+    DWORD magic;
+    DWORD version;
+    DWORD useCount;
+    DWORD entryCount;
+    DWORD checksum;         // HashBytes of the entries
+} OPEN_CACHE_HEADER;
+
+// The start of a save journal, followed by the original bytes
+// of the file from offset to originalSize
+typedef struct _SAVE_JOURNAL_HEADER
+{
+    DWORD magic;
+    DWORD reserved;
+    ULONGLONG offset;
+    ULONGLONG originalSize;
+} SAVE_JOURNAL_HEADER;
+
+// The text of a file, decoded the way the edit control needs it:
+// with CRLF line endings, and no nulls
+typedef struct _DOCUMENT_TEXT
+{
+    WCHAR * text;           // from the process heap, and null-terminated
+    size_t length;
+    size_t capacity;        // in characters, including the terminator
+    int encoding;           // ENCODING_UNSPECIFIED if the bytes couldn't be decoded
+    LINE_ENDING_COUNTS lineEndings;     // as they were in the file
+    size_t replacedChars;   // the control characters that were replaced
+} DOCUMENT_TEXT;
+
+// A highlighted run of characters in a line
+typedef struct _TOKEN
+{
+    DWORD start;        // from the start of the line
+    DWORD length;
+    int type;
+} TOKEN;
+
+// Tokenizes a line that starts in state, and returns the state the next
+// line starts in. Up to maxTokens tokens are returned, and tokens can be
+// NULL when only the state is needed.
+typedef DWORD (*TOKENIZE_LINE)(const WCHAR * line, DWORD length, DWORD state,
+    TOKEN * tokens, DWORD maxTokens, DWORD * tokenCount);
+
+typedef struct _LEXER
+{
+    LPCWSTR name;
+    TOKENIZE_LINE tokenizeLine;
+} LEXER;
+
+// Gets the text of a line, without its line break, for the highlight cache.
+// Returns FALSE if there's no such line.
+typedef BOOL (*GET_LINE_TEXT)(void * context, DWORD line, const WCHAR ** text, DWORD * length);
+
+// The state each line in a window of lines starts in.
+// states[0] is the state of firstLine.
+typedef struct _HIGHLIGHT_CACHE
+{
+    const LEXER * lexer;
+    DWORD firstLine;
+    DWORD stateCount;   // the number of lines with a known state
+    DWORD states[HIGHLIGHT_CACHE_LINES];
+} HIGHLIGHT_CACHE;
+
+// A block of memory in the scratch arena. The data follows the header,
+// which is padded to keep the data 16-byte aligned.
+typedef struct _SCRATCH_BLOCK
+{
+    struct _SCRATCH_BLOCK * next;
+    size_t size;            // bytes of data, not counting the header
+    size_t used;
+    size_t padding;
+} SCRATCH_BLOCK;
+
+// A position in the scratch arena, returned by ScratchBegin
+typedef struct _SCRATCH_MARK
+{
+    SCRATCH_BLOCK * block;
+    size_t used;
+    ULONGLONG liveBytes;
+} SCRATCH_MARK;
+
+// How the scratch arena has been used, reported in the trace summary
+typedef struct _SCRATCH_STATS
+{
+    ULONGLONG liveBytes;        // allocated and not yet freed
+    ULONGLONG peakBytes;        // the most ever live at once
+    ULONGLONG reservedBytes;    // in blocks, whether in use or kept for reuse
+    ULONGLONG retainedBytes;    // in blocks kept for reuse
+    ULONGLONG allocations;
+    ULONGLONG blocksCreated;
+    ULONGLONG blocksReused;
+} SCRATCH_STATS;
+
+// What the filter view shows
+typedef struct _FILTER
+{
+    int type;
+    LPCWSTR searchText;     // only for FILTER_TEXT
+    BOOL matchCase;
+} FILTER;
+
+// A line that matched a filter
+typedef struct _FILTER_MATCH
+{
+    DWORD line;
+    DWORD offset;       // of the start of the line in the text
+} FILTER_MATCH;
+
+// One part of the text that's filtered on its own thread,
+// and the lines in it that matched
+typedef struct _FILTER_CHUNK
+{
+    LPCWSTR text;
+    DWORD start;
+    DWORD end;
+    const FILTER * filter;
+    FILTER_MATCH * matches;     // allocated from the process heap
+    DWORD matchCount;
+    DWORD matchCapacity;
+    DWORD lineCount;
+    BOOL succeeded;
+} FILTER_CHUNK;
+
+// Text that's read from a file a piece at a time, and decoded
+typedef struct _TEXT_STREAM
+{
+    HANDLE hFile;
+    HANDLE hDecompressed;   // the decompressed bytes, when hFile is compressed
+    HANDLE hDecompressThread;
+    int compression;        // a COMPRESSION_ constant, once the first bytes are read
+    int encoding;           // ENCODING_UNSPECIFIED until the BOM has been checked
+    BOOL endOfStream;
+    BOOL failed;
+    BYTE * bytes;           // bytes that were read but not decoded yet
+    size_t byteCount;
+    WCHAR * text;           // decoded text, starting with the lines returned last time
+    size_t textLength;
+    size_t linesLength;     // the length of the lines returned last time
+    size_t linePosition;    // where ReadStreamLine continues in those lines
+    ULONGLONG lineNumber;   // of the line ReadStreamLine returned last
+    BOOL continuesLine;     // the last line returned had no line break yet
+} TEXT_STREAM;
+
+// Called for each line a file search finds, on whichever thread searched
+// the file. line counts from 1, and column from 0. text is the line, or
+// the piece of it that was read when it's very long.
+typedef void (*FILE_SEARCH_MATCH)(void * context, LPCWSTR path, ULONGLONG line, DWORD column,
+    LPCWSTR text, size_t length);
+
+struct _FILE_SEARCH;
+
+// One of the files a file search reads at once, and the buffers it's read with
+typedef struct _FILE_SEARCH_TASK
+{
+    struct _FILE_SEARCH * search;
+    WCHAR path[MAX_PATH];
+    BYTE * bytes;           // CB_STREAM_CHUNK bytes
+    WCHAR * text;           // CCH_STREAM_TEXT characters
+} FILE_SEARCH_TASK;
+
+// A folder a file search is going through
+typedef struct _FILE_SEARCH_FOLDER
+{
+    HANDLE hFind;
+    size_t pathLength;      // of the folder, at the start of the search's path
+} FILE_SEARCH_FOLDER;
+
+// A search of every file in a folder whose name matches a pattern.
+// The caller fills in the options before InitFileSearch. The counts
+// and cancel can be used from any thread while RunFileSearch runs.
+typedef struct _FILE_SEARCH
+{
+    WCHAR folder[MAX_PATH];
+    WCHAR pattern[CCH_FILE_SEARCH_TEXT];    // like *.txt;*.log, or every file when it's empty
+    WCHAR searchText[CCH_FILE_SEARCH_TEXT];
+    BOOL matchCase;
+    BOOL subfolders;
+    LONG maxResults;                // the search stops after this many, unless it's 0
+    FILE_SEARCH_MATCH onMatch;
+    void * context;                 // passed to onMatch
+    volatile LONG cancel;
+    volatile LONG fileCount;        // files searched so far
+    volatile LONG resultCount;      // lines found so far
+    SRWLOCK lock;                   // held while the folders are gone through
+    WCHAR path[MAX_PATH];           // of the last folder, then of its entry
+    WIN32_FIND_DATAW findData;      // the entry of the last folder that's next
+    BOOL hasEntry;                  // findData hasn't been looked at yet
+    DWORD folderCount;
+    FILE_SEARCH_FOLDER folders[MAX_FILE_SEARCH_DEPTH];
+    DWORD taskCount;
+    FILE_SEARCH_TASK tasks[FILE_SEARCH_TASKS];
+} FILE_SEARCH;
+
+// Where a text changed since it last matched a copy of it, as the
+// number of characters at its start and end that are still the same.
+// Both are (size_t)-1 until an edit is added.
+typedef struct _DIRTY_RANGE
+{
+    size_t sameStart;
+    size_t sameEnd;
+} DIRTY_RANGE;
+
+// A timed operation, started by TRACE_BEGIN and recorded by TRACE_END
+typedef struct _TRACE_SCOPE
+{
+    const char * name;
+    LONGLONG start;
+    ULONGLONG bytes;    // how much data the operation processed, if known
+} TRACE_SCOPE;
+
+// The number of events each thread keeps in its trace ring buffer.
+// Once it's full, the thread's oldest events are overwritten.
+#define TRACE_EVENT_COUNT     4096
+
+// Tracing is enabled at startup by the ESNPAD_TRACE environment variable.
+// When it's off, each of these macros costs a single branch.
+extern BOOL g_traceEnabled;
+#define TRACE_BEGIN(scope, name) (g_traceEnabled ? TraceBegin(&(scope), (name)) : (void)0)
+#define TRACE_END(scope)         (g_traceEnabled ? TraceEnd(&(scope)) : (void)0)
+#define TRACE_BYTES(scope, count) ((scope).bytes = (ULONGLONG)(count))
+
+// Function prototypes - encoding.c
+DWORD HashBytes(const BYTE * data, size_t dataSize);
+BOOL DecodeBytes(const BYTE * data, size_t dataSize, int encoding, WCHAR * wideText, size_t wideTextSize,
+    size_t * wideTextLength);
+int GetEncodingFromBom(const BYTE * data, size_t dataSize, size_t * bomSize);
+BOOL ConvertBytesToString(const BYTE * data, size_t dataSize, WCHAR * wideText, size_t wideTextSize,
+    size_t * wideTextLength, int * encoding);
+size_t GetWholeCharBytes(const BYTE * data, size_t dataSize, int encoding);
+size_t ReplaceControlChars(WCHAR * text, size_t length, BOOL showControlChars);
+size_t CountLineBreakBytes(const BYTE * data, size_t dataSize);
+void CountLineEndings(const WCHAR * text, size_t length, LINE_ENDING_COUNTS * counts);
+int GetDominantLineEnding(const LINE_ENDING_COUNTS * counts);
+BOOL HasMixedLineEndings(const LINE_ENDING_COUNTS * counts);
+size_t ConvertLineEndingsToCRLF(WCHAR * text, size_t length, const LINE_ENDING_COUNTS * counts);
+size_t ConvertLineEndingsFromCRLF(WCHAR * text, size_t length, int lineEnding);
+size_t CopyWithLineEnding(const WCHAR * text, size_t length, int lineEnding, WCHAR * dst);
+const BYTE * GetEncodingBom(int encoding, size_t * bomSize);
+size_t EncodeWideTextChunk(LPCWSTR wideText, size_t textLength, int encoding,
+    BYTE * dst, size_t dstSize, size_t * charsEncoded);
+
+// Function prototypes - hexformat.c
+int GetHexOffsetDigits(ULONGLONG dataSize);
+int FormatHexRow(WCHAR * line, ULONGLONG offset, const BYTE * bytes, size_t byteCount, int offsetDigits);
+
+// Function prototypes - lexer.c
+int GetLogLineLevel(const WCHAR * line, DWORD length);
+const LEXER * GetLogLexer(void);
+const LEXER * GetJsonLexer(void);
+void InitHighlightCache(HIGHLIGHT_CACHE * cache, const LEXER * lexer);
+DWORD GetHighlightLineState(HIGHLIGHT_CACHE * cache, DWORD line, GET_LINE_TEXT getLineText, void * context);
+DWORD TokenizeHighlightLine(HIGHLIGHT_CACHE * cache, DWORD line, GET_LINE_TEXT getLineText, void * context,
+    TOKEN * tokens, DWORD maxTokens);
+DWORD InvalidateHighlightCache(HIGHLIGHT_CACHE * cache, DWORD firstLine, DWORD lastLine, int lineDelta,
+    GET_LINE_TEXT getLineText, void * context);
+
+// Function prototypes - scratch.c
+SCRATCH_MARK ScratchBegin(void);
+void ScratchEnd(SCRATCH_MARK mark);
+void * ScratchAlloc(size_t size);
+void GetScratchStats(SCRATCH_STATS * stats);
+
+// Function prototypes - saveplan.c
+ULONGLONG FindFirstChangedChunk(LPCWSTR wideText, size_t textLength, int encoding,
+    const BYTE * original, ULONGLONG originalSize, BYTE * chunk, size_t * charsSame);
+BOOL IsIncrementalSaveWorthwhile(ULONGLONG originalSize, ULONGLONG offset);
+
+// Function prototypes - savejournal.c
+BOOL WriteEncodedText(HANDLE hFile, LPCWSTR wideText, size_t textLength, int encoding,
+    BYTE * chunk, size_t * bytesWritten);
+BOOL WriteSaveJournal(LPCWSTR journalPath, const BYTE * original,
+    ULONGLONG offset, ULONGLONG originalSize);
+BOOL RewriteFileTail(HANDLE hFile, ULONGLONG offset, LPCWSTR wideText, size_t textLength, int encoding,
+    BYTE * chunk, size_t * bytesWritten);
+BOOL RestoreFromSaveJournal(LPCWSTR filePath, LPCWSTR journalPath);
+
+// Function prototypes - search.c
+DWORD FindTextInBuffer(LPCWSTR text, DWORD textLength, LPCWSTR searchText,
+    BOOL matchCase, BOOL searchDown, DWORD searchStart);
+DWORD FindNextLineStart(LPCWSTR text, DWORD textLength, DWORD position);
+BOOL LineMatchesFilter(LPCWSTR line, DWORD lineLength, const FILTER * filter);
+BOOL FilterTextChunk(FILTER_CHUNK * chunk);
+
+// Function prototypes - textdiff.c
+void ClearDirtyRange(DIRTY_RANGE * dirty);
+void MarkAllDirty(DIRTY_RANGE * dirty);
+void AddDirtyEdit(DIRTY_RANGE * dirty, size_t oldLength, size_t oldStart, size_t oldEnd,
+    size_t newLength, size_t newStart, size_t newEnd);
+BOOL FindChangedRange(LPCWSTR oldText, size_t oldLength, LPCWSTR newText, size_t newLength,
+    const DIRTY_RANGE * dirty, size_t * prefix, size_t * suffix);
+
+// Function prototypes - transform.c
+DWORD CountTextLines(LPCWSTR text, DWORD textLength);
+void FillLineTable(LPCWSTR text, DWORD textLength, DWORD * lineStarts);
+DWORD GetLineLength(const DWORD * lineStarts, DWORD line);
+size_t ApplyColumnEdit(LPCWSTR text, const DWORD * lineStarts, DWORD lineCount,
+    DWORD column, DWORD width, LPCWSTR insertText, size_t insertLength, WCHAR * output);
+int CompareLines(LPCWSTR text, const DWORD * lineStarts, DWORD a, DWORD b);
+void MergeLineOrder(LPCWSTR text, const DWORD * lineStarts, const DWORD * left, DWORD leftCount,
+    const DWORD * right, DWORD rightCount, DWORD * output);
+void SortLineOrder(LPCWSTR text, const DWORD * lineStarts, DWORD * order, DWORD * temp, DWORD count);
+DWORD GetParallelTaskCount(ULONGLONG size, ULONGLONG minSize);
+void SortLinesInTasks(LPCWSTR text, const DWORD * lineStarts, DWORD * order, DWORD * temp, DWORD count,
+    DWORD taskCount);
+void SortLinesInParallel(LPCWSTR text, const DWORD * lineStarts, DWORD * order, DWORD * temp, DWORD count);
+DWORD RemoveAdjacentDuplicates(LPCWSTR text, const DWORD * lineStarts, DWORD * order, DWORD count);
+DWORD RemoveLaterDuplicates(LPCWSTR text, const DWORD * lineStarts, const DWORD * sorted, DWORD count,
+    BYTE * keep, DWORD * order);
+size_t WriteLinesInOrder(LPCWSTR text, const DWORD * lineStarts, const DWORD * order, DWORD count, WCHAR * output);
+size_t TrimTrailingWhitespace(LPCWSTR text, const DWORD * lineStarts, DWORD lineCount, WCHAR * output);
+
+// Function prototypes - compress.c
+int GetCompressionFormat(const BYTE * data, size_t size);
+HANDLE StartDecompression(HANDLE hInput, const BYTE * prefix, size_t prefixSize, HANDLE * hThread);
+BOOL FinishDecompression(HANDLE hRead, HANDLE hThread);
+
+// Function prototypes - fileio.c
+BOOL ReadAllFileBytes(HANDLE hFile, BYTE * dst, size_t dstSize, size_t * dstBytesRead);
+BOOL GetFileFingerprint(HANDLE hFile, FILE_FINGERPRINT * fingerprint);
+BOOL FingerprintsMatch(const FILE_FINGERPRINT * a, const FILE_FINGERPRINT * b);
+BOOL IsFileAppendedTo(HANDLE hFile, const FILE_FINGERPRINT * original, const FILE_FINGERPRINT * current);
+int GetFileCompression(HANDLE hFile);
+BOOL ReadDecompressedFileBytes(HANDLE hFile, BYTE ** dst, size_t * dstBytesRead);
+
+// Function prototypes - document.c
+void FailKnownDocument(DOCUMENT_TEXT * document, TRACE_SCOPE * scope);
+BOOL DecodeKnownDocument(const BYTE * data, size_t dataSize, BOOL showControlChars, const DOCUMENT_INFO * known,
+    DOCUMENT_TEXT * document);
+BOOL DecodeDocument(const BYTE * data, size_t dataSize, BOOL showControlChars, const DOCUMENT_INFO * known,
+    DOCUMENT_TEXT * document);
+void GetDocumentInfo(const DOCUMENT_TEXT * document, BOOL showControlChars, DOCUMENT_INFO * info);
+
+// Function prototypes - opencache.c
+DWORD HashFilePath(LPCWSTR filePath);
+void InitOpenCache(OPEN_CACHE * cache);
+BOOL ReadOpenCache(LPCWSTR cacheFile, OPEN_CACHE * cache);
+BOOL WriteOpenCache(LPCWSTR cacheFile, const OPEN_CACHE * cache);
+BOOL FindOpenCacheEntry(OPEN_CACHE * cache, LPCWSTR filePath, const FILE_FINGERPRINT * fingerprint,
+    DOCUMENT_INFO * info);
+void AddOpenCacheEntry(OPEN_CACHE * cache, LPCWSTR filePath, const FILE_FINGERPRINT * fingerprint,
+    const DOCUMENT_INFO * info);
+
+// Function prototypes - stream.c
+void InitTextStream(TEXT_STREAM * stream, HANDLE hFile, BYTE * bytes, WCHAR * text);
+BOOL FillTextStream(TEXT_STREAM * stream);
+size_t FindLastLineEnd(LPCWSTR text, size_t length);
+BOOL ReadStreamLines(TEXT_STREAM * stream, LPCWSTR * lines, size_t * linesLength);
+BOOL ReadStreamLine(TEXT_STREAM * stream, LPCWSTR * line, size_t * lineLength);
+BOOL CloseTextStream(TEXT_STREAM * stream);
+
+// Function prototypes - filesearch.c
+BOOL MatchFileName(LPCWSTR name, LPCWSTR pattern, size_t patternLength);
+BOOL MatchFilePattern(LPCWSTR name, LPCWSTR patterns);
+BOOL AppendSearchPath(FILE_SEARCH * search, size_t pathLength, LPCWSTR name);
+BOOL OpenSearchFolder(FILE_SEARCH * search);
+void CloseSearchFolder(FILE_SEARCH * search);
+BOOL GetNextSearchFile(FILE_SEARCH * search, WCHAR * path);
+void ReportFileSearchMatch(FILE_SEARCH_TASK * task, ULONGLONG line, DWORD column, LPCWSTR text, size_t length);
+void SearchStreamFile(FILE_SEARCH_TASK * task);
+BOOL InitFileSearch(FILE_SEARCH * search);
+void RunFileSearch(FILE_SEARCH * search);
+void CloseFileSearch(FILE_SEARCH * search);
+
+// Function prototypes - trace.c
+void InitTrace(void);
+void StartTrace(LPCWSTR traceFile);
+void TraceBegin(TRACE_SCOPE * scope, const char * name);
+void TraceEnd(TRACE_SCOPE * scope);
+void WriteTraceFile(void);
+
+// Function prototypes - cli.c
+int GetCommandLineCommand(LPCWSTR arg);
+int RunCommandLineCommand(int argc, LPWSTR * argv);
+LPCWSTR GetEncodingName(int encoding);
+
+#endif // _ESNCORE_H_
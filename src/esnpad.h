@@ -11,15 +11,39 @@ by: Matthew Justice
 #define _ESNPAD_H_
 
 #include <windows.h>
+#include "esncore.h"
 
 // General Constants
 #define IDC_EDIT           100
 #define IDC_STATUS         101
-#define CB_BUFFER          512
+#define IDC_HEX            102
+#define IDC_FILTER         103
 #define CCH_FIND_TEXT      256
+#define CCH_COLUMN_TEXT    256
 
-#define APP_TITLE_A        "Essential Notepad"
-#define APP_TITLE_W        L"Essential Notepad"
+// The open cache is kept in this folder of the user's local app data
+#define OPEN_CACHE_FOLDER  L"Essential Notepad"
+#define OPEN_CACHE_FILE    L"open-cache.bin"
+
+// Private window messages
+// WM_APP_STARTUP is posted once the main window has painted, to finish
+// the startup work that doesn't need to happen before the user sees it.
+#define WM_APP_STARTUP     (WM_APP + 1)
+
+// WM_APP_FIND_FILES_RESULT is posted to the Find in Files dialog with a
+// FIND_FILES_RESULT in lparam, and WM_APP_FIND_FILES_DONE once a search ends
+#define WM_APP_FIND_FILES_RESULT (WM_APP + 2)
+#define WM_APP_FIND_FILES_DONE   (WM_APP + 3)
+
+// Timers on the main window
+#define IDT_AUTOSAVE       1
+#define AUTOSAVE_INTERVAL_MS 1000
+#define IDT_STATUS_UPDATE  2
+#define STATUS_UPDATE_INTERVAL_MS 16   // about one frame
+
+// Timers on the Find in Files dialog
+#define IDT_FIND_FILES_STATUS 1
+#define FIND_FILES_STATUS_INTERVAL_MS 250
 
 // Resource constants
 #define IDI_APPICON           100
@@ -39,6 +63,16 @@ by: Matthew Justice
 #define IDM_EDIT_DELETE       311
 #define IDM_EDIT_SELECT_ALL   312
 #define IDM_EDIT_FIND         313
+#define IDM_VIEW_CONTROL_CHARS 314
+#define IDM_VIEW_HEX          315
+#define IDM_VIEW_HIGHLIGHT    316
+#define IDM_VIEW_FILTER_LEVELS 317
+#define IDM_EDIT_COLUMN       318
+#define IDM_EDIT_SORT         319
+#define IDM_EDIT_SORT_UNIQUE  320
+#define IDM_EDIT_REMOVE_DUPLICATES 321
+#define IDM_EDIT_TRIM_WHITESPACE 322
+#define IDM_EDIT_FIND_IN_FILES 323
 
 // Dialog constants
 #define IDC_STATIC            -1
@@ -48,17 +82,48 @@ by: Matthew Justice
 #define IDC_MATCH_CASE        403
 #define IDC_DIRECTION_UP      404
 #define IDC_DIRECTION_DOWN    405
+#define IDC_FIND_FILTER       406
+#define IDD_COLUMN            410
+#define IDC_COLUMN_TEXT       411
+#define IDC_COLUMN_NUMBER     412
+#define IDC_COLUMN_WIDTH      413
+#define IDD_FIND_FILES        420
+#define IDC_FIND_FILES_TEXT   421
+#define IDC_FIND_FILES_FOLDER 422
+#define IDC_FIND_FILES_PATTERN 423
+#define IDC_FIND_FILES_MATCH_CASE 424
+#define IDC_FIND_FILES_SUBFOLDERS 425
+#define IDC_FIND_FILES_RESULTS 426
+#define IDC_FIND_FILES_STATUS 427
+#define IDC_FIND_FILES_FIND   428
+#define IDC_FIND_FILES_STOP   429
+
+// How the active file on disk differs from when it was loaded
+#define FILE_CHANGE_NONE      0
+#define FILE_CHANGE_APPENDED  1     // text was only added to the end
+#define FILE_CHANGE_MODIFIED  2
+
+// The fewest characters worth filtering on a thread pool thread
+#define CCH_MIN_FILTER_CHUNK  (1024 * 1024)
 
-// File related constants
-#define ENCODING_UNSPECIFIED -1
-#define ENCODING_ANSI         0
-#define ENCODING_UTF_8        1
-#define ENCODING_UTF_8_BOM    2
-#define ENCODING_UTF_16_LE    3
-#define ENCODING_UTF_16_BE    4
+// Find in Files stops once it has found this many matching lines
+#define MAX_FIND_FILES_RESULTS 5000
 
-#define UTF16_BOM_BYTES       2
-#define UTF8_BOM_BYTES        3
+// How much of a matching line Find in Files shows
+#define CCH_FIND_FILES_PREVIEW 200
+
+// The files Find in Files searches, until they're changed
+#define FIND_FILES_DEFAULT_PATTERN L"*.txt;*.log;*.json;*.gz"
+
+// The parts of the status bar, from left to right
+#define STATUS_PART_PROGRESS    0
+#define STATUS_PART_POSITION    1
+#define STATUS_PART_SELECTION   2
+#define STATUS_PART_FILE_SIZE   3
+#define STATUS_PART_LINE_ENDING 4
+#define STATUS_PART_ENCODING    5
+#define STATUS_PART_COUNT       6
+#define CCH_STATUS_PART         128
 
 // The max size of the window title, in bytes.
 // This needs to accomodate a file name (which will be < MAX_PATH)
@@ -80,30 +145,133 @@ by: Matthew Justice
 #define LIGHT_MODE_TEXT_COLOR        RGB(0x00, 0x00, 0x00)
 #define LIGHT_MODE_BACKGROUND_COLOR  RGB(0xFF, 0xFF, 0xFF)
 
+// The colors used to paint the edit control
+typedef struct _THEME
+{
+    LPCWSTR name;               // also the section name in the theme file
+    COLORREF textColor;
+    COLORREF backgroundColor;
+    const COLORREF * tokenColors;   // indexed by token type
+    HBRUSH backgroundBrush;     // created on first use
+} THEME;
+
+// The start of a recovery journal, followed by RECOVERY_RECORDs.
+// The journal only applies to the file with this fingerprint.
+typedef struct _RECOVERY_JOURNAL_HEADER
+{
+    DWORD magic;
+    DWORD reserved;
+    FILE_FINGERPRINT fingerprint;
+} RECOVERY_JOURNAL_HEADER;
+
+// One edit in a recovery journal: removedLength characters at start are
+// replaced with the insertedLength characters that follow the record.
+typedef struct _RECOVERY_RECORD
+{
+    DWORD magic;
+    DWORD checksum;
+    ULONGLONG start;
+    ULONGLONG removedLength;
+    ULONGLONG insertedLength;
+} RECOVERY_RECORD;
+
 // Function prototypes - main
 LRESULT CALLBACK MainWndProc(HWND, UINT, WPARAM, LPARAM);
 BOOL InitApp();
 BOOL InitWindow(int);
 int MsgLoop(void);
 void UpdateTitleDirtyIndicator(void);
-HFONT CreateScaledFont(UINT dpi);
+BOOL ConfirmSaveChanges(void);
 
 // Function prototypes - file.c
 void SetEditTextFromFile(LPWSTR filePath);
-BOOL ConvertBytesToString(BYTE * data, size_t dataSize, WCHAR * wideText, size_t wideTextSize);
+void CheckActiveFileOnDisk(void);
+BOOL ConfirmOverwriteChangedFile(void);
 void MainWndOnFileOpen(void);
 void MainWndOnFileSaveAs(void);
 void MainWndOnFileSave(void);
 
+// Function prototypes - clipboard.c
+BOOL CopyEditSelection(HWND hwnd);
+BOOL PasteIntoEdit(HWND hwnd);
+void AttachClipboardHandling(HWND hwndEdit);
+
+// Function prototypes - highlight.c
+void AttachHighlighting(HWND hwndEdit);
+void SelectHighlightLexer(LPCWSTR filePath);
+void SetHighlighting(BOOL enabled);
+void HighlightTextChanged(void);
+
+// Function prototypes - recovery.c
+void SetRecoveryBaseline(WCHAR * text, size_t length, size_t capacity);
+void DiscardRecoveryJournal(void);
+void RecoveryTextChanged(void);
+void AttachRecoveryTracking(HWND hwndEdit);
+void AutosaveRecoveryJournal(void);
+void ResetRecoveryJournal(LPCWSTR filePath);
+void AppendToRecoveryBaseline(LPCWSTR text, size_t length);
+BOOL RecoverUnsavedEdits(LPCWSTR filePath, const FILE_FINGERPRINT * fingerprint);
+LPCWSTR GetRecoveryText(void);
+
+// Function prototypes - save.c
+BOOL SaveWideTextToFile(LPCWSTR filePath, LPCWSTR wideText, size_t textLength, int encoding, size_t * bytesWritten);
+void RecoverInterruptedSave(LPCWSTR filePath);
+
 // Function prototypes - edit.c
 BOOL CreateEditControl(HWND hwndParent, BOOL wordWrap);
-BOOL SetEditText(BYTE * data, size_t dataSize);
+BOOL SetEditText(BYTE * data, size_t dataSize, const DOCUMENT_INFO * known, DOCUMENT_INFO * info);
+BOOL AppendEditText(BYTE * data, size_t dataSize, int encoding);
 LRESULT MainWndOnControlColorEdit(HDC hdc);
 
 // Function prototypes - find.c
 void MainWndOnEditFind(void);
 
+// Function prototypes - findfiles.c
+void MainWndOnEditFindInFiles(void);
+BOOL GetFindFilesProgress(LONG * fileCount, LONG * resultCount);
+
+// Function prototypes - statusbar.c
+void LayoutStatusBar(int width);
+void ShowStatusProgress(LPCWSTR text);
+void UpdateStatusBar(void);
+void RequestStatusUpdate(void);
+void MainWndOnStatusTimer(HWND hwnd);
+void AttachStatusTracking(HWND hwndEdit);
+
+// Function prototypes - column.c
+DWORD GetSelectedLines(LPCWSTR text, DWORD textLength, DWORD * spanStart, DWORD * spanEnd);
+void MainWndOnEditColumn(void);
+
+// Function prototypes - lines.c
+void MainWndOnEditTransform(int command);
+
+// Function prototypes - filter.c
+BOOL ShowFilterView(HWND hwndParent, const FILTER * filter);
+void HideFilterView(void);
+BOOL IsFilterViewVisible(void);
+void MoveFilterView(int width, int height);
+void SetFilterViewFont(HFONT hFont);
+LRESULT MainWndOnDrawItem(DRAWITEMSTRUCT * drawItem);
+LRESULT MainWndOnVKeyToItem(HWND hwndList, int key);
+void FilterViewOnCommand(int code);
+
+// Function prototypes - hexview.c
+BOOL ShowHexView(HWND hwndParent, BOOL show);
+BOOL IsHexViewVisible(void);
+void RefreshHexView(void);
+void HexViewCloseFile(void);
+void MoveHexView(int width, int height);
+
+// Function prototypes - theme.c
+HFONT GetEditFont(UINT dpi);
+HFONT GetHexViewFont(UINT dpi);
+const THEME * GetCurrentTheme(void);
+void SetDarkMode(BOOL darkMode);
+void LoadThemesFromFile(void);
+void FreeThemeResources(void);
+DWORD GetGdiObjectCount(void);
+
 // Function prototypes - utility.c
-void DebugLog(const WCHAR * format, ...);
+void LogStartupPhase(const char * phase);
 
 #endif // _ESNPAD_H_
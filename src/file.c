@@ -18,6 +18,12 @@ by: Matthew Justice
 //
 WCHAR g_activeFile[MAX_PATH]= {0};
 int g_fileEncoding = ENCODING_UNSPECIFIED;
+FILE_FINGERPRINT g_activeFingerprint = {0};
+int g_lineEnding = LINE_ENDING_CRLF;    // the line ending style to save with
+BOOL g_mixedLineEndings = FALSE;        // the file had more than one style
+FILE_FINGERPRINT g_declinedFingerprint = {0};   // a change the user chose not to reload
+BOOL g_checkingActiveFile = FALSE;
+BOOL g_compressedFile = FALSE;          // the active file was decompressed when it was read
 
 extern HWND g_hwndMain;
 extern HWND g_hwndEdit;
@@ -33,15 +39,18 @@ BOOL SetActiveFile(LPWSTR filePath)
     BOOL success = FALSE;
     LPWSTR fileName;
     LPWSTR windowTitle;
+    SCRATCH_MARK scratch = ScratchBegin();
 
     // Copy the specified filePath into the active file global
     if(SUCCEEDED(StringCchCopyW(g_activeFile, MAX_PATH, filePath)))
     {
+        SelectHighlightLexer(g_activeFile);
+
         // Get a pointer to the the file name in the path.
         fileName = PathFindFileNameW(filePath);
 
         // Allocate a buffer to hold the new window title.
-        windowTitle = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, CB_WINDOW_TITLE);
+        windowTitle = ScratchAlloc(CB_WINDOW_TITLE);
         if(windowTitle)
         {
             // Generate a window title that contains the file name and app name
@@ -53,11 +62,11 @@ BOOL SetActiveFile(LPWSTR filePath)
                     success = TRUE;
                 }
             }
-
-            HeapFree(GetProcessHeap(), 0, windowTitle);
         }
     }
 
+    ScratchEnd(scratch);
+
     if(!success)
     {
         // We weren't able to set the active file or the window title.
@@ -70,93 +79,154 @@ BOOL SetActiveFile(LPWSTR filePath)
 }
 
 //
-// ReadAllFileBytes
-// Read all the bytes of a file specified by hFile.
-// The bytes are read into buffer dst of size dstSize.
+// GetActiveFileChange
+// Checks whether g_activeFile has changed on disk since it was loaded
+// or saved. The new fingerprint is returned in current. Returns one of
+// the FILE_CHANGE values.
 //
-BOOL ReadAllFileBytes(HANDLE hFile, BYTE * dst, size_t dstSize)
+int GetActiveFileChange(FILE_FINGERPRINT * current)
 {
-    BYTE readBuffer[CB_BUFFER];
-    DWORD bytesRead;
-    DWORD byteOffset = 0;
+    int change = FILE_CHANGE_NONE;
+    HANDLE hFile;
+
+    hFile = CreateFile(g_activeFile, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, 0, NULL);
 
-    // Read the bytes of the file chunks matching our buffer size, and
-    // append that text to the dst buffer as we go.
-    do
+    if(hFile == INVALID_HANDLE_VALUE)
     {
-        if(!ReadFile(hFile, readBuffer, CB_BUFFER, &bytesRead, NULL))
-        {
-            return FALSE;
-        }
+        // If the file was deleted, saving will write it again
+        return FILE_CHANGE_NONE;
+    }
 
-        // Copy the bytes into the text buffer.
-        if(memcpy_s(dst+byteOffset, dstSize, readBuffer, bytesRead) != 0)
-        {
-            return FALSE;
-        }
+    if(GetFileFingerprint(hFile, current) && !FingerprintsMatch(current, &g_activeFingerprint))
+    {
+        change = IsFileAppendedTo(hFile, &g_activeFingerprint, current) ?
+            FILE_CHANGE_APPENDED : FILE_CHANGE_MODIFIED;
+    }
+
+    CloseHandle(hFile);
+    return change;
+}
+
+//
+// UpdateActiveFileFingerprint
+// Records the fingerprint of g_activeFile as it is now on disk.
+//
+void UpdateActiveFileFingerprint(void)
+{
+    HANDLE hFile;
+
+    ZeroMemory(&g_activeFingerprint, sizeof(g_activeFingerprint));
 
-        // Update our offset into the dst buffer
-        byteOffset += bytesRead;
-    } while (bytesRead);
+    hFile = CreateFile(g_activeFile, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, 0, NULL);
 
-    return TRUE;
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        GetFileFingerprint(hFile, &g_activeFingerprint);
+        CloseHandle(hFile);
+    }
+
+    return;
 }
 
 //
-// ConvertBytesToString
-// Given a data buffer of bytes that contains string data
-// that may be ANSI, UTF-8, or UTF-16, convert the data
-// to a wide character string.
+// ShowCompressedFileError
+// Tells the user why a compressed file couldn't be opened
 //
-BOOL ConvertBytesToString(BYTE * data, size_t dataSize, WCHAR * wideText, size_t wideTextSize)
+void ShowCompressedFileError(LPCWSTR filePath, int compression)
 {
-    BOOL success = FALSE;
+    LPWSTR message;
+    SCRATCH_MARK scratch = ScratchBegin();
 
-    // Detect the encoding
-    if(dataSize >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+    message = ScratchAlloc(CB_PROMPT_MESSAGE);
+    if(message)
     {
-        DebugLog(L"UTF-16 LE detected");
-        // The BOM says this is UTF-16 LE (or UTF-32, but ignore that)
-        // So just treat the data as wide text and copy it into the output buffer.
-        // Start copying from +2 to skip over the BOM bytes.
-        if(SUCCEEDED(StringCchCopyW(wideText, wideTextSize / sizeof(WCHAR), (LPWSTR)(data+2))))
+        if(compression == COMPRESSION_ZSTD)
+        {
+            StringCchPrintf(message, CB_PROMPT_MESSAGE,
+                L"%s is compressed with Zstandard, which can't be opened.\n\nDecompress it first, then open the decompressed file.",
+                PathFindFileNameW(filePath));
+        }
+        else
         {
-            g_fileEncoding = ENCODING_UTF_16_LE;
-            success = TRUE;
+            StringCchPrintf(message, CB_PROMPT_MESSAGE,
+                L"%s can't be decompressed. It isn't a valid gzip file, or it's incomplete.",
+                PathFindFileNameW(filePath));
         }
+
+        MessageBox(g_hwndMain, message, APP_TITLE_W, MB_OK | MB_ICONERROR);
     }
-    else if(dataSize >= 2 && data[0] == 0xFE && data[1] == 0xFF)
+
+    ScratchEnd(scratch);
+}
+
+//
+// GetOpenCachePath
+// Builds the path of the open cache file, in the user's local app data,
+// and creates its folder if it isn't there yet.
+//
+BOOL GetOpenCachePath(LPWSTR cachePath, size_t cchCachePath)
+{
+    DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", cachePath, (DWORD)cchCachePath);
+
+    if(length == 0 || length >= cchCachePath ||
+        FAILED(StringCchCatW(cachePath, cchCachePath, L"\\" OPEN_CACHE_FOLDER)))
     {
-        DebugLog(L"UTF-16 BE is not supported");
-        g_fileEncoding = ENCODING_UNSPECIFIED;
-        success = FALSE;
+        return FALSE;
     }
-    else
+
+    if(!CreateDirectoryW(cachePath, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
     {
-        DebugLog(L"Treating data as UTF-8 or ANSI");
+        return FALSE;
+    }
 
-        // Check for UTF-8 BOM
-        if(dataSize >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
-        {
-            DebugLog(L"\nUTF-8 with BOM detected");
-            g_fileEncoding = ENCODING_UTF_8_BOM;
-            // Move the data pointer past the BOM
-            data += 3;
-        }
-        else
-        {
-            // Treat both ANSI and UTF-8 as ENCODING_UTF_8
-            g_fileEncoding = ENCODING_UTF_8;
-        }
+    return SUCCEEDED(StringCchCatW(cachePath, cchCachePath, L"\\" OPEN_CACHE_FILE));
+}
 
-        // MultiByteToWideChar handles UTF-8 and ANSI
-        if(MultiByteToWideChar(CP_UTF8, MB_PRECOMPOSED, (LPCCH)data, -1, wideText, (int)(wideTextSize / sizeof(WCHAR))) != 0)
-        {
-            success = TRUE;
-        }
+//
+// FindOpenedFileInfo
+// Looks in the open cache for what decoding filePath found out the last
+// time it was opened, if it still has the same fingerprint. The cache is
+// read each time, so files opened in another window are found too.
+//
+BOOL FindOpenedFileInfo(LPCWSTR filePath, const FILE_FINGERPRINT * fingerprint, DOCUMENT_INFO * info)
+{
+    static OPEN_CACHE cache;
+    WCHAR cachePath[MAX_PATH];
+    TRACE_SCOPE scope = {0};
+    BOOL found = FALSE;
+
+    TRACE_BEGIN(scope, "open cache");
+
+    if(GetOpenCachePath(cachePath, ARRAYSIZE(cachePath)) && ReadOpenCache(cachePath, &cache) &&
+        FindOpenCacheEntry(&cache, filePath, fingerprint, info))
+    {
+        // Finding it makes it the last one the cache forgets
+        WriteOpenCache(cachePath, &cache);
+        found = TRUE;
     }
 
-    return success;
+    TRACE_END(scope);
+    return found;
+}
+
+//
+// RememberOpenedFile
+// Adds what decoding filePath found out to the open cache
+//
+void RememberOpenedFile(LPCWSTR filePath, const FILE_FINGERPRINT * fingerprint, const DOCUMENT_INFO * info)
+{
+    static OPEN_CACHE cache;
+    WCHAR cachePath[MAX_PATH];
+
+    if(GetOpenCachePath(cachePath, ARRAYSIZE(cachePath)))
+    {
+        // A cache that can't be read starts over
+        ReadOpenCache(cachePath, &cache);
+        AddOpenCacheEntry(&cache, filePath, fingerprint, info);
+        WriteOpenCache(cachePath, &cache);
+    }
 }
 
 //
@@ -167,13 +237,32 @@ BOOL ConvertBytesToString(BYTE * data, size_t dataSize, WCHAR * wideText, size_t
 void SetEditTextFromFile(LPWSTR filePath)
 {
     HANDLE hFile;
-    BYTE * fileBytes;
+    BYTE * fileBytes = NULL;
+    BYTE * decompressedBytes = NULL;
     size_t fileBytesSize;
+    size_t fileBytesRead = 0;
     LARGE_INTEGER fileSize;
-
-    // If this function fails, there should be no active file.
-    // Assume failure until the file is opened successfully.
-    ZeroMemory(g_activeFile, sizeof(g_activeFile));
+    int compression;
+    BOOL loaded = FALSE;
+    LINE_ENDING_COUNTS lineEndings;
+    FILE_FINGERPRINT fingerprint;
+    BOOL fingerprinted;
+    DOCUMENT_INFO known;
+    BOOL cached = FALSE;
+    DOCUMENT_INFO info;
+    BOOL decoded;
+    BOOL reopen;
+    WCHAR progress[CCH_STATUS_PART];
+    SCRATCH_MARK scratch;
+    TRACE_SCOPE scope = {0};
+
+    TRACE_BEGIN(scope, "open");
+
+    // Undo any save of this file that didn't finish
+    RecoverInterruptedSave(filePath);
+
+    // Remember if this is the active file being opened again.
+    reopen = (g_activeFile[0] != 0) && (lstrcmpiW(filePath, g_activeFile) == 0);
 
     // Open the file
     hFile = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ,
@@ -181,196 +270,400 @@ void SetEditTextFromFile(LPWSTR filePath)
 
     if(hFile == INVALID_HANDLE_VALUE)
     {
+        // If this function fails, there should be no active file.
+        ZeroMemory(g_activeFile, sizeof(g_activeFile));
+        TRACE_END(scope);
         return;
     }
 
+    // Fingerprint the file. If it's the active file, the edit text is clean,
+    // and the file hasn't changed since it was loaded, then the edit control
+    // already holds its contents. Skip reading and decoding it again.
+    fingerprinted = GetFileFingerprint(hFile, &fingerprint);
+    if(fingerprinted && reopen && !g_dirtyText && FingerprintsMatch(&fingerprint, &g_activeFingerprint))
+    {
+        DebugLog(L"Active file is unchanged, skipping reload: %s", g_activeFile);
+        CloseHandle(hFile);
+        TRACE_END(scope);
+        return;
+    }
+
+    // Reading and decoding a large file takes a while, so show what's happening
+    StringCchPrintfW(progress, CCH_STATUS_PART, L"Opening %s...", PathFindFileNameW(filePath));
+    ShowStatusProgress(progress);
+
+    // The edits to the old text have been saved or thrown away by now
+    DiscardRecoveryJournal();
+
+    // If this function fails, there should be no active file.
+    // Assume failure until the file is read successfully.
+    ZeroMemory(g_activeFile, sizeof(g_activeFile));
+    ZeroMemory(&g_activeFingerprint, sizeof(g_activeFingerprint));
+    ZeroMemory(&g_declinedFingerprint, sizeof(g_declinedFingerprint));
+    g_compressedFile = FALSE;
+
     // Get the file size
     if(GetFileSizeEx(hFile, &fileSize))
     {
-        // Allocate a buffer that is large enough to hold the entire contents
-        // of the file, plus two bytes for a null terminator (which will already
-        // be present due to allocating HEAP_ZERO_MEMORY). Only one byte is needed
-        // for the terminator if ANSI/UTF-8, but 2 is needed for UTF-16.
-        fileBytesSize = (size_t)fileSize.QuadPart + 2;
-        fileBytes = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, fileBytesSize);
-        if(fileBytes)
+        TRACE_BYTES(scope, fileSize.QuadPart);
+
+        scratch = ScratchBegin();
+        compression = GetFileCompression(hFile);
+        if(compression == COMPRESSION_GZIP)
+        {
+            // Rotated logs are often compressed. They're decompressed while they're read.
+            loaded = ReadDecompressedFileBytes(hFile, &decompressedBytes, &fileBytesRead);
+            fileBytes = decompressedBytes;
+        }
+        else if(compression == COMPRESSION_NONE)
         {
+            // Allocate a buffer that is large enough to hold the entire contents
+            // of the file. No terminator is needed, since the decoder is given
+            // the exact number of bytes to decode.
+            // It isn't zeroed, since only the bytes that were read are decoded.
+            fileBytesSize = (size_t)fileSize.QuadPart;
+            fileBytes = ScratchAlloc(fileBytesSize);
+
             // Read all the bytes of the file into fileBytes
-            if(ReadAllFileBytes(hFile, fileBytes, fileBytesSize))
+            loaded = fileBytes && ReadAllFileBytes(hFile, fileBytes, fileBytesSize, &fileBytesRead);
+        }
+
+        if(loaded)
+        {
+            // A large file that was opened before, and hasn't changed since,
+            // doesn't need to be scanned for what the open cache knows
+            if(fingerprinted && fileBytesRead >= CB_OPEN_CACHE_MIN)
+            {
+                cached = FindOpenedFileInfo(filePath, &fingerprint, &known);
+            }
+
+            decoded = SetEditText(fileBytes, fileBytesRead, cached ? &known : NULL, &info);
+            g_fileEncoding = info.encoding;
+            lineEndings.crlf = (size_t)info.crlf;
+            lineEndings.lf = (size_t)info.lf;
+            lineEndings.cr = (size_t)info.cr;
+
+            if(decoded)
             {
-                if(SetEditText(fileBytes, fileBytesSize))
+                // Saving would write plain text over the compressed file
+                g_compressedFile = (compression != COMPRESSION_NONE);
+
+                // When the edit text is first set from file, it is clean.
+                g_dirtyText = FALSE;
+
+                // Save with the same line endings the file mostly uses
+                g_lineEnding = GetDominantLineEnding(&lineEndings);
+                g_mixedLineEndings = HasMixedLineEndings(&lineEndings);
+                if(g_mixedLineEndings)
                 {
-                    // When the edit text is first set from file, it is clean.
-                    g_dirtyText = FALSE;
+                    DebugLog(L"Mixed line endings: %Iu CRLF, %Iu LF, %Iu CR",
+                        lineEndings.crlf, lineEndings.lf, lineEndings.cr);
+                }
 
-                    if(SetActiveFile(filePath))
-                    {
-                        DebugLog(L"Active file is %s", g_activeFile);
-                    }
+                // Remember it for next time, unless the cache already knew it
+                if(fingerprinted && fileBytesRead >= CB_OPEN_CACHE_MIN &&
+                    (!cached || memcmp(&info, &known, sizeof(info)) != 0))
+                {
+                    RememberOpenedFile(filePath, &fingerprint, &info);
                 }
-                else
+
+                if(SetActiveFile(filePath))
                 {
-                    DebugLog(L"No active file");
+                    g_activeFingerprint = fingerprint;
+                    DebugLog(L"Active file is %s", g_activeFile);
+
+                    // Bring back edits that weren't saved before the app stopped
+                    if(RecoverUnsavedEdits(g_activeFile, &fingerprint))
+                    {
+                        SetWindowText(g_hwndEdit, GetRecoveryText());
+                        g_dirtyText = TRUE;
+                        UpdateTitleDirtyIndicator();
+                    }
                 }
             }
+            else
+            {
+                DebugLog(L"No active file");
+            }
+        }
+        else if(compression != COMPRESSION_NONE)
+        {
+            ShowCompressedFileError(filePath, compression);
+        }
 
-            HeapFree(GetProcessHeap(), 0, fileBytes);
+        if(decompressedBytes)
+        {
+            HeapFree(GetProcessHeap(), 0, decompressedBytes);
         }
+
+        ScratchEnd(scratch);
     }
 
     CloseHandle(hFile);
+
+    // Show the new active file in the hex view, if it's open
+    RefreshHexView();
+    RequestStatusUpdate();
+
+    TRACE_END(scope);
     return;
 }
 
 //
-// MainWndOnFileOpen
-// Handles IDM_FILE_OPEN by prompting the user
-// for a file to open, then populating the edit
-// control with the contents of that file.
+// AppendEditTextFromActiveFile
+// Reads only the bytes that another program added to the end of
+// g_activeFile, and appends their text to the edit control.
+// current is the fingerprint of the file as it is now.
+// Returns FALSE if the new bytes can't be decoded on their own,
+// and the whole file should be loaded again instead.
 //
-void MainWndOnFileOpen(void)
+BOOL AppendEditTextFromActiveFile(const FILE_FINGERPRINT * current)
 {
-    OPENFILENAME ofn;
-    WCHAR filePath[MAX_PATH];
+    BOOL success = FALSE;
+    HANDLE hFile;
+    BYTE * bytes;
+    size_t bytesSize;
+    size_t bytesRead;
+    size_t bomSize;
+    size_t unitSize = (g_fileEncoding == ENCODING_UTF_16_LE || g_fileEncoding == ENCODING_UTF_16_BE) ? sizeof(WCHAR) : 1;
+    BOOL endsWithCR;
+    LARGE_INTEGER offset;
+    SCRATCH_MARK scratch;
+    TRACE_SCOPE scope = {0};
+
+    // The read starts one character before the old end of the file,
+    // so that character has to be a whole one after the BOM.
+    // A compressed file can't be decompressed from the middle.
+    GetEncodingBom(g_fileEncoding, &bomSize);
+    if(g_compressedFile || g_activeFingerprint.size < bomSize + unitSize ||
+        (g_activeFingerprint.size - bomSize) % unitSize != 0 ||
+        current->size - g_activeFingerprint.size > (SIZE_T)-1 - unitSize)
+    {
+        return FALSE;
+    }
 
-    ZeroMemory(&ofn, sizeof(ofn));
-    ZeroMemory(&filePath, sizeof(filePath));
+    hFile = CreateFile(g_activeFile, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
 
-    // Bring up the File Open Dialog
-    ofn.lStructSize = sizeof(ofn);
-    ofn.hwndOwner = g_hwndMain;
-    ofn.Flags = OFN_HIDEREADONLY;
-    ofn.lpstrDefExt = L"txt";
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
 
-    // pairs of null-terminated filter strings
-    ofn.lpstrFilter = L"Text files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
-    ofn.nFilterIndex = 0;
+    TRACE_BEGIN(scope, "append");
 
-    // Pointer to a buffer that contains an initial file name 
-    // If lpstrFile contains a path, that path is the initial directory
-    // If first byte is NULL, then no initial path
-    ofn.lpstrFile = filePath;
-    ofn.nMaxFile = MAX_PATH;
+    offset.QuadPart = (LONGLONG)(g_activeFingerprint.size - unitSize);
+    bytesSize = (size_t)(current->size - g_activeFingerprint.size) + unitSize;
+    scratch = ScratchBegin();
+    bytes = ScratchAlloc(bytesSize);
+    if(bytes)
+    {
+        // A CR at the old end would pair with an LF at the start of the new
+        // text, and new UTF-8 text can't start partway through a character.
+        if(SetFilePointerEx(hFile, offset, NULL, FILE_BEGIN) &&
+            ReadAllFileBytes(hFile, bytes, bytesSize, &bytesRead) &&
+            bytesRead == bytesSize)
+        {
+            if(unitSize == 1)
+            {
+                endsWithCR = (bytes[0] == '\r');
+            }
+            else if(g_fileEncoding == ENCODING_UTF_16_LE)
+            {
+                endsWithCR = (bytes[0] == '\r' && bytes[1] == 0);
+            }
+            else
+            {
+                endsWithCR = (bytes[0] == 0 && bytes[1] == '\r');
+            }
 
-    // file name and extension of the selected file
-    // Can be null since we don't need to get the name only
-    ofn.lpstrFileTitle = NULL;
-    ofn.nMaxFileTitle = 0;
+            success = !endsWithCR && (unitSize != 1 || (bytes[1] & 0xC0) != 0x80);
+        }
 
-    // If the user specifies a file name and clicks the OK button,
-    // the return value is nonzero (TRUE). 
-    if (GetOpenFileName(&ofn))
+        if(success)
+        {
+            TRACE_BYTES(scope, bytesSize - unitSize);
+            success = AppendEditText(bytes + unitSize, bytesSize - unitSize, g_fileEncoding);
+        }
+    }
+
+    ScratchEnd(scratch);
+
+    CloseHandle(hFile);
+
+    if(success)
     {
-        SetEditTextFromFile(ofn.lpstrFile);
+        // The edit text matches the file again
+        g_activeFingerprint = *current;
+        g_dirtyText = FALSE;
+        UpdateTitleDirtyIndicator();
+        RefreshHexView();
+        RequestStatusUpdate();
     }
 
-    return;
+    TRACE_END(scope);
+    return success;
 }
 
 //
-// WriteBytesToActiveFile
-// Write the specified bytes to g_activeFile
+// CheckActiveFileOnDisk
+// Called when the app is activated. If another program changed
+// g_activeFile, asks the user whether to load it again. When text
+// was only added to the end, just the new text is loaded.
 //
-BOOL WriteBytesToActiveFile(LPCVOID bytes, DWORD byteCount)
+void CheckActiveFileOnDisk(void)
 {
-    BOOL success = FALSE;
-    HANDLE hFile;
-    DWORD bytesWritten = 0;
+    FILE_FINGERPRINT current;
+    int change;
+    int result;
+    LPWSTR prompt;
+    LPWSTR fileName;
+    SCRATCH_MARK scratch;
+    WCHAR filePath[MAX_PATH];
 
-    hFile = CreateFile(g_activeFile, GENERIC_WRITE, FILE_SHARE_READ,
-        NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    // The prompt can activate the app again, so don't check twice
+    if(g_activeFile[0] == 0 || g_checkingActiveFile)
+    {
+        return;
+    }
 
-    if(hFile == INVALID_HANDLE_VALUE)
+    // Only the fingerprint is compared, so this is cheap for any file size
+    change = GetActiveFileChange(&current);
+    if(change == FILE_CHANGE_NONE || FingerprintsMatch(&current, &g_declinedFingerprint))
     {
-        // Early exit
-        DebugLog(L"Couldn't open file for writing: %s", g_activeFile);
-        return FALSE;
+        return;
     }
 
-    success = WriteFile(hFile, bytes, byteCount, &bytesWritten, NULL);
+    scratch = ScratchBegin();
+    prompt = ScratchAlloc(CB_PROMPT_MESSAGE);
+    if(!prompt)
+    {
+        ScratchEnd(scratch);
+        return;
+    }
 
-    CloseHandle(hFile);
+    fileName = PathFindFileNameW(g_activeFile);
+    if(g_dirtyText)
+    {
+        StringCchPrintf(prompt, CB_PROMPT_MESSAGE,
+            L"%s has been changed by another program.\n\nDo you want to reload it and lose your changes?", fileName);
+    }
+    else if(change == FILE_CHANGE_APPENDED)
+    {
+        StringCchPrintf(prompt, CB_PROMPT_MESSAGE,
+            L"Text was added to %s by another program.\n\nDo you want to load the new text?", fileName);
+    }
+    else
+    {
+        StringCchPrintf(prompt, CB_PROMPT_MESSAGE,
+            L"%s has been changed by another program.\n\nDo you want to reload it?", fileName);
+    }
 
-    return success;
+    g_checkingActiveFile = TRUE;
+    result = MessageBox(g_hwndMain, prompt, APP_TITLE_W, MB_YESNO|MB_ICONQUESTION|MB_APPLMODAL);
+    g_checkingActiveFile = FALSE;
+
+    ScratchEnd(scratch);
+
+    if(result != IDYES)
+    {
+        // Don't ask again about this version of the file
+        g_declinedFingerprint = current;
+        return;
+    }
+
+    if(change == FILE_CHANGE_APPENDED && !g_dirtyText && AppendEditTextFromActiveFile(&current))
+    {
+        return;
+    }
+
+    // Loading a file resets g_activeFile, so pass a copy of the path
+    if(SUCCEEDED(StringCchCopyW(filePath, MAX_PATH, g_activeFile)))
+    {
+        SetEditTextFromFile(filePath);
+    }
 }
 
 //
-// ConvertWideTextToUTF16
-// Convert wide text string to UTF-16 LE with BOM.
-//
-// widetext is the null-terminated wide text string to convert.
-// wideTextSize is the size if the wideText in bytes
-// writeBytesCount is an output param, the number of bytes that should be written to a file.
-//
-// The function returns a pointer to a UTF-16 encoded array of bytes that can written a file.
-// This returned array should be freed by the caller with HeapFree().
+// ConfirmOverwriteChangedFile
+// Before saving over g_activeFile, checks whether another program
+// changed it since it was loaded or saved. If so, asks the user
+// whether to overwrite it. Returns TRUE if the save should go ahead.
 //
-BYTE * ConvertWideTextToUTF16(LPWSTR wideText, size_t wideTextSize, size_t * writeBytesCount)
+BOOL ConfirmOverwriteChangedFile(void)
 {
-    // Allocate a buffer for the UTF-16 LE text.
-    size_t fileBytesSize = wideTextSize + UTF16_BOM_BYTES;
-    BYTE * fileBytes = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, fileBytesSize);
-    if(fileBytes)
+    FILE_FINGERPRINT current;
+    LPWSTR prompt;
+    int result;
+    SCRATCH_MARK scratch;
+
+    if(GetActiveFileChange(&current) == FILE_CHANGE_NONE)
     {
-        // Set our UTF-16 LE BOM
-        fileBytes[0] = 0xFF;
-        fileBytes[1] = 0xFE;
+        return TRUE;
+    }
 
-        // Copy in the wide text, as-is, after the BOM
-        if(SUCCEEDED(StringCchCopy((LPWSTR)(fileBytes+UTF16_BOM_BYTES), fileBytesSize-UTF16_BOM_BYTES, wideText)))
-        {
-            // Tell the caller to write 2 byte less to file since we don't need the (wide) null terminator.
-            *writeBytesCount = fileBytesSize - 2;
-        }
+    scratch = ScratchBegin();
+    prompt = ScratchAlloc(CB_PROMPT_MESSAGE);
+    if(!prompt)
+    {
+        ScratchEnd(scratch);
+        return TRUE;
     }
 
-    return fileBytes;
+    StringCchPrintf(prompt, CB_PROMPT_MESSAGE,
+        L"%s has been changed by another program.\n\nDo you want to overwrite it with your changes?",
+        PathFindFileNameW(g_activeFile));
+
+    result = MessageBox(g_hwndMain, prompt, APP_TITLE_W, MB_YESNO|MB_ICONWARNING|MB_DEFBUTTON2|MB_APPLMODAL);
+
+    ScratchEnd(scratch);
+
+    return (result == IDYES);
 }
 
 //
-// ConvertWideTextToUTF8
-// Convert wide text string to UTF-8
-//
-// widetext is the null-terminated wide text string to convert.
-// extraBytes is the number of bytes to reserve at the beginning of the buffer (for a BOM)
-// writeBytesCount is an output param, the number of bytes that should be written to a file.
-//
-// The function returns a pointer to a UTF-8 encoded array of bytes that can written a file.
-// TThis returned array should be freed by the caller with HeapFree().
+// MainWndOnFileOpen
+// Handles IDM_FILE_OPEN by prompting the user
+// for a file to open, then populating the edit
+// control with the contents of that file.
 //
-BYTE * ConvertWideTextToUTF8(LPWSTR wideText, int extraBytes, size_t * writeBytesCount)
+void MainWndOnFileOpen(void)
 {
-    // The pointer and count for the data we'll write to the file
-    BYTE * fileBytes = NULL;
-    size_t fileBytesSize = 0;
+    OPENFILENAME ofn;
+    WCHAR filePath[MAX_PATH];
 
-    // Allocate a buffer for the UTF-8 text.
-    // First, get the required size to hold UTF-8 text. Note that UTF-8 can actually
-    // be larger than wide characters, although this is uncommon.
-    int utf8ByteCount = WideCharToMultiByte(CP_UTF8, 0, wideText, -1, NULL, 0, NULL, NULL);
+    ZeroMemory(&ofn, sizeof(ofn));
+    ZeroMemory(&filePath, sizeof(filePath));
 
-    // Make sure we got a valid byte count.
-    if(utf8ByteCount == 0)
-    {
-        DebugLog(L"Unable to determine UTF-8 byte count.");
-        *writeBytesCount = 0;
-        return NULL;
-    }
+    // Bring up the File Open Dialog
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = g_hwndMain;
+    ofn.Flags = OFN_HIDEREADONLY;
+    ofn.lpstrDefExt = L"txt";
+
+    // pairs of null-terminated filter strings
+    ofn.lpstrFilter = L"Text files (*.txt)\0*.txt\0Compressed files (*.gz)\0*.gz\0All Files (*.*)\0*.*\0";
+    ofn.nFilterIndex = 0;
 
-    // Allocate a buffer to hold the file-ready UTF-8 data.
-    fileBytesSize = utf8ByteCount + extraBytes;
-    fileBytes = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, fileBytesSize);
-    if(fileBytes)
+    // Pointer to a buffer that contains an initial file name 
+    // If lpstrFile contains a path, that path is the initial directory
+    // If first byte is NULL, then no initial path
+    ofn.lpstrFile = filePath;
+    ofn.nMaxFile = MAX_PATH;
+
+    // file name and extension of the selected file
+    // Can be null since we don't need to get the name only
+    ofn.lpstrFileTitle = NULL;
+    ofn.nMaxFileTitle = 0;
+
+    // If the user specifies a file name and clicks the OK button,
+    // the return value is nonzero (TRUE). 
+    if (GetOpenFileName(&ofn))
     {
-        // Convert the string.
-        if(WideCharToMultiByte(CP_UTF8, 0, wideText, -1, (LPSTR)(fileBytes+extraBytes), (int)(fileBytesSize-extraBytes), NULL, NULL) != 0)
-        {
-            // Tell the caller to write 1 byte less to file since we don't need the null terminator.
-            *writeBytesCount = fileBytesSize - 1;
-        }
+        SetEditTextFromFile(ofn.lpstrFile);
     }
 
-    return fileBytes;
+    return;
 }
 
 //
@@ -385,9 +678,12 @@ void SaveEditTextToActiveFile()
     LPWSTR wideText = NULL;
     size_t wideTextSize = 0;
 
-    // The pointer and count that we will pass to WriteBytesToActiveFile
-    BYTE * writeBytesPtr = NULL;
-    size_t writeBytesCount = 0;
+    // The number of encoded bytes written to the file
+    size_t bytesWritten = 0;
+
+    TRACE_SCOPE scope = {0};
+    TRACE_BEGIN(scope, "save");
+    SCRATCH_MARK scratch = ScratchBegin();
 
     DebugLog(L"Saving text to %s with encoding %d", g_activeFile, g_fileEncoding);
 
@@ -397,56 +693,41 @@ void SaveEditTextToActiveFile()
 
     // Allocate a buffer that has one extra character for the null terminator
     wideTextSize = (textLength + 1) * sizeof(WCHAR);
-    wideText = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, wideTextSize);
+    wideText = ScratchAlloc(wideTextSize);
     if(wideText)
     {
-        if(GetWindowText(g_hwndEdit, wideText, (int)(wideTextSize / sizeof(WCHAR))) != 0)
+        textLength = GetWindowText(g_hwndEdit, wideText, (int)(wideTextSize / sizeof(WCHAR)));
+        if(textLength != 0)
         {
-            // We have our wide character text. Now encode it.
-            switch (g_fileEncoding)
-            {
-            case ENCODING_UTF_16_LE:
-                writeBytesPtr = ConvertWideTextToUTF16(wideText, wideTextSize, &writeBytesCount);
-                break;
-            case ENCODING_UTF_8_BOM:
-                // Save as UTF-8 with a BOM
-                writeBytesPtr = ConvertWideTextToUTF8(wideText, UTF8_BOM_BYTES, &writeBytesCount);
-                if(writeBytesPtr)
-                {
-                    // Set our UTF-8 BOM
-                    writeBytesPtr[0] = 0xEF;
-                    writeBytesPtr[1] = 0xBB;
-                    writeBytesPtr[2] = 0xBF;
-                }
-                break;
-            default:
-                // Save as UTF-8
-                writeBytesPtr = ConvertWideTextToUTF8(wideText, 0, &writeBytesCount);
-                break;
-            }
+            // The edit control uses CRLF. Put back the file's own line endings.
+            textLength = (int)ConvertLineEndingsFromCRLF(wideText, textLength, g_lineEnding);
 
-            // Write the bytes to the active file
-            if(writeBytesPtr && writeBytesCount > 0)
-            {
-                // TODO: Handle failure
-                if(WriteBytesToActiveFile(writeBytesPtr, (DWORD)writeBytesCount))
-                {
-                    // When the edit text is initially written to file, it is clean.
-                    g_dirtyText = FALSE;
-                }
-            }
+            // A mapped file can't be truncated, so release the hex view's mapping
+            HexViewCloseFile();
 
-            // Free our write bytes buffer
-            if(writeBytesPtr)
+            // Encode the text straight into the file
+            // TODO: Handle failure
+            if(SaveWideTextToFile(g_activeFile, wideText, textLength, g_fileEncoding, &bytesWritten))
             {
-                HeapFree(GetProcessHeap(), 0, writeBytesPtr);
+                // When the edit text is initially written to file, it is clean.
+                g_dirtyText = FALSE;
+
+                // The file on disk now matches the edit text.
+                UpdateActiveFileFingerprint();
+                ZeroMemory(&g_declinedFingerprint, sizeof(g_declinedFingerprint));
+                ResetRecoveryJournal(g_activeFile);
             }
-        }
 
-        // Free our wide text buffer
-        HeapFree(GetProcessHeap(), 0, wideText);
+            TRACE_BYTES(scope, bytesWritten);
+            RefreshHexView();
+            RequestStatusUpdate();
+        }
     }
 
+    // Free our wide text buffer
+    ScratchEnd(scratch);
+
+    TRACE_END(scope);
     return;
 }
 
@@ -471,6 +752,11 @@ void MainWndOnFileSaveAs(void)
             // Failed to copy the active file, so zero out the filePath buffer.
             ZeroMemory(&filePath, sizeof(filePath));
         }
+        else if(g_compressedFile)
+        {
+            // The text is saved uncompressed, so suggest the name without .gz
+            PathRemoveExtensionW(filePath);
+        }
     }
     else
     {
@@ -487,10 +773,12 @@ void MainWndOnFileSaveAs(void)
     // pairs of null-terminated filter strings
     // These should align with the ENCODING_ constants,
     // and the first entry in this filter is assigned index 1.
-    ofn.lpstrFilter = L"UTF-8 text file (*.txt)\0*.txt\0UTF-8 (with BOM) text file (*.txt)\0*.txt\0UTF-16 LE text file (*.txt)\0*.txt\0";
+    ofn.lpstrFilter = L"UTF-8 text file (*.txt)\0*.txt\0UTF-8 (with BOM) text file (*.txt)\0*.txt\0"
+        L"UTF-16 LE text file (*.txt)\0*.txt\0UTF-16 BE text file (*.txt)\0*.txt\0";
     
     // Set the default encoding to the one in use, if possible.
-    if(g_fileEncoding == ENCODING_UTF_8 || g_fileEncoding == ENCODING_UTF_8_BOM || g_fileEncoding == ENCODING_UTF_16_LE)
+    if(g_fileEncoding == ENCODING_UTF_8 || g_fileEncoding == ENCODING_UTF_8_BOM ||
+        g_fileEncoding == ENCODING_UTF_16_LE || g_fileEncoding == ENCODING_UTF_16_BE)
     {
         ofn.nFilterIndex = g_fileEncoding;
     }
@@ -523,6 +811,7 @@ void MainWndOnFileSaveAs(void)
     {
         if(SetActiveFile(filePath))
         {
+            g_compressedFile = FALSE;
             g_fileEncoding = ofn.nFilterIndex;
             SaveEditTextToActiveFile();
         }
@@ -539,8 +828,14 @@ void MainWndOnFileSaveAs(void)
 //
 void MainWndOnFileSave(void)
 {
-    if(g_activeFile[0] != 0)
+    if(g_activeFile[0] != 0 && !g_compressedFile)
     {
+        // Don't silently overwrite changes another program made
+        if(!ConfirmOverwriteChangedFile())
+        {
+            return;
+        }
+
         // There's already an active file name. Save there.
         SaveEditTextToActiveFile();
 
@@ -549,7 +844,8 @@ void MainWndOnFileSave(void)
     }
     else
     {
-        // There's no active file. Treat this as Save As.
+        // There's no active file, or it's compressed and saving would
+        // write plain text over it. Treat this as Save As.
         MainWndOnFileSaveAs();
     }
 
@@ -0,0 +1,273 @@
+/* -------------------------------------------------------------
+
+fileio.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for reading files: all of a file's bytes, decompressed if
+    they need to be, and the fingerprint that tells if a file has
+    changed. It's part of the portable core, so it only uses the
+    file functions that platform.h declares.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// ReadAllFileBytes
+// Read all the bytes of a file specified by hFile.
+// The bytes are read into buffer dst of size dstSize, and the number
+// of bytes read is returned in dstBytesRead. Reading stops when dst is
+// full, even if the file has grown since its size was checked.
+//
+BOOL ReadAllFileBytes(HANDLE hFile, BYTE * dst, size_t dstSize, size_t * dstBytesRead)
+{
+    DWORD bytesRead;
+    size_t byteOffset = 0;
+
+    *dstBytesRead = 0;
+
+    // Read the file directly into the dst buffer, in chunks
+    // small enough for ReadFile's DWORD byte count.
+    while(byteOffset < dstSize)
+    {
+        DWORD bytesToRead = (DWORD)min(dstSize - byteOffset, CB_READ_CHUNK);
+
+        if(!ReadFile(hFile, dst + byteOffset, bytesToRead, &bytesRead, NULL))
+        {
+            return FALSE;
+        }
+
+        if(bytesRead == 0)
+        {
+            // End of file. The file shrank since its size was checked.
+            break;
+        }
+
+        // Update our offset into the dst buffer
+        byteOffset += bytesRead;
+    }
+
+    *dstBytesRead = byteOffset;
+    return TRUE;
+}
+
+//
+// GetFingerprintBlock
+// Gets the offset and length of one of the blocks sampled for the
+// fingerprint of a file that is fileSize bytes long. Block 0 is at the
+// head of the file, block 1 in the middle, and block 2 at the tail.
+// For small files the blocks overlap, which is fine.
+//
+void GetFingerprintBlock(ULONGLONG fileSize, int block, ULONGLONG * offset, DWORD * length)
+{
+    *length = (DWORD)min(fileSize, CB_FINGERPRINT_BLOCK);
+
+    switch(block)
+    {
+    case 0:
+        *offset = 0;
+        break;
+    case 1:
+        *offset = (fileSize - *length) / 2;
+        break;
+    default:
+        *offset = fileSize - *length;
+        break;
+    }
+}
+
+//
+// HashFileBlock
+// Reads up to length bytes from hFile, starting at the specified
+// offset, and returns a hash of those bytes in hash.
+// length can't be more than CB_FINGERPRINT_BLOCK.
+//
+BOOL HashFileBlock(HANDLE hFile, ULONGLONG offset, DWORD length, DWORD * hash)
+{
+    BYTE block[CB_FINGERPRINT_BLOCK];
+    DWORD bytesRead = 0;
+    LARGE_INTEGER position;
+
+    position.QuadPart = (LONGLONG)offset;
+    if(!SetFilePointerEx(hFile, position, NULL, FILE_BEGIN))
+    {
+        return FALSE;
+    }
+
+    if(!ReadFile(hFile, block, min(length, CB_FINGERPRINT_BLOCK), &bytesRead, NULL))
+    {
+        return FALSE;
+    }
+
+    *hash = HashBytes(block, bytesRead);
+    return TRUE;
+}
+
+//
+// GetFileFingerprint
+// Computes the fingerprint of the file specified by hFile: its size,
+// last write time, and hashes of blocks sampled from the file.
+// Only those blocks are read, so the cost doesn't depend on the file size.
+// The file pointer is left at the beginning of the file.
+//
+BOOL GetFileFingerprint(HANDLE hFile, FILE_FINGERPRINT * fingerprint)
+{
+    BOOL success = FALSE;
+    LARGE_INTEGER fileSize;
+    LARGE_INTEGER start = {0};
+    ULONGLONG offset;
+    DWORD length;
+
+    ZeroMemory(fingerprint, sizeof(*fingerprint));
+
+    if(GetFileSizeEx(hFile, &fileSize) && GetFileTime(hFile, NULL, NULL, &fingerprint->lastWriteTime))
+    {
+        fingerprint->size = (ULONGLONG)fileSize.QuadPart;
+
+        success = TRUE;
+        for(int i = 0; success && i < FINGERPRINT_BLOCK_COUNT; i++)
+        {
+            GetFingerprintBlock(fingerprint->size, i, &offset, &length);
+            success = HashFileBlock(hFile, offset, length, &fingerprint->blockHashes[i]);
+        }
+    }
+
+    // Leave the file pointer where the caller expects it.
+    SetFilePointerEx(hFile, start, NULL, FILE_BEGIN);
+
+    return success;
+}
+
+//
+// FingerprintsMatch
+// Returns TRUE if two file fingerprints describe the same file contents.
+//
+BOOL FingerprintsMatch(const FILE_FINGERPRINT * a, const FILE_FINGERPRINT * b)
+{
+    return (a->size == b->size) &&
+        (CompareFileTime(&a->lastWriteTime, &b->lastWriteTime) == 0) &&
+        (memcmp(a->blockHashes, b->blockHashes, sizeof(a->blockHashes)) == 0);
+}
+
+//
+// IsFileAppendedTo
+// Returns TRUE if hFile looks like the file described by original with
+// more bytes added to the end. The blocks sampled for original are hashed
+// again at the same offsets, so this costs the same as a fingerprint.
+//
+BOOL IsFileAppendedTo(HANDLE hFile, const FILE_FINGERPRINT * original, const FILE_FINGERPRINT * current)
+{
+    ULONGLONG offset;
+    DWORD length;
+    DWORD hash;
+
+    if(original->size == 0 || current->size <= original->size)
+    {
+        return FALSE;
+    }
+
+    for(int i = 0; i < FINGERPRINT_BLOCK_COUNT; i++)
+    {
+        GetFingerprintBlock(original->size, i, &offset, &length);
+        if(!HashFileBlock(hFile, offset, length, &hash) || hash != original->blockHashes[i])
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+//
+// GetFileCompression
+// Returns the COMPRESSION_ format of a file, from its first bytes.
+// The file is left at its start.
+//
+int GetFileCompression(HANDLE hFile)
+{
+    BYTE magic[CB_COMPRESSION_MAGIC];
+    DWORD bytesRead = 0;
+    LARGE_INTEGER start = {0};
+
+    if(!ReadFile(hFile, magic, sizeof(magic), &bytesRead, NULL))
+    {
+        bytesRead = 0;
+    }
+    SetFilePointerEx(hFile, start, NULL, FILE_BEGIN);
+
+    return GetCompressionFormat(magic, bytesRead);
+}
+
+//
+// ReadDecompressedFileBytes
+// Reads all the bytes of a gzip compressed file, decompressed.
+// The size isn't known until they've all been read, so they're read
+// into a buffer from the process heap that grows as needed, and is
+// returned in dst. The caller frees it.
+// Returns FALSE if the file can't be read, or isn't valid.
+//
+BOOL ReadDecompressedFileBytes(HANDLE hFile, BYTE ** dst, size_t * dstBytesRead)
+{
+    HANDLE hRead;
+    HANDLE hThread;
+    BYTE * buffer;
+    BYTE * grown;
+    size_t bufferSize = CB_READ_CHUNK;
+    size_t byteOffset = 0;
+    DWORD bytesRead;
+    BOOL success = TRUE;
+
+    *dst = NULL;
+    *dstBytesRead = 0;
+
+    hRead = StartDecompression(hFile, NULL, 0, &hThread);
+    if(hRead == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    buffer = HeapAlloc(GetProcessHeap(), 0, bufferSize);
+    success = (buffer != NULL);
+
+    while(success)
+    {
+        if(byteOffset == bufferSize)
+        {
+            grown = NULL;
+            if(bufferSize <= (SIZE_T)-1 / 2)
+            {
+                grown = HeapReAlloc(GetProcessHeap(), 0, buffer, bufferSize * 2);
+            }
+            if(!grown)
+            {
+                success = FALSE;
+                break;
+            }
+            buffer = grown;
+            bufferSize *= 2;
+        }
+
+        // The end of the decompressed bytes is reported as a failed read
+        if(!ReadFile(hRead, buffer + byteOffset, (DWORD)min(bufferSize - byteOffset, CB_READ_CHUNK), &bytesRead, NULL) ||
+            bytesRead == 0)
+        {
+            break;
+        }
+        byteOffset += bytesRead;
+    }
+
+    // Bad compressed data is only found once it's all been read
+    success = FinishDecompression(hRead, hThread) && success;
+    if(!success)
+    {
+        if(buffer)
+        {
+            HeapFree(GetProcessHeap(), 0, buffer);
+        }
+        return FALSE;
+    }
+
+    *dst = buffer;
+    *dstBytesRead = byteOffset;
+    return TRUE;
+}
@@ -0,0 +1,420 @@
+/* -------------------------------------------------------------
+
+filesearch.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for searching every file in a folder whose name matches a
+    pattern, like *.txt;*.log, which Find in Files runs.
+
+    Each task streams one file at a time through its own fixed
+    buffers, so memory doesn't grow with the size or the number of
+    files. When a task is done with a file, it takes the next one
+    from the folders, which only one task goes through at a time.
+    Matches are reported as they're found.
+    Nothing in here touches windows or app globals.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// MatchFileName
+// Returns TRUE if a file name matches a pattern of patternLength
+// characters, where * matches any characters and ? matches any one.
+// Case doesn't matter, like it doesn't in file names on Windows.
+//
+BOOL MatchFileName(LPCWSTR name, LPCWSTR pattern, size_t patternLength)
+{
+    size_t n = 0;
+    size_t p = 0;
+    size_t starPattern = (size_t)-1;
+    size_t starName = 0;
+
+    // *.* matches names without a dot too, as it always has on Windows
+    if(patternLength == 3 && wcsncmp(pattern, L"*.*", 3) == 0)
+    {
+        return TRUE;
+    }
+
+    while(name[n] != 0)
+    {
+        if(p < patternLength && pattern[p] == L'*')
+        {
+            // Match nothing with the * for now, and more if the rest doesn't match
+            starPattern = ++p;
+            starName = n;
+        }
+        else if(p < patternLength && (pattern[p] == L'?' || _wcsnicmp(&pattern[p], &name[n], 1) == 0))
+        {
+            p++;
+            n++;
+        }
+        else if(starPattern != (size_t)-1)
+        {
+            p = starPattern;
+            n = ++starName;
+        }
+        else
+        {
+            return FALSE;
+        }
+    }
+
+    while(p < patternLength && pattern[p] == L'*')
+    {
+        p++;
+    }
+
+    return p == patternLength;
+}
+
+//
+// MatchFilePattern
+// Returns TRUE if a file name matches any of the patterns in a list
+// separated by semicolons, like *.txt; *.log
+//
+BOOL MatchFilePattern(LPCWSTR name, LPCWSTR patterns)
+{
+    LPCWSTR start = patterns;
+    LPCWSTR end;
+    size_t length;
+
+    while(*start != 0)
+    {
+        while(*start == L' ' || *start == L';')
+        {
+            start++;
+        }
+
+        end = start;
+        while(*end != 0 && *end != L';')
+        {
+            end++;
+        }
+
+        // The spaces before the next semicolon aren't part of the pattern
+        length = (size_t)(end - start);
+        while(length > 0 && start[length - 1] == L' ')
+        {
+            length--;
+        }
+
+        if(length > 0 && MatchFileName(name, start, length))
+        {
+            return TRUE;
+        }
+
+        start = end;
+    }
+
+    return FALSE;
+}
+
+//
+// AppendSearchPath
+// Makes the search's path that of an entry of the folder whose path
+// is the first pathLength characters of it. Returns FALSE if it would
+// be longer than MAX_PATH.
+//
+BOOL AppendSearchPath(FILE_SEARCH * search, size_t pathLength, LPCWSTR name)
+{
+    size_t nameLength = wcslen(name);
+
+    if(pathLength + 1 + nameLength >= MAX_PATH)
+    {
+        return FALSE;
+    }
+
+    search->path[pathLength] = PATH_SEPARATOR_W;
+    CopyMemory(search->path + pathLength + 1, name, (nameLength + 1) * sizeof(WCHAR));
+    return TRUE;
+}
+
+//
+// OpenSearchFolder
+// Starts going through the folder at the search's path, and reads
+// its first entry. Returns FALSE if it can't be read.
+//
+BOOL OpenSearchFolder(FILE_SEARCH * search)
+{
+    FILE_SEARCH_FOLDER * folder;
+    WCHAR pattern[MAX_PATH];
+    size_t pathLength = wcslen(search->path);
+    HANDLE hFind;
+
+    if(search->folderCount == MAX_FILE_SEARCH_DEPTH || pathLength + 2 >= MAX_PATH)
+    {
+        return FALSE;
+    }
+
+    CopyMemory(pattern, search->path, pathLength * sizeof(WCHAR));
+    pattern[pathLength] = PATH_SEPARATOR_W;
+    pattern[pathLength + 1] = L'*';
+    pattern[pathLength + 2] = 0;
+
+    hFind = FindFirstFileExW(pattern, FindExInfoBasic, &search->findData, FindExSearchNameMatch,
+        NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if(hFind == INVALID_HANDLE_VALUE)
+    {
+        DebugLog(L"OpenSearchFolder: unable to read %s (%u)\n", search->path, GetLastError());
+        return FALSE;
+    }
+
+    folder = &search->folders[search->folderCount++];
+    folder->hFind = hFind;
+    folder->pathLength = pathLength;
+    search->hasEntry = TRUE;
+
+    return TRUE;
+}
+
+//
+// CloseSearchFolder
+// Stops going through the last folder, and goes back to the one it's in
+//
+void CloseSearchFolder(FILE_SEARCH * search)
+{
+    FindClose(search->folders[--search->folderCount].hFind);
+    search->hasEntry = FALSE;
+}
+
+//
+// GetNextSearchFile
+// Gets the path of the next file whose name matches the search's
+// pattern, going into each folder as it's found when subfolders are
+// included. Links to other folders are skipped, so a loop of them can't
+// go on forever. Returns FALSE once there are no more, or the search is
+// cancelled. Any task can call this, one at a time.
+//
+BOOL GetNextSearchFile(FILE_SEARCH * search, WCHAR * path)
+{
+    FILE_SEARCH_FOLDER * folder;
+    WIN32_FIND_DATAW * findData = &search->findData;
+    BOOL found = FALSE;
+
+    AcquireSRWLockExclusive(&search->lock);
+
+    while(!found && search->folderCount > 0 && !search->cancel)
+    {
+        folder = &search->folders[search->folderCount - 1];
+
+        if(!search->hasEntry && !FindNextFileW(folder->hFind, findData))
+        {
+            CloseSearchFolder(search);
+            continue;
+        }
+        search->hasEntry = FALSE;
+
+        if(wcscmp(findData->cFileName, L".") == 0 || wcscmp(findData->cFileName, L"..") == 0 ||
+            !AppendSearchPath(search, folder->pathLength, findData->cFileName))
+        {
+            continue;
+        }
+
+        if(findData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            if(search->subfolders && !(findData->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+            {
+                OpenSearchFolder(search);
+            }
+        }
+        else if(MatchFilePattern(findData->cFileName, search->pattern))
+        {
+            CopyMemory(path, search->path, sizeof(search->path));
+            found = TRUE;
+        }
+    }
+
+    ReleaseSRWLockExclusive(&search->lock);
+
+    return found;
+}
+
+//
+// ReportFileSearchMatch
+// Reports a line that matched. Once maxResults have been found,
+// the search is cancelled instead.
+//
+void ReportFileSearchMatch(FILE_SEARCH_TASK * task, ULONGLONG line, DWORD column, LPCWSTR text, size_t length)
+{
+    FILE_SEARCH * search = task->search;
+    LONG resultCount = InterlockedIncrement(&search->resultCount);
+
+    if(search->maxResults > 0 && resultCount > search->maxResults)
+    {
+        InterlockedDecrement(&search->resultCount);
+        InterlockedExchange(&search->cancel, TRUE);
+        return;
+    }
+
+    if(search->onMatch)
+    {
+        search->onMatch(search->context, task->path, line, column, text, length);
+    }
+}
+
+//
+// SearchStreamFile
+// Searches the file at the task's path a line at a time
+//
+void SearchStreamFile(FILE_SEARCH_TASK * task)
+{
+    FILE_SEARCH * search = task->search;
+    TEXT_STREAM stream;
+    HANDLE hFile;
+    LPCWSTR line;
+    size_t lineLength;
+    ULONGLONG pieceLine = 0;
+    ULONGLONG matchLine = 0;
+    size_t pieceOffset = 0;
+    DWORD position;
+
+    hFile = CreateFile(task->path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        InitTextStream(&stream, hFile, task->bytes, task->text);
+
+        while(!search->cancel && ReadStreamLine(&stream, &line, &lineLength))
+        {
+            // A line too long to read at once comes in pieces. Columns count
+            // from the start of the line, and each line is reported only once.
+            // A match that's split between two pieces isn't found.
+            if(stream.lineNumber != pieceLine)
+            {
+                pieceLine = stream.lineNumber;
+                pieceOffset = 0;
+            }
+
+            if(matchLine != pieceLine && lineLength <= MAXDWORD)
+            {
+                position = FindTextInBuffer(line, (DWORD)lineLength, search->searchText, search->matchCase, TRUE, 0);
+                if(position != FIND_NOT_FOUND)
+                {
+                    matchLine = pieceLine;
+                    ReportFileSearchMatch(task, pieceLine, (DWORD)min(pieceOffset + position, MAXDWORD),
+                        line, lineLength);
+                }
+            }
+
+            pieceOffset += lineLength;
+        }
+
+        CloseTextStream(&stream);
+        CloseHandle(hFile);
+    }
+    else
+    {
+        DebugLog(L"SearchStreamFile: unable to open %s (%u)\n", task->path, GetLastError());
+    }
+
+    InterlockedIncrement(&search->fileCount);
+}
+
+//
+// FileSearchTaskCallback
+// Searches one file after another, until there are none left.
+// Each task runs this on a thread of its own.
+//
+void FileSearchTaskCallback(void * context)
+{
+    FILE_SEARCH_TASK * task = (FILE_SEARCH_TASK *)context;
+
+    while(GetNextSearchFile(task->search, task->path))
+    {
+        SearchStreamFile(task);
+    }
+}
+
+//
+// InitFileSearch
+// Gets a search ready to run once its options are filled in, and
+// allocates the buffers of its tasks. Each task has a few MB of them,
+// so there are no more than there are processors. Returns FALSE if
+// they can't be allocated.
+//
+BOOL InitFileSearch(FILE_SEARCH * search)
+{
+    FILE_SEARCH_TASK * task;
+    size_t folderLength = wcslen(search->folder);
+
+    // The folder's paths are built with a separator after it
+    if(folderLength > 0 && (search->folder[folderLength - 1] == PATH_SEPARATOR_W ||
+        search->folder[folderLength - 1] == L'/'))
+    {
+        search->folder[folderLength - 1] = 0;
+    }
+
+    if(search->pattern[0] == 0)
+    {
+        search->pattern[0] = L'*';
+        search->pattern[1] = 0;
+    }
+
+    InitializeSRWLock(&search->lock);
+    search->folderCount = 0;
+    search->taskCount = GetParallelTaskCount(FILE_SEARCH_TASKS, 1);
+
+    for(DWORD i = 0; i < search->taskCount; i++)
+    {
+        task = &search->tasks[i];
+        task->search = search;
+        task->bytes = HeapAlloc(GetProcessHeap(), 0, CB_STREAM_CHUNK);
+        task->text = HeapAlloc(GetProcessHeap(), 0, CCH_STREAM_TEXT * sizeof(WCHAR));
+        if(!task->bytes || !task->text)
+        {
+            CloseFileSearch(search);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+//
+// RunFileSearch
+// Searches every file in the folder, and returns once they've all
+// been searched, or the search is cancelled
+//
+void RunFileSearch(FILE_SEARCH * search)
+{
+    TRACE_SCOPE scope = {0};
+
+    TRACE_BEGIN(scope, "find in files");
+
+    CopyMemory(search->path, search->folder, sizeof(search->path));
+    if(OpenSearchFolder(search))
+    {
+        RunParallelTasks(FileSearchTaskCallback, search->tasks, sizeof(FILE_SEARCH_TASK), search->taskCount);
+    }
+
+    // A search that was cancelled stops partway through its folders
+    while(search->folderCount > 0)
+    {
+        CloseSearchFolder(search);
+    }
+
+    TRACE_END(scope);
+}
+
+//
+// CloseFileSearch
+// Frees the buffers of a search's tasks
+//
+void CloseFileSearch(FILE_SEARCH * search)
+{
+    for(DWORD i = 0; i < search->taskCount; i++)
+    {
+        if(search->tasks[i].bytes)
+        {
+            HeapFree(GetProcessHeap(), 0, search->tasks[i].bytes);
+            search->tasks[i].bytes = NULL;
+        }
+        if(search->tasks[i].text)
+        {
+            HeapFree(GetProcessHeap(), 0, search->tasks[i].text);
+            search->tasks[i].text = NULL;
+        }
+    }
+}
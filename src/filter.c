@@ -0,0 +1,435 @@
+/* -------------------------------------------------------------
+
+filter.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the filter view, which shows only the lines of the
+    edit control's text that match a filter, in its place.
+
+    The filter is a list of matching line offsets. The view is a
+    list box with no data of its own, which draws each line from
+    the edit control's text, so the text is never copied.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <windows.h>
+#include <strsafe.h>
+#include "esnpad.h"
+
+// The most characters of a line that are drawn in the filter view
+#define CCH_FILTER_LINE_MAX   1024
+
+// The max length of a line number in the filter view, with the space after it
+#define CCH_FILTER_LINE_NUMBER 16
+
+//
+// globals
+//
+HWND g_hwndFilter = NULL;           // handle to the filter view list box
+FILTER_MATCH * g_filterMatches = NULL;
+DWORD g_filterMatchCount = 0;
+
+extern HINSTANCE g_hinst;
+extern HWND g_hwndMain;
+extern HWND g_hwndEdit;
+
+//
+// FilterChunkCallback
+// Filters one chunk of the text, on one of the tasks of BuildFilterMatches
+//
+void FilterChunkCallback(void * context)
+{
+    FILTER_CHUNK * chunk = context;
+
+    chunk->succeeded = FilterTextChunk(chunk);
+}
+
+//
+// FreeFilterMatches
+//
+void FreeFilterMatches(void)
+{
+    if(g_filterMatches)
+    {
+        HeapFree(GetProcessHeap(), 0, g_filterMatches);
+        g_filterMatches = NULL;
+    }
+
+    g_filterMatchCount = 0;
+}
+
+//
+// BuildFilter
+// Finds the lines of text that match filter, and keeps them in g_filterMatches.
+// The text is split into chunks at line starts, one for each processor,
+// and the chunks are filtered in parallel on the thread pool. The matches
+// from each chunk are then joined in order, with their line numbers
+// offset by the lines in the chunks before them.
+// Returns FALSE if the filter couldn't be built.
+//
+BOOL BuildFilter(LPCWSTR text, DWORD textLength, const FILTER * filter)
+{
+    BOOL success = TRUE;
+    FILTER_CHUNK * chunks;
+    DWORD chunkCount;
+    DWORD chunk;
+    DWORD matchCount = 0;
+    DWORD lineCount = 0;
+    DWORD match;
+    TRACE_SCOPE scope = {0};
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    TRACE_BEGIN(scope, "filter");
+    TRACE_BYTES(scope, (ULONGLONG)textLength * sizeof(WCHAR));
+
+    FreeFilterMatches();
+
+    chunkCount = GetParallelTaskCount(textLength, CCH_MIN_FILTER_CHUNK);
+
+    chunks = ScratchAlloc(chunkCount * sizeof(FILTER_CHUNK));
+    if(!chunks)
+    {
+        ScratchEnd(scratch);
+        return FALSE;
+    }
+
+    for(chunk = 0; chunk < chunkCount; chunk++)
+    {
+        ZeroMemory(&chunks[chunk], sizeof(FILTER_CHUNK));
+        chunks[chunk].text = text;
+        chunks[chunk].filter = filter;
+        chunks[chunk].start = (chunk == 0) ? 0 : chunks[chunk - 1].end;
+        chunks[chunk].end = (chunk == chunkCount - 1) ? textLength :
+            FindNextLineStart(text, textLength, (DWORD)((ULONGLONG)textLength * (chunk + 1) / chunkCount));
+        chunks[chunk].end = max(chunks[chunk].end, chunks[chunk].start);
+    }
+
+    RunParallelTasks(FilterChunkCallback, chunks, sizeof(FILTER_CHUNK), chunkCount);
+
+    for(chunk = 0; chunk < chunkCount; chunk++)
+    {
+        success = success && chunks[chunk].succeeded;
+        matchCount += chunks[chunk].matchCount;
+    }
+
+    if(success && matchCount > 0)
+    {
+        g_filterMatches = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)matchCount * sizeof(FILTER_MATCH));
+        success = (g_filterMatches != NULL);
+    }
+
+    for(chunk = 0; chunk < chunkCount; chunk++)
+    {
+        if(success)
+        {
+            for(match = 0; match < chunks[chunk].matchCount; match++)
+            {
+                g_filterMatches[g_filterMatchCount].line = chunks[chunk].matches[match].line + lineCount;
+                g_filterMatches[g_filterMatchCount].offset = chunks[chunk].matches[match].offset;
+                g_filterMatchCount++;
+            }
+            lineCount += chunks[chunk].lineCount;
+        }
+
+        if(chunks[chunk].matches)
+        {
+            HeapFree(GetProcessHeap(), 0, chunks[chunk].matches);
+        }
+    }
+
+    if(!success)
+    {
+        DebugLog(L"Unable to build the filter");
+        FreeFilterMatches();
+    }
+
+    ScratchEnd(scratch);
+    TRACE_END(scope);
+
+    return success;
+}
+
+//
+// CreateFilterView
+// Creates the filter view list box, with the same size and position as the edit control.
+// It has no strings of its own: each item is drawn from a match in g_filterMatches.
+//
+BOOL CreateFilterView(HWND hwndParent)
+{
+    RECT rectEdit = {0};
+
+    // The edit control's position is relative to the parent's client area
+    if(g_hwndEdit)
+    {
+        GetWindowRect(g_hwndEdit, &rectEdit);
+        MapWindowPoints(NULL, hwndParent, (POINT *)&rectEdit, 2);
+    }
+
+    g_hwndFilter = CreateWindowEx(0, L"ListBox", NULL,
+        WS_CHILD|WS_BORDER|WS_VSCROLL|LBS_NODATA|LBS_OWNERDRAWFIXED|LBS_NOINTEGRALHEIGHT|LBS_NOTIFY|LBS_WANTKEYBOARDINPUT,
+        rectEdit.left, rectEdit.top, rectEdit.right - rectEdit.left, rectEdit.bottom - rectEdit.top,
+        hwndParent, (HMENU)IDC_FILTER, g_hinst, NULL);
+
+    if(g_hwndFilter)
+    {
+        SetFilterViewFont(GetEditFont(GetDpiForWindow(hwndParent)));
+    }
+
+    return (g_hwndFilter != NULL);
+}
+
+//
+// IsFilterViewVisible
+// Returns TRUE if the filter view is being shown instead of the edit control
+//
+BOOL IsFilterViewVisible(void)
+{
+    return g_hwndFilter && IsWindowVisible(g_hwndFilter);
+}
+
+//
+// ShowFilterView
+// Filters the text in the edit control and shows the matching lines
+// in place of the edit control. The filter view isn't shown if no
+// lines match. Returns TRUE if it's shown.
+//
+BOOL ShowFilterView(HWND hwndParent, const FILTER * filter)
+{
+    HLOCAL hText;
+    LPCWSTR text;
+    DWORD textLength;
+    BOOL built = FALSE;
+
+    if(IsHexViewVisible() || (!g_hwndFilter && !CreateFilterView(hwndParent)))
+    {
+        return FALSE;
+    }
+
+    // The text is filtered where the edit control keeps it, rather than copied
+    hText = (HLOCAL)SendMessage(g_hwndEdit, EM_GETHANDLE, 0, 0);
+    text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+    if(text)
+    {
+        textLength = (DWORD)GetWindowTextLength(g_hwndEdit);
+        built = BuildFilter(text, textLength, filter);
+        LocalUnlock(hText);
+    }
+
+    if(!built)
+    {
+        MessageBox(hwndParent, L"Unable to filter the text.", APP_TITLE_W, MB_OK | MB_ICONERROR);
+        return FALSE;
+    }
+
+    if(g_filterMatchCount == 0)
+    {
+        MessageBox(hwndParent, L"No lines match the filter.", APP_TITLE_W, MB_OK | MB_ICONINFORMATION);
+        return FALSE;
+    }
+
+    SendMessage(g_hwndFilter, LB_SETCOUNT, g_filterMatchCount, 0);
+    SendMessage(g_hwndFilter, LB_SETCURSEL, 0, 0);
+
+    ShowWindow(g_hwndFilter, SW_SHOW);
+    ShowWindow(g_hwndEdit, SW_HIDE);
+    SetFocus(g_hwndFilter);
+
+    CheckMenuItem(GetMenu(hwndParent), IDM_VIEW_FILTER_LEVELS,
+        filter->type == FILTER_LEVELS ? MF_CHECKED : MF_UNCHECKED);
+
+    return TRUE;
+}
+
+//
+// HideFilterView
+// Shows the edit control again in place of the filter view.
+// Nothing has to be undone, so this is immediate.
+//
+void HideFilterView(void)
+{
+    if(!IsFilterViewVisible())
+    {
+        return;
+    }
+
+    ShowWindow(g_hwndEdit, SW_SHOW);
+    ShowWindow(g_hwndFilter, SW_HIDE);
+    SetFocus(g_hwndEdit);
+
+    SendMessage(g_hwndFilter, LB_SETCOUNT, 0, 0);
+    FreeFilterMatches();
+
+    CheckMenuItem(GetMenu(g_hwndMain), IDM_VIEW_FILTER_LEVELS, MF_UNCHECKED);
+}
+
+//
+// GoToFilteredLine
+// Hides the filter view, and moves the caret in the
+// edit control to the line selected in the filter view.
+//
+void GoToFilteredLine(void)
+{
+    LRESULT item = SendMessage(g_hwndFilter, LB_GETCURSEL, 0, 0);
+    DWORD offset;
+
+    if(item < 0 || (DWORD)item >= g_filterMatchCount)
+    {
+        return;
+    }
+
+    offset = g_filterMatches[item].offset;
+    HideFilterView();
+
+    SendMessage(g_hwndEdit, EM_SETSEL, offset, offset);
+    SendMessage(g_hwndEdit, EM_SCROLLCARET, 0, 0);
+}
+
+//
+// MoveFilterView
+// Sizes the filter view to match the edit control
+//
+void MoveFilterView(int width, int height)
+{
+    if(g_hwndFilter)
+    {
+        MoveWindow(g_hwndFilter, 0, 0, width, height, TRUE);
+    }
+
+    return;
+}
+
+//
+// SetFilterViewFont
+// Sets the filter view's font, and makes each item one line of it tall
+//
+void SetFilterViewFont(HFONT hFont)
+{
+    HDC hdc;
+    HGDIOBJ oldFont;
+    TEXTMETRIC textMetric = {0};
+
+    if(!g_hwndFilter)
+    {
+        return;
+    }
+
+    SendMessage(g_hwndFilter, WM_SETFONT, (WPARAM)hFont, TRUE);
+
+    hdc = GetDC(g_hwndFilter);
+    if(hdc)
+    {
+        oldFont = SelectObject(hdc, hFont);
+        GetTextMetrics(hdc, &textMetric);
+        SelectObject(hdc, oldFont);
+        ReleaseDC(g_hwndFilter, hdc);
+    }
+
+    SendMessage(g_hwndFilter, LB_SETITEMHEIGHT, 0, max(textMetric.tmHeight, 1));
+}
+
+//
+// MainWndOnDrawItem
+// Handles WM_DRAWITEM for the filter view by drawing the line number
+// and text of one matching line, read from the edit control's text.
+//
+LRESULT MainWndOnDrawItem(DRAWITEMSTRUCT * drawItem)
+{
+    const THEME * theme = GetCurrentTheme();
+    BOOL selected = (drawItem->itemState & ODS_SELECTED);
+    WCHAR lineNumber[CCH_FILTER_LINE_NUMBER];
+    HLOCAL hText;
+    LPCWSTR text;
+    DWORD textLength;
+    DWORD offset;
+    DWORD lineLength = 0;
+    RECT rect = drawItem->rcItem;
+    SIZE size;
+
+    if(drawItem->CtlID != IDC_FILTER)
+    {
+        return FALSE;
+    }
+
+    SetBkColor(drawItem->hDC, selected ? GetSysColor(COLOR_HIGHLIGHT) : theme->backgroundColor);
+    SetTextColor(drawItem->hDC, selected ? GetSysColor(COLOR_HIGHLIGHTTEXT) : theme->textColor);
+    ExtTextOut(drawItem->hDC, 0, 0, ETO_OPAQUE, &rect, NULL, 0, NULL);
+
+    if(drawItem->itemID == (UINT)-1 || drawItem->itemID >= g_filterMatchCount)
+    {
+        return TRUE;
+    }
+
+    if(SUCCEEDED(StringCchPrintf(lineNumber, CCH_FILTER_LINE_NUMBER, L"%8lu  ", g_filterMatches[drawItem->itemID].line + 1)))
+    {
+        DrawText(drawItem->hDC, lineNumber, -1, &rect, DT_SINGLELINE | DT_NOPREFIX);
+        if(GetTextExtentPoint32(drawItem->hDC, lineNumber, (int)wcslen(lineNumber), &size))
+        {
+            rect.left += size.cx;
+        }
+    }
+
+    hText = (HLOCAL)SendMessage(g_hwndEdit, EM_GETHANDLE, 0, 0);
+    text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+    if(text)
+    {
+        textLength = (DWORD)GetWindowTextLength(g_hwndEdit);
+        offset = g_filterMatches[drawItem->itemID].offset;
+
+        while(offset + lineLength < textLength && lineLength < CCH_FILTER_LINE_MAX && text[offset + lineLength] != L'\r')
+        {
+            lineLength++;
+        }
+
+        if(offset < textLength)
+        {
+            DrawText(drawItem->hDC, text + offset, (int)lineLength, &rect,
+                DT_SINGLELINE | DT_NOPREFIX | DT_EXPANDTABS);
+        }
+
+        LocalUnlock(hText);
+    }
+
+    return TRUE;
+}
+
+//
+// MainWndOnVKeyToItem
+// Handles WM_VKEYTOITEM for the filter view. Enter goes to the
+// selected line, and Escape goes back to the edit control.
+//
+LRESULT MainWndOnVKeyToItem(HWND hwndList, int key)
+{
+    if(hwndList != g_hwndFilter)
+    {
+        return -1;
+    }
+
+    if(key == VK_RETURN)
+    {
+        GoToFilteredLine();
+        return -2;
+    }
+
+    if(key == VK_ESCAPE)
+    {
+        HideFilterView();
+        return -2;
+    }
+
+    // Let the list box handle the key
+    return -1;
+}
+
+//
+// FilterViewOnCommand
+// Handles WM_COMMAND for the filter view
+//
+void FilterViewOnCommand(int code)
+{
+    if(code == LBN_DBLCLK)
+    {
+        GoToFilteredLine();
+    }
+
+    return;
+}
@@ -32,15 +32,21 @@ void FindTextInEditControl(LPWSTR searchText, BOOL matchCase, BOOL searchDown)
         return;
     }
 
+    TRACE_SCOPE scope = {0};
+    TRACE_BEGIN(scope, "search");
+    SCRATCH_MARK scratch = ScratchBegin();
+
     // Get the length of the text in the edit control
     int textLength = GetWindowTextLength(g_hwndEdit);
+    TRACE_BYTES(scope, textLength * sizeof(WCHAR));
 
     // Allocate a buffer to hold the text
-    LPWSTR textBuffer = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (textLength + 1) * sizeof(WCHAR));
+    LPWSTR textBuffer = ScratchAlloc((textLength + 1) * sizeof(WCHAR));
     if(textBuffer)
     {
-        // Copy the text to the buffer
-        GetWindowText(g_hwndEdit, textBuffer, textLength + 1);
+        // Copy the text to the buffer. The search is bounded by the
+        // length GetWindowText returns, so the buffer isn't zeroed first.
+        textLength = GetWindowText(g_hwndEdit, textBuffer, textLength + 1);
     }
 
     // Find the current selection
@@ -54,36 +60,14 @@ void FindTextInEditControl(LPWSTR searchText, BOOL matchCase, BOOL searchDown)
     DebugLog(L"Search starting at position: %d\n", searchStart);
 
     // Find the text
-    DWORD foundPos = (DWORD)-1;
-    if (searchDown)
+    DWORD foundPos = FIND_NOT_FOUND;
+    if (textBuffer)
     {
-        // Search downwards
-        for (DWORD i = searchStart; i <= textLength - wcslen(searchText); i++)
-        {
-            if ((matchCase && wcsncmp(&textBuffer[i], searchText, wcslen(searchText)) == 0) ||
-                (!matchCase && _wcsnicmp(&textBuffer[i], searchText, wcslen(searchText)) == 0))
-            {
-                foundPos = i;
-                break;
-            }
-        }
-    }
-    else
-    {
-        // Search upwards
-        for (DWORD i = searchStart; i != (DWORD)-1; i--)
-        {
-            if ((matchCase && wcsncmp(&textBuffer[i], searchText, wcslen(searchText)) == 0) ||
-                (!matchCase && _wcsnicmp(&textBuffer[i], searchText, wcslen(searchText)) == 0))
-            {
-                foundPos = i;
-                break;
-            }
-        }
+        foundPos = FindTextInBuffer(textBuffer, (DWORD)textLength, searchText, matchCase, searchDown, searchStart);
     }
 
     // If found, select the text in the edit control
-    if (foundPos != (DWORD)-1)
+    if (foundPos != FIND_NOT_FOUND)
     {
         DebugLog(L"Text found at position: %d\n", foundPos);
         // Select the found text in the edit control
@@ -98,10 +82,9 @@ void FindTextInEditControl(LPWSTR searchText, BOOL matchCase, BOOL searchDown)
     }
 
     // Free the text buffer
-    if(textBuffer)
-    {
-        HeapFree(GetProcessHeap(), 0, textBuffer);
-    }
+    ScratchEnd(scratch);
+
+    TRACE_END(scope);
 }
 
 //
@@ -137,6 +120,22 @@ INT_PTR CALLBACK FindDlgProc(HWND hdlg, UINT msg, WPARAM wparam, LPARAM lparam)
                 }
             }
             return TRUE;
+        case IDC_FIND_FILTER:
+            {
+                // Show only the lines with the search text, using the same options
+                WCHAR searchText[CCH_FIND_TEXT] = {0};
+                FILTER filter = {0};
+                GetDlgItemText(hdlg, IDC_FIND_TEXT, searchText, CCH_FIND_TEXT);
+
+                if(wcslen(searchText) > 0)
+                {
+                    filter.type = FILTER_TEXT;
+                    filter.searchText = searchText;
+                    filter.matchCase = (IsDlgButtonChecked(hdlg, IDC_MATCH_CASE) == BST_CHECKED);
+                    ShowFilterView(g_hwndMain, &filter);
+                }
+            }
+            return TRUE;
         case IDCANCEL:
             DestroyWindow(hdlg);
             g_hwndFind = NULL;
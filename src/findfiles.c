@@ -0,0 +1,500 @@
+/* -------------------------------------------------------------
+
+findfiles.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the Find in Files dialog, which searches every file
+    in a folder whose name matches a pattern, like *.txt;*.log
+
+    The search runs in filesearch.c on a thread of its own, so the
+    dialog keeps responding. Matches are posted to the dialog as
+    they're found, so results show up while the search goes on.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <windows.h>
+#include <shlwapi.h>
+#include <strsafe.h>
+#include "esnpad.h"
+
+// A line that matched, posted to the dialog with WM_APP_FIND_FILES_RESULT
+typedef struct _FIND_FILES_RESULT
+{
+    WCHAR path[MAX_PATH];
+    ULONGLONG line;         // counting from 1
+    DWORD column;           // where the match starts, counting from 0
+    DWORD matchLength;
+    WCHAR preview[CCH_FIND_FILES_PREVIEW];
+} FIND_FILES_RESULT;
+
+// A search, shared by the dialog and the search thread.
+// The dialog frees it once the search thread has finished.
+typedef struct _FIND_FILES_SEARCH
+{
+    HWND hwndNotify;
+    HANDLE hThread;
+    FILE_SEARCH files;
+} FIND_FILES_SEARCH;
+
+//
+// globals
+//
+HWND g_hwndFindFiles = NULL;                // handle to the Find in Files dialog
+FIND_FILES_SEARCH * g_findFilesSearch = NULL; // the search that's running, if any
+
+extern HWND g_hwndMain;
+extern HWND g_hwndEdit;
+extern HINSTANCE g_hinst;
+extern WCHAR g_activeFile[MAX_PATH];
+
+//
+// PostFindFilesResult
+// Posts a line that matched to the dialog. This runs on the thread
+// that searched the file.
+//
+void PostFindFilesResult(void * context, LPCWSTR path, ULONGLONG line, DWORD column, LPCWSTR text, size_t length)
+{
+    FIND_FILES_SEARCH * search = (FIND_FILES_SEARCH *)context;
+    FIND_FILES_RESULT * result;
+    size_t previewLength = min(length, CCH_FIND_FILES_PREVIEW - 1);
+
+    result = HeapAlloc(GetProcessHeap(), 0, sizeof(FIND_FILES_RESULT));
+    if(!result)
+    {
+        return;
+    }
+
+    StringCchCopyW(result->path, MAX_PATH, path);
+    result->line = line;
+    result->column = column;
+    result->matchLength = (DWORD)wcslen(search->files.searchText);
+
+    // The results list shows one line each, so tabs and other control characters become spaces
+    for(size_t i = 0; i < previewLength; i++)
+    {
+        result->preview[i] = (text[i] < L' ') ? L' ' : text[i];
+    }
+    result->preview[previewLength] = 0;
+
+    if(!PostMessage(search->hwndNotify, WM_APP_FIND_FILES_RESULT, 0, (LPARAM)result))
+    {
+        HeapFree(GetProcessHeap(), 0, result);
+    }
+}
+
+//
+// FindFilesThreadProc
+// Runs a search, then tells the dialog it's done
+//
+DWORD WINAPI FindFilesThreadProc(LPVOID param)
+{
+    FIND_FILES_SEARCH * search = (FIND_FILES_SEARCH *)param;
+
+    RunFileSearch(&search->files);
+
+    PostMessage(search->hwndNotify, WM_APP_FIND_FILES_DONE, 0, 0);
+
+    return 0;
+}
+
+//
+// FreeFindFilesSearch
+// Frees a search. Its thread must have finished.
+//
+void FreeFindFilesSearch(FIND_FILES_SEARCH * search)
+{
+    CloseFileSearch(&search->files);
+
+    if(search->hThread)
+    {
+        CloseHandle(search->hThread);
+    }
+
+    HeapFree(GetProcessHeap(), 0, search);
+}
+
+//
+// StartFindFilesSearch
+// Starts searching with the options in the dialog.
+// Returns the search, or NULL if it couldn't be started.
+//
+FIND_FILES_SEARCH * StartFindFilesSearch(HWND hdlg)
+{
+    FIND_FILES_SEARCH * search;
+    FILE_SEARCH * files;
+
+    search = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(FIND_FILES_SEARCH));
+    if(!search)
+    {
+        return NULL;
+    }
+
+    search->hwndNotify = hdlg;
+    files = &search->files;
+    GetDlgItemText(hdlg, IDC_FIND_FILES_TEXT, files->searchText, CCH_FILE_SEARCH_TEXT);
+    GetDlgItemText(hdlg, IDC_FIND_FILES_FOLDER, files->folder, MAX_PATH);
+    GetDlgItemText(hdlg, IDC_FIND_FILES_PATTERN, files->pattern, CCH_FILE_SEARCH_TEXT);
+    files->matchCase = (IsDlgButtonChecked(hdlg, IDC_FIND_FILES_MATCH_CASE) == BST_CHECKED);
+    files->subfolders = (IsDlgButtonChecked(hdlg, IDC_FIND_FILES_SUBFOLDERS) == BST_CHECKED);
+    files->maxResults = MAX_FIND_FILES_RESULTS;
+    files->onMatch = PostFindFilesResult;
+    files->context = search;
+
+    if(!InitFileSearch(files))
+    {
+        FreeFindFilesSearch(search);
+        return NULL;
+    }
+
+    search->hThread = CreateThread(NULL, 0, FindFilesThreadProc, search, 0, NULL);
+    if(!search->hThread)
+    {
+        FreeFindFilesSearch(search);
+        return NULL;
+    }
+
+    return search;
+}
+
+//
+// UpdateFindFilesStatus
+// Shows how many files have been searched, and how many lines matched
+//
+void UpdateFindFilesStatus(HWND hdlg)
+{
+    WCHAR status[CB_BUFFER];
+    LONG fileCount = g_findFilesSearch ? g_findFilesSearch->files.fileCount : 0;
+    LONG resultCount = (LONG)SendDlgItemMessage(hdlg, IDC_FIND_FILES_RESULTS, LB_GETCOUNT, 0, 0);
+
+    if(g_findFilesSearch)
+    {
+        StringCchPrintfW(status, CB_BUFFER, L"Searching... %ld files, %ld matching lines", fileCount, resultCount);
+    }
+    else if(resultCount >= MAX_FIND_FILES_RESULTS)
+    {
+        StringCchPrintfW(status, CB_BUFFER, L"Stopped after %ld matching lines", resultCount);
+    }
+    else
+    {
+        StringCchPrintfW(status, CB_BUFFER, L"%ld matching lines", resultCount);
+    }
+
+    SetDlgItemText(hdlg, IDC_FIND_FILES_STATUS, status);
+
+    // The main window's status bar shows the progress too
+    RequestStatusUpdate();
+}
+
+//
+// GetFindFilesProgress
+// Gets how many files have been searched, and how many lines matched.
+// Returns FALSE if there's no search running.
+//
+BOOL GetFindFilesProgress(LONG * fileCount, LONG * resultCount)
+{
+    if(!g_findFilesSearch)
+    {
+        return FALSE;
+    }
+
+    *fileCount = g_findFilesSearch->files.fileCount;
+    *resultCount = g_findFilesSearch->files.resultCount;
+    return TRUE;
+}
+
+//
+// FinishFindFilesSearch
+// Waits for the search thread, and frees the search. When wait is FALSE,
+// the search has already told the dialog it's done.
+//
+void FinishFindFilesSearch(HWND hdlg, BOOL wait)
+{
+    FIND_FILES_SEARCH * search = g_findFilesSearch;
+    MSG msg;
+
+    if(!search)
+    {
+        return;
+    }
+
+    if(wait)
+    {
+        InterlockedExchange(&search->files.cancel, TRUE);
+    }
+    WaitForSingleObject(search->hThread, INFINITE);
+
+    // Results that were posted but not handled yet would leak
+    if(wait)
+    {
+        while(PeekMessage(&msg, hdlg, WM_APP_FIND_FILES_RESULT, WM_APP_FIND_FILES_DONE, PM_REMOVE))
+        {
+            if(msg.message == WM_APP_FIND_FILES_RESULT)
+            {
+                HeapFree(GetProcessHeap(), 0, (FIND_FILES_RESULT *)msg.lParam);
+            }
+        }
+    }
+
+    KillTimer(hdlg, IDT_FIND_FILES_STATUS);
+    g_findFilesSearch = NULL;
+    FreeFindFilesSearch(search);
+
+    EnableWindow(GetDlgItem(hdlg, IDC_FIND_FILES_FIND), TRUE);
+    EnableWindow(GetDlgItem(hdlg, IDC_FIND_FILES_STOP), FALSE);
+    UpdateFindFilesStatus(hdlg);
+}
+
+//
+// ClearFindFilesResults
+// Empties the results list, and frees the results in it
+//
+void ClearFindFilesResults(HWND hdlg)
+{
+    HWND hwndList = GetDlgItem(hdlg, IDC_FIND_FILES_RESULTS);
+    int count = (int)SendMessage(hwndList, LB_GETCOUNT, 0, 0);
+
+    for(int i = 0; i < count; i++)
+    {
+        HeapFree(GetProcessHeap(), 0, (FIND_FILES_RESULT *)SendMessage(hwndList, LB_GETITEMDATA, i, 0));
+    }
+
+    SendMessage(hwndList, LB_RESETCONTENT, 0, 0);
+}
+
+//
+// AddFindFilesResult
+// Adds a result to the list, which then owns it. Paths are shown
+// from the folder that was searched.
+//
+void AddFindFilesResult(HWND hdlg, FIND_FILES_RESULT * result)
+{
+    WCHAR folder[MAX_PATH];
+    WCHAR item[MAX_PATH + CCH_FIND_FILES_PREVIEW + 32];
+    LPCWSTR path = result->path;
+    size_t folderLength;
+    int index;
+
+    GetDlgItemText(hdlg, IDC_FIND_FILES_FOLDER, folder, MAX_PATH);
+    folderLength = wcslen(folder);
+    if(folderLength > 0 && _wcsnicmp(path, folder, folderLength) == 0)
+    {
+        path += folderLength;
+        while(*path == L'\\')
+        {
+            path++;
+        }
+    }
+
+    StringCchPrintfW(item, ARRAYSIZE(item), L"%s(%I64u): %s", path, result->line, result->preview);
+
+    index = (int)SendDlgItemMessage(hdlg, IDC_FIND_FILES_RESULTS, LB_ADDSTRING, 0, (LPARAM)item);
+    if(index < 0)
+    {
+        HeapFree(GetProcessHeap(), 0, result);
+        return;
+    }
+
+    SendDlgItemMessage(hdlg, IDC_FIND_FILES_RESULTS, LB_SETITEMDATA, index, (LPARAM)result);
+}
+
+//
+// OpenFindFilesResult
+// Opens the file of the selected result, if it isn't open already,
+// and selects the match
+//
+void OpenFindFilesResult(HWND hdlg)
+{
+    FIND_FILES_RESULT * result;
+    HLOCAL hText;
+    LPCWSTR text;
+    DWORD textLength;
+    DWORD position = 0;
+    DWORD matchEnd;
+    int index;
+
+    index = (int)SendDlgItemMessage(hdlg, IDC_FIND_FILES_RESULTS, LB_GETCURSEL, 0, 0);
+    if(index < 0)
+    {
+        return;
+    }
+
+    result = (FIND_FILES_RESULT *)SendDlgItemMessage(hdlg, IDC_FIND_FILES_RESULTS, LB_GETITEMDATA, index, 0);
+
+    if(lstrcmpiW(result->path, g_activeFile) != 0)
+    {
+        if(!ConfirmSaveChanges())
+        {
+            return;
+        }
+
+        SetEditTextFromFile(result->path);
+        if(lstrcmpiW(result->path, g_activeFile) != 0)
+        {
+            MessageBox(hdlg, L"Unable to open the file.", APP_TITLE_W, MB_OK | MB_ICONERROR);
+            return;
+        }
+    }
+
+    // Lines are counted through the text, since EM_LINEINDEX
+    // counts wrapped lines when word wrap is on
+    hText = (HLOCAL)SendMessage(g_hwndEdit, EM_GETHANDLE, 0, 0);
+    text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+    if(!text)
+    {
+        return;
+    }
+
+    textLength = (DWORD)GetWindowTextLength(g_hwndEdit);
+    for(ULONGLONG line = 1; line < result->line && position < textLength; line++)
+    {
+        position = FindNextLineStart(text, textLength, position);
+    }
+
+    LocalUnlock(hText);
+
+    position = (DWORD)min((ULONGLONG)position + result->column, textLength);
+    matchEnd = (DWORD)min((ULONGLONG)position + result->matchLength, textLength);
+
+    SendMessage(g_hwndEdit, EM_SETSEL, position, matchEnd);
+    SendMessage(g_hwndEdit, EM_SCROLLCARET, 0, 0);
+    SetFocus(g_hwndEdit);
+}
+
+//
+// FindFilesOnInitDialog
+// Fills in the folder of the active file, or the current folder,
+// and the kinds of files that are searched unless they're changed
+//
+void FindFilesOnInitDialog(HWND hdlg)
+{
+    WCHAR folder[MAX_PATH] = {0};
+
+    if(g_activeFile[0] != 0)
+    {
+        StringCchCopyW(folder, MAX_PATH, g_activeFile);
+        PathRemoveFileSpecW(folder);
+    }
+    else
+    {
+        GetCurrentDirectory(MAX_PATH, folder);
+    }
+
+    SendDlgItemMessage(hdlg, IDC_FIND_FILES_TEXT, EM_LIMITTEXT, CCH_FILE_SEARCH_TEXT - 1, 0);
+    SendDlgItemMessage(hdlg, IDC_FIND_FILES_FOLDER, EM_LIMITTEXT, MAX_PATH - 1, 0);
+    SendDlgItemMessage(hdlg, IDC_FIND_FILES_PATTERN, EM_LIMITTEXT, CCH_FILE_SEARCH_TEXT - 1, 0);
+    SetDlgItemText(hdlg, IDC_FIND_FILES_FOLDER, folder);
+    SetDlgItemText(hdlg, IDC_FIND_FILES_PATTERN, FIND_FILES_DEFAULT_PATTERN);
+    CheckDlgButton(hdlg, IDC_FIND_FILES_SUBFOLDERS, BST_CHECKED);
+    EnableWindow(GetDlgItem(hdlg, IDC_FIND_FILES_STOP), FALSE);
+}
+
+//
+// FindFilesOnFind
+// Handles the Find button, which starts a new search. When the results
+// list has the focus, Enter opens the selected result instead.
+//
+void FindFilesOnFind(HWND hdlg)
+{
+    WCHAR searchText[CCH_FIND_TEXT] = {0};
+
+    if(GetFocus() == GetDlgItem(hdlg, IDC_FIND_FILES_RESULTS))
+    {
+        OpenFindFilesResult(hdlg);
+        return;
+    }
+
+    GetDlgItemText(hdlg, IDC_FIND_FILES_TEXT, searchText, CCH_FIND_TEXT);
+    if(g_findFilesSearch || wcslen(searchText) == 0)
+    {
+        return;
+    }
+
+    ClearFindFilesResults(hdlg);
+
+    g_findFilesSearch = StartFindFilesSearch(hdlg);
+    if(!g_findFilesSearch)
+    {
+        MessageBox(hdlg, L"Unable to start the search.", APP_TITLE_W, MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    EnableWindow(GetDlgItem(hdlg, IDC_FIND_FILES_STOP), TRUE);
+    EnableWindow(GetDlgItem(hdlg, IDC_FIND_FILES_FIND), FALSE);
+    SetTimer(hdlg, IDT_FIND_FILES_STATUS, FIND_FILES_STATUS_INTERVAL_MS, NULL);
+    UpdateFindFilesStatus(hdlg);
+}
+
+//
+// FindFilesDlgProc
+// Dialog procedure for the Find in Files dialog
+//
+INT_PTR CALLBACK FindFilesDlgProc(HWND hdlg, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    switch(msg)
+    {
+    case WM_INITDIALOG:
+        FindFilesOnInitDialog(hdlg);
+        return TRUE;
+    case WM_APP_FIND_FILES_RESULT:
+        AddFindFilesResult(hdlg, (FIND_FILES_RESULT *)lparam);
+        return TRUE;
+    case WM_APP_FIND_FILES_DONE:
+        FinishFindFilesSearch(hdlg, FALSE);
+        return TRUE;
+    case WM_TIMER:
+        if(wparam == IDT_FIND_FILES_STATUS)
+        {
+            UpdateFindFilesStatus(hdlg);
+        }
+        return TRUE;
+    case WM_COMMAND:
+        switch(LOWORD(wparam))
+        {
+        case IDC_FIND_FILES_FIND:
+            FindFilesOnFind(hdlg);
+            return TRUE;
+        case IDC_FIND_FILES_STOP:
+            if(g_findFilesSearch)
+            {
+                // The search thread posts WM_APP_FIND_FILES_DONE once it stops
+                InterlockedExchange(&g_findFilesSearch->files.cancel, TRUE);
+            }
+            return TRUE;
+        case IDC_FIND_FILES_RESULTS:
+            if(HIWORD(wparam) == LBN_DBLCLK)
+            {
+                OpenFindFilesResult(hdlg);
+            }
+            return TRUE;
+        case IDCANCEL:
+            DestroyWindow(hdlg);
+            return TRUE;
+        }
+        break;
+    case WM_DESTROY:
+        // This also runs when the main window is destroyed, since it owns the dialog
+        FinishFindFilesSearch(hdlg, TRUE);
+        ClearFindFilesResults(hdlg);
+        g_hwndFindFiles = NULL;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+//
+// MainWndOnEditFindInFiles
+// Handles IDM_EDIT_FIND_IN_FILES by showing the Find in Files dialog
+//
+void MainWndOnEditFindInFiles(void)
+{
+    if(g_hwndFindFiles == NULL)
+    {
+        g_hwndFindFiles = CreateDialog(g_hinst, MAKEINTRESOURCE(IDD_FIND_FILES), g_hwndMain, FindFilesDlgProc);
+        ShowWindow(g_hwndFindFiles, SW_SHOW);
+    }
+    else
+    {
+        SetFocus(g_hwndFindFiles);
+    }
+}
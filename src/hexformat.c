@@ -0,0 +1,77 @@
+/* -------------------------------------------------------------
+
+hexformat.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for formatting bytes as the rows of the hex view.
+    Nothing in here touches windows or app globals.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// GetHexOffsetDigits
+// Returns the number of hex digits the offsets of data of the specified
+// size are shown with: 8, unless the data needs more
+//
+int GetHexOffsetDigits(ULONGLONG dataSize)
+{
+    return (dataSize > 0xFFFFFFFF) ? 16 : 8;
+}
+
+//
+// FormatHexRow
+// Formats up to HEX_BYTES_PER_ROW bytes as a row of the hex view:
+// the offset, the bytes in hex, then the bytes as characters.
+// line must hold at least CCH_HEX_ROW characters. The formatting is
+// done with table lookups, since this runs for every visible row on
+// every paint. Returns the number of characters in the row.
+//
+int FormatHexRow(WCHAR * line, ULONGLONG offset, const BYTE * bytes, size_t byteCount, int offsetDigits)
+{
+    static const WCHAR hexDigits[] = L"0123456789ABCDEF";
+    WCHAR * out = line;
+    WCHAR * chars;
+
+    // The offset, most significant digit first
+    for(int shift = (offsetDigits - 1) * 4; shift >= 0; shift -= 4)
+    {
+        *out++ = hexDigits[(offset >> shift) & 0xF];
+    }
+
+    *out++ = L' ';
+    *out++ = L' ';
+
+    // The character column starts after the hex columns, which are
+    // always the same width so the character column lines up.
+    chars = out + (HEX_BYTES_PER_ROW * 3) + 2;
+
+    for(size_t i = 0; i < HEX_BYTES_PER_ROW; i++)
+    {
+        if(i == HEX_BYTES_PER_ROW / 2)
+        {
+            *out++ = L' ';
+        }
+
+        if(i < byteCount)
+        {
+            BYTE b = bytes[i];
+            out[0] = hexDigits[b >> 4];
+            out[1] = hexDigits[b & 0xF];
+            chars[i] = (b >= 0x20 && b < 0x7F) ? (WCHAR)b : L'.';
+        }
+        else
+        {
+            out[0] = L' ';
+            out[1] = L' ';
+        }
+
+        out[2] = L' ';
+        out += 3;
+    }
+
+    *out++ = L' ';
+
+    return (int)(out - line) + (int)byteCount;
+}
@@ -0,0 +1,519 @@
+/* -------------------------------------------------------------
+
+hexview.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the hex view, which shows the raw bytes of the active file.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <windows.h>
+#include <limits.h>
+#include "esnpad.h"
+
+// The number of rows to scroll for each notch of the mouse wheel
+#define HEX_WHEEL_ROWS      3
+
+#define HEX_VIEW_CLASS      L"EsnpadHexView"
+
+//
+// globals
+//
+HWND g_hwndHex = NULL;              // handle to the hex view window
+BOOL g_hexClassRegistered = FALSE;  // the hex view class is registered on first use
+HANDLE g_hexFile = INVALID_HANDLE_VALUE;
+HANDLE g_hexMapping = NULL;
+const BYTE * g_hexData = NULL;      // the mapped view of the whole file
+ULONGLONG g_hexDataSize = 0;
+ULONGLONG g_hexTopRow = 0;          // the first row shown in the window
+ULONGLONG g_hexRowsPerScrollUnit = 1;   // above 1 only when there are more rows than a scroll bar can count
+int g_hexRowHeight = 1;             // in pixels
+
+extern HINSTANCE g_hinst;
+extern HWND g_hwndEdit;
+extern WCHAR g_activeFile[MAX_PATH];
+
+//
+// HexViewRowCount
+// Returns the number of rows needed to show the whole file
+//
+ULONGLONG HexViewRowCount(void)
+{
+    return (g_hexDataSize + HEX_BYTES_PER_ROW - 1) / HEX_BYTES_PER_ROW;
+}
+
+//
+// HexViewVisibleRows
+// Returns the number of whole rows that fit in the hex view
+//
+int HexViewVisibleRows(void)
+{
+    RECT rectClient;
+
+    GetClientRect(g_hwndHex, &rectClient);
+    return max(1, (rectClient.bottom - rectClient.top) / g_hexRowHeight);
+}
+
+//
+// HexViewUpdateScrollBar
+// Sets the scroll bar range and position from the file size and top row.
+// A scroll bar counts with ints, so for files with more rows than that,
+// each scroll unit stands for several rows.
+//
+void HexViewUpdateScrollBar(void)
+{
+    SCROLLINFO si;
+    ULONGLONG rowCount = HexViewRowCount();
+
+    g_hexRowsPerScrollUnit = (rowCount / INT_MAX) + 1;
+
+    ZeroMemory(&si, sizeof(si));
+    si.cbSize = sizeof(si);
+    si.fMask = SIF_RANGE|SIF_PAGE|SIF_POS|SIF_DISABLENOSCROLL;
+    si.nMin = 0;
+    si.nMax = (rowCount > 0) ? (int)((rowCount - 1) / g_hexRowsPerScrollUnit) : 0;
+    si.nPage = (UINT)max(1, (ULONGLONG)HexViewVisibleRows() / g_hexRowsPerScrollUnit);
+    si.nPos = (int)(g_hexTopRow / g_hexRowsPerScrollUnit);
+
+    SetScrollInfo(g_hwndHex, SB_VERT, &si, TRUE);
+
+    return;
+}
+
+//
+// HexViewScrollTo
+// Makes the specified row the top row, keeping the last page full
+//
+void HexViewScrollTo(LONGLONG row)
+{
+    LONGLONG lastTopRow = (LONGLONG)HexViewRowCount() - HexViewVisibleRows();
+
+    if(row > lastTopRow)
+    {
+        row = lastTopRow;
+    }
+
+    if(row < 0)
+    {
+        row = 0;
+    }
+
+    if((ULONGLONG)row != g_hexTopRow)
+    {
+        g_hexTopRow = (ULONGLONG)row;
+        HexViewUpdateScrollBar();
+        InvalidateRect(g_hwndHex, NULL, FALSE);
+    }
+
+    return;
+}
+
+//
+// HexViewCloseFile
+// Unmaps and closes the file shown in the hex view.
+// The file must be closed before it can be written.
+//
+void HexViewCloseFile(void)
+{
+    if(g_hexData)
+    {
+        UnmapViewOfFile(g_hexData);
+        g_hexData = NULL;
+    }
+
+    if(g_hexMapping)
+    {
+        CloseHandle(g_hexMapping);
+        g_hexMapping = NULL;
+    }
+
+    if(g_hexFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(g_hexFile);
+        g_hexFile = INVALID_HANDLE_VALUE;
+    }
+
+    g_hexDataSize = 0;
+    g_hexTopRow = 0;
+
+    if(g_hwndHex)
+    {
+        HexViewUpdateScrollBar();
+        InvalidateRect(g_hwndHex, NULL, FALSE);
+    }
+
+    return;
+}
+
+//
+// HexViewOpenFile
+// Maps the whole file read-only, so that any part of it can be
+// shown without reading it first. Only the pages that are actually
+// shown are ever read from disk.
+//
+BOOL HexViewOpenFile(LPCWSTR filePath)
+{
+    LARGE_INTEGER fileSize;
+
+    HexViewCloseFile();
+
+    g_hexFile = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+
+    if(g_hexFile == INVALID_HANDLE_VALUE)
+    {
+        DebugLog(L"Couldn't open file for the hex view: %s", filePath);
+        return FALSE;
+    }
+
+    if(!GetFileSizeEx(g_hexFile, &fileSize))
+    {
+        HexViewCloseFile();
+        return FALSE;
+    }
+
+    // An empty file can't be mapped, but there's nothing to show anyway
+    if(fileSize.QuadPart > 0)
+    {
+        g_hexMapping = CreateFileMapping(g_hexFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(g_hexMapping)
+        {
+            g_hexData = MapViewOfFile(g_hexMapping, FILE_MAP_READ, 0, 0, 0);
+        }
+
+        if(!g_hexData)
+        {
+            DebugLog(L"Couldn't map file for the hex view: %s", filePath);
+            HexViewCloseFile();
+            return FALSE;
+        }
+
+        g_hexDataSize = (ULONGLONG)fileSize.QuadPart;
+    }
+
+    HexViewUpdateScrollBar();
+    InvalidateRect(g_hwndHex, NULL, FALSE);
+
+    return TRUE;
+}
+
+//
+// HexViewUpdateRowHeight
+// Measures the hex view font to find the height of a row
+//
+void HexViewUpdateRowHeight(HWND hwnd)
+{
+    TEXTMETRIC tm;
+    HDC hdc = GetDC(hwnd);
+
+    if(hdc)
+    {
+        HFONT hOldFont = SelectObject(hdc, GetHexViewFont(GetDpiForWindow(hwnd)));
+        if(GetTextMetrics(hdc, &tm))
+        {
+            g_hexRowHeight = max(1, tm.tmHeight);
+        }
+
+        SelectObject(hdc, hOldFont);
+        ReleaseDC(hwnd, hdc);
+    }
+
+    return;
+}
+
+//
+// HexViewOnPaint
+// Handles WM_PAINT for the hex view. Only the rows that intersect
+// the invalid rectangle are formatted and drawn.
+//
+void HexViewOnPaint(HWND hwnd)
+{
+    PAINTSTRUCT ps;
+    WCHAR line[CCH_HEX_ROW];
+    const THEME * theme = GetCurrentTheme();
+    HDC hdc = BeginPaint(hwnd, &ps);
+
+    FillRect(hdc, &ps.rcPaint, theme->backgroundBrush);
+
+    HFONT hOldFont = SelectObject(hdc, GetHexViewFont(GetDpiForWindow(hwnd)));
+    SetTextColor(hdc, theme->textColor);
+    SetBkColor(hdc, theme->backgroundColor);
+
+    if(!g_hexData)
+    {
+        LPCWSTR message = (g_activeFile[0] != 0) ? L"The file is empty." : L"There is no file to show. Save the text to a file first.";
+        TextOut(hdc, 0, 0, message, lstrlenW(message));
+    }
+    else
+    {
+        int offsetDigits = GetHexOffsetDigits(g_hexDataSize);
+
+        int firstRow = ps.rcPaint.top / g_hexRowHeight;
+        int lastRow = (ps.rcPaint.bottom + g_hexRowHeight - 1) / g_hexRowHeight;
+
+        for(int row = firstRow; row < lastRow; row++)
+        {
+            ULONGLONG offset = (g_hexTopRow + row) * HEX_BYTES_PER_ROW;
+
+            if(offset >= g_hexDataSize)
+            {
+                break;
+            }
+
+            size_t byteCount = (size_t)min(g_hexDataSize - offset, HEX_BYTES_PER_ROW);
+            int length = FormatHexRow(line, offset, g_hexData + offset, byteCount, offsetDigits);
+            TextOut(hdc, 0, row * g_hexRowHeight, line, length);
+        }
+    }
+
+    SelectObject(hdc, hOldFont);
+    EndPaint(hwnd, &ps);
+
+    return;
+}
+
+//
+// HexViewOnVScroll
+// Handles WM_VSCROLL for the hex view
+//
+void HexViewOnVScroll(int code)
+{
+    SCROLLINFO si;
+    LONGLONG row = (LONGLONG)g_hexTopRow;
+    int page = HexViewVisibleRows();
+
+    switch(code)
+    {
+    case SB_LINEUP:
+        row -= 1;
+        break;
+    case SB_LINEDOWN:
+        row += 1;
+        break;
+    case SB_PAGEUP:
+        row -= page;
+        break;
+    case SB_PAGEDOWN:
+        row += page;
+        break;
+    case SB_TOP:
+        row = 0;
+        break;
+    case SB_BOTTOM:
+        row = (LONGLONG)HexViewRowCount();
+        break;
+    case SB_THUMBTRACK:
+    case SB_THUMBPOSITION:
+        // Use the 32-bit track position, not the 16-bit one in wparam
+        ZeroMemory(&si, sizeof(si));
+        si.cbSize = sizeof(si);
+        si.fMask = SIF_TRACKPOS;
+        GetScrollInfo(g_hwndHex, SB_VERT, &si);
+        row = (LONGLONG)(si.nTrackPos * g_hexRowsPerScrollUnit);
+        break;
+    default:
+        return;
+    }
+
+    HexViewScrollTo(row);
+
+    return;
+}
+
+//
+// HexViewOnKeyDown
+// Handles WM_KEYDOWN for the hex view, for scrolling with the keyboard
+//
+void HexViewOnKeyDown(WPARAM key)
+{
+    switch(key)
+    {
+    case VK_UP:
+        HexViewOnVScroll(SB_LINEUP);
+        break;
+    case VK_DOWN:
+        HexViewOnVScroll(SB_LINEDOWN);
+        break;
+    case VK_PRIOR:
+        HexViewOnVScroll(SB_PAGEUP);
+        break;
+    case VK_NEXT:
+        HexViewOnVScroll(SB_PAGEDOWN);
+        break;
+    case VK_HOME:
+        HexViewOnVScroll(SB_TOP);
+        break;
+    case VK_END:
+        HexViewOnVScroll(SB_BOTTOM);
+        break;
+    }
+
+    return;
+}
+
+//
+// HexViewProc
+// window procedure for the hex view
+//
+LRESULT CALLBACK HexViewProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    switch(msg)
+    {
+    case WM_PAINT:
+        HexViewOnPaint(hwnd);
+        return 0;
+    case WM_ERASEBKGND:
+        // WM_PAINT fills the background
+        return 1;
+    case WM_SIZE:
+        HexViewUpdateRowHeight(hwnd);
+        HexViewUpdateScrollBar();
+        return 0;
+    case WM_VSCROLL:
+        HexViewOnVScroll(LOWORD(wparam));
+        return 0;
+    case WM_MOUSEWHEEL:
+        HexViewScrollTo((LONGLONG)g_hexTopRow - (GET_WHEEL_DELTA_WPARAM(wparam) / WHEEL_DELTA) * HEX_WHEEL_ROWS);
+        return 0;
+    case WM_KEYDOWN:
+        HexViewOnKeyDown(wparam);
+        return 0;
+    case WM_LBUTTONDOWN:
+        SetFocus(hwnd);
+        return 0;
+    case WM_DESTROY:
+        HexViewCloseFile();
+        g_hwndHex = NULL;
+        return 0;
+    }
+
+    return DefWindowProc(hwnd, msg, wparam, lparam);
+}
+
+//
+// CreateHexView
+// Registers the hex view window class and creates the window,
+// with the same size and position as the edit control.
+//
+BOOL CreateHexView(HWND hwndParent)
+{
+    WNDCLASSEX wc;
+    RECT rectEdit = {0};
+
+    if(!g_hexClassRegistered)
+    {
+        ZeroMemory(&wc, sizeof(wc));
+        wc.cbSize = sizeof(wc);
+        wc.lpfnWndProc = HexViewProc;
+        wc.hInstance = g_hinst;
+        wc.lpszClassName = HEX_VIEW_CLASS;
+        wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+
+        if(!RegisterClassEx(&wc))
+        {
+            return FALSE;
+        }
+
+        g_hexClassRegistered = TRUE;
+    }
+
+    // The edit control's position is relative to the parent's client area
+    if(g_hwndEdit)
+    {
+        GetWindowRect(g_hwndEdit, &rectEdit);
+        MapWindowPoints(NULL, hwndParent, (POINT *)&rectEdit, 2);
+    }
+
+    g_hwndHex = CreateWindowEx(0, HEX_VIEW_CLASS, NULL,
+        WS_CHILD|WS_BORDER|WS_VSCROLL,
+        rectEdit.left, rectEdit.top, rectEdit.right - rectEdit.left, rectEdit.bottom - rectEdit.top,
+        hwndParent, (HMENU)IDC_HEX, g_hinst, NULL);
+
+    if(g_hwndHex)
+    {
+        HexViewUpdateRowHeight(g_hwndHex);
+    }
+
+    return (g_hwndHex != NULL);
+}
+
+//
+// IsHexViewVisible
+// Returns TRUE if the hex view is being shown instead of the edit control
+//
+BOOL IsHexViewVisible(void)
+{
+    return g_hwndHex && IsWindowVisible(g_hwndHex);
+}
+
+//
+// ShowHexView
+// Shows the hex view in place of the edit control, or the other way around.
+// The file is only mapped while the hex view is shown.
+//
+BOOL ShowHexView(HWND hwndParent, BOOL show)
+{
+    if(show)
+    {
+        if(!g_hwndHex && !CreateHexView(hwndParent))
+        {
+            return FALSE;
+        }
+
+        ShowWindow(g_hwndHex, SW_SHOW);
+        ShowWindow(g_hwndEdit, SW_HIDE);
+        SetFocus(g_hwndHex);
+
+        RefreshHexView();
+    }
+    else if(g_hwndHex)
+    {
+        HexViewCloseFile();
+
+        ShowWindow(g_hwndEdit, SW_SHOW);
+        ShowWindow(g_hwndHex, SW_HIDE);
+        SetFocus(g_hwndEdit);
+    }
+
+    return TRUE;
+}
+
+//
+// RefreshHexView
+// Shows the current contents of g_activeFile in the hex view.
+// Call it whenever the active file changes or is written. While
+// the hex view is hidden, the file isn't mapped at all, since
+// ShowHexView refreshes it when it's shown again.
+//
+void RefreshHexView(void)
+{
+    if(!IsHexViewVisible())
+    {
+        return;
+    }
+
+    if(g_activeFile[0] != 0)
+    {
+        HexViewOpenFile(g_activeFile);
+    }
+    else
+    {
+        HexViewCloseFile();
+    }
+
+    return;
+}
+
+//
+// MoveHexView
+// Sizes the hex view to match the edit control
+//
+void MoveHexView(int width, int height)
+{
+    if(g_hwndHex)
+    {
+        MoveWindow(g_hwndHex, 0, 0, width, height, TRUE);
+    }
+
+    return;
+}
@@ -0,0 +1,454 @@
+/* -------------------------------------------------------------
+
+highlight.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for syntax highlighting in the edit control.
+
+    The edit control draws all of its text in one color, so the
+    highlighted tokens are painted over its text after it paints.
+    Only the lines that are being painted are tokenized, using the
+    states cached by lexer.c to start each one.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+
+#include <windows.h>
+#include <commctrl.h>
+#include <shlwapi.h>
+#include "esnpad.h"
+
+// The ID of the edit control subclass
+#define HIGHLIGHT_SUBCLASS_ID 1
+
+// The text of the edit control, for GetEditLineText
+typedef struct _HIGHLIGHT_TEXT
+{
+    HWND hwnd;
+    LPCWSTR text;
+    DWORD textLength;
+} HIGHLIGHT_TEXT;
+
+//
+// globals
+//
+BOOL g_highlightEnabled = FALSE;
+HIGHLIGHT_CACHE g_highlightCache = {0};
+DWORD g_highlightChangeCount = 0;   // the number of EN_CHANGE notifications so far
+
+extern HWND g_hwndEdit;
+
+//
+// GetEditLineText
+// Gets the text of a line in the edit control, for the highlight cache.
+// context is a HIGHLIGHT_TEXT.
+//
+BOOL GetEditLineText(void * context, DWORD line, const WCHAR ** text, DWORD * length)
+{
+    HIGHLIGHT_TEXT * editText = context;
+    LRESULT lineStart = SendMessage(editText->hwnd, EM_LINEINDEX, line, 0);
+
+    if(lineStart < 0 || (DWORD)lineStart > editText->textLength)
+    {
+        return FALSE;
+    }
+
+    *text = editText->text + lineStart;
+    *length = (DWORD)SendMessage(editText->hwnd, EM_LINELENGTH, lineStart, 0);
+
+    return TRUE;
+}
+
+//
+// LockEditText
+// Gets a pointer to the edit control's own copy of its text, without
+// copying it. The text can't be changed, and must be unlocked with
+// LocalUnlock before the edit control gets another message that
+// could change it.
+//
+HLOCAL LockEditText(HWND hwnd, HIGHLIGHT_TEXT * editText)
+{
+    HLOCAL hText = (HLOCAL)SendMessage(hwnd, EM_GETHANDLE, 0, 0);
+
+    editText->hwnd = hwnd;
+    editText->textLength = (DWORD)GetWindowTextLength(hwnd);
+    editText->text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+
+    return editText->text ? hText : NULL;
+}
+
+//
+// GetEditLineHeight
+// Returns the height of a line in the edit control's font
+//
+int GetEditLineHeight(HWND hwnd)
+{
+    HDC hdc;
+    HFONT hFont;
+    HGDIOBJ oldFont;
+    TEXTMETRIC textMetric = {0};
+
+    hdc = GetDC(hwnd);
+    if(!hdc)
+    {
+        return 1;
+    }
+
+    hFont = (HFONT)SendMessage(hwnd, WM_GETFONT, 0, 0);
+    oldFont = SelectObject(hdc, hFont);
+    GetTextMetrics(hdc, &textMetric);
+    SelectObject(hdc, oldFont);
+    ReleaseDC(hwnd, hdc);
+
+    return max(textMetric.tmHeight, 1);
+}
+
+//
+// InvalidateEditLines
+// Invalidates the visible part of the lines from firstLine to lastLine,
+// which can be HIGHLIGHT_ALL_LINES, so they're highlighted again.
+//
+void InvalidateEditLines(HWND hwnd, DWORD firstLine, DWORD lastLine)
+{
+    RECT rect;
+    DWORD firstVisible = (DWORD)SendMessage(hwnd, EM_GETFIRSTVISIBLELINE, 0, 0);
+    int lineHeight = GetEditLineHeight(hwnd);
+    DWORD visibleLines;
+
+    SendMessage(hwnd, EM_GETRECT, 0, (LPARAM)&rect);
+    visibleLines = (DWORD)((rect.bottom - rect.top) / lineHeight + 1);
+
+    if(lastLine < firstVisible || (firstLine > firstVisible && firstLine - firstVisible > visibleLines))
+    {
+        return;
+    }
+
+    if(lastLine - firstVisible < visibleLines)
+    {
+        rect.bottom = rect.top + (int)(lastLine - firstVisible + 1) * lineHeight;
+    }
+    if(firstLine > firstVisible)
+    {
+        rect.top += (int)(firstLine - firstVisible) * lineHeight;
+    }
+
+    InvalidateRect(hwnd, &rect, FALSE);
+}
+
+//
+// PaintHighlights
+// Paints the highlighted tokens in the visible lines over the text
+// the edit control painted. Only the area in updateRgn is painted.
+// Tokens in the selection are left alone so it stays visible, and
+// tokens with tabs are skipped, since the edit control expands them.
+//
+void PaintHighlights(HWND hwnd, HRGN updateRgn)
+{
+    HDC hdc;
+    HLOCAL hText;
+    HIGHLIGHT_TEXT editText;
+    HGDIOBJ oldFont;
+    RECT formatRect;
+    TOKEN tokens[MAX_LINE_TOKENS];
+    DWORD tokenCount;
+    DWORD token;
+    DWORD firstLine;
+    DWORD lineCount;
+    DWORD visibleLines;
+    DWORD line;
+    DWORD lineStart;
+    DWORD tokenStart;
+    DWORD selStart = 0;
+    DWORD selEnd = 0;
+    DWORD i;
+    LRESULT position;
+    BOOL caretHidden;
+    const THEME * theme = GetCurrentTheme();
+    int lineHeight = GetEditLineHeight(hwnd);
+
+    SendMessage(hwnd, EM_GETRECT, 0, (LPARAM)&formatRect);
+    SendMessage(hwnd, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+    firstLine = (DWORD)SendMessage(hwnd, EM_GETFIRSTVISIBLELINE, 0, 0);
+    lineCount = (DWORD)SendMessage(hwnd, EM_GETLINECOUNT, 0, 0);
+    visibleLines = (DWORD)((formatRect.bottom - formatRect.top) / lineHeight + 1);
+
+    hText = LockEditText(hwnd, &editText);
+    if(!hText)
+    {
+        return;
+    }
+
+    hdc = GetDC(hwnd);
+    if(hdc)
+    {
+        SelectClipRgn(hdc, updateRgn);
+        IntersectClipRect(hdc, formatRect.left, formatRect.top, formatRect.right, formatRect.bottom);
+        oldFont = SelectObject(hdc, (HFONT)SendMessage(hwnd, WM_GETFONT, 0, 0));
+        SetBkMode(hdc, OPAQUE);
+        SetBkColor(hdc, theme->backgroundColor);
+        caretHidden = HideCaret(hwnd);
+
+        for(line = firstLine; line < lineCount && line - firstLine < visibleLines; line++)
+        {
+            tokenCount = TokenizeHighlightLine(&g_highlightCache, line, GetEditLineText, &editText,
+                tokens, MAX_LINE_TOKENS);
+            lineStart = (DWORD)SendMessage(hwnd, EM_LINEINDEX, line, 0);
+
+            for(token = 0; token < tokenCount; token++)
+            {
+                if(tokens[token].type == TOKEN_TEXT)
+                {
+                    continue;
+                }
+
+                tokenStart = lineStart + tokens[token].start;
+                if(selStart != selEnd && tokenStart < selEnd && tokenStart + tokens[token].length > selStart)
+                {
+                    continue;
+                }
+
+                for(i = 0; i < tokens[token].length && editText.text[tokenStart + i] != L'\t'; i++)
+                {
+                }
+                if(i < tokens[token].length)
+                {
+                    continue;
+                }
+
+                position = SendMessage(hwnd, EM_POSFROMCHAR, tokenStart, 0);
+                if(position == -1)
+                {
+                    continue;
+                }
+
+                SetTextColor(hdc, theme->tokenColors[tokens[token].type]);
+                ExtTextOutW(hdc, (short)LOWORD(position), (short)HIWORD(position), 0, NULL,
+                    editText.text + tokenStart, tokens[token].length, NULL);
+            }
+        }
+
+        if(caretHidden)
+        {
+            ShowCaret(hwnd);
+        }
+        SelectObject(hdc, oldFont);
+        ReleaseDC(hwnd, hdc);
+    }
+
+    LocalUnlock(hText);
+}
+
+//
+// HighlightOnPaint
+// Handles WM_PAINT for the edit control by letting it paint,
+// then painting the highlights over the same area.
+//
+LRESULT HighlightOnPaint(HWND hwnd, WPARAM wParam, LPARAM lParam)
+{
+    LRESULT result;
+    HRGN updateRgn = CreateRectRgn(0, 0, 0, 0);
+    int regionType = ERROR;
+
+    if(updateRgn)
+    {
+        regionType = GetUpdateRgn(hwnd, updateRgn, FALSE);
+    }
+
+    result = DefSubclassProc(hwnd, WM_PAINT, wParam, lParam);
+
+    if(regionType != ERROR && regionType != NULLREGION)
+    {
+        PaintHighlights(hwnd, updateRgn);
+    }
+
+    if(updateRgn)
+    {
+        DeleteObject(updateRgn);
+    }
+
+    return result;
+}
+
+//
+// HighlightOnEdit
+// Handles a message that can change the text or the selection.
+// The edit control paints those changes itself, without highlighting,
+// so the lines that changed are invalidated to be painted again.
+// When the text changed, the cache is updated first.
+//
+LRESULT HighlightOnEdit(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    LRESULT result;
+    HLOCAL hText;
+    HIGHLIGHT_TEXT editText;
+    DWORD oldStart = 0;
+    DWORD oldEnd = 0;
+    DWORD newStart = 0;
+    DWORD newEnd = 0;
+    DWORD changeCount = g_highlightChangeCount;
+    DWORD firstLine;
+    DWORD lastLine;
+    DWORD changedLine;
+    DWORD textLength;
+    int oldLineCount;
+    int lineDelta;
+
+    SendMessage(hwnd, EM_GETSEL, (WPARAM)&oldStart, (LPARAM)&oldEnd);
+    oldLineCount = (int)SendMessage(hwnd, EM_GETLINECOUNT, 0, 0);
+
+    result = DefSubclassProc(hwnd, msg, wParam, lParam);
+
+    SendMessage(hwnd, EM_GETSEL, (WPARAM)&newStart, (LPARAM)&newEnd);
+
+    if(changeCount != g_highlightChangeCount)
+    {
+        // Nothing before the start of the old or new selection changed,
+        // and the changed text ends at the end of one of them
+        textLength = (DWORD)GetWindowTextLength(hwnd);
+        firstLine = (DWORD)SendMessage(hwnd, EM_LINEFROMCHAR, min(oldStart, newStart), 0);
+        lastLine = (DWORD)SendMessage(hwnd, EM_LINEFROMCHAR, newEnd, 0);
+        changedLine = (DWORD)SendMessage(hwnd, EM_LINEFROMCHAR, min(oldEnd, textLength), 0);
+        lastLine = max(lastLine, changedLine);
+        lineDelta = (int)SendMessage(hwnd, EM_GETLINECOUNT, 0, 0) - oldLineCount;
+
+        changedLine = HIGHLIGHT_ALL_LINES;
+        hText = LockEditText(hwnd, &editText);
+        if(hText)
+        {
+            changedLine = InvalidateHighlightCache(&g_highlightCache, firstLine, lastLine, lineDelta,
+                GetEditLineText, &editText);
+            LocalUnlock(hText);
+        }
+        else
+        {
+            InitHighlightCache(&g_highlightCache, g_highlightCache.lexer);
+        }
+
+        InvalidateEditLines(hwnd, firstLine, max(changedLine, lastLine));
+    }
+    else if(newStart != oldStart || newEnd != oldEnd)
+    {
+        InvalidateEditLines(hwnd,
+            (DWORD)SendMessage(hwnd, EM_LINEFROMCHAR, min(oldStart, newStart), 0),
+            (DWORD)SendMessage(hwnd, EM_LINEFROMCHAR, max(oldEnd, newEnd), 0));
+    }
+
+    return result;
+}
+
+//
+// HighlightEditProc
+// The subclass procedure for the edit control
+//
+LRESULT CALLBACK HighlightEditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam,
+    UINT_PTR idSubclass, DWORD_PTR refData)
+{
+    UNREFERENCED_PARAMETER(refData);
+
+    switch(msg)
+    {
+    case WM_PAINT:
+        // wParam is an HDC when the control is asked to paint somewhere else
+        if(g_highlightEnabled && !wParam)
+        {
+            return HighlightOnPaint(hwnd, wParam, lParam);
+        }
+        break;
+    case WM_CHAR:
+    case WM_KEYDOWN:
+    case WM_LBUTTONDOWN:
+    case WM_LBUTTONDBLCLK:
+    case WM_LBUTTONUP:
+    case WM_MOUSEMOVE:
+    case WM_TIMER:
+    case WM_CUT:
+    case WM_PASTE:
+    case WM_CLEAR:
+    case WM_UNDO:
+    case EM_UNDO:
+    case EM_SETSEL:
+    case EM_REPLACESEL:
+        if(g_highlightEnabled)
+        {
+            return HighlightOnEdit(hwnd, msg, wParam, lParam);
+        }
+        break;
+    case WM_SETTEXT:
+        // EN_CHANGE isn't sent for this, and all of the text is new
+        InitHighlightCache(&g_highlightCache, g_highlightCache.lexer);
+        break;
+    case WM_NCDESTROY:
+        RemoveWindowSubclass(hwnd, HighlightEditProc, idSubclass);
+        break;
+    }
+
+    return DefSubclassProc(hwnd, msg, wParam, lParam);
+}
+
+//
+// AttachHighlighting
+// Subclasses a new edit control so it can be highlighted.
+// Lines may wrap differently in the new control, so the cache is emptied.
+//
+void AttachHighlighting(HWND hwndEdit)
+{
+    if(!SetWindowSubclass(hwndEdit, HighlightEditProc, HIGHLIGHT_SUBCLASS_ID, 0))
+    {
+        DebugLog(L"Unable to subclass the edit control for highlighting");
+    }
+
+    InitHighlightCache(&g_highlightCache, g_highlightCache.lexer ? g_highlightCache.lexer : GetLogLexer());
+}
+
+//
+// SelectHighlightLexer
+// Picks the lexer for a file based on its extension.
+// JSON files get the JSON lexer, and everything else is treated as a log.
+//
+void SelectHighlightLexer(LPCWSTR filePath)
+{
+    LPCWSTR extension = PathFindExtensionW(filePath);
+    const LEXER * lexer = GetLogLexer();
+
+    if(!lstrcmpiW(extension, L".json") || !lstrcmpiW(extension, L".jsonl") || !lstrcmpiW(extension, L".ndjson"))
+    {
+        lexer = GetJsonLexer();
+    }
+
+    if(lexer != g_highlightCache.lexer)
+    {
+        DebugLog(L"Highlighting with the %s lexer", lexer->name);
+        InitHighlightCache(&g_highlightCache, lexer);
+
+        if(g_highlightEnabled && g_hwndEdit)
+        {
+            InvalidateRect(g_hwndEdit, NULL, FALSE);
+        }
+    }
+}
+
+//
+// SetHighlighting
+// Turns syntax highlighting on or off
+//
+void SetHighlighting(BOOL enabled)
+{
+    g_highlightEnabled = enabled;
+
+    // Edits aren't tracked while highlighting is off, so the cache may be stale
+    InitHighlightCache(&g_highlightCache, g_highlightCache.lexer ? g_highlightCache.lexer : GetLogLexer());
+
+    if(g_hwndEdit)
+    {
+        InvalidateRect(g_hwndEdit, NULL, FALSE);
+    }
+}
+
+//
+// HighlightTextChanged
+// Called when the edit control sends EN_CHANGE
+//
+void HighlightTextChanged(void)
+{
+    g_highlightChangeCount++;
+}
@@ -0,0 +1,662 @@
+/* -------------------------------------------------------------
+
+lexer.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    The lexers used for syntax highlighting, and the cache of the
+    state each line starts in.
+
+    A lexer tokenizes one line at a time. It's given the state the
+    line starts in, and returns the state the next line starts in,
+    so a line can be tokenized without looking at any other text.
+    Nothing in this file calls into Windows, so the lexers can be
+    built and measured on their own.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+
+#include <string.h>
+#include "esncore.h"
+
+// The deepest JSON nesting that's tracked. Deeper text is still tokenized.
+#define MAX_JSON_DEPTH 0xFFFF
+
+// The level names recognized in a log line, and the token type for each
+typedef struct _LOG_LEVEL
+{
+    const WCHAR * name;
+    DWORD length;
+    int type;
+} LOG_LEVEL;
+
+DWORD TokenizeLogLine(const WCHAR * line, DWORD length, DWORD state, TOKEN * tokens, DWORD maxTokens, DWORD * tokenCount);
+DWORD TokenizeJsonLine(const WCHAR * line, DWORD length, DWORD state, TOKEN * tokens, DWORD maxTokens, DWORD * tokenCount);
+
+//
+// globals
+//
+const LEXER g_logLexer = { L"Log", TokenizeLogLine };
+const LEXER g_jsonLexer = { L"JSON", TokenizeJsonLine };
+
+const LOG_LEVEL g_logLevels[] =
+{
+    { L"FATAL", 5, TOKEN_ERROR },
+    { L"CRITICAL", 8, TOKEN_ERROR },
+    { L"ERROR", 5, TOKEN_ERROR },
+    { L"ERR", 3, TOKEN_ERROR },
+    { L"WARNING", 7, TOKEN_WARNING },
+    { L"WARN", 4, TOKEN_WARNING },
+    { L"INFO", 4, TOKEN_INFO },
+    { L"NOTICE", 6, TOKEN_INFO },
+    { L"DEBUG", 5, TOKEN_DEBUG },
+    { L"TRACE", 5, TOKEN_DEBUG },
+};
+
+//
+// IsDigitChar
+// Only ASCII digits count, since that's all a timestamp or a JSON number uses
+//
+BOOL IsDigitChar(WCHAR c)
+{
+    return (c >= L'0' && c <= L'9');
+}
+
+//
+// IsWordChar
+//
+BOOL IsWordChar(WCHAR c)
+{
+    return IsDigitChar(c) || (c >= L'A' && c <= L'Z') || (c >= L'a' && c <= L'z') || c == L'_';
+}
+
+//
+// AddToken
+// Adds a token to the list, if there's room for it.
+// Tokens past maxTokens are dropped, but the line is still
+// tokenized to the end so the state it returns is right.
+//
+void AddToken(TOKEN * tokens, DWORD maxTokens, DWORD * tokenCount, DWORD start, DWORD length, int type)
+{
+    if(*tokenCount < maxTokens)
+    {
+        tokens[*tokenCount].start = start;
+        tokens[*tokenCount].length = length;
+        tokens[*tokenCount].type = type;
+        (*tokenCount)++;
+    }
+}
+
+//
+// MatchDigits
+// Checks for count digits at position in line
+//
+BOOL MatchDigits(const WCHAR * line, DWORD length, DWORD position, DWORD count)
+{
+    DWORD i;
+
+    if(position > length || length - position < count)
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        if(!IsDigitChar(line[position + i]))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+//
+// MatchTime
+// Matches a time like 12:34, 12:34:56.789, or 12:34:56,789+01:00 at position.
+// Returns the position after the time, or 0 if there isn't one.
+//
+DWORD MatchTime(const WCHAR * line, DWORD length, DWORD position)
+{
+    DWORD i = position;
+
+    if(!MatchDigits(line, length, i, 2) || i + 2 >= length || line[i + 2] != L':' ||
+        !MatchDigits(line, length, i + 3, 2))
+    {
+        return 0;
+    }
+    i += 5;
+
+    // Seconds
+    if(i < length && line[i] == L':' && MatchDigits(line, length, i + 1, 2))
+    {
+        i += 3;
+    }
+
+    // Fractions of a second
+    if(i < length && (line[i] == L'.' || line[i] == L',') && MatchDigits(line, length, i + 1, 1))
+    {
+        i++;
+        while(i < length && IsDigitChar(line[i]))
+        {
+            i++;
+        }
+    }
+
+    // Time zone
+    if(i < length && line[i] == L'Z')
+    {
+        i++;
+    }
+    else if(i < length && (line[i] == L'+' || line[i] == L'-') && MatchDigits(line, length, i + 1, 2))
+    {
+        i += 3;
+        if(i < length && line[i] == L':' && MatchDigits(line, length, i + 1, 2))
+        {
+            i += 3;
+        }
+        else if(MatchDigits(line, length, i, 2))
+        {
+            i += 2;
+        }
+    }
+
+    return i;
+}
+
+//
+// MatchTimestamp
+// Matches a timestamp at position: a date like 2024-01-31 or 2024/01/31,
+// a time, or both, optionally in square brackets.
+// Returns the length of the timestamp, or 0 if there isn't one.
+//
+DWORD MatchTimestamp(const WCHAR * line, DWORD length, DWORD position)
+{
+    DWORD i = position;
+    DWORD end;
+    BOOL bracket = FALSE;
+
+    if(i < length && line[i] == L'[')
+    {
+        bracket = TRUE;
+        i++;
+    }
+
+    if(MatchDigits(line, length, i, 4) && i + 4 < length && (line[i + 4] == L'-' || line[i + 4] == L'/') &&
+        MatchDigits(line, length, i + 5, 2) && i + 7 < length && line[i + 7] == line[i + 4] &&
+        MatchDigits(line, length, i + 8, 2))
+    {
+        i += 10;
+
+        // The date and time can be separated by a T or a space
+        if(i < length && (line[i] == L'T' || line[i] == L' '))
+        {
+            end = MatchTime(line, length, i + 1);
+            if(end)
+            {
+                i = end;
+            }
+        }
+    }
+    else
+    {
+        i = MatchTime(line, length, i);
+        if(!i)
+        {
+            return 0;
+        }
+    }
+
+    if(bracket)
+    {
+        if(i >= length || line[i] != L']')
+        {
+            return 0;
+        }
+        i++;
+    }
+
+    return i - position;
+}
+
+//
+// MatchLogLevel
+// Checks if the word at position is a level name, ignoring case.
+// Returns the level's token type, or TOKEN_TEXT if it isn't one.
+//
+int MatchLogLevel(const WCHAR * line, DWORD position, DWORD wordLength)
+{
+    size_t level;
+    DWORD i;
+    WCHAR c;
+
+    for(level = 0; level < ARRAYSIZE(g_logLevels); level++)
+    {
+        if(g_logLevels[level].length != wordLength)
+        {
+            continue;
+        }
+
+        for(i = 0; i < wordLength; i++)
+        {
+            c = line[position + i];
+            if(c >= L'a' && c <= L'z')
+            {
+                c = (WCHAR)(c - L'a' + L'A');
+            }
+            if(c != g_logLevels[level].name[i])
+            {
+                break;
+            }
+        }
+
+        if(i == wordLength)
+        {
+            return g_logLevels[level].type;
+        }
+    }
+
+    return TOKEN_TEXT;
+}
+
+//
+// FindLogLevel
+// Finds the first level name in line from position to end.
+// Returns its token type and sets levelStart and levelLength,
+// or returns TOKEN_TEXT if there isn't one.
+//
+int FindLogLevel(const WCHAR * line, DWORD position, DWORD end, DWORD * levelStart, DWORD * levelLength)
+{
+    DWORD i = position;
+    DWORD wordStart;
+    int type;
+
+    while(i < end)
+    {
+        if(!IsWordChar(line[i]))
+        {
+            i++;
+            continue;
+        }
+
+        wordStart = i;
+        while(i < end && IsWordChar(line[i]))
+        {
+            i++;
+        }
+
+        type = MatchLogLevel(line, wordStart, i - wordStart);
+        if(type != TOKEN_TEXT)
+        {
+            *levelStart = wordStart;
+            *levelLength = i - wordStart;
+            return type;
+        }
+    }
+
+    return TOKEN_TEXT;
+}
+
+//
+// FindLogPayload
+// Returns the position of the JSON payload in a log line,
+// which starts at the first brace, or length if there isn't one.
+//
+DWORD FindLogPayload(const WCHAR * line, DWORD length, DWORD position)
+{
+    while(position < length && line[position] != L'{')
+    {
+        position++;
+    }
+
+    return position;
+}
+
+//
+// GetLogLineLevel
+// Returns the token type of the level of a log line,
+// or TOKEN_TEXT if it doesn't have one.
+//
+int GetLogLineLevel(const WCHAR * line, DWORD length)
+{
+    DWORD levelStart;
+    DWORD levelLength;
+
+    return FindLogLevel(line, 0, FindLogPayload(line, length, 0), &levelStart, &levelLength);
+}
+
+//
+// TokenizeJson
+// Tokenizes line from position to the end as JSON. The state is the
+// depth of the objects and arrays that are open when the line starts.
+// Returns the depth at the end of the line.
+//
+DWORD TokenizeJson(const WCHAR * line, DWORD length, DWORD position, DWORD state,
+    TOKEN * tokens, DWORD maxTokens, DWORD * tokenCount)
+{
+    DWORD depth = state;
+    DWORD i = position;
+    DWORD start;
+    DWORD next;
+    WCHAR c;
+    int type;
+
+    while(i < length)
+    {
+        c = line[i];
+        start = i;
+
+        if(c == L'"')
+        {
+            // Strings end at the line, even if they aren't closed
+            i++;
+            while(i < length && line[i] != L'"')
+            {
+                i += (line[i] == L'\\') ? 2 : 1;
+            }
+            i = min(i + 1, length);
+
+            // A string followed by a colon is a key
+            type = TOKEN_STRING;
+            for(next = i; next < length && (line[next] == L' ' || line[next] == L'\t'); next++)
+            {
+            }
+            if(next < length && line[next] == L':')
+            {
+                type = TOKEN_KEY;
+            }
+            AddToken(tokens, maxTokens, tokenCount, start, i - start, type);
+        }
+        else if(c == L'{' || c == L'[')
+        {
+            depth = min(depth + 1, MAX_JSON_DEPTH);
+            AddToken(tokens, maxTokens, tokenCount, start, 1, TOKEN_PUNCTUATION);
+            i++;
+        }
+        else if(c == L'}' || c == L']')
+        {
+            if(depth > 0)
+            {
+                depth--;
+            }
+            AddToken(tokens, maxTokens, tokenCount, start, 1, TOKEN_PUNCTUATION);
+            i++;
+        }
+        else if(c == L':' || c == L',')
+        {
+            AddToken(tokens, maxTokens, tokenCount, start, 1, TOKEN_PUNCTUATION);
+            i++;
+        }
+        else if(IsDigitChar(c) || (c == L'-' && i + 1 < length && IsDigitChar(line[i + 1])))
+        {
+            i++;
+            while(i < length && (IsDigitChar(line[i]) || line[i] == L'.' || line[i] == L'e' ||
+                line[i] == L'E' || line[i] == L'+' || line[i] == L'-'))
+            {
+                i++;
+            }
+            AddToken(tokens, maxTokens, tokenCount, start, i - start, TOKEN_NUMBER);
+        }
+        else if(IsWordChar(c))
+        {
+            while(i < length && IsWordChar(line[i]))
+            {
+                i++;
+            }
+            if((i - start == 4 && (!wcsncmp(line + start, L"true", 4) || !wcsncmp(line + start, L"null", 4))) ||
+                (i - start == 5 && !wcsncmp(line + start, L"false", 5)))
+            {
+                AddToken(tokens, maxTokens, tokenCount, start, i - start, TOKEN_KEYWORD);
+            }
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    return depth;
+}
+
+//
+// TokenizeJsonLine
+// The JSON lexer
+//
+DWORD TokenizeJsonLine(const WCHAR * line, DWORD length, DWORD state, TOKEN * tokens, DWORD maxTokens, DWORD * tokenCount)
+{
+    *tokenCount = 0;
+    return TokenizeJson(line, length, 0, state, tokens, maxTokens, tokenCount);
+}
+
+//
+// TokenizeLogLine
+// The log lexer. A line is a timestamp, a level, and a message that
+// may hold a JSON payload. The state is the depth of a JSON payload
+// that continues on the next lines. A line that starts with a
+// timestamp is always a new entry, which ends any payload.
+//
+DWORD TokenizeLogLine(const WCHAR * line, DWORD length, DWORD state, TOKEN * tokens, DWORD maxTokens, DWORD * tokenCount)
+{
+    DWORD i = 0;
+    DWORD timestampLength;
+    DWORD payloadStart;
+    DWORD levelStart;
+    DWORD levelLength;
+    int type;
+
+    *tokenCount = 0;
+
+    while(i < length && (line[i] == L' ' || line[i] == L'\t'))
+    {
+        i++;
+    }
+
+    timestampLength = MatchTimestamp(line, length, i);
+    if(timestampLength)
+    {
+        AddToken(tokens, maxTokens, tokenCount, i, timestampLength, TOKEN_TIMESTAMP);
+        i += timestampLength;
+        state = LEXER_STATE_INITIAL;
+    }
+    else if(state != LEXER_STATE_INITIAL)
+    {
+        // The line continues a payload from an earlier line
+        return TokenizeJson(line, length, i, state, tokens, maxTokens, tokenCount);
+    }
+
+    // Only the first level name before the payload is highlighted,
+    // so a level named in the message isn't mistaken for the entry's
+    payloadStart = FindLogPayload(line, length, i);
+    type = FindLogLevel(line, i, payloadStart, &levelStart, &levelLength);
+    if(type != TOKEN_TEXT)
+    {
+        AddToken(tokens, maxTokens, tokenCount, levelStart, levelLength, type);
+    }
+
+    return TokenizeJson(line, length, payloadStart, LEXER_STATE_INITIAL, tokens, maxTokens, tokenCount);
+}
+
+//
+// GetLogLexer
+//
+const LEXER * GetLogLexer(void)
+{
+    return &g_logLexer;
+}
+
+//
+// GetJsonLexer
+//
+const LEXER * GetJsonLexer(void)
+{
+    return &g_jsonLexer;
+}
+
+//
+// InitHighlightCache
+// Empties the cache and sets the lexer used to fill it
+//
+void InitHighlightCache(HIGHLIGHT_CACHE * cache, const LEXER * lexer)
+{
+    cache->lexer = lexer;
+    cache->firstLine = 0;
+    cache->stateCount = 0;
+}
+
+//
+// GetHighlightLineState
+// Returns the state that line starts in. Lines are tokenized forward
+// from the nearest known state. When that's more than HIGHLIGHT_SYNC_LINES
+// away, the cache starts over that many lines before line, assuming the
+// initial state there, so a jump to the middle of a large file only
+// tokenizes a few lines. Log entries start with a timestamp, which resets
+// the state, so the guess is almost always right by the time line is reached.
+//
+DWORD GetHighlightLineState(HIGHLIGHT_CACHE * cache, DWORD line, GET_LINE_TEXT getLineText, void * context)
+{
+    DWORD shift;
+    DWORD index;
+    DWORD tokenCount;
+    const WCHAR * text;
+    DWORD length;
+
+    // Only a line past the last known state can be too far from it.
+    // Lines inside the cached window already have their states.
+    if(cache->stateCount == 0 || line < cache->firstLine ||
+        (line >= cache->firstLine + cache->stateCount &&
+        line - (cache->firstLine + cache->stateCount - 1) > HIGHLIGHT_SYNC_LINES))
+    {
+        cache->firstLine = line > HIGHLIGHT_SYNC_LINES ? line - HIGHLIGHT_SYNC_LINES : 0;
+        cache->states[0] = LEXER_STATE_INITIAL;
+        cache->stateCount = 1;
+    }
+    else if(line - cache->firstLine >= HIGHLIGHT_CACHE_LINES)
+    {
+        // Slide the window down, with some room to spare so it
+        // doesn't have to move again for every line scrolled
+        shift = line - cache->firstLine - HIGHLIGHT_CACHE_LINES + 1 + HIGHLIGHT_CACHE_LINES / 4;
+        if(shift < cache->stateCount)
+        {
+            memmove(cache->states, cache->states + shift, (cache->stateCount - shift) * sizeof(DWORD));
+            cache->firstLine += shift;
+            cache->stateCount -= shift;
+        }
+        else
+        {
+            cache->firstLine = line - HIGHLIGHT_SYNC_LINES;
+            cache->states[0] = LEXER_STATE_INITIAL;
+            cache->stateCount = 1;
+        }
+    }
+
+    while(cache->stateCount <= line - cache->firstLine)
+    {
+        index = cache->stateCount - 1;
+        if(!getLineText(context, cache->firstLine + index, &text, &length))
+        {
+            return cache->states[index];
+        }
+
+        cache->states[index + 1] = cache->lexer->tokenizeLine(text, length, cache->states[index], NULL, 0, &tokenCount);
+        cache->stateCount++;
+    }
+
+    return cache->states[line - cache->firstLine];
+}
+
+//
+// TokenizeHighlightLine
+// Tokenizes line into tokens, and keeps the state the next line starts in.
+// Returns the number of tokens.
+//
+DWORD TokenizeHighlightLine(HIGHLIGHT_CACHE * cache, DWORD line, GET_LINE_TEXT getLineText, void * context,
+    TOKEN * tokens, DWORD maxTokens)
+{
+    DWORD state;
+    DWORD tokenCount = 0;
+    DWORD index;
+    const WCHAR * text;
+    DWORD length;
+
+    state = GetHighlightLineState(cache, line, getLineText, context);
+    if(!getLineText(context, line, &text, &length))
+    {
+        return 0;
+    }
+
+    state = cache->lexer->tokenizeLine(text, length, state, tokens, maxTokens, &tokenCount);
+
+    // The next visible line usually comes next, so save its state
+    index = line - cache->firstLine;
+    if(index + 1 == cache->stateCount && cache->stateCount < HIGHLIGHT_CACHE_LINES)
+    {
+        cache->states[cache->stateCount++] = state;
+    }
+
+    return tokenCount;
+}
+
+//
+// InvalidateHighlightCache
+// Updates the cache after the text from firstLine to lastLine was edited,
+// which changed the number of lines by lineDelta. The start state of
+// firstLine can't have changed. When the number of lines is the same,
+// the lines after the edit are tokenized again only until one starts in
+// the same state it did before, since every line after that will too.
+// Returns the last line whose start state changed, or HIGHLIGHT_ALL_LINES.
+//
+DWORD InvalidateHighlightCache(HIGHLIGHT_CACHE * cache, DWORD firstLine, DWORD lastLine, int lineDelta,
+    GET_LINE_TEXT getLineText, void * context)
+{
+    DWORD index;
+    DWORD state;
+    DWORD tokenCount;
+    const WCHAR * text;
+    DWORD length;
+
+    if(cache->stateCount == 0)
+    {
+        return HIGHLIGHT_ALL_LINES;
+    }
+
+    if(firstLine < cache->firstLine)
+    {
+        // The cached lines might have moved or changed, so start over
+        cache->stateCount = 0;
+        return HIGHLIGHT_ALL_LINES;
+    }
+
+    index = firstLine - cache->firstLine;
+    if(index >= cache->stateCount)
+    {
+        // Nothing after the edit was cached
+        return lastLine;
+    }
+
+    if(lineDelta != 0)
+    {
+        // The lines after the edit moved, so their states don't line up anymore
+        cache->stateCount = index + 1;
+        return HIGHLIGHT_ALL_LINES;
+    }
+
+    while(index + 1 < cache->stateCount)
+    {
+        if(!getLineText(context, cache->firstLine + index, &text, &length))
+        {
+            cache->stateCount = index + 1;
+            return HIGHLIGHT_ALL_LINES;
+        }
+
+        state = cache->lexer->tokenizeLine(text, length, cache->states[index], NULL, 0, &tokenCount);
+        index++;
+
+        if(state == cache->states[index] && cache->firstLine + index > lastLine)
+        {
+            return cache->firstLine + index - 1;
+        }
+        cache->states[index] = state;
+    }
+
+    // The states never converged, so the lines past the cache may be painted wrong
+    return HIGHLIGHT_ALL_LINES;
+}
@@ -0,0 +1,168 @@
+/* -------------------------------------------------------------
+
+lines.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the Edit > Transform commands, which sort, remove
+    duplicates from, or trim the selected lines.
+
+    Sorting moves line numbers rather than text, and is split across
+    threads by SortLinesInParallel in the core.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <windows.h>
+#include "esnpad.h"
+
+extern HWND g_hwndMain;
+extern HWND g_hwndEdit;
+
+//
+// OrderLines
+// Returns the line numbers of the lines in a line table in the order
+// the sort command puts them, which is one of the IDM_EDIT_ Transform
+// commands. lineCount is updated to the number of lines that are kept.
+// The order is in scratch memory. Returns NULL if there wasn't enough memory.
+//
+DWORD * OrderLines(int command, LPCWSTR text, const DWORD * lineStarts, DWORD * lineCount)
+{
+    DWORD * order;
+    DWORD * temp;
+    BYTE * keep;
+    DWORD i;
+
+    order = ScratchAlloc((size_t)*lineCount * sizeof(DWORD));
+    temp = ScratchAlloc((size_t)*lineCount * sizeof(DWORD));
+    if(!order || !temp)
+    {
+        return NULL;
+    }
+
+    for(i = 0; i < *lineCount; i++)
+    {
+        order[i] = i;
+    }
+
+    SortLinesInParallel(text, lineStarts, order, temp, *lineCount);
+
+    if(command == IDM_EDIT_SORT_UNIQUE)
+    {
+        *lineCount = RemoveAdjacentDuplicates(text, lineStarts, order, *lineCount);
+    }
+    else if(command == IDM_EDIT_REMOVE_DUPLICATES)
+    {
+        keep = ScratchAlloc(*lineCount);
+        if(!keep)
+        {
+            return NULL;
+        }
+
+        *lineCount = RemoveLaterDuplicates(text, lineStarts, order, *lineCount, keep, temp);
+        order = temp;
+    }
+
+    return order;
+}
+
+//
+// MainWndOnEditTransform
+// Handles the Edit > Transform commands. They change the selected lines,
+// or every line when nothing is selected. The lines are replaced with
+// one EM_REPLACESEL, so the whole transform is a single undo.
+//
+void MainWndOnEditTransform(int command)
+{
+    HLOCAL hText;
+    LPCWSTR text;
+    DWORD textLength;
+    DWORD selStart = 0;
+    DWORD selEnd = 0;
+    DWORD spanStart = 0;
+    DWORD spanEnd = 0;
+    DWORD lineCount;
+    DWORD * lineStarts;
+    DWORD * order;
+    WCHAR * output = NULL;
+    size_t outputLength = 0;
+    TRACE_SCOPE scope = {0};
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    hText = (HLOCAL)SendMessage(g_hwndEdit, EM_GETHANDLE, 0, 0);
+    text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+    if(!text)
+    {
+        ScratchEnd(scratch);
+        return;
+    }
+
+    TRACE_BEGIN(scope, "transform lines");
+
+    textLength = (DWORD)GetWindowTextLength(g_hwndEdit);
+    SendMessage(g_hwndEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+    if(selStart == selEnd)
+    {
+        // Leave a final line break where it is, rather than sorting an empty line to the top
+        spanEnd = textLength;
+        if(spanEnd >= 2 && text[spanEnd - 1] == L'\n' && text[spanEnd - 2] == L'\r')
+        {
+            spanEnd -= 2;
+        }
+    }
+    else
+    {
+        GetSelectedLines(text, textLength, &spanStart, &spanEnd);
+    }
+
+    TRACE_BYTES(scope, (spanEnd - spanStart) * sizeof(WCHAR));
+
+    lineCount = CountTextLines(text + spanStart, spanEnd - spanStart);
+    lineStarts = ScratchAlloc(((size_t)lineCount + 1) * sizeof(DWORD));
+    if(lineStarts)
+    {
+        FillLineTable(text + spanStart, spanEnd - spanStart, lineStarts);
+
+        if(command == IDM_EDIT_TRIM_WHITESPACE)
+        {
+            outputLength = TrimTrailingWhitespace(text + spanStart, lineStarts, lineCount, NULL);
+            output = ScratchAlloc((outputLength + 1) * sizeof(WCHAR));
+            if(output)
+            {
+                TrimTrailingWhitespace(text + spanStart, lineStarts, lineCount, output);
+            }
+        }
+        else
+        {
+            order = OrderLines(command, text + spanStart, lineStarts, &lineCount);
+            if(order)
+            {
+                outputLength = WriteLinesInOrder(text + spanStart, lineStarts, order, lineCount, NULL);
+                output = ScratchAlloc((outputLength + 1) * sizeof(WCHAR));
+                if(output)
+                {
+                    WriteLinesInOrder(text + spanStart, lineStarts, order, lineCount, output);
+                }
+            }
+        }
+
+        if(output)
+        {
+            output[outputLength] = 0;
+        }
+    }
+
+    LocalUnlock(hText);
+
+    if(output)
+    {
+        SendMessage(g_hwndEdit, EM_SETSEL, spanStart, spanEnd);
+        SendMessageW(g_hwndEdit, EM_REPLACESEL, TRUE, (LPARAM)output);
+        SendMessage(g_hwndEdit, EM_SETSEL, spanStart, spanStart + outputLength);
+    }
+    else
+    {
+        MessageBox(g_hwndMain, L"Unable to transform the lines.", APP_TITLE_W, MB_OK | MB_ICONERROR);
+    }
+
+    ScratchEnd(scratch);
+    TRACE_END(scope);
+}
@@ -26,6 +26,13 @@ LPWSTR g_cmdLineFile = NULL;
 BOOL g_dirtyText = FALSE;   // "dirty" means text changes haven't been saved
 
 extern WCHAR g_activeFile[MAX_PATH];
+extern FILE_FINGERPRINT g_activeFingerprint;
+extern int g_fileEncoding;
+extern BOOL g_compressedFile;
+extern BOOL g_showControlChars;
+extern int g_lineEnding;
+extern BOOL g_mixedLineEndings;
+extern HWND g_hwndFindFiles;
 
 
 //
@@ -44,9 +51,25 @@ int WINAPI WinMain(
     int argc = 0;
     LPWSTR * argv = NULL;
 
+    // Turn on tracing, if it was requested, before the first startup
+    // phase, so that every phase is traced
+    InitTrace();
+
+    // Start the clock for the startup phase timings
+    LogStartupPhase("startup: WinMain");
+
     // Get the command line args
     argv = CommandLineToArgvW(GetCommandLineW(), &argc);
-    if((argc > 1) && PathFileExistsW(argv[1]))
+    if((argc > 1) && GetCommandLineCommand(argv[1]) != CLI_COMMAND_NONE)
+    {
+        // Commands like /convert run without a window, and write to
+        // the console the app was started from
+        AttachConsole(ATTACH_PARENT_PROCESS);
+        int commandExitCode = RunCommandLineCommand(argc, argv);
+        WriteTraceFile();
+        return commandExitCode;
+    }
+    else if((argc > 1) && PathFileExistsW(argv[1]))
     {
         // The first arg can be a text file name to open
         g_cmdLineFile = argv[1];
@@ -64,6 +87,8 @@ int WINAPI WinMain(
         return -1;
     }
 
+    LogStartupPhase("startup: InitApp");
+
     // Create the window and display it
     if(!InitWindow(nShowCmd))
     {
@@ -74,7 +99,15 @@ int WINAPI WinMain(
     }
 
     // run the message loop
-    return MsgLoop();
+    int exitCode = MsgLoop();
+
+    // The windows are gone, so the GDI objects they used can be freed
+    FreeThemeResources();
+
+    // Write out the trace, if tracing is on
+    WriteTraceFile();
+
+    return exitCode;
 }
 
 //
@@ -84,15 +117,6 @@ int WINAPI WinMain(
 BOOL InitApp()
 {
     WNDCLASSEX wc;
-    INITCOMMONCONTROLSEX icc;
-
-    // Ensure that comctl32.dll is loaded, register status bar control class
-    icc.dwSize = sizeof(icc);
-    icc.dwICC = ICC_BAR_CLASSES;
-    if(!InitCommonControlsEx(&icc))
-    {
-        return FALSE;
-    }
 
     // Describe the main window with the window class structure
     ZeroMemory(&wc, sizeof(wc));
@@ -144,27 +168,29 @@ BOOL InitWindow(int nCmdShow)
     // make the window visible
     ShowWindow(g_hwndMain, nCmdShow);
 
-    return TRUE;
-}
+    // Paint the window and its edit control now, rather than
+    // waiting for the message queue to empty out.
+    RedrawWindow(g_hwndMain, NULL, NULL, RDW_UPDATENOW|RDW_ALLCHILDREN);
+    LogStartupPhase("startup: first paint");
 
-//
-// CreateScaledFont
-// Helper function to create scaled font based on DPI
-//
-HFONT CreateScaledFont(UINT dpi)
-{
-    int scaledHeight = MulDiv(18, dpi, 96); // Base font size of 18
-    return CreateFont(scaledHeight, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
-                     DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-                     DEFAULT_QUALITY, DEFAULT_PITCH|FF_DONTCARE, NULL);
+    // Finish the rest of startup from the message loop.
+    PostMessage(g_hwndMain, WM_APP_STARTUP, 0, 0);
+
+    return TRUE;
 }
 
 //
 // MainWndOnCreate
 // Handles WM_CREATE for the main window
+// Only the edit control is created here. Everything else
+// waits for WM_APP_STARTUP, after the window has painted.
 //
 LRESULT MainWndOnCreate(HWND hwnd)
 {
+    // Start with the theme that the menu says is selected
+    LoadThemesFromFile();
+    SetDarkMode(GetMenuState(GetMenu(hwnd), IDM_VIEW_DARKMODE, MF_BYCOMMAND) & MF_CHECKED);
+
     // Create the edit control window
     if(!CreateEditControl(hwnd, TRUE))
     {
@@ -172,6 +198,26 @@ LRESULT MainWndOnCreate(HWND hwnd)
         return -1;
     }
 
+    return 0;
+}
+
+//
+// CreateStatusBar
+// Loads the common controls and creates the status bar control
+//
+BOOL CreateStatusBar(HWND hwnd)
+{
+    INITCOMMONCONTROLSEX icc;
+    RECT rectClient;
+
+    // Ensure that comctl32.dll is loaded, register status bar control class
+    icc.dwSize = sizeof(icc);
+    icc.dwICC = ICC_BAR_CLASSES;
+    if(!InitCommonControlsEx(&icc))
+    {
+        return FALSE;
+    }
+
     // Create the status bar control
     g_hwndStatus = CreateWindowEx(0, STATUSCLASSNAME, NULL,
         WS_VISIBLE|WS_CHILD|SBARS_SIZEGRIP,
@@ -179,13 +225,39 @@ LRESULT MainWndOnCreate(HWND hwnd)
 
     if(!g_hwndStatus)
     {
-        // -1 indicates WM_CREATE failure
-        return -1;
+        return FALSE;
     }
 
+    // Make room for the status bar below the edit control
+    GetClientRect(hwnd, &rectClient);
+    SendMessage(hwnd, WM_SIZE, SIZE_RESTORED, MAKELPARAM(rectClient.right, rectClient.bottom));
+    RequestStatusUpdate();
+
+    return TRUE;
+}
+
+//
+// MainWndOnStartup
+// Handles WM_APP_STARTUP for the main window by creating
+// the status bar and loading the command line file.
+//
+LRESULT MainWndOnStartup(HWND hwnd)
+{
+    if(!CreateStatusBar(hwnd))
+    {
+        // The app still works without a status bar.
+        DebugLog(L"Unable to create the status bar");
+    }
+
+    LogStartupPhase("startup: status bar");
+
+    // Journal unsaved edits in the background, so they survive a crash
+    SetTimer(hwnd, IDT_AUTOSAVE, AUTOSAVE_INTERVAL_MS, NULL);
+
     if(g_cmdLineFile)
     {
         SetEditTextFromFile(g_cmdLineFile);
+        LogStartupPhase("startup: file loaded");
     }
 
     return 0;
@@ -197,22 +269,29 @@ LRESULT MainWndOnCreate(HWND hwnd)
 //
 LRESULT MainWndOnResize(int width, int height)
 {
-    if(g_hwndEdit && g_hwndStatus)
+    if(g_hwndEdit)
     {
         RECT rectStatus;
-        int heightEdit;
+        int heightEdit = height;
 
-        // Set the status bar size
-        SendMessage(g_hwndStatus, WM_SIZE, SIZE_RESTORED, 0);
+        // The status bar doesn't exist until startup is complete
+        if(g_hwndStatus)
+        {
+            // Set the status bar size, and the size of its parts
+            SendMessage(g_hwndStatus, WM_SIZE, SIZE_RESTORED, 0);
+            LayoutStatusBar(width);
 
-        // Get the status bar window rectangle
-        GetWindowRect(g_hwndStatus, &rectStatus);
+            // Get the status bar window rectangle
+            GetWindowRect(g_hwndStatus, &rectStatus);
 
-        // Calculate the height of the edit control
-        heightEdit = height - (rectStatus.bottom - rectStatus.top);
+            // Calculate the height of the edit control
+            heightEdit = height - (rectStatus.bottom - rectStatus.top);
+        }
 
-        // Resize the edit control
+        // Resize the edit control, and the hex view that takes its place
         MoveWindow(g_hwndEdit, 0, 0, width, heightEdit, TRUE);
+        MoveHexView(width, heightEdit);
+        MoveFilterView(width, heightEdit);
     }
 
     return 0;
@@ -236,12 +315,14 @@ BOOL ConfirmSaveChanges(void)
     }
 
     // Allocate a buffer to hold the prompt message
-    LPWSTR prompt = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, CB_PROMPT_MESSAGE);
+    SCRATCH_MARK scratch = ScratchBegin();
+    LPWSTR prompt = ScratchAlloc(CB_PROMPT_MESSAGE);
 
     if(!prompt)
     {
         // If we can't allocate memory, just return TRUE.
         // The caller should continue as usual.
+        ScratchEnd(scratch);
         return TRUE;
     }
 
@@ -265,12 +346,13 @@ BOOL ConfirmSaveChanges(void)
         APP_TITLE_W, MB_YESNOCANCEL|MB_ICONQUESTION|MB_DEFBUTTON1|MB_APPLMODAL);
 
     // Free the memory we allocated for the prompt message
-    HeapFree(GetProcessHeap(), 0, prompt);
+    ScratchEnd(scratch);
 
     if(result == IDYES)
     {
-        // The user wants to save
+        // The user wants to save. If the save didn't happen, keep the changes.
         MainWndOnFileSave();
+        return !g_dirtyText;
     }
 
     return (result != IDCANCEL);
@@ -286,8 +368,9 @@ BOOL ConfirmSaveChanges(void)
 void UpdateTitleDirtyIndicator(void)
 {
     // Allocate buffers to hold the old and new window titles.
-    LPWSTR oldWindowTitle = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, CB_WINDOW_TITLE);
-    LPWSTR newWindowTitle = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, CB_WINDOW_TITLE);
+    SCRATCH_MARK scratch = ScratchBegin();
+    LPWSTR oldWindowTitle = ScratchAlloc(CB_WINDOW_TITLE);
+    LPWSTR newWindowTitle = ScratchAlloc(CB_WINDOW_TITLE);
     if(oldWindowTitle && newWindowTitle)
     {
         // Get the current main window title as the "old" window title
@@ -314,16 +397,8 @@ void UpdateTitleDirtyIndicator(void)
         }
     }
 
-    // Free memory if needed.
-    if(oldWindowTitle)
-    {
-        HeapFree(GetProcessHeap(), 0, oldWindowTitle);
-    }
-
-    if(newWindowTitle)
-    {
-        HeapFree(GetProcessHeap(), 0, newWindowTitle);
-    }
+    // Free the title buffers
+    ScratchEnd(scratch);
 
     return;
 }
@@ -333,6 +408,19 @@ void UpdateTitleDirtyIndicator(void)
 //
 void EditControlOnCommand(int code)
 {
+    // Any change needs to be journaled on the next autosave
+    if(code == EN_CHANGE)
+    {
+        RecoveryTextChanged();
+        HighlightTextChanged();
+
+        // The filtered line offsets may not match the text anymore
+        HideFilterView();
+
+        // The caret moves with the text, and the selection is gone
+        RequestStatusUpdate();
+    }
+
     // When the text of the edit control changes, make it as dirty
     // (meaning it isn't in sync with the active file), and update
     // the main window title to show dirty indicator. We only need
@@ -354,6 +442,7 @@ void EditControlOnCommand(int code)
 void MainWndOnFileNew(void)
 {
     // Clear the edit control
+    HideFilterView();
     SetWindowText(g_hwndEdit, L"");
 
     // Set the app title back to the default (no filename or dirty indicator)
@@ -362,8 +451,22 @@ void MainWndOnFileNew(void)
     // The text isn't dirty, since there is none.
     g_dirtyText = FALSE;
 
-    // There is no active file.
+    // New text isn't journaled until it has a file
+    DiscardRecoveryJournal();
+    SetRecoveryBaseline(NULL, 0, 0);
+
+    // There is no active file, so nothing it was read with carries over.
     ZeroMemory(g_activeFile, sizeof(g_activeFile));
+    ZeroMemory(&g_activeFingerprint, sizeof(g_activeFingerprint));
+    g_fileEncoding = ENCODING_UNSPECIFIED;
+    g_compressedFile = FALSE;
+    RefreshHexView();
+    SelectHighlightLexer(g_activeFile);
+
+    // New text uses the edit control's own line endings.
+    g_lineEnding = LINE_ENDING_CRLF;
+    g_mixedLineEndings = FALSE;
+    RequestStatusUpdate();
 
     return;
 }
@@ -403,29 +506,114 @@ void MainWndOnViewWordWrap(void)
 //
 // MainWndOnViewDarkMode
 // Handles IDM_VIEW_DARKMODE by toggling the check box on the menu,
-// and updating the edit control colors.
+// and switching the edit control to the new theme.
 //
 void MainWndOnViewDarkMode(void)
 {
     HMENU hMenu = GetMenu(g_hwndMain);
     UINT darkModeMenuState = GetMenuState(hMenu, IDM_VIEW_DARKMODE, MF_BYCOMMAND);
-    UINT wordWrapState = GetMenuState(hMenu, IDM_VIEW_WORDWRAP, MF_BYCOMMAND);
 
     if (darkModeMenuState & MF_CHECKED)
     {
         // Dark mode is on, turn it off in the menu
-        CheckMenuItem(GetMenu(g_hwndMain), IDM_VIEW_DARKMODE, MF_UNCHECKED);
+        CheckMenuItem(hMenu, IDM_VIEW_DARKMODE, MF_UNCHECKED);
+        SetDarkMode(FALSE);
     }
     else
     {
         // Dark mode is off, turn it on in the menu
-        CheckMenuItem(GetMenu(g_hwndMain), IDM_VIEW_DARKMODE, MF_CHECKED);
+        CheckMenuItem(hMenu, IDM_VIEW_DARKMODE, MF_CHECKED);
+        SetDarkMode(TRUE);
     }
 
-    // Create a new edit control, preserving the current word wrap setting.
-    // This is necessary because we need to trigger another WM_CTLCOLOREDIT,
-    // which will set the new colors based on the new dark mode menu setting.
-    CreateEditControl(g_hwndMain, (wordWrapState & MF_CHECKED));
+    return;
+}
+
+//
+// MainWndOnViewControlChars
+// Handles IDM_VIEW_CONTROL_CHARS by toggling the check box on the menu.
+// Control characters are replaced when a file is decoded, so the
+// active file is loaded again to show the change, unless that
+// would throw away unsaved edits.
+//
+void MainWndOnViewControlChars(void)
+{
+    HMENU hMenu = GetMenu(g_hwndMain);
+    UINT controlCharsState = GetMenuState(hMenu, IDM_VIEW_CONTROL_CHARS, MF_BYCOMMAND);
+
+    g_showControlChars = !(controlCharsState & MF_CHECKED);
+    CheckMenuItem(hMenu, IDM_VIEW_CONTROL_CHARS, g_showControlChars ? MF_CHECKED : MF_UNCHECKED);
+
+    if(g_activeFile[0] != 0 && !g_dirtyText)
+    {
+        // Loading a file resets g_activeFile, so pass a copy of the path
+        WCHAR filePath[MAX_PATH];
+        if(SUCCEEDED(StringCchCopyW(filePath, MAX_PATH, g_activeFile)))
+        {
+            // Forget the fingerprint, so the unchanged file is decoded again
+            ZeroMemory(&g_activeFingerprint, sizeof(g_activeFingerprint));
+            SetEditTextFromFile(filePath);
+        }
+    }
+
+    return;
+}
+
+//
+// MainWndOnViewHighlight
+// Handles IDM_VIEW_HIGHLIGHT by toggling the check box on the menu,
+// and turning syntax highlighting on or off.
+//
+void MainWndOnViewHighlight(void)
+{
+    HMENU hMenu = GetMenu(g_hwndMain);
+    BOOL highlight = !(GetMenuState(hMenu, IDM_VIEW_HIGHLIGHT, MF_BYCOMMAND) & MF_CHECKED);
+
+    CheckMenuItem(hMenu, IDM_VIEW_HIGHLIGHT, highlight ? MF_CHECKED : MF_UNCHECKED);
+    SetHighlighting(highlight);
+
+    return;
+}
+
+//
+// MainWndOnViewFilterLevels
+// Handles IDM_VIEW_FILTER_LEVELS by showing only the error and
+// warning lines in the filter view, or going back to all of the text.
+//
+void MainWndOnViewFilterLevels(void)
+{
+    FILTER filter = {0};
+
+    if(IsFilterViewVisible())
+    {
+        HideFilterView();
+    }
+    else
+    {
+        filter.type = FILTER_LEVELS;
+        ShowFilterView(g_hwndMain, &filter);
+    }
+
+    return;
+}
+
+//
+// MainWndOnViewHex
+// Handles IDM_VIEW_HEX by toggling the check box on the menu,
+// and switching between the edit control and the hex view.
+//
+void MainWndOnViewHex(void)
+{
+    HMENU hMenu = GetMenu(g_hwndMain);
+    BOOL showHex = !(GetMenuState(hMenu, IDM_VIEW_HEX, MF_BYCOMMAND) & MF_CHECKED);
+
+    // The hex view takes the edit control's place, so it replaces the filter view too
+    HideFilterView();
+
+    if(ShowHexView(g_hwndMain, showHex))
+    {
+        CheckMenuItem(hMenu, IDM_VIEW_HEX, showHex ? MF_CHECKED : MF_UNCHECKED);
+    }
 
     return;
 }
@@ -437,8 +625,9 @@ void MainWndOnViewDarkMode(void)
 LRESULT MainWndOnDpiChanged(int dpiY, RECT * pWindowRect)
 {
     // Set the edit control font based on the new DPI
-    HFONT hFont = CreateScaledFont(dpiY);
+    HFONT hFont = GetEditFont(dpiY);
     SendMessage(g_hwndEdit, WM_SETFONT, (WPARAM)hFont, TRUE);
+    SetFilterViewFont(hFont);
 
     // Resize the window to match the new DPI
     SetWindowPos(g_hwndMain, NULL, pWindowRect->left, pWindowRect->top,
@@ -483,6 +672,18 @@ LRESULT MainWndOnCommand(HWND hwnd, int id, int code)
     case IDM_VIEW_DARKMODE:
         MainWndOnViewDarkMode();
         break;
+    case IDM_VIEW_CONTROL_CHARS:
+        MainWndOnViewControlChars();
+        break;
+    case IDM_VIEW_HIGHLIGHT:
+        MainWndOnViewHighlight();
+        break;
+    case IDM_VIEW_FILTER_LEVELS:
+        MainWndOnViewFilterLevels();
+        break;
+    case IDM_VIEW_HEX:
+        MainWndOnViewHex();
+        break;
     case IDM_EDIT_UNDO:
         SendMessage(g_hwndEdit, EM_UNDO, 0, 0);
         break;
@@ -504,9 +705,24 @@ LRESULT MainWndOnCommand(HWND hwnd, int id, int code)
     case IDC_EDIT:
         EditControlOnCommand(code);
         break;
+    case IDC_FILTER:
+        FilterViewOnCommand(code);
+        break;
     case IDM_EDIT_FIND:
         MainWndOnEditFind();
         break;
+    case IDM_EDIT_FIND_IN_FILES:
+        MainWndOnEditFindInFiles();
+        break;
+    case IDM_EDIT_COLUMN:
+        MainWndOnEditColumn();
+        break;
+    case IDM_EDIT_SORT:
+    case IDM_EDIT_SORT_UNIQUE:
+    case IDM_EDIT_REMOVE_DUPLICATES:
+    case IDM_EDIT_TRIM_WHITESPACE:
+        MainWndOnEditTransform(id);
+        break;
     }
 
     return 0;
@@ -529,6 +745,9 @@ LRESULT CALLBACK MainWndProc(
     case WM_CREATE:
         result = MainWndOnCreate(hwnd);
         break;
+    case WM_APP_STARTUP:
+        result = MainWndOnStartup(hwnd);
+        break;
     case WM_SIZE:
         result = MainWndOnResize((int)LOWORD(lparam), (int)HIWORD(lparam));
         break;
@@ -538,6 +757,19 @@ LRESULT CALLBACK MainWndProc(
     case WM_CTLCOLOREDIT:
         result = MainWndOnControlColorEdit((HDC)wparam);
         break;
+    case WM_DRAWITEM:
+        result = MainWndOnDrawItem((DRAWITEMSTRUCT *)lparam);
+        break;
+    case WM_VKEYTOITEM:
+        result = MainWndOnVKeyToItem((HWND)lparam, (int)LOWORD(wparam));
+        break;
+    case WM_ACTIVATEAPP:
+        // Another program may have changed the file while we were in the background
+        if(wparam)
+        {
+            CheckActiveFileOnDisk();
+        }
+        break;
     case WM_DPICHANGED:
         result = MainWndOnDpiChanged(HIWORD(wparam), (RECT *)lparam);
         break;
@@ -547,7 +779,21 @@ LRESULT CALLBACK MainWndProc(
             DestroyWindow(hwnd); // if the main window is closed, destroy it
         }
         break;
+    case WM_TIMER:
+        if(wparam == IDT_AUTOSAVE)
+        {
+            AutosaveRecoveryJournal();
+        }
+        else if(wparam == IDT_STATUS_UPDATE)
+        {
+            MainWndOnStatusTimer(hwnd);
+        }
+        break;
     case WM_DESTROY:
+        // Unsaved edits were saved or thrown away when the window closed
+        KillTimer(hwnd, IDT_AUTOSAVE);
+        KillTimer(hwnd, IDT_STATUS_UPDATE);
+        DiscardRecoveryJournal();
         PostQuitMessage(0); // quit the program by posting a WM_QUIT
         break;
     default:
@@ -574,6 +820,12 @@ int MsgLoop(void)
             continue;
         }
 
+        // and the modeless Find in Files dialog
+        if(g_hwndFindFiles && IsDialogMessage(g_hwndFindFiles, &msg))
+        {
+            continue;
+        }
+
         if(!TranslateAccelerator(g_hwndMain, hAccelTable, &msg))
         {
             TranslateMessage(&msg); // translate WM_KEYDOWN to WM_CHAR
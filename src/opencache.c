@@ -0,0 +1,202 @@
+/* -------------------------------------------------------------
+
+opencache.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the open cache, which remembers what decoding a large
+    file found out: its encoding, the length of its text, and its
+    line endings. It's kept in a small file between sessions, keyed
+    by the file's path and fingerprint, so opening a log again
+    skips the scans that found those out.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// HashFilePath
+// Computes a 32-bit FNV-1a hash of a path, the same for
+// any case of the ASCII letters in it, like paths on Windows
+//
+DWORD HashFilePath(LPCWSTR filePath)
+{
+    DWORD hash = 2166136261;
+
+    for(LPCWSTR c = filePath; *c; c++)
+    {
+        WCHAR lower = (*c >= L'A' && *c <= L'Z') ? (WCHAR)(*c - L'A' + L'a') : *c;
+
+        hash ^= (BYTE)lower;
+        hash *= 16777619;
+        hash ^= (BYTE)(lower >> 8);
+        hash *= 16777619;
+    }
+
+    return hash;
+}
+
+//
+// InitOpenCache
+// Empties cache
+//
+void InitOpenCache(OPEN_CACHE * cache)
+{
+    ZeroMemory(cache, sizeof(*cache));
+}
+
+//
+// ReadOpenCache
+// Reads the open cache from cacheFile. If it doesn't exist, is from
+// another version, or was only partly written, cache is left empty
+// and FALSE is returned.
+//
+BOOL ReadOpenCache(LPCWSTR cacheFile, OPEN_CACHE * cache)
+{
+    BOOL success = FALSE;
+    HANDLE hFile;
+    OPEN_CACHE_HEADER header;
+    DWORD entriesSize;
+    DWORD bytesRead = 0;
+    BYTE extra;
+
+    InitOpenCache(cache);
+
+    hFile = CreateFile(cacheFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    if(ReadFile(hFile, &header, sizeof(header), &bytesRead, NULL) && bytesRead == sizeof(header) &&
+        header.magic == OPEN_CACHE_MAGIC && header.version == OPEN_CACHE_VERSION &&
+        header.entryCount <= OPEN_CACHE_ENTRIES)
+    {
+        entriesSize = header.entryCount * sizeof(OPEN_CACHE_ENTRY);
+
+        // The file must hold exactly the entries its header says it does
+        success = ReadFile(hFile, cache->entries, entriesSize, &bytesRead, NULL) && bytesRead == entriesSize &&
+            ReadFile(hFile, &extra, sizeof(extra), &bytesRead, NULL) && bytesRead == 0 &&
+            HashBytes((const BYTE *)cache->entries, entriesSize) == header.checksum;
+    }
+
+    CloseHandle(hFile);
+
+    if(!success)
+    {
+        InitOpenCache(cache);
+        return FALSE;
+    }
+
+    cache->useCount = header.useCount;
+    cache->entryCount = header.entryCount;
+    return TRUE;
+}
+
+//
+// WriteOpenCache
+// Writes the open cache to cacheFile, replacing what was there.
+// A write that doesn't finish leaves a file that ReadOpenCache ignores.
+//
+BOOL WriteOpenCache(LPCWSTR cacheFile, const OPEN_CACHE * cache)
+{
+    BOOL success;
+    HANDLE hFile;
+    OPEN_CACHE_HEADER header;
+    DWORD entriesSize = cache->entryCount * sizeof(OPEN_CACHE_ENTRY);
+    DWORD bytesWritten = 0;
+
+    header.magic = OPEN_CACHE_MAGIC;
+    header.version = OPEN_CACHE_VERSION;
+    header.useCount = cache->useCount;
+    header.entryCount = cache->entryCount;
+    header.checksum = HashBytes((const BYTE *)cache->entries, entriesSize);
+
+    hFile = CreateFile(cacheFile, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    success = WriteFile(hFile, &header, sizeof(header), &bytesWritten, NULL) && bytesWritten == sizeof(header) &&
+        WriteFile(hFile, cache->entries, entriesSize, &bytesWritten, NULL) && bytesWritten == entriesSize;
+
+    CloseHandle(hFile);
+
+    if(!success)
+    {
+        DeleteFile(cacheFile);
+    }
+
+    return success;
+}
+
+//
+// FindOpenCacheEntry
+// Looks for what the cache knows about filePath, as long as the file
+// still has the same fingerprint, and returns it in info.
+// An entry that's found counts as used, so it's kept longer.
+//
+BOOL FindOpenCacheEntry(OPEN_CACHE * cache, LPCWSTR filePath, const FILE_FINGERPRINT * fingerprint,
+    DOCUMENT_INFO * info)
+{
+    DWORD pathHash = HashFilePath(filePath);
+
+    for(DWORD i = 0; i < cache->entryCount; i++)
+    {
+        OPEN_CACHE_ENTRY * entry = &cache->entries[i];
+
+        if(entry->pathHash == pathHash && FingerprintsMatch(&entry->fingerprint, fingerprint))
+        {
+            entry->lastUsed = ++cache->useCount;
+            *info = entry->info;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+//
+// AddOpenCacheEntry
+// Remembers info for filePath with the specified fingerprint. It
+// replaces what the cache knew about the path before. When the cache
+// is full, the file that was used longest ago is forgotten.
+//
+void AddOpenCacheEntry(OPEN_CACHE * cache, LPCWSTR filePath, const FILE_FINGERPRINT * fingerprint,
+    const DOCUMENT_INFO * info)
+{
+    DWORD pathHash = HashFilePath(filePath);
+    OPEN_CACHE_ENTRY * entry = NULL;
+
+    for(DWORD i = 0; i < cache->entryCount && !entry; i++)
+    {
+        if(cache->entries[i].pathHash == pathHash)
+        {
+            entry = &cache->entries[i];
+        }
+    }
+
+    if(!entry && cache->entryCount < OPEN_CACHE_ENTRIES)
+    {
+        entry = &cache->entries[cache->entryCount++];
+    }
+
+    if(!entry)
+    {
+        entry = &cache->entries[0];
+        for(DWORD i = 1; i < cache->entryCount; i++)
+        {
+            if(cache->entries[i].lastUsed < entry->lastUsed)
+            {
+                entry = &cache->entries[i];
+            }
+        }
+    }
+
+    // Zeroed first, so the padding in the cache file is always the same
+    ZeroMemory(entry, sizeof(*entry));
+    entry->pathHash = pathHash;
+    entry->lastUsed = ++cache->useCount;
+    entry->fingerprint = *fingerprint;
+    entry->info = *info;
+}
@@ -0,0 +1,315 @@
+/* -------------------------------------------------------------
+
+platform.h
+   Essential Notepad - A basic Notepad implementation for Windows
+   The platform layer under the portable core.
+
+   On Windows this is windows.h. Everywhere else it declares the
+   small part of the Windows API the core uses, which
+   platform_posix.c implements, so the core builds unchanged and
+   can be tested and measured on Linux. The core must be built with
+   a 2-byte wchar_t there (-fshort-wchar), so L"" strings are UTF-16
+   like they are on Windows.
+
+   The functions at the end are what the core calls instead of
+   Windows directly, like running tasks on several threads at once.
+   platform_win32.c and platform_posix.c each implement them.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#ifndef _PLATFORM_H_
+#define _PLATFORM_H_
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <strsafe.h>
+
+// Thread local variables, like each thread's trace events
+#define THREAD_LOCAL __declspec(thread)
+
+// What command line options start with, and the line break of the
+// text commands write for people to read
+#define CLI_OPTION_CHAR L'/'
+#define NEWLINE_W L"\r\n"
+
+// What separates the folders and the file name in a path
+#define PATH_SEPARATOR_W L'\\'
+
+#else // _WIN32
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+
+_Static_assert(sizeof(wchar_t) == 2, "The core needs a 2-byte wchar_t. Build it with -fshort-wchar.");
+
+#define THREAD_LOCAL __thread
+
+// Paths start with a slash here, so command line options start with
+// a dash instead, and lines end with LF like other tools' output
+#define CLI_OPTION_CHAR L'-'
+#define NEWLINE_W L"\n"
+#define PATH_SEPARATOR_W L'/'
+
+// Types
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef LONG HRESULT;
+typedef uint32_t ULONG;
+typedef uint32_t UINT;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef size_t SIZE_T;
+typedef char CHAR;
+typedef wchar_t WCHAR;
+typedef WCHAR * LPWSTR;
+typedef const WCHAR * LPCWSTR;
+typedef char * LPSTR;
+typedef const char * LPCSTR;
+typedef const char * LPCCH;
+typedef void VOID;
+typedef void * LPVOID;
+typedef void * PVOID;
+typedef void * HANDLE;
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID param);
+
+typedef union _LARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+        LONG HighPart;
+    } u;
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct _FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME;
+
+#define TRUE  1
+#define FALSE 0
+#define WINAPI
+#define CALLBACK
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+#define MAXDWORD 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WAIT_FAILED 0xFFFFFFFF
+#define STILL_ACTIVE 259
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+
+// Standard input, output and error, for GetStdHandle
+#define STD_INPUT_HANDLE            ((DWORD)-10)
+#define STD_OUTPUT_HANDLE           ((DWORD)-11)
+#define STD_ERROR_HANDLE            ((DWORD)-12)
+
+// Results of the StringCch functions
+#define S_OK                        ((HRESULT)0)
+#define STRSAFE_E_INSUFFICIENT_BUFFER ((HRESULT)0x8007007A)
+#define STRSAFE_E_INVALID_PARAMETER ((HRESULT)0x80070057)
+#define SUCCEEDED(hr)               (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)                  (((HRESULT)(hr)) < 0)
+
+// Error codes, from GetLastError
+#define ERROR_SUCCESS               0
+#define ERROR_FILE_NOT_FOUND        2
+#define ERROR_PATH_NOT_FOUND        3
+#define ERROR_ACCESS_DENIED         5
+#define ERROR_INVALID_HANDLE        6
+#define ERROR_NO_MORE_FILES         18
+#define ERROR_NOT_ENOUGH_MEMORY     8
+#define ERROR_WRITE_FAULT           29
+#define ERROR_READ_FAULT            30
+#define ERROR_GEN_FAILURE           31
+#define ERROR_HANDLE_DISK_FULL      39
+#define ERROR_FILE_EXISTS           80
+#define ERROR_INVALID_PARAMETER     87
+#define ERROR_BROKEN_PIPE           109
+#define ERROR_INSUFFICIENT_BUFFER   122
+#define ERROR_ALREADY_EXISTS        183
+#define ERROR_ENVVAR_NOT_FOUND      203
+#define ERROR_NO_UNICODE_TRANSLATION 1113
+
+// CreateFile access, sharing, creation and flags
+#define GENERIC_READ                0x80000000
+#define GENERIC_WRITE               0x40000000
+#define FILE_SHARE_READ             0x00000001
+#define FILE_SHARE_WRITE            0x00000002
+#define FILE_SHARE_DELETE           0x00000004
+#define CREATE_NEW                  1
+#define CREATE_ALWAYS               2
+#define OPEN_EXISTING               3
+#define OPEN_ALWAYS                 4
+#define TRUNCATE_EXISTING           5
+#define FILE_ATTRIBUTE_HIDDEN       0x00000002
+#define FILE_ATTRIBUTE_NORMAL       0x00000080
+#define FILE_FLAG_WRITE_THROUGH     0x80000000
+#define FILE_FLAG_SEQUENTIAL_SCAN   0x08000000
+
+#define FILE_BEGIN                  0
+#define FILE_CURRENT                1
+#define FILE_END                    2
+
+#define MOVEFILE_REPLACE_EXISTING   0x00000001
+#define MOVEFILE_WRITE_THROUGH      0x00000008
+
+// Going through the entries of a folder
+#define FILE_ATTRIBUTE_DIRECTORY    0x00000010
+#define FILE_ATTRIBUTE_REPARSE_POINT 0x00000400
+#define FindExInfoBasic             1
+#define FindExSearchNameMatch       0
+#define FIND_FIRST_EX_LARGE_FETCH   0x00000002
+
+// An entry of a folder, from FindFirstFileExW or FindNextFileW.
+// Only the fields the core uses are here.
+typedef struct _WIN32_FIND_DATAW
+{
+    DWORD dwFileAttributes;
+    WCHAR cFileName[MAX_PATH];
+} WIN32_FIND_DATAW;
+
+typedef int FINDEX_INFO_LEVELS;
+typedef int FINDEX_SEARCH_OPS;
+
+// A lock that one thread holds at a time. A zeroed one is unlocked,
+// like SRWLOCK_INIT, and it never needs to be destroyed here.
+typedef pthread_mutex_t SRWLOCK;
+#define InitializeSRWLock(lock)         pthread_mutex_init((lock), NULL)
+#define AcquireSRWLockExclusive(lock)   pthread_mutex_lock(lock)
+#define ReleaseSRWLockExclusive(lock)   pthread_mutex_unlock(lock)
+
+// Memory
+#define HEAP_ZERO_MEMORY            0x00000008
+#define MEM_COMMIT                  0x00001000
+#define MEM_RESERVE                 0x00002000
+#define MEM_RELEASE                 0x00008000
+#define PAGE_READWRITE              0x04
+
+#define ZeroMemory(dst, size)       memset((dst), 0, (size))
+#define CopyMemory(dst, src, size)  memcpy((dst), (src), (size))
+#define MoveMemory(dst, src, size)  memmove((dst), (src), (size))
+#define FillMemory(dst, size, fill) memset((dst), (fill), (size))
+
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#define UNREFERENCED_PARAMETER(p) ((void)(p))
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define IS_HIGH_SURROGATE(c) (((c) & 0xFC00) == 0xD800)
+#define IS_LOW_SURROGATE(c)  (((c) & 0xFC00) == 0xDC00)
+
+#define _TRUNCATE ((size_t)-1)
+
+// Interlocked operations, on LONG or pointer sized values
+#define InterlockedIncrement(target)  __atomic_add_fetch((target), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement(target)  __atomic_sub_fetch((target), 1, __ATOMIC_SEQ_CST)
+#define InterlockedExchange(target, value) __atomic_exchange_n((target), (value), __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd(target, value) __atomic_fetch_add((target), (value), __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchangePointer(target, value, comparand) \
+    __sync_val_compare_and_swap((target), (comparand), (value))
+
+// The C library's wide string functions expect a 4-byte wchar_t here,
+// so the core's calls go to versions for UTF-16 instead
+#define wcslen      PortableWcslen
+#define wcsncmp     PortableWcsncmp
+#define _wcsnicmp   PortableWcsnicmp
+#define wcscmp(a, b)   PortableWcsncmp((a), (b), (size_t)-1)
+#define _wcsicmp(a, b) PortableWcsnicmp((a), (b), (size_t)-1)
+#define wmemchr     PortableWmemchr
+#define wmemcmp     PortableWmemcmp
+
+#define CreateFile  CreateFileW
+#define DeleteFile  DeleteFileW
+#define CreateDirectory CreateDirectoryW
+#define RemoveDirectory RemoveDirectoryW
+#define MoveFileEx  MoveFileExW
+#define GetEnvironmentVariable GetEnvironmentVariableW
+
+// Function prototypes - platform_posix.c
+size_t PortableWcslen(const WCHAR * text);
+int PortableWcsncmp(const WCHAR * a, const WCHAR * b, size_t count);
+int PortableWcsnicmp(const WCHAR * a, const WCHAR * b, size_t count);
+WCHAR * PortableWmemchr(const WCHAR * text, WCHAR c, size_t count);
+int PortableWmemcmp(const WCHAR * a, const WCHAR * b, size_t count);
+DWORD GetLastError(void);
+void SetLastError(DWORD error);
+HANDLE CreateFileW(LPCWSTR path, DWORD access, DWORD share, void * security, DWORD creation,
+    DWORD flags, HANDLE hTemplate);
+BOOL ReadFile(HANDLE hFile, void * buffer, DWORD bytesToRead, DWORD * bytesRead, void * overlapped);
+BOOL WriteFile(HANDLE hFile, const void * buffer, DWORD bytesToWrite, DWORD * bytesWritten, void * overlapped);
+BOOL CloseHandle(HANDLE handle);
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER * size);
+BOOL SetFilePointerEx(HANDLE hFile, LARGE_INTEGER distance, LARGE_INTEGER * newPosition, DWORD method);
+BOOL SetEndOfFile(HANDLE hFile);
+BOOL GetFileTime(HANDLE hFile, FILETIME * creationTime, FILETIME * accessTime, FILETIME * writeTime);
+LONG CompareFileTime(const FILETIME * a, const FILETIME * b);
+BOOL FlushFileBuffers(HANDLE hFile);
+BOOL DeleteFileW(LPCWSTR path);
+BOOL MoveFileExW(LPCWSTR existingPath, LPCWSTR newPath, DWORD flags);
+BOOL CreateDirectoryW(LPCWSTR path, void * security);
+BOOL RemoveDirectoryW(LPCWSTR path);
+HANDLE FindFirstFileExW(LPCWSTR pattern, FINDEX_INFO_LEVELS infoLevel, void * findData,
+    FINDEX_SEARCH_OPS searchOp, void * searchFilter, DWORD flags);
+BOOL FindNextFileW(HANDLE hFind, WIN32_FIND_DATAW * findData);
+BOOL FindClose(HANDLE hFind);
+HANDLE GetStdHandle(DWORD stdHandle);
+BOOL GetConsoleMode(HANDLE hConsole, DWORD * mode);
+BOOL WriteConsoleW(HANDLE hConsole, const void * buffer, DWORD length, DWORD * written, void * reserved);
+BOOL CreatePipe(HANDLE * hRead, HANDLE * hWrite, void * security, DWORD size);
+HANDLE CreateThread(void * security, SIZE_T stackSize, LPTHREAD_START_ROUTINE start, LPVOID param,
+    DWORD flags, DWORD * threadId);
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds);
+BOOL GetExitCodeThread(HANDLE hThread, DWORD * exitCode);
+DWORD GetCurrentThreadId(void);
+DWORD GetCurrentProcessId(void);
+void Sleep(DWORD milliseconds);
+HANDLE GetProcessHeap(void);
+void * HeapAlloc(HANDLE hHeap, DWORD flags, SIZE_T size);
+void * HeapReAlloc(HANDLE hHeap, DWORD flags, void * memory, SIZE_T size);
+BOOL HeapFree(HANDLE hHeap, DWORD flags, void * memory);
+void * VirtualAlloc(void * address, SIZE_T size, DWORD type, DWORD protect);
+BOOL VirtualFree(void * address, SIZE_T size, DWORD type);
+BOOL QueryPerformanceCounter(LARGE_INTEGER * count);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER * frequency);
+DWORD GetEnvironmentVariableW(LPCWSTR name, LPWSTR buffer, DWORD size);
+int _snprintf_s(char * buffer, size_t size, size_t count, const char * format, ...);
+size_t FormatUtf8V(char * buffer, size_t size, const WCHAR * format, va_list vaArgs);
+HRESULT StringCchVPrintfW(WCHAR * dst, size_t cchDst, const WCHAR * format, va_list vaArgs);
+HRESULT StringCchLengthW(const WCHAR * text, size_t cchMax, size_t * length);
+
+#endif // _WIN32
+
+// The most tasks that RunParallelTasks runs at once
+#define MAX_PARALLEL_TASKS 64
+
+// Runs one of the tasks passed to RunParallelTasks
+typedef void (*PARALLEL_TASK_CALLBACK)(void * task);
+
+// A task of RunParallelTasks, as it's passed to another thread
+typedef struct _PARALLEL_WORK
+{
+    PARALLEL_TASK_CALLBACK callback;
+    void * task;
+} PARALLEL_WORK;
+
+// Function prototypes - platform_win32.c and platform_posix.c
+void DebugLog(const WCHAR * format, ...);
+int DecodeUtf8(const BYTE * data, int dataSize, WCHAR * wideText, int capacity);
+int EncodeUtf8(LPCWSTR wideText, int textLength, BYTE * dst, int dstSize);
+ULONGLONG GetPeakMemoryUsage(void);
+DWORD GetProcessorCount(void);
+void RunParallelTasks(PARALLEL_TASK_CALLBACK callback, void * tasks, size_t taskSize, DWORD taskCount);
+
+#endif // _PLATFORM_H_
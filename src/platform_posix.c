@@ -0,0 +1,1870 @@
+/* -------------------------------------------------------------
+
+platform_posix.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    The platform layer under the portable core, for Linux and other
+    POSIX systems. It implements the part of the Windows API that
+    platform.h declares, with the same results and error codes the
+    core relies on, so the core can be tested and measured there.
+
+    Wide strings are UTF-16 (the core is built with -fshort-wchar),
+    and paths are converted to UTF-8 for the system.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "platform.h"
+
+// The kinds of object a HANDLE refers to
+#define HANDLE_FILE     1
+#define HANDLE_PIPE     2
+#define HANDLE_THREAD   3
+#define HANDLE_FIND     4
+
+// FILETIME counts 100ns intervals since 1601, and time_t counts seconds since 1970
+#define FILETIME_UNIX_EPOCH 116444736000000000ULL
+#define FILETIME_PER_SECOND 10000000ULL
+
+// The longest UTF-8 path that's converted from a wide path
+#define CB_PATH (MAX_PATH * 3 + 1)
+
+// The most UTF-8 bytes that text formatted by FormatUtf8V, or one wide
+// string in it, is converted to
+#define CB_FORMAT_TEXT 2048
+
+// What a HANDLE points to
+typedef struct _POSIX_HANDLE
+{
+    int type;
+    int fd;                         // for files and pipes
+    DIR * dir;                      // for finding files
+    pthread_t thread;               // for threads
+    LPTHREAD_START_ROUTINE start;
+    LPVOID param;
+    volatile DWORD exitCode;        // STILL_ACTIVE until the thread returns
+    BOOL joined;
+} POSIX_HANDLE;
+
+//
+// globals
+//
+THREAD_LOCAL DWORD g_lastError = ERROR_SUCCESS;
+POSIX_HANDLE g_stdHandles[3] = { { .type = HANDLE_FILE, .fd = 0 }, { .type = HANDLE_FILE, .fd = 1 },
+    { .type = HANDLE_FILE, .fd = 2 } };
+int g_processHeap;      // GetProcessHeap returns its address, since the heap is malloc
+
+//
+// GetLastError
+// Returns the last error set on this thread
+//
+DWORD GetLastError(void)
+{
+    return g_lastError;
+}
+
+//
+// SetLastError
+// Sets the last error for this thread
+//
+void SetLastError(DWORD error)
+{
+    g_lastError = error;
+}
+
+//
+// SetLastErrorFromErrno
+// Sets the last error to the Windows error code closest to errno
+//
+void SetLastErrorFromErrno(void)
+{
+    DWORD error;
+
+    switch(errno)
+    {
+    case 0:
+        error = ERROR_SUCCESS;
+        break;
+    case ENOENT:
+        error = ERROR_FILE_NOT_FOUND;
+        break;
+    case ENOTDIR:
+    case ENAMETOOLONG:
+        error = ERROR_PATH_NOT_FOUND;
+        break;
+    case EACCES:
+    case EPERM:
+    case EISDIR:
+    case EROFS:
+        error = ERROR_ACCESS_DENIED;
+        break;
+    case EBADF:
+        error = ERROR_INVALID_HANDLE;
+        break;
+    case ENOMEM:
+        error = ERROR_NOT_ENOUGH_MEMORY;
+        break;
+    case ENOSPC:
+        error = ERROR_HANDLE_DISK_FULL;
+        break;
+    case EEXIST:
+        error = ERROR_FILE_EXISTS;
+        break;
+    case EINVAL:
+        error = ERROR_INVALID_PARAMETER;
+        break;
+    case EPIPE:
+        error = ERROR_BROKEN_PIPE;
+        break;
+    default:
+        error = ERROR_GEN_FAILURE;
+        break;
+    }
+
+    g_lastError = error;
+}
+
+//
+// PortableWcslen
+// wcslen for UTF-16 strings
+//
+size_t PortableWcslen(const WCHAR * text)
+{
+    size_t length = 0;
+
+    while(text[length] != 0)
+    {
+        length++;
+    }
+
+    return length;
+}
+
+//
+// PortableWcsncmp
+// wcsncmp for UTF-16 strings
+//
+int PortableWcsncmp(const WCHAR * a, const WCHAR * b, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        if(a[i] != b[i])
+        {
+            return (a[i] < b[i]) ? -1 : 1;
+        }
+
+        if(a[i] == 0)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+//
+// PortableWcsnicmp
+// _wcsnicmp for UTF-16 strings. Like _wcsnicmp in the C locale,
+// only A to Z are compared without case.
+//
+int PortableWcsnicmp(const WCHAR * a, const WCHAR * b, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        WCHAR x = (a[i] >= L'A' && a[i] <= L'Z') ? (WCHAR)(a[i] + (L'a' - L'A')) : a[i];
+        WCHAR y = (b[i] >= L'A' && b[i] <= L'Z') ? (WCHAR)(b[i] + (L'a' - L'A')) : b[i];
+
+        if(x != y)
+        {
+            return (x < y) ? -1 : 1;
+        }
+
+        if(x == 0)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+//
+// PortableWmemchr
+// wmemchr for UTF-16 text
+//
+WCHAR * PortableWmemchr(const WCHAR * text, WCHAR c, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        if(text[i] == c)
+        {
+            return (WCHAR *)&text[i];
+        }
+    }
+
+    return NULL;
+}
+
+//
+// PortableWmemcmp
+// wmemcmp for UTF-16 text
+//
+int PortableWmemcmp(const WCHAR * a, const WCHAR * b, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        if(a[i] != b[i])
+        {
+            return (a[i] < b[i]) ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+//
+// DecodeUtf8
+// Converts dataSize bytes of UTF-8 to at most capacity wide chars.
+// Each invalid sequence, such as an overlong form, an encoded surrogate
+// or a truncated character, becomes one U+FFFD. Nulls are converted like
+// any other character, and no terminator is added.
+// Returns the number of wide chars, or 0 if they don't fit. With a
+// capacity of 0, returns how many wide chars are needed.
+//
+int DecodeUtf8(const BYTE * data, int dataSize, WCHAR * wideText, int capacity)
+{
+    int length = 0;
+    int i = 0;
+
+    if(dataSize <= 0 || capacity < 0)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 0;
+    }
+
+    while(i < dataSize)
+    {
+        unsigned int c = data[i];
+        unsigned int codePoint = 0xFFFD;
+        int trailCount = 0;
+        BYTE low = 0x80;
+        BYTE high = 0xBF;
+        int n;
+
+        // Runs of ASCII, which most text is, are copied without the checks below
+        if(c < 0x80 && capacity > 0)
+        {
+            int run = i;
+
+            while(run < dataSize && data[run] < 0x80 && length < capacity)
+            {
+                wideText[length++] = data[run++];
+            }
+
+            if(run < dataSize && data[run] < 0x80)
+            {
+                SetLastError(ERROR_INSUFFICIENT_BUFFER);
+                return 0;
+            }
+
+            i = run;
+            continue;
+        }
+
+        // The valid ranges of the second byte follow the Unicode
+        // well-formed UTF-8 table, which excludes overlongs and surrogates
+        if(c < 0x80)
+        {
+            codePoint = c;
+        }
+        else if(c >= 0xC2 && c <= 0xDF)
+        {
+            trailCount = 1;
+            codePoint = c & 0x1F;
+        }
+        else if(c >= 0xE0 && c <= 0xEF)
+        {
+            trailCount = 2;
+            codePoint = c & 0x0F;
+            low = (c == 0xE0) ? 0xA0 : 0x80;
+            high = (c == 0xED) ? 0x9F : 0xBF;
+        }
+        else if(c >= 0xF0 && c <= 0xF4)
+        {
+            trailCount = 3;
+            codePoint = c & 0x07;
+            low = (c == 0xF0) ? 0x90 : 0x80;
+            high = (c == 0xF4) ? 0x8F : 0xBF;
+        }
+
+        i++;
+
+        // Take the trail bytes. A byte that doesn't fit ends the sequence,
+        // and starts the next one.
+        for(n = 0; n < trailCount; n++)
+        {
+            if(i >= dataSize || data[i] < low || data[i] > high)
+            {
+                codePoint = 0xFFFD;
+                break;
+            }
+
+            codePoint = (codePoint << 6) | (data[i] & 0x3F);
+            low = 0x80;
+            high = 0xBF;
+            i++;
+        }
+
+        n = (codePoint > 0xFFFF) ? 2 : 1;
+        if(capacity > 0)
+        {
+            if(length + n > capacity)
+            {
+                SetLastError(ERROR_INSUFFICIENT_BUFFER);
+                return 0;
+            }
+
+            if(n == 2)
+            {
+                codePoint -= 0x10000;
+                wideText[length] = (WCHAR)(0xD800 + (codePoint >> 10));
+                wideText[length + 1] = (WCHAR)(0xDC00 + (codePoint & 0x3FF));
+            }
+            else
+            {
+                wideText[length] = (WCHAR)codePoint;
+            }
+        }
+
+        length += n;
+    }
+
+    return length;
+}
+
+//
+// EncodeUtf8
+// Converts textLength wide chars to at most dstSize bytes of UTF-8.
+// Lone surrogates become U+FFFD.
+// Returns the number of bytes, or 0 if they don't fit. With a
+// dstSize of 0, returns how many bytes are needed.
+//
+int EncodeUtf8(LPCWSTR wideText, int textLength, BYTE * dst, int dstSize)
+{
+    int byteCount = 0;
+
+    if(textLength <= 0 || dstSize < 0)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 0;
+    }
+
+    for(int i = 0; i < textLength; i++)
+    {
+        unsigned int codePoint = wideText[i];
+        BYTE bytes[4];
+        int n;
+
+        if(IS_HIGH_SURROGATE(codePoint) && i + 1 < textLength && IS_LOW_SURROGATE(wideText[i + 1]))
+        {
+            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (wideText[i + 1] - 0xDC00);
+            i++;
+        }
+        else if(IS_HIGH_SURROGATE(codePoint) || IS_LOW_SURROGATE(codePoint))
+        {
+            codePoint = 0xFFFD;
+        }
+
+        if(codePoint < 0x80)
+        {
+            bytes[0] = (BYTE)codePoint;
+            n = 1;
+        }
+        else if(codePoint < 0x800)
+        {
+            bytes[0] = (BYTE)(0xC0 | (codePoint >> 6));
+            bytes[1] = (BYTE)(0x80 | (codePoint & 0x3F));
+            n = 2;
+        }
+        else if(codePoint < 0x10000)
+        {
+            bytes[0] = (BYTE)(0xE0 | (codePoint >> 12));
+            bytes[1] = (BYTE)(0x80 | ((codePoint >> 6) & 0x3F));
+            bytes[2] = (BYTE)(0x80 | (codePoint & 0x3F));
+            n = 3;
+        }
+        else
+        {
+            bytes[0] = (BYTE)(0xF0 | (codePoint >> 18));
+            bytes[1] = (BYTE)(0x80 | ((codePoint >> 12) & 0x3F));
+            bytes[2] = (BYTE)(0x80 | ((codePoint >> 6) & 0x3F));
+            bytes[3] = (BYTE)(0x80 | (codePoint & 0x3F));
+            n = 4;
+        }
+
+        if(dstSize > 0)
+        {
+            if(byteCount + n > dstSize)
+            {
+                SetLastError(ERROR_INSUFFICIENT_BUFFER);
+                return 0;
+            }
+
+            memcpy(&dst[byteCount], bytes, n);
+        }
+
+        byteCount += n;
+    }
+
+    return byteCount;
+}
+
+//
+// GetUtf8Path
+// Converts a wide path to the UTF-8 path the system takes.
+// Returns FALSE, with the last error set, if it's too long.
+//
+BOOL GetUtf8Path(LPCWSTR path, char * utf8Path)
+{
+    size_t length = PortableWcslen(path);
+    int byteCount = 0;
+
+    if(length > MAX_PATH)
+    {
+        SetLastError(ERROR_PATH_NOT_FOUND);
+        return FALSE;
+    }
+
+    if(length > 0)
+    {
+        byteCount = EncodeUtf8(path, (int)length, (BYTE *)utf8Path, CB_PATH - 1);
+        if(byteCount == 0)
+        {
+            SetLastError(ERROR_PATH_NOT_FOUND);
+            return FALSE;
+        }
+    }
+
+    utf8Path[byteCount] = 0;
+    return TRUE;
+}
+
+//
+// NewHandle
+// Allocates a handle of the given type
+//
+POSIX_HANDLE * NewHandle(int type, int fd)
+{
+    POSIX_HANDLE * handle = calloc(1, sizeof(POSIX_HANDLE));
+
+    if(handle)
+    {
+        handle->type = type;
+        handle->fd = fd;
+    }
+    else
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+    }
+
+    return handle;
+}
+
+//
+// GetHandleFd
+// Returns the file descriptor of a file or pipe handle, or -1
+//
+int GetHandleFd(HANDLE handle)
+{
+    POSIX_HANDLE * posixHandle = (POSIX_HANDLE *)handle;
+
+    if(handle == NULL || handle == INVALID_HANDLE_VALUE || posixHandle->type == HANDLE_THREAD ||
+        posixHandle->type == HANDLE_FIND)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return -1;
+    }
+
+    return posixHandle->fd;
+}
+
+//
+// CreateFileW
+// Opens or creates a file. Sharing modes aren't enforced,
+// and directories can't be opened, like on Windows.
+//
+HANDLE CreateFileW(LPCWSTR path, DWORD access, DWORD share, void * security, DWORD creation,
+    DWORD flags, HANDLE hTemplate)
+{
+    char utf8Path[CB_PATH];
+    struct stat fileStat;
+    POSIX_HANDLE * handle;
+    int openFlags;
+    int fd;
+
+    UNREFERENCED_PARAMETER(share);
+    UNREFERENCED_PARAMETER(security);
+    UNREFERENCED_PARAMETER(hTemplate);
+
+    if(!GetUtf8Path(path, utf8Path))
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    if((access & GENERIC_READ) && (access & GENERIC_WRITE))
+    {
+        openFlags = O_RDWR;
+    }
+    else if(access & GENERIC_WRITE)
+    {
+        openFlags = O_WRONLY;
+    }
+    else
+    {
+        openFlags = O_RDONLY;
+    }
+
+    switch(creation)
+    {
+    case CREATE_NEW:
+        openFlags |= O_CREAT | O_EXCL;
+        break;
+    case CREATE_ALWAYS:
+        openFlags |= O_CREAT | O_TRUNC;
+        break;
+    case OPEN_ALWAYS:
+        openFlags |= O_CREAT;
+        break;
+    case TRUNCATE_EXISTING:
+        openFlags |= O_TRUNC;
+        break;
+    case OPEN_EXISTING:
+        break;
+    default:
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    if(flags & FILE_FLAG_WRITE_THROUGH)
+    {
+        openFlags |= O_DSYNC;
+    }
+
+    fd = open(utf8Path, openFlags | O_CLOEXEC, 0666);
+    if(fd < 0)
+    {
+        SetLastErrorFromErrno();
+        return INVALID_HANDLE_VALUE;
+    }
+
+    if(fstat(fd, &fileStat) != 0 || S_ISDIR(fileStat.st_mode))
+    {
+        close(fd);
+        SetLastError(ERROR_ACCESS_DENIED);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    handle = NewHandle(HANDLE_FILE, fd);
+    if(!handle)
+    {
+        close(fd);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    SetLastError(ERROR_SUCCESS);
+    return handle;
+}
+
+//
+// ReadFile
+// Reads from a file or pipe. A file read only comes up short at the
+// end of the file. A pipe read returns what's there, and fails with
+// ERROR_BROKEN_PIPE once the write end is closed and the pipe is empty.
+//
+BOOL ReadFile(HANDLE hFile, void * buffer, DWORD bytesToRead, DWORD * bytesRead, void * overlapped)
+{
+    POSIX_HANDLE * handle = (POSIX_HANDLE *)hFile;
+    int fd = GetHandleFd(hFile);
+    DWORD total = 0;
+
+    UNREFERENCED_PARAMETER(overlapped);
+
+    *bytesRead = 0;
+    if(fd < 0)
+    {
+        return FALSE;
+    }
+
+    while(total < bytesToRead)
+    {
+        ssize_t result = read(fd, (BYTE *)buffer + total, bytesToRead - total);
+
+        if(result < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            SetLastErrorFromErrno();
+            *bytesRead = total;
+            return FALSE;
+        }
+
+        if(result == 0)
+        {
+            if(handle->type == HANDLE_PIPE && total == 0 && bytesToRead > 0)
+            {
+                SetLastError(ERROR_BROKEN_PIPE);
+                return FALSE;
+            }
+
+            break;
+        }
+
+        total += (DWORD)result;
+
+        if(handle->type == HANDLE_PIPE)
+        {
+            break;
+        }
+    }
+
+    *bytesRead = total;
+    return TRUE;
+}
+
+//
+// WriteFile
+// Writes all of buffer to a file or pipe. Writing to a pipe
+// whose read end is closed fails with ERROR_BROKEN_PIPE.
+//
+BOOL WriteFile(HANDLE hFile, const void * buffer, DWORD bytesToWrite, DWORD * bytesWritten, void * overlapped)
+{
+    int fd = GetHandleFd(hFile);
+    DWORD total = 0;
+
+    UNREFERENCED_PARAMETER(overlapped);
+
+    if(bytesWritten)
+    {
+        *bytesWritten = 0;
+    }
+
+    if(fd < 0)
+    {
+        return FALSE;
+    }
+
+    while(total < bytesToWrite)
+    {
+        ssize_t result = write(fd, (const BYTE *)buffer + total, bytesToWrite - total);
+
+        if(result < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            SetLastErrorFromErrno();
+            if(bytesWritten)
+            {
+                *bytesWritten = total;
+            }
+            return FALSE;
+        }
+
+        total += (DWORD)result;
+    }
+
+    if(bytesWritten)
+    {
+        *bytesWritten = total;
+    }
+
+    return TRUE;
+}
+
+//
+// CloseHandle
+// Closes a file or pipe, or lets a thread clean up after itself.
+// Handles from FindFirstFileExW are closed by FindClose instead.
+//
+BOOL CloseHandle(HANDLE handle)
+{
+    POSIX_HANDLE * posixHandle = (POSIX_HANDLE *)handle;
+    BOOL success = TRUE;
+
+    if(handle == NULL || handle == INVALID_HANDLE_VALUE || posixHandle->type == HANDLE_FIND)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    if(posixHandle->type == HANDLE_THREAD)
+    {
+        // The thread still uses the handle until it returns
+        if(!posixHandle->joined)
+        {
+            pthread_join(posixHandle->thread, NULL);
+        }
+    }
+    else if(close(posixHandle->fd) != 0)
+    {
+        SetLastErrorFromErrno();
+        success = FALSE;
+    }
+
+    free(posixHandle);
+    return success;
+}
+
+//
+// GetFileSizeEx
+// Gets the size of a file
+//
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER * size)
+{
+    struct stat fileStat;
+    int fd = GetHandleFd(hFile);
+
+    if(fd < 0)
+    {
+        return FALSE;
+    }
+
+    if(fstat(fd, &fileStat) != 0)
+    {
+        SetLastErrorFromErrno();
+        return FALSE;
+    }
+
+    size->QuadPart = (LONGLONG)fileStat.st_size;
+    return TRUE;
+}
+
+//
+// SetFilePointerEx
+// Moves the file position
+//
+BOOL SetFilePointerEx(HANDLE hFile, LARGE_INTEGER distance, LARGE_INTEGER * newPosition, DWORD method)
+{
+    int fd = GetHandleFd(hFile);
+    int whence = (method == FILE_END) ? SEEK_END : (method == FILE_CURRENT) ? SEEK_CUR : SEEK_SET;
+    off_t position;
+
+    if(fd < 0)
+    {
+        return FALSE;
+    }
+
+    position = lseek(fd, (off_t)distance.QuadPart, whence);
+    if(position < 0)
+    {
+        SetLastErrorFromErrno();
+        return FALSE;
+    }
+
+    if(newPosition)
+    {
+        newPosition->QuadPart = (LONGLONG)position;
+    }
+
+    return TRUE;
+}
+
+//
+// SetEndOfFile
+// Truncates or extends a file to its current position
+//
+BOOL SetEndOfFile(HANDLE hFile)
+{
+    int fd = GetHandleFd(hFile);
+    off_t position;
+
+    if(fd < 0)
+    {
+        return FALSE;
+    }
+
+    position = lseek(fd, 0, SEEK_CUR);
+    if(position < 0 || ftruncate(fd, position) != 0)
+    {
+        SetLastErrorFromErrno();
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// TimespecToFileTime
+// Converts a POSIX time to a FILETIME
+//
+void TimespecToFileTime(const struct timespec * time, FILETIME * fileTime)
+{
+    ULONGLONG ticks = (ULONGLONG)time->tv_sec * FILETIME_PER_SECOND +
+        (ULONGLONG)time->tv_nsec / 100 + FILETIME_UNIX_EPOCH;
+
+    fileTime->dwLowDateTime = (DWORD)ticks;
+    fileTime->dwHighDateTime = (DWORD)(ticks >> 32);
+}
+
+//
+// GetFileTime
+// Gets the times of a file. POSIX has no creation time,
+// so the time of the last status change stands in for it.
+//
+BOOL GetFileTime(HANDLE hFile, FILETIME * creationTime, FILETIME * accessTime, FILETIME * writeTime)
+{
+    struct stat fileStat;
+    int fd = GetHandleFd(hFile);
+
+    if(fd < 0)
+    {
+        return FALSE;
+    }
+
+    if(fstat(fd, &fileStat) != 0)
+    {
+        SetLastErrorFromErrno();
+        return FALSE;
+    }
+
+    if(creationTime)
+    {
+        TimespecToFileTime(&fileStat.st_ctim, creationTime);
+    }
+
+    if(accessTime)
+    {
+        TimespecToFileTime(&fileStat.st_atim, accessTime);
+    }
+
+    if(writeTime)
+    {
+        TimespecToFileTime(&fileStat.st_mtim, writeTime);
+    }
+
+    return TRUE;
+}
+
+//
+// CompareFileTime
+// Returns -1, 0 or 1 as a is earlier than, the same as, or later than b
+//
+LONG CompareFileTime(const FILETIME * a, const FILETIME * b)
+{
+    ULONGLONG x = ((ULONGLONG)a->dwHighDateTime << 32) | a->dwLowDateTime;
+    ULONGLONG y = ((ULONGLONG)b->dwHighDateTime << 32) | b->dwLowDateTime;
+
+    return (x > y) - (x < y);
+}
+
+//
+// FlushFileBuffers
+// Writes a file's data through to the disk
+//
+BOOL FlushFileBuffers(HANDLE hFile)
+{
+    int fd = GetHandleFd(hFile);
+
+    if(fd < 0)
+    {
+        return FALSE;
+    }
+
+    if(fsync(fd) != 0)
+    {
+        SetLastErrorFromErrno();
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// DeleteFileW
+// Deletes a file
+//
+BOOL DeleteFileW(LPCWSTR path)
+{
+    char utf8Path[CB_PATH];
+
+    if(!GetUtf8Path(path, utf8Path))
+    {
+        return FALSE;
+    }
+
+    if(unlink(utf8Path) != 0)
+    {
+        SetLastErrorFromErrno();
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// MoveFileExW
+// Renames a file. Without MOVEFILE_REPLACE_EXISTING,
+// it fails if the new path already exists.
+//
+BOOL MoveFileExW(LPCWSTR existingPath, LPCWSTR newPath, DWORD flags)
+{
+    char utf8Existing[CB_PATH];
+    char utf8New[CB_PATH];
+
+    if(!GetUtf8Path(existingPath, utf8Existing) || !GetUtf8Path(newPath, utf8New))
+    {
+        return FALSE;
+    }
+
+    if(!(flags & MOVEFILE_REPLACE_EXISTING) && access(utf8New, F_OK) == 0)
+    {
+        SetLastError(ERROR_ALREADY_EXISTS);
+        return FALSE;
+    }
+
+    if(rename(utf8Existing, utf8New) != 0)
+    {
+        SetLastErrorFromErrno();
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// CreateDirectoryW
+// Creates a folder. Fails with ERROR_ALREADY_EXISTS if there's already
+// something at path, like on Windows.
+//
+BOOL CreateDirectoryW(LPCWSTR path, void * security)
+{
+    char utf8Path[CB_PATH];
+
+    UNREFERENCED_PARAMETER(security);
+
+    if(!GetUtf8Path(path, utf8Path))
+    {
+        return FALSE;
+    }
+
+    if(mkdir(utf8Path, 0777) != 0)
+    {
+        if(errno == EEXIST)
+        {
+            SetLastError(ERROR_ALREADY_EXISTS);
+        }
+        else
+        {
+            SetLastErrorFromErrno();
+        }
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// RemoveDirectoryW
+// Removes an empty folder
+//
+BOOL RemoveDirectoryW(LPCWSTR path)
+{
+    char utf8Path[CB_PATH];
+
+    if(!GetUtf8Path(path, utf8Path))
+    {
+        return FALSE;
+    }
+
+    if(rmdir(utf8Path) != 0)
+    {
+        SetLastErrorFromErrno();
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// ReadFindEntry
+// Reads the next entry of a folder that converts to a wide name.
+// A link is a reparse point, and a directory too if it links to one,
+// like a directory symbolic link on Windows. Fails with
+// ERROR_NO_MORE_FILES after the last entry.
+//
+BOOL ReadFindEntry(POSIX_HANDLE * handle, WIN32_FIND_DATAW * findData)
+{
+    struct dirent * entry;
+    struct stat entryStat;
+    size_t nameLength;
+    int length;
+
+    for(;;)
+    {
+        errno = 0;
+        entry = readdir(handle->dir);
+        if(!entry)
+        {
+            if(errno != 0)
+            {
+                SetLastErrorFromErrno();
+            }
+            else
+            {
+                SetLastError(ERROR_NO_MORE_FILES);
+            }
+            return FALSE;
+        }
+
+        // A name that's too long for cFileName is skipped, like a path
+        // longer than MAX_PATH can't be opened
+        nameLength = strlen(entry->d_name);
+        length = DecodeUtf8((const BYTE *)entry->d_name, (int)nameLength, findData->cFileName, MAX_PATH - 1);
+        if(length == 0)
+        {
+            continue;
+        }
+        findData->cFileName[length] = 0;
+
+        findData->dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+        if(entry->d_type == DT_DIR)
+        {
+            findData->dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+        }
+        else if((entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) &&
+            fstatat(dirfd(handle->dir), entry->d_name, &entryStat, AT_SYMLINK_NOFOLLOW) == 0)
+        {
+            if(S_ISLNK(entryStat.st_mode))
+            {
+                // A link to nothing is listed as a file
+                findData->dwFileAttributes = FILE_ATTRIBUTE_REPARSE_POINT;
+                if(fstatat(dirfd(handle->dir), entry->d_name, &entryStat, 0) == 0 && S_ISDIR(entryStat.st_mode))
+                {
+                    findData->dwFileAttributes |= FILE_ATTRIBUTE_DIRECTORY;
+                }
+            }
+            else if(S_ISDIR(entryStat.st_mode))
+            {
+                findData->dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+            }
+        }
+
+        SetLastError(ERROR_SUCCESS);
+        return TRUE;
+    }
+}
+
+//
+// FindFirstFileExW
+// Starts going through the entries of a folder, including . and ..,
+// and reads the first one. Only a pattern of the folder followed by
+// a * on its own is supported, which matches every entry.
+//
+HANDLE FindFirstFileExW(LPCWSTR pattern, FINDEX_INFO_LEVELS infoLevel, void * findData,
+    FINDEX_SEARCH_OPS searchOp, void * searchFilter, DWORD flags)
+{
+    WCHAR folder[MAX_PATH + 1];
+    char utf8Path[CB_PATH];
+    size_t length = PortableWcslen(pattern);
+    POSIX_HANDLE * handle;
+    DIR * dir;
+
+    UNREFERENCED_PARAMETER(infoLevel);
+    UNREFERENCED_PARAMETER(searchOp);
+    UNREFERENCED_PARAMETER(searchFilter);
+    UNREFERENCED_PARAMETER(flags);
+
+    if(length == 0 || length > MAX_PATH || pattern[length - 1] != L'*' ||
+        (length > 1 && pattern[length - 2] != L'/' && pattern[length - 2] != L'\\'))
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    // The folder, with its separator, or the current one
+    if(length == 1)
+    {
+        folder[0] = L'.';
+        folder[1] = 0;
+    }
+    else
+    {
+        CopyMemory(folder, pattern, (length - 1) * sizeof(WCHAR));
+        folder[length - 1] = 0;
+    }
+
+    if(!GetUtf8Path(folder, utf8Path))
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    dir = opendir(utf8Path);
+    if(!dir)
+    {
+        SetLastErrorFromErrno();
+        return INVALID_HANDLE_VALUE;
+    }
+
+    handle = NewHandle(HANDLE_FIND, -1);
+    if(!handle)
+    {
+        closedir(dir);
+        return INVALID_HANDLE_VALUE;
+    }
+    handle->dir = dir;
+
+    if(!ReadFindEntry(handle, (WIN32_FIND_DATAW *)findData))
+    {
+        closedir(dir);
+        free(handle);
+        SetLastError(ERROR_FILE_NOT_FOUND);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return handle;
+}
+
+//
+// FindNextFileW
+// Reads the next entry of a folder
+//
+BOOL FindNextFileW(HANDLE hFind, WIN32_FIND_DATAW * findData)
+{
+    POSIX_HANDLE * handle = (POSIX_HANDLE *)hFind;
+
+    if(hFind == NULL || hFind == INVALID_HANDLE_VALUE || handle->type != HANDLE_FIND)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    return ReadFindEntry(handle, findData);
+}
+
+//
+// FindClose
+// Stops going through the entries of a folder
+//
+BOOL FindClose(HANDLE hFind)
+{
+    POSIX_HANDLE * handle = (POSIX_HANDLE *)hFind;
+
+    if(hFind == NULL || hFind == INVALID_HANDLE_VALUE || handle->type != HANDLE_FIND)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    closedir(handle->dir);
+    free(handle);
+    return TRUE;
+}
+
+//
+// GetStdHandle
+// Returns the handle of standard input, output or error. It's the same
+// handle every time, and mustn't be closed.
+//
+HANDLE GetStdHandle(DWORD stdHandle)
+{
+    switch(stdHandle)
+    {
+    case STD_INPUT_HANDLE:
+        return &g_stdHandles[0];
+    case STD_OUTPUT_HANDLE:
+        return &g_stdHandles[1];
+    case STD_ERROR_HANDLE:
+        return &g_stdHandles[2];
+    default:
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return INVALID_HANDLE_VALUE;
+    }
+}
+
+//
+// GetConsoleMode
+// There's no console here. A terminal takes UTF-8 like a file or a
+// pipe does, so every handle is written to as one.
+//
+BOOL GetConsoleMode(HANDLE hConsole, DWORD * mode)
+{
+    UNREFERENCED_PARAMETER(hConsole);
+
+    *mode = 0;
+    SetLastError(ERROR_INVALID_HANDLE);
+    return FALSE;
+}
+
+//
+// WriteConsoleW
+// Fails, since GetConsoleMode says no handle is a console
+//
+BOOL WriteConsoleW(HANDLE hConsole, const void * buffer, DWORD length, DWORD * written, void * reserved)
+{
+    UNREFERENCED_PARAMETER(hConsole);
+    UNREFERENCED_PARAMETER(buffer);
+    UNREFERENCED_PARAMETER(length);
+    UNREFERENCED_PARAMETER(reserved);
+
+    *written = 0;
+    SetLastError(ERROR_INVALID_HANDLE);
+    return FALSE;
+}
+
+//
+// CreatePipe
+// Creates an anonymous pipe. SIGPIPE is ignored, so writing
+// after the read end is closed fails instead of ending the process.
+//
+BOOL CreatePipe(HANDLE * hRead, HANDLE * hWrite, void * security, DWORD size)
+{
+    int fds[2];
+
+    UNREFERENCED_PARAMETER(security);
+    UNREFERENCED_PARAMETER(size);
+
+    signal(SIGPIPE, SIG_IGN);
+
+    if(pipe(fds) != 0)
+    {
+        SetLastErrorFromErrno();
+        return FALSE;
+    }
+
+    *hRead = NewHandle(HANDLE_PIPE, fds[0]);
+    *hWrite = NewHandle(HANDLE_PIPE, fds[1]);
+    if(!*hRead || !*hWrite)
+    {
+        free(*hRead);
+        free(*hWrite);
+        close(fds[0]);
+        close(fds[1]);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// ThreadStart
+// Runs a thread's start routine, and keeps its exit code
+//
+void * ThreadStart(void * param)
+{
+    POSIX_HANDLE * handle = param;
+    DWORD exitCode = handle->start(handle->param);
+
+    __atomic_store_n(&handle->exitCode, exitCode, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+//
+// CreateThread
+// Starts a thread
+//
+HANDLE CreateThread(void * security, SIZE_T stackSize, LPTHREAD_START_ROUTINE start, LPVOID param,
+    DWORD flags, DWORD * threadId)
+{
+    POSIX_HANDLE * handle;
+
+    UNREFERENCED_PARAMETER(security);
+    UNREFERENCED_PARAMETER(stackSize);
+    UNREFERENCED_PARAMETER(flags);
+
+    handle = NewHandle(HANDLE_THREAD, -1);
+    if(!handle)
+    {
+        return NULL;
+    }
+
+    handle->start = start;
+    handle->param = param;
+    handle->exitCode = STILL_ACTIVE;
+
+    if(pthread_create(&handle->thread, NULL, ThreadStart, handle) != 0)
+    {
+        free(handle);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    if(threadId)
+    {
+        *threadId = 0;
+    }
+
+    return handle;
+}
+
+//
+// WaitForSingleObject
+// Waits for a thread to return. Only INFINITE waits are supported.
+//
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds)
+{
+    POSIX_HANDLE * posixHandle = (POSIX_HANDLE *)handle;
+
+    if(handle == NULL || posixHandle->type != HANDLE_THREAD || milliseconds != INFINITE)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return WAIT_FAILED;
+    }
+
+    if(!posixHandle->joined)
+    {
+        pthread_join(posixHandle->thread, NULL);
+        posixHandle->joined = TRUE;
+    }
+
+    return WAIT_OBJECT_0;
+}
+
+//
+// GetExitCodeThread
+// Gets what a thread returned, or STILL_ACTIVE if it's running
+//
+BOOL GetExitCodeThread(HANDLE hThread, DWORD * exitCode)
+{
+    POSIX_HANDLE * handle = (POSIX_HANDLE *)hThread;
+
+    if(hThread == NULL || handle->type != HANDLE_THREAD)
+    {
+        SetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
+    *exitCode = __atomic_load_n(&handle->exitCode, __ATOMIC_ACQUIRE);
+    return TRUE;
+}
+
+//
+// GetCurrentThreadId
+// Returns the system's ID for the calling thread
+//
+DWORD GetCurrentThreadId(void)
+{
+    return (DWORD)syscall(SYS_gettid);
+}
+
+//
+// GetCurrentProcessId
+// Returns the ID of the process
+//
+DWORD GetCurrentProcessId(void)
+{
+    return (DWORD)getpid();
+}
+
+//
+// Sleep
+// Suspends the calling thread
+//
+void Sleep(DWORD milliseconds)
+{
+    struct timespec delay;
+
+    delay.tv_sec = milliseconds / 1000;
+    delay.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+    while(nanosleep(&delay, &delay) != 0 && errno == EINTR);
+}
+
+//
+// GetProcessHeap
+// Returns a handle that stands for the C library heap
+//
+HANDLE GetProcessHeap(void)
+{
+    return &g_processHeap;
+}
+
+//
+// HeapAlloc
+// Allocates memory, zeroed if HEAP_ZERO_MEMORY is given
+//
+void * HeapAlloc(HANDLE hHeap, DWORD flags, SIZE_T size)
+{
+    UNREFERENCED_PARAMETER(hHeap);
+
+    // Like the Windows heap, a 0 byte allocation still returns a pointer
+    size = max(size, 1);
+
+    return (flags & HEAP_ZERO_MEMORY) ? calloc(1, size) : malloc(size);
+}
+
+//
+// HeapReAlloc
+// Resizes memory from HeapAlloc. HEAP_ZERO_MEMORY isn't supported.
+//
+void * HeapReAlloc(HANDLE hHeap, DWORD flags, void * memory, SIZE_T size)
+{
+    UNREFERENCED_PARAMETER(hHeap);
+
+    if(flags & HEAP_ZERO_MEMORY)
+    {
+        return NULL;
+    }
+
+    return realloc(memory, max(size, 1));
+}
+
+//
+// HeapFree
+// Frees memory from HeapAlloc
+//
+BOOL HeapFree(HANDLE hHeap, DWORD flags, void * memory)
+{
+    UNREFERENCED_PARAMETER(hHeap);
+    UNREFERENCED_PARAMETER(flags);
+
+    free(memory);
+    return TRUE;
+}
+
+//
+// VirtualAlloc
+// Allocates zeroed memory. Only reserving and
+// committing it all at once is supported.
+//
+void * VirtualAlloc(void * address, SIZE_T size, DWORD type, DWORD protect)
+{
+    UNREFERENCED_PARAMETER(protect);
+
+    if(address != NULL || !(type & MEM_COMMIT))
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    return calloc(1, size);
+}
+
+//
+// VirtualFree
+// Frees memory from VirtualAlloc
+//
+BOOL VirtualFree(void * address, SIZE_T size, DWORD type)
+{
+    UNREFERENCED_PARAMETER(size);
+    UNREFERENCED_PARAMETER(type);
+
+    free(address);
+    return TRUE;
+}
+
+//
+// QueryPerformanceCounter
+// Gets the monotonic clock, in nanoseconds
+//
+BOOL QueryPerformanceCounter(LARGE_INTEGER * count)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    count->QuadPart = (LONGLONG)now.tv_sec * 1000000000LL + now.tv_nsec;
+
+    return TRUE;
+}
+
+//
+// QueryPerformanceFrequency
+// The counter counts nanoseconds
+//
+BOOL QueryPerformanceFrequency(LARGE_INTEGER * frequency)
+{
+    frequency->QuadPart = 1000000000LL;
+    return TRUE;
+}
+
+//
+// GetEnvironmentVariableW
+// Gets an environment variable, converted from UTF-8.
+// Returns its length, or the size needed with the terminator
+// if it doesn't fit, or 0 if it isn't set.
+//
+DWORD GetEnvironmentVariableW(LPCWSTR name, LPWSTR buffer, DWORD size)
+{
+    char utf8Name[CB_PATH];
+    const char * value;
+    int length = 0;
+
+    if(!GetUtf8Path(name, utf8Name))
+    {
+        return 0;
+    }
+
+    value = getenv(utf8Name);
+    if(!value)
+    {
+        SetLastError(ERROR_ENVVAR_NOT_FOUND);
+        return 0;
+    }
+
+    if(value[0] != 0)
+    {
+        length = DecodeUtf8((const BYTE *)value, (int)strlen(value), NULL, 0);
+    }
+
+    if((DWORD)length >= size)
+    {
+        return (DWORD)length + 1;
+    }
+
+    if(length > 0)
+    {
+        DecodeUtf8((const BYTE *)value, (int)strlen(value), buffer, length);
+    }
+
+    buffer[length] = 0;
+    return (DWORD)length;
+}
+
+//
+// _snprintf_s
+// snprintf that returns -1, like the Windows version with _TRUNCATE,
+// when the output is cut short. The output is always terminated.
+//
+int _snprintf_s(char * buffer, size_t size, size_t count, const char * format, ...)
+{
+    va_list vaArgs;
+    int length;
+
+    UNREFERENCED_PARAMETER(count);
+
+    va_start(vaArgs, format);
+    length = vsnprintf(buffer, size, format, vaArgs);
+    va_end(vaArgs);
+
+    return (length < 0 || (size_t)length >= size) ? -1 : length;
+}
+
+//
+// FormatUtf8V
+// A vsnprintf that takes a wide format, and writes UTF-8 to buffer.
+// As on Windows, %s takes a wide string. %I is the Windows size_t
+// prefix, and %I64 the prefix for a 64-bit number. The output is always
+// terminated. Returns its length.
+//
+size_t FormatUtf8V(char * buffer, size_t size, const WCHAR * format, va_list vaArgs)
+{
+    size_t length = 0;
+
+    if(size == 0)
+    {
+        return 0;
+    }
+
+    for(const WCHAR * p = format; *p != 0 && length < size - 1; p++)
+    {
+        char spec[16];
+        size_t specLength = 0;
+        int longCount = 0;
+        BOOL sizeArg = FALSE;
+        int written = 0;
+
+        if(*p != L'%')
+        {
+            written = EncodeUtf8(p, 1, (BYTE *)&buffer[length], (int)(size - 1 - length));
+            length += written;
+            continue;
+        }
+
+        // Copy the flags, width and precision as they are
+        spec[specLength++] = '%';
+        for(p++; *p != 0 && *p < 0x80 && strchr("-+ #0123456789.", (char)*p) != NULL && specLength < 8; p++)
+        {
+            spec[specLength++] = (char)*p;
+        }
+
+        for(; *p == L'l' || *p == L'h' || *p == L'z' || *p == L'I'; p++)
+        {
+            if(*p == L'l')
+            {
+                longCount++;
+            }
+            else if(*p == L'I' && p[1] == L'6' && p[2] == L'4')
+            {
+                longCount = 2;
+                p += 2;
+            }
+            else if(*p == L'z' || *p == L'I')
+            {
+                sizeArg = TRUE;
+            }
+        }
+
+        if(*p == 0)
+        {
+            break;
+        }
+
+        if(*p == L's')
+        {
+            const WCHAR * text = va_arg(vaArgs, const WCHAR *);
+            char utf8Text[CB_FORMAT_TEXT];
+            int textLength = 0;
+
+            if(text && text[0] != 0)
+            {
+                textLength = EncodeUtf8(text, (int)min(PortableWcslen(text), CB_FORMAT_TEXT / 3),
+                    (BYTE *)utf8Text, sizeof(utf8Text) - 1);
+            }
+            utf8Text[textLength] = 0;
+
+            spec[specLength++] = 's';
+            spec[specLength] = 0;
+            written = snprintf(&buffer[length], size - length, spec, utf8Text);
+        }
+        else if(*p == L'f' || *p == L'g' || *p == L'e')
+        {
+            spec[specLength++] = (char)*p;
+            spec[specLength] = 0;
+            written = snprintf(&buffer[length], size - length, spec, va_arg(vaArgs, double));
+        }
+        else if(*p == L'p')
+        {
+            spec[specLength++] = 'p';
+            spec[specLength] = 0;
+            written = snprintf(&buffer[length], size - length, spec, va_arg(vaArgs, void *));
+        }
+        else if(*p == L'c')
+        {
+            WCHAR character = (WCHAR)va_arg(vaArgs, int);
+
+            written = EncodeUtf8(&character, 1, (BYTE *)&buffer[length], (int)(size - 1 - length));
+        }
+        else if(*p < 0x80 && strchr("diuxX", (char)*p) != NULL)
+        {
+            BOOL isSigned = (*p == L'd' || *p == L'i');
+
+            // Everything is widened to long long, so one format works for all sizes
+            spec[specLength++] = 'l';
+            spec[specLength++] = 'l';
+            spec[specLength++] = (char)*p;
+            spec[specLength] = 0;
+
+            if(sizeArg)
+            {
+                written = snprintf(&buffer[length], size - length, spec,
+                    isSigned ? (long long)va_arg(vaArgs, ptrdiff_t) : (long long)va_arg(vaArgs, size_t));
+            }
+            else if(longCount >= 2)
+            {
+                written = snprintf(&buffer[length], size - length, spec, va_arg(vaArgs, long long));
+            }
+            else if(longCount == 1)
+            {
+                written = snprintf(&buffer[length], size - length, spec,
+                    isSigned ? (long long)va_arg(vaArgs, long) : (long long)va_arg(vaArgs, unsigned long));
+            }
+            else
+            {
+                written = snprintf(&buffer[length], size - length, spec,
+                    isSigned ? (long long)va_arg(vaArgs, int) : (long long)va_arg(vaArgs, unsigned int));
+            }
+        }
+        else
+        {
+            buffer[length] = (char)*p;
+            written = 1;
+        }
+
+        if(written > 0)
+        {
+            length = min(length + (size_t)written, size - 1);
+        }
+    }
+
+    buffer[length] = 0;
+    return length;
+}
+
+//
+// StringCchVPrintfW
+// Formats wide text like the Windows version. The text is formatted as
+// UTF-8 by FormatUtf8V, then decoded. Fails with
+// STRSAFE_E_INSUFFICIENT_BUFFER if the text was cut short.
+//
+HRESULT StringCchVPrintfW(WCHAR * dst, size_t cchDst, const WCHAR * format, va_list vaArgs)
+{
+    char buffer[CB_FORMAT_TEXT];
+    size_t length;
+    int textLength;
+
+    if(cchDst == 0)
+    {
+        return STRSAFE_E_INVALID_PARAMETER;
+    }
+
+    length = FormatUtf8V(buffer, sizeof(buffer), format, vaArgs);
+    textLength = DecodeUtf8((const BYTE *)buffer, (int)length, dst, (int)(cchDst - 1));
+    if(textLength == 0 && length > 0)
+    {
+        // It doesn't fit, so decode as much of it as does
+        while(length > 0 && textLength == 0)
+        {
+            length--;
+            textLength = DecodeUtf8((const BYTE *)buffer, (int)length, dst, (int)(cchDst - 1));
+        }
+        dst[textLength] = 0;
+        return STRSAFE_E_INSUFFICIENT_BUFFER;
+    }
+
+    dst[textLength] = 0;
+    return (length == sizeof(buffer) - 1) ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+//
+// StringCchLengthW
+// Gets the length of text, which has to be shorter than cchMax
+//
+HRESULT StringCchLengthW(const WCHAR * text, size_t cchMax, size_t * length)
+{
+    size_t i = 0;
+
+    while(i < cchMax && text[i] != 0)
+    {
+        i++;
+    }
+
+    if(length)
+    {
+        *length = (i < cchMax) ? i : 0;
+    }
+
+    return (i < cchMax) ? S_OK : STRSAFE_E_INVALID_PARAMETER;
+}
+
+//
+// DebugLog
+// A printf style logging function for debug builds, that writes to stderr.
+// The format is the same as on Windows, as FormatUtf8V takes it.
+//
+#ifdef DEBUG
+void DebugLog(const WCHAR * format, ...)
+{
+    va_list vaArgs;
+    char buffer[CB_FORMAT_TEXT];
+    size_t length;
+
+    va_start(vaArgs, format);
+    length = FormatUtf8V(buffer, sizeof(buffer) - 1, format, vaArgs);
+    va_end(vaArgs);
+
+    // OutputDebugString doesn't need a line break at the end, but stderr does
+    if(length > 0 && buffer[length - 1] != '\n')
+    {
+        buffer[length++] = '\n';
+    }
+
+    buffer[length] = 0;
+    fputs(buffer, stderr);
+}
+#else /* DEBUG */
+//
+// Do not log in release builds
+//
+void DebugLog(const WCHAR * format, ...)
+{
+    UNREFERENCED_PARAMETER(format);
+}
+#endif /* DEBUG */
+
+//
+// GetPeakMemoryUsage
+// Returns the peak resident set size of the process, in bytes
+//
+ULONGLONG GetPeakMemoryUsage(void)
+{
+    struct rusage usage;
+
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+
+    // ru_maxrss is in kilobytes on Linux
+    return (ULONGLONG)usage.ru_maxrss * 1024;
+}
+
+//
+// GetProcessorCount
+// Returns the number of processors online
+//
+DWORD GetProcessorCount(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (DWORD)count : 1;
+}
+
+//
+// ParallelThreadProc
+// Runs one task of RunParallelTasks on its own thread
+//
+DWORD ParallelThreadProc(LPVOID param)
+{
+    PARALLEL_WORK * parallelWork = param;
+
+    parallelWork->callback(parallelWork->task);
+    return 0;
+}
+
+//
+// RunParallelTasks
+// Runs callback for each of taskCount tasks, which are taskSize bytes
+// apart starting at tasks, and waits for all of them to finish. The
+// first task runs on this thread while the others each get a thread
+// of their own. A task whose thread can't be started runs on this
+// thread too.
+//
+void RunParallelTasks(PARALLEL_TASK_CALLBACK callback, void * tasks, size_t taskSize, DWORD taskCount)
+{
+    PARALLEL_WORK parallelWork[MAX_PARALLEL_TASKS];
+    HANDLE threads[MAX_PARALLEL_TASKS] = {0};
+    DWORD i;
+
+    taskCount = min(taskCount, MAX_PARALLEL_TASKS);
+
+    for(i = 1; i < taskCount; i++)
+    {
+        parallelWork[i].callback = callback;
+        parallelWork[i].task = (BYTE *)tasks + i * taskSize;
+        threads[i] = CreateThread(NULL, 0, ParallelThreadProc, &parallelWork[i], 0, NULL);
+    }
+
+    if(taskCount > 0)
+    {
+        callback(tasks);
+    }
+
+    for(i = 1; i < taskCount; i++)
+    {
+        if(threads[i])
+        {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+        else
+        {
+            callback(parallelWork[i].task);
+        }
+    }
+}
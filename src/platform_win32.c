@@ -0,0 +1,151 @@
+/* -------------------------------------------------------------
+
+platform_win32.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    The platform layer under the portable core, for Windows.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <windows.h>
+#include <psapi.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "platform.h"
+
+//
+// DebugLog
+// A printf style logging function for debug builds.
+// The message is formatted on the stack, so any thread can log.
+//
+#ifdef DEBUG
+#define DEBUG_LOG_BUFFER_SIZE 1024
+void DebugLog(const WCHAR * format, ...)
+{
+    va_list vaArgs;
+    WCHAR buffer[DEBUG_LOG_BUFFER_SIZE];
+
+    va_start(vaArgs, format);
+    if(vswprintf(buffer, DEBUG_LOG_BUFFER_SIZE, format, vaArgs) > 0)
+    {
+        OutputDebugStringW(buffer);
+    }
+    va_end(vaArgs);
+}
+#else /* DEBUG */
+//
+// Do not log in release builds
+//
+void DebugLog(const WCHAR * format, ...)
+{
+    UNREFERENCED_PARAMETER(format);
+}
+#endif /* DEBUG */
+
+//
+// DecodeUtf8
+// Converts dataSize bytes of UTF-8 to at most capacity wide chars.
+// Invalid sequences become U+FFFD. Nulls are converted like any other
+// character, and no terminator is added.
+// Returns the number of wide chars, or 0 if they don't fit.
+//
+int DecodeUtf8(const BYTE * data, int dataSize, WCHAR * wideText, int capacity)
+{
+    return MultiByteToWideChar(CP_UTF8, 0, (LPCCH)data, dataSize, wideText, capacity);
+}
+
+//
+// EncodeUtf8
+// Converts textLength wide chars to at most dstSize bytes of UTF-8.
+// Lone surrogates become U+FFFD.
+// Returns the number of bytes, or 0 if they don't fit.
+//
+int EncodeUtf8(LPCWSTR wideText, int textLength, BYTE * dst, int dstSize)
+{
+    return WideCharToMultiByte(CP_UTF8, 0, wideText, textLength, (LPSTR)dst, dstSize, NULL, NULL);
+}
+
+//
+// GetPeakMemoryUsage
+// Returns the peak working set of the process, in bytes
+//
+ULONGLONG GetPeakMemoryUsage(void)
+{
+    PROCESS_MEMORY_COUNTERS memoryCounters = {0};
+
+    GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters));
+
+    return (ULONGLONG)memoryCounters.PeakWorkingSetSize;
+}
+
+//
+// GetProcessorCount
+// Returns the number of logical processors
+//
+DWORD GetProcessorCount(void)
+{
+    SYSTEM_INFO systemInfo;
+
+    GetSystemInfo(&systemInfo);
+
+    return systemInfo.dwNumberOfProcessors;
+}
+
+//
+// ParallelWorkCallback
+// Thread pool callback that runs one task of RunParallelTasks
+//
+VOID CALLBACK ParallelWorkCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work)
+{
+    PARALLEL_WORK * parallelWork = context;
+
+    UNREFERENCED_PARAMETER(instance);
+    UNREFERENCED_PARAMETER(work);
+
+    parallelWork->callback(parallelWork->task);
+}
+
+//
+// RunParallelTasks
+// Runs callback for each of taskCount tasks, which are taskSize bytes
+// apart starting at tasks, and waits for all of them to finish. The
+// first task runs on this thread while the others run on the thread
+// pool. A task that can't be queued runs on this thread too.
+//
+void RunParallelTasks(PARALLEL_TASK_CALLBACK callback, void * tasks, size_t taskSize, DWORD taskCount)
+{
+    PARALLEL_WORK parallelWork[MAX_PARALLEL_TASKS];
+    PTP_WORK work[MAX_PARALLEL_TASKS] = {0};
+    DWORD i;
+
+    taskCount = min(taskCount, MAX_PARALLEL_TASKS);
+
+    for(i = 1; i < taskCount; i++)
+    {
+        parallelWork[i].callback = callback;
+        parallelWork[i].task = (BYTE *)tasks + i * taskSize;
+        work[i] = CreateThreadpoolWork(ParallelWorkCallback, &parallelWork[i], NULL);
+        if(work[i])
+        {
+            SubmitThreadpoolWork(work[i]);
+        }
+    }
+
+    if(taskCount > 0)
+    {
+        callback(tasks);
+    }
+
+    for(i = 1; i < taskCount; i++)
+    {
+        if(work[i])
+        {
+            WaitForThreadpoolWorkCallbacks(work[i], FALSE);
+            CloseThreadpoolWork(work[i]);
+        }
+        else
+        {
+            callback(parallelWork[i].task);
+        }
+    }
+}
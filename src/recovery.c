@@ -0,0 +1,668 @@
+/* -------------------------------------------------------------
+
+recovery.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for recovering unsaved edits after a crash.
+    A copy of the text as it was last journaled is kept in memory.
+    On a timer, the edit text is compared with it, and the change
+    is appended to a journal that sits next to the file. Opening
+    the file again replays the journal on top of it.
+    Edits are tracked as they're made, so the comparison only has to
+    look at the text around them, not the whole document.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+
+#include <windows.h>
+#include <commctrl.h>
+#include <shlwapi.h>
+#include <strsafe.h>
+#include "esnpad.h"
+
+// Holds the unsaved edits to a file
+#define RECOVERY_JOURNAL_SUFFIX L".esnpad-recovery"
+
+// Marks the start of a recovery journal, "ESNR"
+#define RECOVERY_JOURNAL_MAGIC 0x524E5345
+
+// Marks the start of each record in a recovery journal, "ESNE"
+#define RECOVERY_RECORD_MAGIC 0x454E5345
+
+// A journal for a different version of the file is kept aside with
+// this suffix and a number, up to this many of them
+#define RECOVERY_KEPT_SUFFIX L".old"
+#define RECOVERY_MAX_KEPT 100
+
+// The ID of the edit control subclass
+#define RECOVERY_SUBCLASS_ID 4
+
+// Ctrl+Z, which the edit control undoes as a character
+#define RECOVERY_UNDO_CHAR 0x1A
+
+// Records are written as they're made, so they survive the app crashing.
+// Flushing them to disk, which makes them survive the system crashing,
+// is batched since it's much slower.
+#define RECOVERY_FLUSH_INTERVAL_MS 5000
+
+//
+// globals
+//
+BOOL g_recoveryPending = FALSE;     // the edit text changed since it was last journaled
+DIRTY_RANGE g_recoveryDirty;        // where it changed
+int g_recoveryEditDepth = 0;        // the tracked edit messages being handled
+BOOL g_recoveryEditChanged = FALSE; // the text changed while handling them
+
+WCHAR * g_recoveryText = NULL;      // the edit text as of the last record
+size_t g_recoveryLength = 0;        // in characters
+size_t g_recoveryCapacity = 0;      // in characters
+
+WCHAR g_recoveryFile[MAX_PATH] = {0};
+HANDLE g_hRecoveryJournal = INVALID_HANDLE_VALUE;
+BOOL g_recoveryUnflushed = FALSE;
+ULONGLONG g_recoveryLastFlush = 0;
+
+extern HWND g_hwndMain;
+extern HWND g_hwndEdit;
+extern FILE_FINGERPRINT g_activeFingerprint;
+
+//
+// GetRecoveryJournalPath
+// Builds the path of the recovery journal for filePath.
+//
+BOOL GetRecoveryJournalPath(LPCWSTR filePath, LPWSTR journalPath, size_t cchJournalPath)
+{
+    return SUCCEEDED(StringCchPrintfW(journalPath, cchJournalPath, L"%s%s", filePath, RECOVERY_JOURNAL_SUFFIX));
+}
+
+//
+// HashRecoveryRecord
+// Computes the checksum of a record, so a record that was
+// only partly written before a crash isn't replayed.
+//
+DWORD HashRecoveryRecord(const RECOVERY_RECORD * record, LPCWSTR inserted)
+{
+    return HashBytes((const BYTE *)inserted, (size_t)record->insertedLength * sizeof(WCHAR)) ^
+        (DWORD)record->start ^ (DWORD)(record->start >> 32) ^
+        (DWORD)record->removedLength ^ (DWORD)record->insertedLength;
+}
+
+//
+// ApplyRecoveryEdit
+// Replaces removedLength characters at start in g_recoveryText
+// with the insertedLength characters in inserted.
+//
+BOOL ApplyRecoveryEdit(size_t start, size_t removedLength, LPCWSTR inserted, size_t insertedLength)
+{
+    size_t newLength;
+    size_t newCapacity;
+    WCHAR * newText;
+
+    if(!g_recoveryText || start > g_recoveryLength || removedLength > g_recoveryLength - start)
+    {
+        return FALSE;
+    }
+
+    // Grow the buffer with room to spare, so typing doesn't reallocate it every time
+    newLength = g_recoveryLength - removedLength + insertedLength;
+    if(newLength + 1 > g_recoveryCapacity)
+    {
+        newCapacity = newLength + (newLength / 2) + 1;
+        newText = HeapReAlloc(GetProcessHeap(), 0, g_recoveryText, newCapacity * sizeof(WCHAR));
+        if(!newText)
+        {
+            return FALSE;
+        }
+
+        g_recoveryText = newText;
+        g_recoveryCapacity = newCapacity;
+    }
+
+    memmove(g_recoveryText + start + insertedLength, g_recoveryText + start + removedLength,
+        (g_recoveryLength - start - removedLength) * sizeof(WCHAR));
+    memcpy(g_recoveryText + start, inserted, insertedLength * sizeof(WCHAR));
+
+    g_recoveryLength = newLength;
+    g_recoveryText[newLength] = 0;
+
+    return TRUE;
+}
+
+//
+// SetRecoveryBaseline
+// Takes ownership of text, the edit text as it was just loaded,
+// as the starting point for journaling edits. capacity is the size
+// of the text buffer in characters. text can be NULL to stop tracking.
+//
+void SetRecoveryBaseline(WCHAR * text, size_t length, size_t capacity)
+{
+    if(g_recoveryText)
+    {
+        HeapFree(GetProcessHeap(), 0, g_recoveryText);
+    }
+
+    g_recoveryText = text;
+    g_recoveryLength = text ? length : 0;
+    g_recoveryCapacity = text ? capacity : 0;
+    g_recoveryPending = FALSE;
+    ClearDirtyRange(&g_recoveryDirty);
+}
+
+//
+// DiscardRecoveryJournal
+// Closes and deletes the journal for the current file. Called once
+// its unsaved edits have been saved, or the user chose to throw them away.
+//
+void DiscardRecoveryJournal(void)
+{
+    WCHAR journalPath[MAX_PATH];
+
+    if(g_hRecoveryJournal != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(g_hRecoveryJournal);
+        g_hRecoveryJournal = INVALID_HANDLE_VALUE;
+
+        if(GetRecoveryJournalPath(g_recoveryFile, journalPath, ARRAYSIZE(journalPath)))
+        {
+            DeleteFile(journalPath);
+        }
+    }
+
+    ZeroMemory(g_recoveryFile, sizeof(g_recoveryFile));
+    g_recoveryUnflushed = FALSE;
+}
+
+//
+// CreateRecoveryJournal
+// Creates the journal for the current file, when its first
+// edit is recorded. Saved and unedited files don't have one.
+//
+BOOL CreateRecoveryJournal(void)
+{
+    RECOVERY_JOURNAL_HEADER header;
+    DWORD bytesWritten;
+    WCHAR journalPath[MAX_PATH];
+
+    if(!GetRecoveryJournalPath(g_recoveryFile, journalPath, ARRAYSIZE(journalPath)))
+    {
+        return FALSE;
+    }
+
+    // Never replace a journal this didn't write, like one that was left
+    // for a different version of the file and couldn't be moved aside
+    g_hRecoveryJournal = CreateFile(journalPath, GENERIC_WRITE, FILE_SHARE_READ,
+        NULL, CREATE_NEW, FILE_ATTRIBUTE_HIDDEN, NULL);
+
+    if(g_hRecoveryJournal == INVALID_HANDLE_VALUE)
+    {
+        DebugLog(L"Couldn't create recovery journal: %s", journalPath);
+        return FALSE;
+    }
+
+    header.magic = RECOVERY_JOURNAL_MAGIC;
+    header.reserved = 0;
+    // The baseline is the active file as it was last loaded or saved
+    header.fingerprint = g_activeFingerprint;
+
+    return WriteFile(g_hRecoveryJournal, &header, sizeof(header), &bytesWritten, NULL);
+}
+
+//
+// AppendRecoveryRecord
+// Writes one edit to the end of the journal.
+//
+BOOL AppendRecoveryRecord(size_t start, size_t removedLength, LPCWSTR inserted, size_t insertedLength)
+{
+    BOOL success = FALSE;
+    RECOVERY_RECORD * record;
+    size_t recordSize;
+    DWORD bytesWritten;
+    SCRATCH_MARK scratch;
+
+    if(g_hRecoveryJournal == INVALID_HANDLE_VALUE && !CreateRecoveryJournal())
+    {
+        return FALSE;
+    }
+
+    // Put the record together so it's written with a single call
+    recordSize = sizeof(RECOVERY_RECORD) + insertedLength * sizeof(WCHAR);
+    if(recordSize > MAXDWORD)
+    {
+        return FALSE;
+    }
+
+    scratch = ScratchBegin();
+    record = ScratchAlloc(recordSize);
+    if(record)
+    {
+        record->magic = RECOVERY_RECORD_MAGIC;
+        record->start = start;
+        record->removedLength = removedLength;
+        record->insertedLength = insertedLength;
+        record->checksum = HashRecoveryRecord(record, inserted);
+        memcpy(record + 1, inserted, insertedLength * sizeof(WCHAR));
+
+        success = WriteFile(g_hRecoveryJournal, record, (DWORD)recordSize, &bytesWritten, NULL);
+        g_recoveryUnflushed = TRUE;
+    }
+
+    ScratchEnd(scratch);
+
+    return success;
+}
+
+//
+// RecoveryTextChanged
+// Called when the edit control sends EN_CHANGE. A change made while
+// handling a tracked edit message is where RecoveryEditProc says it is.
+// Any other change could be anywhere, so all of the text is compared.
+//
+void RecoveryTextChanged(void)
+{
+    g_recoveryPending = TRUE;
+
+    if(g_recoveryEditDepth > 0)
+    {
+        g_recoveryEditChanged = TRUE;
+    }
+    else
+    {
+        MarkAllDirty(&g_recoveryDirty);
+    }
+}
+
+//
+// IsTrackedRecoveryEdit
+// Returns whether msg only changes the text at the selection,
+// like typing, deleting, cutting, and pasting
+//
+BOOL IsTrackedRecoveryEdit(UINT msg, WPARAM wParam)
+{
+    switch(msg)
+    {
+    case WM_CHAR:
+        return wParam != RECOVERY_UNDO_CHAR;
+    case WM_KEYDOWN:
+        // The other keys move the caret, or send characters
+        return wParam == VK_DELETE || wParam == VK_INSERT;
+    case WM_CUT:
+    case WM_CLEAR:
+    case WM_PASTE:
+    case EM_REPLACESEL:
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+//
+// RecoveryEditProc
+// The subclass procedure for the edit control that tracks where
+// edits change the text, from the selection before and after them
+//
+LRESULT CALLBACK RecoveryEditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam,
+    UINT_PTR idSubclass, DWORD_PTR refData)
+{
+    LRESULT result;
+    BOOL outerChanged;
+    int outerDepth;
+    DWORD oldStart = 0;
+    DWORD oldEnd = 0;
+    DWORD newStart = 0;
+    DWORD newEnd = 0;
+    int oldLength;
+
+    UNREFERENCED_PARAMETER(refData);
+
+    if(msg == WM_NCDESTROY)
+    {
+        RemoveWindowSubclass(hwnd, RecoveryEditProc, idSubclass);
+        return DefSubclassProc(hwnd, msg, wParam, lParam);
+    }
+
+    if(IsTrackedRecoveryEdit(msg, wParam))
+    {
+        SendMessage(hwnd, EM_GETSEL, (WPARAM)&oldStart, (LPARAM)&oldEnd);
+        oldLength = GetWindowTextLength(hwnd);
+
+        outerChanged = g_recoveryEditChanged;
+        g_recoveryEditChanged = FALSE;
+        g_recoveryEditDepth++;
+
+        result = DefSubclassProc(hwnd, msg, wParam, lParam);
+
+        g_recoveryEditDepth--;
+        if(g_recoveryEditChanged)
+        {
+            SendMessage(hwnd, EM_GETSEL, (WPARAM)&newStart, (LPARAM)&newEnd);
+            AddDirtyEdit(&g_recoveryDirty, oldLength, oldStart, oldEnd,
+                GetWindowTextLength(hwnd), newStart, newEnd);
+        }
+
+        g_recoveryEditChanged = g_recoveryEditChanged || outerChanged;
+        return result;
+    }
+
+    if(g_recoveryEditDepth > 0)
+    {
+        // Like an undo sent while handling a keystroke,
+        // which can change the text away from the selection
+        outerDepth = g_recoveryEditDepth;
+        g_recoveryEditDepth = 0;
+        result = DefSubclassProc(hwnd, msg, wParam, lParam);
+        g_recoveryEditDepth = outerDepth;
+        return result;
+    }
+
+    return DefSubclassProc(hwnd, msg, wParam, lParam);
+}
+
+//
+// AttachRecoveryTracking
+// Subclasses a new edit control so its edits are tracked
+//
+void AttachRecoveryTracking(HWND hwndEdit)
+{
+    if(!SetWindowSubclass(hwndEdit, RecoveryEditProc, RECOVERY_SUBCLASS_ID, 0))
+    {
+        DebugLog(L"Unable to subclass the edit control for recovery");
+    }
+
+    // Until it's tracked, an edit could be anywhere
+    MarkAllDirty(&g_recoveryDirty);
+}
+
+//
+// AutosaveRecoveryJournal
+// Called on a timer. If the edit text has changed, records the change in
+// the journal as a single edit covering everything between the first and
+// last characters that differ. Only the text around the edits made since
+// the last tick is compared, so the cost doesn't grow with the document.
+//
+void AutosaveRecoveryJournal(void)
+{
+    HLOCAL hText;
+    LPCWSTR text;
+    size_t length;
+    size_t prefix;
+    size_t suffix;
+
+    if(g_recoveryPending && g_recoveryText && g_recoveryFile[0] != 0)
+    {
+        g_recoveryPending = FALSE;
+
+        // Read the text in place, rather than copying it out of the edit control
+        hText = (HLOCAL)SendMessage(g_hwndEdit, EM_GETHANDLE, 0, 0);
+        text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+        if(text)
+        {
+            length = GetWindowTextLength(g_hwndEdit);
+
+            if(FindChangedRange(g_recoveryText, g_recoveryLength, text, length, &g_recoveryDirty, &prefix, &suffix))
+            {
+                if(!AppendRecoveryRecord(prefix, g_recoveryLength - prefix - suffix,
+                    text + prefix, length - prefix - suffix))
+                {
+                    // Try again on the next tick, with any edits made since
+                    g_recoveryPending = TRUE;
+                }
+                else if(!ApplyRecoveryEdit(prefix, g_recoveryLength - prefix - suffix,
+                    text + prefix, length - prefix - suffix))
+                {
+                    // The journal no longer matches the baseline, so stop journaling
+                    DebugLog(L"Unable to update the recovery baseline, recovery is off");
+                    DiscardRecoveryJournal();
+                    SetRecoveryBaseline(NULL, 0, 0);
+                }
+                else
+                {
+                    ClearDirtyRange(&g_recoveryDirty);
+                }
+            }
+            else
+            {
+                ClearDirtyRange(&g_recoveryDirty);
+            }
+
+            LocalUnlock(hText);
+        }
+    }
+
+    if(g_recoveryUnflushed && GetTickCount64() - g_recoveryLastFlush >= RECOVERY_FLUSH_INTERVAL_MS)
+    {
+        FlushFileBuffers(g_hRecoveryJournal);
+        g_recoveryUnflushed = FALSE;
+        g_recoveryLastFlush = GetTickCount64();
+    }
+}
+
+//
+// ResetRecoveryJournal
+// Called after the edit text is saved to filePath. The saved file is the
+// new starting point, so the journal is deleted and the edit text is
+// copied as the new baseline.
+//
+void ResetRecoveryJournal(LPCWSTR filePath)
+{
+    HLOCAL hText;
+    LPCWSTR text;
+    size_t length;
+
+    DiscardRecoveryJournal();
+
+    hText = (HLOCAL)SendMessage(g_hwndEdit, EM_GETHANDLE, 0, 0);
+    text = hText ? (LPCWSTR)LocalLock(hText) : NULL;
+    if(text)
+    {
+        // Empty the baseline, then put the whole text in as one edit
+        length = GetWindowTextLength(g_hwndEdit);
+        if(!g_recoveryText)
+        {
+            g_recoveryText = HeapAlloc(GetProcessHeap(), 0, (length + 1) * sizeof(WCHAR));
+            g_recoveryCapacity = g_recoveryText ? length + 1 : 0;
+        }
+
+        g_recoveryLength = 0;
+        if(g_recoveryText && ApplyRecoveryEdit(0, 0, text, length))
+        {
+            StringCchCopyW(g_recoveryFile, ARRAYSIZE(g_recoveryFile), filePath);
+        }
+
+        LocalUnlock(hText);
+    }
+
+    g_recoveryPending = FALSE;
+    ClearDirtyRange(&g_recoveryDirty);
+}
+
+//
+// KeepStaleRecoveryJournal
+// Called when the journal for filePath was made for a different version
+// of the file, so its edits can't be replayed on the file as it is now.
+// Asks whether to keep it, and if so renames it aside, where a new journal
+// won't overwrite it. It's only deleted if the user says they don't want it.
+//
+void KeepStaleRecoveryJournal(LPCWSTR filePath, LPCWSTR journalPath)
+{
+    WCHAR prompt[CB_PROMPT_MESSAGE];
+    WCHAR keptPath[MAX_PATH];
+    LPCWSTR fileName = PathFindFileName(filePath);
+    int result;
+
+    StringCchPrintf(prompt, ARRAYSIZE(prompt),
+        L"Unsaved edits to %s were found, but they were made to a version of the file "
+        L"that has since changed, so they can't be recovered into it.\n\n"
+        L"Do you want to keep them in a separate file? If you don't, they'll be deleted.", fileName);
+
+    result = MessageBox(g_hwndMain, prompt, APP_TITLE_W, MB_YESNO|MB_ICONWARNING|MB_APPLMODAL);
+    if(result != IDYES)
+    {
+        DebugLog(L"Deleting recovery journal for a different file: %s", journalPath);
+        DeleteFile(journalPath);
+        return;
+    }
+
+    // Never replace a journal that was kept before
+    for(int i = 1; i <= RECOVERY_MAX_KEPT; i++)
+    {
+        if(FAILED(StringCchPrintfW(keptPath, ARRAYSIZE(keptPath), L"%s%s%d", journalPath, RECOVERY_KEPT_SUFFIX, i)))
+        {
+            break;
+        }
+
+        if(MoveFileEx(journalPath, keptPath, 0))
+        {
+            DebugLog(L"Kept recovery journal for a different file as %s", keptPath);
+            StringCchPrintf(prompt, ARRAYSIZE(prompt), L"The unsaved edits were kept in:\n\n%s", keptPath);
+            MessageBox(g_hwndMain, prompt, APP_TITLE_W, MB_OK|MB_ICONINFORMATION|MB_APPLMODAL);
+            return;
+        }
+
+        if(GetLastError() != ERROR_ALREADY_EXISTS && GetLastError() != ERROR_FILE_EXISTS)
+        {
+            break;
+        }
+    }
+
+    DebugLog(L"Couldn't keep recovery journal for a different file: %s", journalPath);
+    MessageBox(g_hwndMain, L"The unsaved edits couldn't be moved, so they were left where they are. "
+        L"Edits to this file won't be journaled until they're moved or deleted.",
+        APP_TITLE_W, MB_OK|MB_ICONWARNING|MB_APPLMODAL);
+
+    return;
+}
+
+//
+// RecoverUnsavedEdits
+// Called after filePath is loaded, and SetRecoveryBaseline has been
+// given its text. If a journal of unsaved edits was left behind for this
+// exact file, replays it on the baseline and returns TRUE. The recovered
+// text can then be read with GetRecoveryText. Journaling continues
+// where the old journal left off.
+//
+BOOL RecoverUnsavedEdits(LPCWSTR filePath, const FILE_FINGERPRINT * fingerprint)
+{
+    HANDLE hJournal;
+    RECOVERY_JOURNAL_HEADER header;
+    RECOVERY_RECORD record;
+    WCHAR * inserted;
+    DWORD insertedSize;
+    DWORD bytesRead;
+    LARGE_INTEGER validSize;
+    SCRATCH_MARK scratch;
+    int recordCount = 0;
+    WCHAR journalPath[MAX_PATH];
+
+    DiscardRecoveryJournal();
+
+    if(!g_recoveryText || !GetRecoveryJournalPath(filePath, journalPath, ARRAYSIZE(journalPath)) ||
+        FAILED(StringCchCopyW(g_recoveryFile, ARRAYSIZE(g_recoveryFile), filePath)))
+    {
+        return FALSE;
+    }
+
+    hJournal = CreateFile(journalPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if(hJournal == INVALID_HANDLE_VALUE)
+    {
+        // No journal, so there's nothing to recover
+        return FALSE;
+    }
+
+    // A journal without a whole header has no edits in it
+    if(!ReadFile(hJournal, &header, sizeof(header), &bytesRead, NULL) ||
+        bytesRead != sizeof(header) ||
+        header.magic != RECOVERY_JOURNAL_MAGIC)
+    {
+        DebugLog(L"Discarding damaged recovery journal: %s", journalPath);
+        CloseHandle(hJournal);
+        DeleteFile(journalPath);
+        return FALSE;
+    }
+
+    // Edits to a different version of the file can't be replayed,
+    // but they're the user's, so they're only deleted if they say so
+    if(!FingerprintsMatch(&header.fingerprint, fingerprint))
+    {
+        CloseHandle(hJournal);
+        KeepStaleRecoveryJournal(filePath, journalPath);
+        return FALSE;
+    }
+
+    validSize.QuadPart = sizeof(header);
+
+    // Replay records until the end, or the first one that's damaged.
+    // A damaged record was being written when the app stopped.
+    while(ReadFile(hJournal, &record, sizeof(record), &bytesRead, NULL) &&
+        bytesRead == sizeof(record) &&
+        record.magic == RECOVERY_RECORD_MAGIC &&
+        record.insertedLength <= (MAXDWORD - sizeof(record)) / sizeof(WCHAR))
+    {
+        insertedSize = (DWORD)record.insertedLength * sizeof(WCHAR);
+        scratch = ScratchBegin();
+        inserted = ScratchAlloc(max(insertedSize, sizeof(WCHAR)));
+        if(!inserted)
+        {
+            ScratchEnd(scratch);
+            break;
+        }
+
+        if(!ReadFile(hJournal, inserted, insertedSize, &bytesRead, NULL) ||
+            bytesRead != insertedSize ||
+            record.checksum != HashRecoveryRecord(&record, inserted) ||
+            !ApplyRecoveryEdit((size_t)record.start, (size_t)record.removedLength,
+                inserted, (size_t)record.insertedLength))
+        {
+            ScratchEnd(scratch);
+            break;
+        }
+
+        ScratchEnd(scratch);
+
+        validSize.QuadPart += sizeof(record) + insertedSize;
+        recordCount++;
+    }
+
+    if(recordCount == 0)
+    {
+        CloseHandle(hJournal);
+        DeleteFile(journalPath);
+        return FALSE;
+    }
+
+    DebugLog(L"Recovered %d unsaved edits from %s", recordCount, journalPath);
+
+    // Drop any damaged record, and append new ones after the last good one
+    SetFilePointerEx(hJournal, validSize, NULL, FILE_BEGIN);
+    SetEndOfFile(hJournal);
+    g_hRecoveryJournal = hJournal;
+
+    return TRUE;
+}
+
+//
+// AppendToRecoveryBaseline
+// Adds text to the end of the baseline, after the same text
+// was appended to the edit control from the file on disk.
+//
+void AppendToRecoveryBaseline(LPCWSTR text, size_t length)
+{
+    if(!ApplyRecoveryEdit(g_recoveryLength, 0, text, length))
+    {
+        SetRecoveryBaseline(NULL, 0, 0);
+    }
+
+    // The edit control and the baseline match again
+    g_recoveryPending = FALSE;
+    ClearDirtyRange(&g_recoveryDirty);
+}
+
+//
+// GetRecoveryText
+// Returns the text as of the last journaled edit.
+//
+LPCWSTR GetRecoveryText(void)
+{
+    return g_recoveryText;
+}
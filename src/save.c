@@ -0,0 +1,293 @@
+/* -------------------------------------------------------------
+
+save.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for safely writing text to files.
+    A save either rewrites only the end of the file that changed,
+    protected by a journal, or writes a new copy of the file
+    and swaps it into place.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+
+#include <windows.h>
+#include <strsafe.h>
+#include "esnpad.h"
+
+// Holds the original bytes while a file is being changed in place
+#define SAVE_JOURNAL_SUFFIX L".esnpad-save"
+
+// Holds the new copy of a file until it replaces the original
+#define SAVE_TEMP_SUFFIX L".esnpad-tmp"
+
+// Room for the path of a file next to one being saved: a path of
+// up to MAX_PATH, a suffix, and the prefix that lifts the MAX_PATH limit
+#define CCH_SAVE_PATH (MAX_PATH + 32)
+
+//
+// GetSavePath
+// Builds the path of one of the files that sits next to filePath
+// while it's being saved, by appending suffix. When that's longer than
+// MAX_PATH, the full path is prefixed with \\?\ so the file APIs accept
+// it. savePath should hold CCH_SAVE_PATH characters.
+//
+BOOL GetSavePath(LPCWSTR filePath, LPCWSTR suffix, LPWSTR savePath, size_t cchSavePath)
+{
+    if(wcslen(filePath) + wcslen(suffix) < MAX_PATH)
+    {
+        return SUCCEEDED(StringCchPrintfW(savePath, cchSavePath, L"%s%s", filePath, suffix));
+    }
+
+    // A long path has to be a full one, since it isn't normalized
+    if(filePath[0] == L'\\' && filePath[1] == L'\\')
+    {
+        if(filePath[2] == L'?' || filePath[2] == L'.')
+        {
+            // It already has a prefix
+            return SUCCEEDED(StringCchPrintfW(savePath, cchSavePath, L"%s%s", filePath, suffix));
+        }
+
+        return SUCCEEDED(StringCchPrintfW(savePath, cchSavePath, L"\\\\?\\UNC\\%s%s", filePath + 2, suffix));
+    }
+
+    if(filePath[0] == 0 || filePath[1] != L':' || filePath[2] != L'\\')
+    {
+        DebugLog(L"Path is too long to save next to: %s", filePath);
+        return FALSE;
+    }
+
+    return SUCCEEDED(StringCchPrintfW(savePath, cchSavePath, L"\\\\?\\%s%s", filePath, suffix));
+}
+
+//
+// WriteWideTextToFile
+// Creates filePath, or truncates it, and writes wideText
+// to it with the specified encoding, BOM first.
+//
+BOOL WriteWideTextToFile(LPCWSTR filePath, LPCWSTR wideText, size_t textLength, int encoding,
+    BYTE * chunk, size_t * bytesWritten)
+{
+    BOOL success = TRUE;
+    HANDLE hFile;
+    const BYTE * bom;
+    size_t bomSize;
+    DWORD bomBytesWritten;
+
+    hFile = CreateFile(filePath, GENERIC_WRITE, 0,
+        NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        // Early exit
+        DebugLog(L"Couldn't open file for writing: %s", filePath);
+        return FALSE;
+    }
+
+    // Start with the BOM, if this encoding has one
+    bom = GetEncodingBom(encoding, &bomSize);
+    if(bomSize > 0)
+    {
+        success = WriteFile(hFile, bom, (DWORD)bomSize, &bomBytesWritten, NULL);
+        *bytesWritten += bomBytesWritten;
+    }
+
+    if(success)
+    {
+        success = WriteEncodedText(hFile, wideText, textLength, encoding, chunk, bytesWritten);
+    }
+
+    // The new copy has to be on disk before it replaces the original
+    if(success)
+    {
+        success = FlushFileBuffers(hFile);
+    }
+
+    CloseHandle(hFile);
+    return success;
+}
+
+//
+// SaveFullCopy
+// Writes wideText to a temporary file next to filePath, then swaps it
+// into place. If anything fails, the original file is left untouched.
+// Only when the temporary file can't be named is filePath written directly.
+//
+BOOL SaveFullCopy(LPCWSTR filePath, LPCWSTR wideText, size_t textLength, int encoding,
+    BYTE * chunk, size_t * bytesWritten)
+{
+    WCHAR tempPath[CCH_SAVE_PATH];
+
+    if(!GetSavePath(filePath, SAVE_TEMP_SUFFIX, tempPath, ARRAYSIZE(tempPath)))
+    {
+        // There's no name for a copy, so the file can only be written in place
+        return WriteWideTextToFile(filePath, wideText, textLength, encoding, chunk, bytesWritten);
+    }
+
+    if(!WriteWideTextToFile(tempPath, wideText, textLength, encoding, chunk, bytesWritten))
+    {
+        DeleteFile(tempPath);
+        return FALSE;
+    }
+
+    // ReplaceFile keeps the original's attributes and security,
+    // but it needs the original to exist.
+    if(!ReplaceFile(filePath, tempPath, NULL, REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL))
+    {
+        if(!MoveFileEx(tempPath, filePath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            DebugLog(L"Couldn't replace %s, error %u", filePath, GetLastError());
+            DeleteFile(tempPath);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+//
+// SaveIncremental
+// Rewrites filePath in place from the first chunk that changed to the
+// end, leaving the unchanged start of the file alone. The bytes being
+// replaced are journaled first. Returns FALSE without touching the file
+// if it's small, can't be mapped, or IsIncrementalSaveWorthwhile says
+// too much of it changed. The caller should then save a full copy instead.
+//
+BOOL SaveIncremental(LPCWSTR filePath, LPCWSTR wideText, size_t textLength, int encoding,
+    BYTE * chunk, size_t * bytesWritten)
+{
+    BOOL success = FALSE;
+    HANDLE hFile;
+    HANDLE hMapping;
+    const BYTE * original;
+    LARGE_INTEGER fileSize;
+    LARGE_INTEGER offset;
+    size_t charsSame;
+    WCHAR journalPath[CCH_SAVE_PATH];
+
+    if(!GetSavePath(filePath, SAVE_JOURNAL_SUFFIX, journalPath, ARRAYSIZE(journalPath)))
+    {
+        return FALSE;
+    }
+
+    hFile = CreateFile(filePath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    if(!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart < CB_INCREMENTAL_SAVE_MIN ||
+        (ULONGLONG)fileSize.QuadPart > (SIZE_T)-1)
+    {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    original = hMapping ? (const BYTE *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if(!original)
+    {
+        // Most likely there isn't enough address space for the whole file
+        if(hMapping)
+        {
+            CloseHandle(hMapping);
+        }
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    offset.QuadPart = (LONGLONG)FindFirstChangedChunk(wideText, textLength, encoding,
+        original, fileSize.QuadPart, chunk, &charsSame);
+
+    if(IsIncrementalSaveWorthwhile((ULONGLONG)fileSize.QuadPart, (ULONGLONG)offset.QuadPart))
+    {
+        success = WriteSaveJournal(journalPath, original, offset.QuadPart, fileSize.QuadPart);
+    }
+
+    // The file can't be truncated while it's mapped
+    UnmapViewOfFile(original);
+    CloseHandle(hMapping);
+
+    if(success)
+    {
+        DebugLog(L"Saving incrementally from offset %I64d of %I64d", offset.QuadPart, fileSize.QuadPart);
+
+        success = RewriteFileTail(hFile, (ULONGLONG)offset.QuadPart, wideText + charsSame, textLength - charsSame,
+            encoding, chunk, bytesWritten);
+
+        CloseHandle(hFile);
+
+        if(success)
+        {
+            // The new contents are on disk, so the journal isn't needed
+            DeleteFile(journalPath);
+        }
+        else
+        {
+            // Put the original back. The caller can then try a full copy.
+            DebugLog(L"Incremental save failed, error %u", GetLastError());
+            RecoverInterruptedSave(filePath);
+        }
+    }
+    else
+    {
+        CloseHandle(hFile);
+    }
+
+    return success;
+}
+
+//
+// SaveWideTextToFile
+// Saves wideText to filePath with the specified encoding, without
+// leaving a half-written file behind if the save fails partway.
+// When only the end of a large file changed, just that part is rewritten.
+// The number of bytes written to disk is returned in bytesWritten.
+//
+BOOL SaveWideTextToFile(LPCWSTR filePath, LPCWSTR wideText, size_t textLength, int encoding, size_t * bytesWritten)
+{
+    BOOL success = FALSE;
+    BYTE * chunk;
+    SCRATCH_MARK scratch = ScratchBegin();
+
+    *bytesWritten = 0;
+
+    chunk = ScratchAlloc(CB_WRITE_CHUNK);
+    if(chunk)
+    {
+        success = SaveIncremental(filePath, wideText, textLength, encoding, chunk, bytesWritten);
+        if(!success)
+        {
+            *bytesWritten = 0;
+            success = SaveFullCopy(filePath, wideText, textLength, encoding, chunk, bytesWritten);
+        }
+    }
+
+    ScratchEnd(scratch);
+
+    return success;
+}
+
+//
+// RecoverInterruptedSave
+// If a save of filePath was interrupted, copies the original bytes
+// back from the save journal so the file is as it was before the save.
+// Also removes any temporary copy left over from a full save.
+//
+void RecoverInterruptedSave(LPCWSTR filePath)
+{
+    WCHAR journalPath[CCH_SAVE_PATH];
+    WCHAR tempPath[CCH_SAVE_PATH];
+
+    if(GetSavePath(filePath, SAVE_TEMP_SUFFIX, tempPath, ARRAYSIZE(tempPath)))
+    {
+        DeleteFile(tempPath);
+    }
+
+    if(GetSavePath(filePath, SAVE_JOURNAL_SUFFIX, journalPath, ARRAYSIZE(journalPath)))
+    {
+        RestoreFromSaveJournal(filePath, journalPath);
+    }
+}
@@ -0,0 +1,213 @@
+/* -------------------------------------------------------------
+
+savejournal.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the file writes of a save: encoding text to a file,
+    journaling the bytes a save rewrites in place, rewriting the
+    end of the file, and putting it back from the journal if that
+    was interrupted. Nothing in here touches windows or app globals,
+    so a save can be interrupted and recovered in the tests.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// WriteEncodedText
+// Encode wideText a chunk at a time, and write the chunks to hFile at its
+// current file pointer. chunk is scratch space of CB_WRITE_CHUNK bytes.
+// The number of bytes written is added to bytesWritten.
+//
+BOOL WriteEncodedText(HANDLE hFile, LPCWSTR wideText, size_t textLength, int encoding,
+    BYTE * chunk, size_t * bytesWritten)
+{
+    BOOL success = TRUE;
+    size_t chunkBytes;
+    size_t charsEncoded;
+    DWORD chunkBytesWritten;
+
+    while(success && textLength > 0)
+    {
+        chunkBytes = EncodeWideTextChunk(wideText, textLength, encoding, chunk, CB_WRITE_CHUNK, &charsEncoded);
+        if(charsEncoded == 0)
+        {
+            return FALSE;
+        }
+
+        success = WriteFile(hFile, chunk, (DWORD)chunkBytes, &chunkBytesWritten, NULL) &&
+            chunkBytesWritten == chunkBytes;
+        *bytesWritten += chunkBytesWritten;
+
+        wideText += charsEncoded;
+        textLength -= charsEncoded;
+    }
+
+    return success;
+}
+
+//
+// WriteSaveJournal
+// Copies the original bytes from offset to the end of the file into the
+// save journal, so RestoreFromSaveJournal can put them back if the save
+// is interrupted. The journal is on disk when this returns TRUE.
+//
+BOOL WriteSaveJournal(LPCWSTR journalPath, const BYTE * original,
+    ULONGLONG offset, ULONGLONG originalSize)
+{
+    BOOL success = FALSE;
+    HANDLE hFile;
+    SAVE_JOURNAL_HEADER header;
+    DWORD bytesWritten;
+    DWORD chunkBytes;
+
+    hFile = CreateFile(journalPath, GENERIC_WRITE, 0,
+        NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_HIDDEN | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        DebugLog(L"Couldn't create save journal: %s", journalPath);
+        return FALSE;
+    }
+
+    header.magic = SAVE_JOURNAL_MAGIC;
+    header.reserved = 0;
+    header.offset = offset;
+    header.originalSize = originalSize;
+
+    success = WriteFile(hFile, &header, sizeof(header), &bytesWritten, NULL) && bytesWritten == sizeof(header);
+    while(success && offset < originalSize)
+    {
+        chunkBytes = (DWORD)min(originalSize - offset, CB_WRITE_CHUNK);
+        success = WriteFile(hFile, original + offset, chunkBytes, &bytesWritten, NULL) && bytesWritten == chunkBytes;
+        offset += chunkBytes;
+    }
+
+    if(success)
+    {
+        success = FlushFileBuffers(hFile);
+    }
+
+    CloseHandle(hFile);
+
+    if(!success)
+    {
+        DeleteFile(journalPath);
+    }
+
+    return success;
+}
+
+//
+// RewriteFileTail
+// Writes wideText to hFile from offset, and cuts the file off after it.
+// The bytes being replaced should be in a save journal first.
+// Returns TRUE once the new end of the file is on disk.
+//
+BOOL RewriteFileTail(HANDLE hFile, ULONGLONG offset, LPCWSTR wideText, size_t textLength, int encoding,
+    BYTE * chunk, size_t * bytesWritten)
+{
+    LARGE_INTEGER position;
+
+    position.QuadPart = (LONGLONG)offset;
+
+    return SetFilePointerEx(hFile, position, NULL, FILE_BEGIN) &&
+        WriteEncodedText(hFile, wideText, textLength, encoding, chunk, bytesWritten) &&
+        SetEndOfFile(hFile) &&
+        FlushFileBuffers(hFile);
+}
+
+//
+// RestoreFromSaveJournal
+// If journalPath holds a complete save journal for filePath, copies the
+// original bytes back so the file is as it was before the save, and
+// deletes the journal. A journal that isn't complete was still being
+// written when the save stopped, and the file hadn't been touched yet,
+// so it's just deleted. Returns FALSE if the file couldn't be restored,
+// and keeps the journal so it can be tried again.
+//
+BOOL RestoreFromSaveJournal(LPCWSTR filePath, LPCWSTR journalPath)
+{
+    HANDLE hJournal;
+    HANDLE hFile;
+    SAVE_JOURNAL_HEADER header;
+    LARGE_INTEGER journalSize;
+    LARGE_INTEGER offset;
+    BYTE * chunk;
+    DWORD bytesRead;
+    DWORD bytesWritten;
+    BOOL success;
+    BOOL readSuccess;
+    SCRATCH_MARK scratch;
+
+    hJournal = CreateFile(journalPath, GENERIC_READ, 0,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if(hJournal == INVALID_HANDLE_VALUE)
+    {
+        // No journal, so there's nothing to recover
+        return TRUE;
+    }
+
+    if(!GetFileSizeEx(hJournal, &journalSize) ||
+        !ReadFile(hJournal, &header, sizeof(header), &bytesRead, NULL) ||
+        bytesRead != sizeof(header) ||
+        header.magic != SAVE_JOURNAL_MAGIC ||
+        header.offset > header.originalSize ||
+        (ULONGLONG)journalSize.QuadPart != sizeof(header) + header.originalSize - header.offset)
+    {
+        DebugLog(L"Discarding incomplete save journal: %s", journalPath);
+        CloseHandle(hJournal);
+        DeleteFile(journalPath);
+        return TRUE;
+    }
+
+    DebugLog(L"Recovering interrupted save: %s", filePath);
+
+    success = FALSE;
+    scratch = ScratchBegin();
+    chunk = ScratchAlloc(CB_WRITE_CHUNK);
+    hFile = CreateFile(filePath, GENERIC_WRITE, 0,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if(chunk && hFile != INVALID_HANDLE_VALUE)
+    {
+        // Nothing is written unless the file is at the journal's offset,
+        // since the original bytes anywhere else would corrupt it
+        offset.QuadPart = (LONGLONG)header.offset;
+        success = SetFilePointerEx(hFile, offset, NULL, FILE_BEGIN);
+
+        do
+        {
+            readSuccess = ReadFile(hJournal, chunk, CB_WRITE_CHUNK, &bytesRead, NULL);
+            success = success && readSuccess &&
+                WriteFile(hFile, chunk, bytesRead, &bytesWritten, NULL) && bytesWritten == bytesRead;
+        } while(success && bytesRead > 0);
+
+        offset.QuadPart = (LONGLONG)header.originalSize;
+        success = success &&
+            SetFilePointerEx(hFile, offset, NULL, FILE_BEGIN) &&
+            SetEndOfFile(hFile) &&
+            FlushFileBuffers(hFile);
+    }
+
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hFile);
+    }
+
+    ScratchEnd(scratch);
+    CloseHandle(hJournal);
+
+    // Keep the journal if the file couldn't be restored, so it can be tried again
+    if(success)
+    {
+        DeleteFile(journalPath);
+    }
+    else
+    {
+        DebugLog(L"Couldn't recover from save journal, error %u", GetLastError());
+    }
+
+    return success;
+}
@@ -0,0 +1,80 @@
+/* -------------------------------------------------------------
+
+saveplan.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for planning how a save writes a file: finding where the
+    new text first differs from the file on disk, and choosing
+    between rewriting the file from there and writing a full copy.
+    Nothing in here touches windows or app globals.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// FindFirstChangedChunk
+// Encodes wideText a chunk at a time and compares each chunk to the
+// original file bytes at the same offset. Returns the file offset of
+// the first chunk that differs, and in charsSame, how many wide chars
+// are encoded before it. If nothing differs, the offset is the end
+// of the new text.
+//
+ULONGLONG FindFirstChangedChunk(LPCWSTR wideText, size_t textLength, int encoding,
+    const BYTE * original, ULONGLONG originalSize, BYTE * chunk, size_t * charsSame)
+{
+    ULONGLONG offset;
+    size_t chunkBytes;
+    size_t charsEncoded;
+    const BYTE * bom;
+    size_t bomSize;
+
+    *charsSame = 0;
+
+    // A different BOM means nothing can be kept
+    bom = GetEncodingBom(encoding, &bomSize);
+    if(bomSize > originalSize || (bomSize > 0 && memcmp(original, bom, bomSize) != 0))
+    {
+        return 0;
+    }
+
+    offset = bomSize;
+    while(*charsSame < textLength)
+    {
+        chunkBytes = EncodeWideTextChunk(wideText + *charsSame, textLength - *charsSame,
+            encoding, chunk, CB_WRITE_CHUNK, &charsEncoded);
+
+        if(charsEncoded == 0 || chunkBytes > originalSize - offset ||
+            memcmp(chunk, original + offset, chunkBytes) != 0)
+        {
+            break;
+        }
+
+        offset += chunkBytes;
+        *charsSame += charsEncoded;
+    }
+
+    return offset;
+}
+
+//
+// IsIncrementalSaveWorthwhile
+// Decides whether a file of originalSize bytes, whose new contents first
+// differ at offset, should be rewritten in place from offset instead of
+// written as a full copy. Rewriting in place journals the old tail and
+// then writes the new one, so it's always chosen when the tail is small,
+// and otherwise only when that writes fewer bytes than a full copy.
+//
+BOOL IsIncrementalSaveWorthwhile(ULONGLONG originalSize, ULONGLONG offset)
+{
+    ULONGLONG tail;
+
+    if(originalSize < CB_INCREMENTAL_SAVE_MIN || offset > originalSize)
+    {
+        return FALSE;
+    }
+
+    tail = originalSize - offset;
+
+    return tail <= CB_INCREMENTAL_SAVE_TAIL || tail <= originalSize / 2;
+}
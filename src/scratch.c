@@ -0,0 +1,199 @@
+/* -------------------------------------------------------------
+
+scratch.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    A scratch arena for temporary buffers that only live for the
+    length of one operation, like a find or a save.
+    Allocating is a pointer bump, memory isn't zeroed, and blocks
+    are kept after an operation so the next one can reuse them
+    instead of going back to the OS.
+
+    Only the UI thread uses the arena. Every ScratchBegin must be
+    matched by a ScratchEnd in the same function, so operations
+    started from a nested message loop (like a timer firing while
+    a message box is up) are freed before the outer one.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+
+#include "esncore.h"
+
+// The smallest block requested from the OS. Larger allocations get a block of their own.
+#define CB_SCRATCH_BLOCK (1024 * 1024)
+
+// Free blocks beyond this total are given back to the OS
+#define CB_SCRATCH_RETAIN_MAX (256 * 1024 * 1024)
+
+// Every allocation is aligned to this
+#define SCRATCH_ALIGNMENT 16
+
+//
+// globals
+//
+SCRATCH_BLOCK * g_scratchBlocks = NULL;     // blocks in use, the most recent first
+SCRATCH_BLOCK * g_scratchFree = NULL;       // blocks kept for reuse
+SCRATCH_STATS g_scratchStats = {0};
+
+//
+// ReleaseScratchBlock
+// Keeps a block that's no longer in use for reuse, or gives it back to
+// the OS if enough memory is already being kept.
+//
+void ReleaseScratchBlock(SCRATCH_BLOCK * block)
+{
+    if(g_scratchStats.retainedBytes + block->size <= CB_SCRATCH_RETAIN_MAX)
+    {
+        block->next = g_scratchFree;
+        g_scratchFree = block;
+        g_scratchStats.retainedBytes += block->size;
+    }
+    else
+    {
+        g_scratchStats.reservedBytes -= block->size;
+        VirtualFree(block, 0, MEM_RELEASE);
+    }
+}
+
+//
+// GetScratchBlock
+// Makes a block with at least size bytes free the current block.
+// The smallest free block that's big enough is reused if there is one.
+// Otherwise a new block is allocated.
+//
+BOOL GetScratchBlock(size_t size)
+{
+    SCRATCH_BLOCK ** link;
+    SCRATCH_BLOCK ** bestLink = NULL;
+    SCRATCH_BLOCK * block;
+    size_t blockSize;
+
+    for(link = &g_scratchFree; *link; link = &(*link)->next)
+    {
+        if((*link)->size >= size && (!bestLink || (*link)->size < (*bestLink)->size))
+        {
+            bestLink = link;
+        }
+    }
+
+    if(bestLink)
+    {
+        block = *bestLink;
+        *bestLink = block->next;
+        g_scratchStats.retainedBytes -= block->size;
+        g_scratchStats.blocksReused++;
+    }
+    else
+    {
+        // The header sits at the start of the block, and the data follows it
+        blockSize = max(size, CB_SCRATCH_BLOCK);
+        if(blockSize > (SIZE_T)-1 - sizeof(SCRATCH_BLOCK))
+        {
+            return FALSE;
+        }
+
+        // VirtualAlloc rather than the heap, since these blocks
+        // are large and the heap would only pass them through
+        block = VirtualAlloc(NULL, sizeof(SCRATCH_BLOCK) + blockSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if(!block)
+        {
+            DebugLog(L"Unable to allocate a scratch block of %Iu bytes", blockSize);
+            return FALSE;
+        }
+
+        block->size = blockSize;
+        g_scratchStats.reservedBytes += blockSize;
+        g_scratchStats.blocksCreated++;
+    }
+
+    block->used = 0;
+    block->next = g_scratchBlocks;
+    g_scratchBlocks = block;
+
+    return TRUE;
+}
+
+//
+// ScratchBegin
+// Starts an operation's use of the scratch arena. Pass the returned
+// mark to ScratchEnd to free everything allocated after this call.
+//
+SCRATCH_MARK ScratchBegin(void)
+{
+    SCRATCH_MARK mark;
+
+    mark.block = g_scratchBlocks;
+    mark.used = g_scratchBlocks ? g_scratchBlocks->used : 0;
+    mark.liveBytes = g_scratchStats.liveBytes;
+
+    return mark;
+}
+
+//
+// ScratchEnd
+// Frees everything allocated from the scratch arena since the
+// ScratchBegin that returned mark. Blocks are kept for reuse.
+//
+void ScratchEnd(SCRATCH_MARK mark)
+{
+    SCRATCH_BLOCK * block;
+
+    while(g_scratchBlocks && g_scratchBlocks != mark.block)
+    {
+        block = g_scratchBlocks;
+        g_scratchBlocks = block->next;
+        ReleaseScratchBlock(block);
+    }
+
+    if(g_scratchBlocks)
+    {
+        g_scratchBlocks->used = mark.used;
+    }
+
+    g_scratchStats.liveBytes = mark.liveBytes;
+}
+
+//
+// ScratchAlloc
+// Allocates size bytes from the scratch arena. The memory isn't zeroed.
+// It's freed by the ScratchEnd for the operation that allocated it,
+// and must not be passed to HeapFree.
+// Returns NULL if the memory can't be allocated.
+//
+void * ScratchAlloc(size_t size)
+{
+    BYTE * data;
+
+    if(size > (SIZE_T)-1 - SCRATCH_ALIGNMENT)
+    {
+        return NULL;
+    }
+
+    size = (size + SCRATCH_ALIGNMENT - 1) & ~(size_t)(SCRATCH_ALIGNMENT - 1);
+
+    if(!g_scratchBlocks || g_scratchBlocks->size - g_scratchBlocks->used < size)
+    {
+        if(!GetScratchBlock(size))
+        {
+            return NULL;
+        }
+    }
+
+    data = (BYTE *)(g_scratchBlocks + 1) + g_scratchBlocks->used;
+    g_scratchBlocks->used += size;
+
+    g_scratchStats.allocations++;
+    g_scratchStats.liveBytes += size;
+    g_scratchStats.peakBytes = max(g_scratchStats.peakBytes, g_scratchStats.liveBytes);
+
+    return data;
+}
+
+//
+// GetScratchStats
+// Returns the scratch arena's usage statistics, for the trace summary.
+//
+void GetScratchStats(SCRATCH_STATS * stats)
+{
+    *stats = g_scratchStats;
+}
@@ -0,0 +1,164 @@
+/* -------------------------------------------------------------
+
+search.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for searching text in memory.
+    Nothing in here touches windows or app globals.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// FindTextInBuffer
+// Searches text, which is textLength characters long, for searchText.
+// The search begins at searchStart and moves down (forward) or up (backward).
+// Returns the position of the match, or FIND_NOT_FOUND if there isn't one.
+//
+DWORD FindTextInBuffer(LPCWSTR text, DWORD textLength, LPCWSTR searchText,
+    BOOL matchCase, BOOL searchDown, DWORD searchStart)
+{
+    size_t searchLength = wcslen(searchText);
+
+    // There can't be a match if the search text is longer than the text
+    if(searchLength == 0 || searchLength > textLength)
+    {
+        return FIND_NOT_FOUND;
+    }
+
+    // The last position where a match could start
+    DWORD lastStart = textLength - (DWORD)searchLength;
+
+    if (searchDown)
+    {
+        // Search downwards
+        for (DWORD i = searchStart; i <= lastStart; i++)
+        {
+            if ((matchCase && wcsncmp(&text[i], searchText, searchLength) == 0) ||
+                (!matchCase && _wcsnicmp(&text[i], searchText, searchLength) == 0))
+            {
+                return i;
+            }
+        }
+    }
+    else
+    {
+        // Search upwards
+        if (searchStart > lastStart)
+        {
+            searchStart = lastStart;
+        }
+
+        for (DWORD i = searchStart; i != (DWORD)-1; i--)
+        {
+            if ((matchCase && wcsncmp(&text[i], searchText, searchLength) == 0) ||
+                (!matchCase && _wcsnicmp(&text[i], searchText, searchLength) == 0))
+            {
+                return i;
+            }
+        }
+    }
+
+    return FIND_NOT_FOUND;
+}
+
+//
+// FindNextLineStart
+// Returns the position of the first line that starts at or after
+// position, or textLength if there isn't one. Lines end with CRLF.
+//
+DWORD FindNextLineStart(LPCWSTR text, DWORD textLength, DWORD position)
+{
+    for(DWORD i = max(position, 1); i < textLength; i++)
+    {
+        if(text[i] == L'\n' && text[i - 1] == L'\r')
+        {
+            return i + 1;
+        }
+    }
+
+    return textLength;
+}
+
+//
+// LineMatchesFilter
+// Returns TRUE if a line, without its line break, matches the filter
+//
+BOOL LineMatchesFilter(LPCWSTR line, DWORD lineLength, const FILTER * filter)
+{
+    int level;
+
+    if(filter->type == FILTER_LEVELS)
+    {
+        level = GetLogLineLevel(line, lineLength);
+        return (level == TOKEN_ERROR || level == TOKEN_WARNING);
+    }
+
+    return FindTextInBuffer(line, lineLength, filter->searchText, filter->matchCase, TRUE, 0) != FIND_NOT_FOUND;
+}
+
+//
+// FilterTextChunk
+// Finds the lines that match chunk->filter among the lines that start
+// from chunk->start up to chunk->end, which must both be line starts.
+// Each match records the line's offset in the text and its number,
+// counting from the first line in the chunk. Only the matches are
+// stored, so the filter is small even when the text is large.
+// This runs on a thread pool thread, so it only touches the chunk.
+// Returns FALSE if memory for the matches can't be allocated.
+//
+BOOL FilterTextChunk(FILTER_CHUNK * chunk)
+{
+    LPCWSTR text = chunk->text;
+    DWORD position = chunk->start;
+    DWORD lineEnd;
+    FILTER_MATCH * matches;
+    DWORD capacity;
+
+    chunk->matchCount = 0;
+    chunk->lineCount = 0;
+
+    while(position < chunk->end)
+    {
+        lineEnd = position;
+        while(lineEnd < chunk->end && !(text[lineEnd] == L'\r' && lineEnd + 1 < chunk->end && text[lineEnd + 1] == L'\n'))
+        {
+            lineEnd++;
+        }
+
+        if(LineMatchesFilter(text + position, lineEnd - position, chunk->filter))
+        {
+            if(chunk->matchCount == chunk->matchCapacity)
+            {
+                // Grow by doubling, starting with room for a page of matches
+                capacity = max(chunk->matchCapacity * 2, 512);
+                if(!chunk->matches)
+                {
+                    matches = HeapAlloc(GetProcessHeap(), 0, capacity * sizeof(FILTER_MATCH));
+                }
+                else
+                {
+                    matches = HeapReAlloc(GetProcessHeap(), 0, chunk->matches, capacity * sizeof(FILTER_MATCH));
+                }
+
+                if(!matches)
+                {
+                    return FALSE;
+                }
+
+                chunk->matches = matches;
+                chunk->matchCapacity = capacity;
+            }
+
+            chunk->matches[chunk->matchCount].line = chunk->lineCount;
+            chunk->matches[chunk->matchCount].offset = position;
+            chunk->matchCount++;
+        }
+
+        chunk->lineCount++;
+        position = (lineEnd < chunk->end) ? lineEnd + 2 : lineEnd;
+    }
+
+    return TRUE;
+}
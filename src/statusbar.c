@@ -0,0 +1,286 @@
+/* -------------------------------------------------------------
+
+statusbar.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the status bar below the edit control.
+
+    Anything that can change what the status bar shows asks for an
+    update with RequestStatusUpdate. That's cheap enough to do on
+    every keystroke, since it only starts a timer. The timer fires
+    once the message queue is empty, so any number of requests in a
+    frame become one update, after the typing has been handled.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <windows.h>
+#include <commctrl.h>
+#include <shlwapi.h>
+#include <strsafe.h>
+#include "esnpad.h"
+
+// The ID of the edit control subclass
+#define STATUS_SUBCLASS_ID 3
+
+//
+// globals
+//
+BOOL g_statusUpdatePending = FALSE;
+WCHAR g_statusText[STATUS_PART_COUNT][CCH_STATUS_PART] = {0};  // what each part shows now
+
+// The width of each part at 96 DPI. The progress part takes what's left.
+const int g_statusPartWidths[STATUS_PART_COUNT] = {0, 140, 170, 90, 110, 130};
+
+extern HWND g_hwndMain;
+extern HWND g_hwndEdit;
+extern HWND g_hwndStatus;
+extern WCHAR g_activeFile[MAX_PATH];
+extern FILE_FINGERPRINT g_activeFingerprint;
+extern int g_fileEncoding;
+extern int g_lineEnding;
+extern BOOL g_mixedLineEndings;
+
+//
+// LayoutStatusBar
+// Divides the status bar into its parts, for a main window
+// client area that's width pixels wide
+//
+void LayoutStatusBar(int width)
+{
+    int edges[STATUS_PART_COUNT];
+    UINT dpi;
+
+    if(!g_hwndStatus)
+    {
+        return;
+    }
+
+    // Each part is given by its right edge, and the last one goes to the end
+    dpi = GetDpiForWindow(g_hwndStatus);
+    edges[STATUS_PART_COUNT - 1] = -1;
+    for(int part = STATUS_PART_COUNT - 2; part >= 0; part--)
+    {
+        width -= MulDiv(g_statusPartWidths[part + 1], dpi, 96);
+        edges[part] = max(width, 0);
+    }
+
+    SendMessage(g_hwndStatus, SB_SETPARTS, STATUS_PART_COUNT, (LPARAM)edges);
+}
+
+//
+// SetStatusPartText
+// Sets the text of a status bar part, if it's different from
+// what the part already shows
+//
+void SetStatusPartText(int part, LPCWSTR text)
+{
+    if(lstrcmpW(g_statusText[part], text) != 0)
+    {
+        StringCchCopyW(g_statusText[part], CCH_STATUS_PART, text);
+        SendMessage(g_hwndStatus, SB_SETTEXT, part, (LPARAM)g_statusText[part]);
+    }
+}
+
+//
+// ShowStatusProgress
+// Shows the progress of work that keeps the message loop from running,
+// such as loading a file. The status bar is painted right away, since
+// it won't get a WM_PAINT until the work is done.
+//
+void ShowStatusProgress(LPCWSTR text)
+{
+    if(g_hwndStatus)
+    {
+        SetStatusPartText(STATUS_PART_PROGRESS, text);
+        UpdateWindow(g_hwndStatus);
+    }
+}
+
+//
+// GetEditCaret
+// Gets the selection of the edit control, and the end of it that
+// has the caret. EM_GETSEL always puts the start first, so when the
+// selection was made backwards, the caret is found by its position.
+//
+DWORD GetEditCaret(DWORD * selStart, DWORD * selEnd)
+{
+    POINT caret;
+    LRESULT startPos;
+
+    SendMessage(g_hwndEdit, EM_GETSEL, (WPARAM)selStart, (LPARAM)selEnd);
+
+    if(*selStart != *selEnd && GetCaretPos(&caret))
+    {
+        startPos = SendMessage(g_hwndEdit, EM_POSFROMCHAR, *selStart, 0);
+        if(startPos != -1 && (short)LOWORD(startPos) == caret.x && (short)HIWORD(startPos) == caret.y)
+        {
+            return *selStart;
+        }
+    }
+
+    return *selEnd;
+}
+
+//
+// UpdateStatusBar
+// Shows the state of the edit text and the active file in the status bar.
+// Lines are found with the edit control's own table of line starts,
+// so none of the text is read, however long it is.
+//
+void UpdateStatusBar(void)
+{
+    WCHAR text[CCH_STATUS_PART];
+    DWORD selStart = 0;
+    DWORD selEnd = 0;
+    DWORD caret;
+    DWORD line;
+    DWORD lineStart;
+    DWORD selLines;
+    LONG fileCount;
+    LONG resultCount;
+    LPCWSTR lineEnding;
+
+    g_statusUpdatePending = FALSE;
+    if(!g_hwndStatus || !g_hwndEdit)
+    {
+        return;
+    }
+
+    // Background work
+    text[0] = 0;
+    if(GetFindFilesProgress(&fileCount, &resultCount))
+    {
+        StringCchPrintfW(text, CCH_STATUS_PART, L"Finding in files... %ld files, %ld matching lines",
+            fileCount, resultCount);
+    }
+    SetStatusPartText(STATUS_PART_PROGRESS, text);
+
+    // Where the caret is. With word wrap on, lines are the ones on screen.
+    caret = GetEditCaret(&selStart, &selEnd);
+    line = (DWORD)SendMessage(g_hwndEdit, EM_LINEFROMCHAR, caret, 0);
+    lineStart = (DWORD)SendMessage(g_hwndEdit, EM_LINEINDEX, line, 0);
+    StringCchPrintfW(text, CCH_STATUS_PART, L"Ln %lu, Col %lu", line + 1, caret - lineStart + 1);
+    SetStatusPartText(STATUS_PART_POSITION, text);
+
+    // The size of the selection
+    text[0] = 0;
+    if(selEnd > selStart)
+    {
+        selLines = (DWORD)SendMessage(g_hwndEdit, EM_LINEFROMCHAR, selEnd, 0) -
+            (DWORD)SendMessage(g_hwndEdit, EM_LINEFROMCHAR, selStart, 0) + 1;
+        if(selLines > 1)
+        {
+            StringCchPrintfW(text, CCH_STATUS_PART, L"%lu selected, %lu lines", selEnd - selStart, selLines);
+        }
+        else
+        {
+            StringCchPrintfW(text, CCH_STATUS_PART, L"%lu selected", selEnd - selStart);
+        }
+    }
+    SetStatusPartText(STATUS_PART_SELECTION, text);
+
+    // The size of the active file, as it was last loaded or saved
+    text[0] = 0;
+    if(g_activeFile[0] != 0)
+    {
+        StrFormatByteSizeW((LONGLONG)g_activeFingerprint.size, text, CCH_STATUS_PART);
+    }
+    SetStatusPartText(STATUS_PART_FILE_SIZE, text);
+
+    // The line endings the text is saved with
+    switch(g_lineEnding)
+    {
+    case LINE_ENDING_LF:
+        lineEnding = L"Unix (LF)";
+        break;
+    case LINE_ENDING_CR:
+        lineEnding = L"Macintosh (CR)";
+        break;
+    default:
+        lineEnding = L"Windows (CRLF)";
+        break;
+    }
+
+    if(g_mixedLineEndings)
+    {
+        StringCchPrintfW(text, CCH_STATUS_PART, L"Mixed, %s", lineEnding);
+        lineEnding = text;
+    }
+    SetStatusPartText(STATUS_PART_LINE_ENDING, lineEnding);
+
+    SetStatusPartText(STATUS_PART_ENCODING, GetEncodingName(g_fileEncoding));
+}
+
+//
+// RequestStatusUpdate
+// Asks for the status bar to be updated once the message queue is empty.
+// Requests made before then are combined into the same update.
+//
+void RequestStatusUpdate(void)
+{
+    if(!g_statusUpdatePending && g_hwndStatus)
+    {
+        g_statusUpdatePending = SetTimer(g_hwndMain, IDT_STATUS_UPDATE, STATUS_UPDATE_INTERVAL_MS, NULL) != 0;
+    }
+}
+
+//
+// MainWndOnStatusTimer
+// Handles IDT_STATUS_UPDATE for the main window. The timer only
+// fires once for each request.
+//
+void MainWndOnStatusTimer(HWND hwnd)
+{
+    KillTimer(hwnd, IDT_STATUS_UPDATE);
+    UpdateStatusBar();
+}
+
+//
+// StatusEditProc
+// The subclass procedure for the edit control that watches for
+// the caret or selection moving
+//
+LRESULT CALLBACK StatusEditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam,
+    UINT_PTR idSubclass, DWORD_PTR refData)
+{
+    UNREFERENCED_PARAMETER(refData);
+
+    switch(msg)
+    {
+    case WM_MOUSEMOVE:
+        // Only a drag can change the selection
+        if(!(wParam & MK_LBUTTON))
+        {
+            break;
+        }
+        // fall through
+    case WM_KEYDOWN:
+    case WM_CHAR:
+    case WM_LBUTTONDOWN:
+    case WM_LBUTTONDBLCLK:
+    case WM_LBUTTONUP:
+    case WM_SETFOCUS:
+    case EM_SETSEL:
+        RequestStatusUpdate();
+        break;
+    case WM_NCDESTROY:
+        RemoveWindowSubclass(hwnd, StatusEditProc, idSubclass);
+        break;
+    }
+
+    return DefSubclassProc(hwnd, msg, wParam, lParam);
+}
+
+//
+// AttachStatusTracking
+// Subclasses a new edit control so the status bar follows its caret
+//
+void AttachStatusTracking(HWND hwndEdit)
+{
+    if(!SetWindowSubclass(hwndEdit, StatusEditProc, STATUS_SUBCLASS_ID, 0))
+    {
+        DebugLog(L"Unable to subclass the edit control for the status bar");
+    }
+
+    RequestStatusUpdate();
+}
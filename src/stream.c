@@ -0,0 +1,268 @@
+/* -------------------------------------------------------------
+
+stream.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for reading text from a file a piece at a time, so that
+    a file of any size can be searched or converted in a fixed
+    amount of memory. It decodes with the same code as the editor.
+
+    The caller opens the file and provides the buffers, so a stream
+    can be read on any thread. A gzip file is decompressed as it's
+    read, on a thread of its own.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// InitTextStream
+// Sets up stream to read hFile from its current position. bytes must
+// hold CB_STREAM_CHUNK bytes, and text CCH_STREAM_TEXT characters.
+// Call CloseTextStream before closing hFile.
+//
+void InitTextStream(TEXT_STREAM * stream, HANDLE hFile, BYTE * bytes, WCHAR * text)
+{
+    ZeroMemory(stream, sizeof(TEXT_STREAM));
+    stream->hFile = hFile;
+    stream->compression = COMPRESSION_NONE;
+    stream->encoding = ENCODING_UNSPECIFIED;
+    stream->bytes = bytes;
+    stream->text = text;
+}
+
+//
+// FillTextStream
+// Reads more of a stream's file, and decodes every whole character
+// that's been read. The compression and encoding are detected from
+// the first bytes. Returns FALSE if the file can't be read or decoded,
+// or if its compressed data isn't valid.
+//
+BOOL FillTextStream(TEXT_STREAM * stream)
+{
+    HANDLE hInput = stream->hDecompressed ? stream->hDecompressed : stream->hFile;
+    DWORD bytesRead = 0;
+    size_t bomSize = 0;
+    size_t wholeBytes;
+    size_t decodedLength = 0;
+
+    if(!ReadFile(hInput, stream->bytes + stream->byteCount,
+        (DWORD)(CB_STREAM_CHUNK - stream->byteCount), &bytesRead, NULL))
+    {
+        // The end of a pipe is reported as a failed read
+        if(GetLastError() != ERROR_BROKEN_PIPE)
+        {
+            return FALSE;
+        }
+        bytesRead = 0;
+    }
+
+    stream->byteCount += bytesRead;
+    stream->endOfStream = (bytesRead == 0);
+
+    // The end of the decompressed bytes is when bad compressed data shows up
+    if(stream->endOfStream && stream->hDecompressThread && !CloseTextStream(stream))
+    {
+        return FALSE;
+    }
+
+    if(stream->encoding == ENCODING_UNSPECIFIED)
+    {
+        // Wait until there are enough bytes to tell if they're compressed, and to hold any BOM
+        if(stream->byteCount < CB_COMPRESSION_MAGIC && !stream->endOfStream)
+        {
+            return TRUE;
+        }
+
+        // Compressed bytes are decompressed on another thread as they're read,
+        // and the text is read from there instead. It has a BOM of its own.
+        if(stream->compression == COMPRESSION_NONE)
+        {
+            stream->compression = GetCompressionFormat(stream->bytes, stream->byteCount);
+            if(stream->compression == COMPRESSION_GZIP)
+            {
+                stream->hDecompressed = StartDecompression(stream->hFile, stream->bytes, stream->byteCount,
+                    &stream->hDecompressThread);
+                if(stream->hDecompressed == INVALID_HANDLE_VALUE)
+                {
+                    stream->hDecompressed = NULL;
+                    return FALSE;
+                }
+
+                stream->byteCount = 0;
+                stream->endOfStream = FALSE;
+                return TRUE;
+            }
+            else if(stream->compression != COMPRESSION_NONE)
+            {
+                return FALSE;
+            }
+        }
+
+        stream->encoding = GetEncodingFromBom(stream->bytes, stream->byteCount, &bomSize);
+    }
+
+    // Leave a character that's been partly read for the next read,
+    // unless there's nothing more to read
+    wholeBytes = stream->byteCount - bomSize;
+    if(!stream->endOfStream)
+    {
+        wholeBytes = GetWholeCharBytes(stream->bytes + bomSize, wholeBytes, stream->encoding);
+    }
+
+    if(!DecodeBytes(stream->bytes + bomSize, wholeBytes, stream->encoding, stream->text + stream->textLength,
+        (CCH_STREAM_TEXT - stream->textLength) * sizeof(WCHAR), &decodedLength))
+    {
+        return FALSE;
+    }
+
+    stream->textLength += decodedLength;
+    stream->byteCount -= bomSize + wholeBytes;
+    MoveMemory(stream->bytes, stream->bytes + bomSize + wholeBytes, stream->byteCount);
+
+    return TRUE;
+}
+
+//
+// FindLastLineEnd
+// Returns the position just past the last line break in text, or 0 if
+// there isn't one. A CR at the very end doesn't count yet, since an LF
+// that makes it a CRLF might not have been read.
+//
+size_t FindLastLineEnd(LPCWSTR text, size_t length)
+{
+    for(size_t i = length; i > 0; i--)
+    {
+        if(text[i - 1] == L'\n' || (text[i - 1] == L'\r' && i < length))
+        {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+//
+// ReadStreamLines
+// Returns the next whole lines of a stream in lines, with their line
+// breaks, which can be CRLF, LF or CR. They're good until the next call.
+// An unfinished line is kept for the next call, unless it's too long
+// to keep, in which case it's returned a piece at a time.
+// Returns FALSE at the end of the stream, or if it can't be read,
+// which sets stream->failed.
+//
+BOOL ReadStreamLines(TEXT_STREAM * stream, LPCWSTR * lines, size_t * linesLength)
+{
+    size_t end = 0;
+
+    // Drop the lines returned last time, and keep the rest
+    stream->textLength -= stream->linesLength;
+    MoveMemory(stream->text, stream->text + stream->linesLength, stream->textLength * sizeof(WCHAR));
+    stream->linesLength = 0;
+
+    while(end == 0 && !stream->endOfStream)
+    {
+        if(stream->textLength + CB_STREAM_CHUNK + 2 > CCH_STREAM_TEXT)
+        {
+            // There's no room to decode more. Don't split a CRLF or a surrogate pair.
+            end = stream->textLength;
+            if(stream->text[end - 1] == L'\r' || IS_HIGH_SURROGATE(stream->text[end - 1]))
+            {
+                end--;
+            }
+        }
+        else if(FillTextStream(stream))
+        {
+            end = FindLastLineEnd(stream->text, stream->textLength);
+        }
+        else
+        {
+            stream->failed = TRUE;
+            return FALSE;
+        }
+    }
+
+    if(stream->endOfStream)
+    {
+        end = stream->textLength;
+    }
+
+    stream->linesLength = end;
+    *lines = stream->text;
+    *linesLength = end;
+
+    return (end > 0);
+}
+
+//
+// ReadStreamLine
+// Returns the next line of a stream in line, without its line break.
+// stream->lineNumber is its number, counting from 1. A line too long
+// to read at once comes a piece at a time, and each piece has the same
+// line number. The line is good until the next call.
+// Returns FALSE at the end of the stream, or if it can't be read,
+// which sets stream->failed.
+//
+BOOL ReadStreamLine(TEXT_STREAM * stream, LPCWSTR * line, size_t * lineLength)
+{
+    LPCWSTR lines;
+    size_t linesLength;
+    size_t start;
+    size_t end;
+
+    if(stream->linePosition >= stream->linesLength)
+    {
+        if(!ReadStreamLines(stream, &lines, &linesLength))
+        {
+            return FALSE;
+        }
+        stream->linePosition = 0;
+    }
+
+    start = stream->linePosition;
+    end = start;
+    while(end < stream->linesLength && stream->text[end] != L'\r' && stream->text[end] != L'\n')
+    {
+        end++;
+    }
+
+    if(!stream->continuesLine)
+    {
+        stream->lineNumber++;
+    }
+
+    // Without a line break, the rest of the line comes next time
+    stream->continuesLine = (end == stream->linesLength);
+
+    *line = stream->text + start;
+    *lineLength = end - start;
+
+    if(end < stream->linesLength)
+    {
+        end += (stream->text[end] == L'\r' && end + 1 < stream->linesLength && stream->text[end + 1] == L'\n') ? 2 : 1;
+    }
+    stream->linePosition = end;
+
+    return TRUE;
+}
+
+//
+// CloseTextStream
+// Stops decompressing a stream's file, if it's compressed. Call it
+// even if the stream wasn't read to the end. The caller closes the
+// file itself. Returns FALSE if the compressed data wasn't all read,
+// or wasn't valid.
+//
+BOOL CloseTextStream(TEXT_STREAM * stream)
+{
+    BOOL success = TRUE;
+
+    if(stream->hDecompressThread)
+    {
+        success = FinishDecompression(stream->hDecompressed, stream->hDecompressThread);
+        stream->hDecompressed = NULL;
+        stream->hDecompressThread = NULL;
+    }
+
+    return success;
+}
@@ -0,0 +1,86 @@
+/* -------------------------------------------------------------
+
+textdiff.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for finding what changed between a text and an older copy
+    of it, as one replaced range. Edits can be tracked as they're
+    made, so only the text around them has to be compared.
+    Nothing in here touches windows or app globals.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+//
+// ClearDirtyRange
+// Starts tracking edits again, once the text and its copy match
+//
+void ClearDirtyRange(DIRTY_RANGE * dirty)
+{
+    dirty->sameStart = (size_t)-1;
+    dirty->sameEnd = (size_t)-1;
+}
+
+//
+// MarkAllDirty
+// Called for an edit that wasn't tracked, so all of the text is compared
+//
+void MarkAllDirty(DIRTY_RANGE * dirty)
+{
+    dirty->sameStart = 0;
+    dirty->sameEnd = 0;
+}
+
+//
+// AddDirtyEdit
+// Adds an edit that changed the text somewhere between the selection
+// before it, from oldStart to oldEnd of oldLength characters, and the
+// selection after it, from newStart to newEnd of newLength characters.
+// That's where typing, deleting and pasting change the text.
+//
+void AddDirtyEdit(DIRTY_RANGE * dirty, size_t oldLength, size_t oldStart, size_t oldEnd,
+    size_t newLength, size_t newStart, size_t newEnd)
+{
+    size_t sameEnd;
+
+    oldEnd = min(oldEnd, oldLength);
+    newEnd = min(newEnd, newLength);
+    sameEnd = min(oldLength - oldEnd, newLength - newEnd);
+
+    dirty->sameStart = min(dirty->sameStart, min(oldStart, newStart));
+    dirty->sameEnd = min(dirty->sameEnd, sameEnd);
+}
+
+//
+// FindChangedRange
+// Compares newText with oldText, an older copy of it, skipping what
+// dirty says is the same at the start and end. Returns FALSE if they're
+// the same. Otherwise oldText becomes newText by replacing everything
+// between the first prefix and last suffix characters with the text
+// between them in newText.
+//
+BOOL FindChangedRange(LPCWSTR oldText, size_t oldLength, LPCWSTR newText, size_t newLength,
+    const DIRTY_RANGE * dirty, size_t * prefix, size_t * suffix)
+{
+    size_t shorter = min(oldLength, newLength);
+    size_t same = min(dirty->sameStart, shorter);
+    size_t sameEnd = min(dirty->sameEnd, shorter - same);
+    size_t limit = shorter - sameEnd;
+
+    while(same < limit && oldText[same] == newText[same])
+    {
+        same++;
+    }
+
+    limit = shorter - same;
+    while(sameEnd < limit && oldText[oldLength - sameEnd - 1] == newText[newLength - sameEnd - 1])
+    {
+        sameEnd++;
+    }
+
+    *prefix = same;
+    *suffix = sameEnd;
+
+    return oldLength != newLength || same + sameEnd != shorter;
+}
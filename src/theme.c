@@ -0,0 +1,329 @@
+/* -------------------------------------------------------------
+
+theme.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for the color themes and the GDI objects used to draw the edit control.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <windows.h>
+#include <shlwapi.h>
+#include <stdlib.h>
+#include "esnpad.h"
+
+// The maximum number of fonts that we keep. There's one edit control font
+// and one hex view font per DPI. More than one DPI is only needed when
+// moving between monitors.
+#define MAX_CACHED_FONTS 8
+
+// The name of the optional file, next to the exe, that overrides the theme colors
+#define THEME_FILE_NAME L"esnpad.ini"
+
+//
+// globals
+//
+// The highlight colors for each token type, in the order of the TOKEN_ constants
+const COLORREF g_lightTokenColors[TOKEN_TYPE_COUNT] =
+{
+    LIGHT_MODE_TEXT_COLOR,
+    RGB(0x00, 0x80, 0x80),  // timestamp
+    RGB(0xC0, 0x00, 0x00),  // error
+    RGB(0xA0, 0x60, 0x00),  // warning
+    RGB(0x00, 0x60, 0x00),  // info
+    RGB(0x80, 0x80, 0x80),  // debug
+    RGB(0x00, 0x00, 0xA0),  // key
+    RGB(0xA0, 0x30, 0x30),  // string
+    RGB(0x09, 0x86, 0x58),  // number
+    RGB(0x00, 0x00, 0xFF),  // keyword
+    RGB(0x60, 0x60, 0x60),  // punctuation
+};
+const COLORREF g_darkTokenColors[TOKEN_TYPE_COUNT] =
+{
+    DARK_MODE_TEXT_COLOR,
+    RGB(0x4E, 0xC9, 0xB0),  // timestamp
+    RGB(0xF4, 0x47, 0x47),  // error
+    RGB(0xDC, 0xDC, 0xAA),  // warning
+    RGB(0x6A, 0x99, 0x55),  // info
+    RGB(0x80, 0x80, 0x80),  // debug
+    RGB(0x9C, 0xDC, 0xFE),  // key
+    RGB(0xCE, 0x91, 0x78),  // string
+    RGB(0xB5, 0xCE, 0xA8),  // number
+    RGB(0x56, 0x9C, 0xD6),  // keyword
+    RGB(0xA0, 0xA0, 0xA0),  // punctuation
+};
+THEME g_lightTheme = { L"Light", LIGHT_MODE_TEXT_COLOR, LIGHT_MODE_BACKGROUND_COLOR, g_lightTokenColors, NULL };
+THEME g_darkTheme = { L"Dark", DARK_MODE_TEXT_COLOR, DARK_MODE_BACKGROUND_COLOR, g_darkTokenColors, NULL };
+THEME * g_currentTheme = &g_lightTheme; // the theme used to paint the edit control
+HFONT g_cachedFonts[MAX_CACHED_FONTS] = {0};    // edit control and hex view fonts...
+UINT g_cachedFontDpis[MAX_CACHED_FONTS] = {0};  // ...the DPI of each one...
+BOOL g_cachedFontFixed[MAX_CACHED_FONTS] = {0}; // ...and whether each one is fixed pitch
+int g_nextFontSlot = 0;         // the slot to use for the next new font
+
+extern HWND g_hwndEdit;
+extern HWND g_hwndHex;
+extern HWND g_hwndFilter;
+
+//
+// GetGdiObjectCount
+// Returns the number of GDI objects currently owned by the process.
+//
+DWORD GetGdiObjectCount(void)
+{
+    return GetGuiResources(GetCurrentProcess(), GR_GDIOBJECTS);
+}
+
+//
+// LogGdiObjectCount
+// Logs the number of GDI objects owned by the process in debug builds,
+// so that a leak shows up as a count that keeps growing.
+//
+void LogGdiObjectCount(const WCHAR * reason)
+{
+    DebugLog(L"GDI objects after %s: %u\n", reason, GetGdiObjectCount());
+}
+
+//
+// CreateScaledFont
+// Helper function to create scaled font based on DPI.
+// A fixed pitch font is used when characters need to line up in columns.
+//
+HFONT CreateScaledFont(UINT dpi, BOOL fixedPitch)
+{
+    int scaledHeight = MulDiv(18, dpi, 96); // Base font size of 18
+
+    if(fixedPitch)
+    {
+        return CreateFont(scaledHeight, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
+                         DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
+                         DEFAULT_QUALITY, FIXED_PITCH|FF_MODERN, L"Consolas");
+    }
+
+    return CreateFont(scaledHeight, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
+                     DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
+                     DEFAULT_QUALITY, DEFAULT_PITCH|FF_DONTCARE, NULL);
+}
+
+//
+// IsFontInUse
+// Returns TRUE if hFont is set on the edit control or the filter view.
+// Those keep using the font they were given until they get another one,
+// so it can't be deleted until then.
+//
+BOOL IsFontInUse(HFONT hFont)
+{
+    if(!hFont)
+    {
+        return FALSE;
+    }
+
+    return (g_hwndEdit && (HFONT)SendMessage(g_hwndEdit, WM_GETFONT, 0, 0) == hFont) ||
+        (g_hwndFilter && (HFONT)SendMessage(g_hwndFilter, WM_GETFONT, 0, 0) == hFont);
+}
+
+//
+// GetCachedFont
+// Returns the font for the specified DPI and pitch.
+// The font is created the first time it's needed, and reused after that.
+// The caller must not delete the returned font.
+//
+HFONT GetCachedFont(UINT dpi, BOOL fixedPitch)
+{
+    HFONT hFont;
+    int slot;
+
+    // Look for a font that was already created for this DPI and pitch
+    for(slot = 0; slot < MAX_CACHED_FONTS; slot++)
+    {
+        if(g_cachedFonts[slot] && g_cachedFontDpis[slot] == dpi && g_cachedFontFixed[slot] == fixedPitch)
+        {
+            return g_cachedFonts[slot];
+        }
+    }
+
+    hFont = CreateScaledFont(dpi, fixedPitch);
+    if(!hFont)
+    {
+        return NULL;
+    }
+
+    // Reuse the oldest slot whose font isn't set on a window. Fewer windows
+    // keep a font than there are slots, so there's always one to reuse.
+    // The hex view only selects its font while it paints, so it can go.
+    for(int i = 0; i < MAX_CACHED_FONTS; i++)
+    {
+        slot = g_nextFontSlot;
+        g_nextFontSlot = (g_nextFontSlot + 1) % MAX_CACHED_FONTS;
+
+        if(!IsFontInUse(g_cachedFonts[slot]))
+        {
+            break;
+        }
+    }
+
+    if(g_cachedFonts[slot])
+    {
+        DeleteObject(g_cachedFonts[slot]);
+    }
+
+    g_cachedFonts[slot] = hFont;
+    g_cachedFontDpis[slot] = dpi;
+    g_cachedFontFixed[slot] = fixedPitch;
+
+    LogGdiObjectCount(L"creating a font");
+
+    return hFont;
+}
+
+//
+// GetEditFont
+// Returns the edit control font for the specified DPI.
+// The caller must not delete the returned font.
+//
+HFONT GetEditFont(UINT dpi)
+{
+    return GetCachedFont(dpi, FALSE);
+}
+
+//
+// GetHexViewFont
+// Returns the fixed pitch hex view font for the specified DPI.
+// The caller must not delete the returned font.
+//
+HFONT GetHexViewFont(UINT dpi)
+{
+    return GetCachedFont(dpi, TRUE);
+}
+
+//
+// GetCurrentTheme
+// Returns the theme used to paint the edit control. Its background
+// brush is created the first time it's needed, then reused.
+//
+const THEME * GetCurrentTheme(void)
+{
+    if(g_currentTheme->backgroundBrush == NULL)
+    {
+        g_currentTheme->backgroundBrush = CreateSolidBrush(g_currentTheme->backgroundColor);
+        LogGdiObjectCount(L"creating a brush");
+    }
+
+    return g_currentTheme;
+}
+
+//
+// SetDarkMode
+// Switches between the dark and light themes. The edit control and
+// hex view are repainted with the new colors, without touching the text.
+//
+void SetDarkMode(BOOL darkMode)
+{
+    g_currentTheme = darkMode ? &g_darkTheme : &g_lightTheme;
+
+    DebugLog(L"Theme is %s\n", g_currentTheme->name);
+
+    if(g_hwndEdit)
+    {
+        InvalidateRect(g_hwndEdit, NULL, TRUE);
+    }
+
+    if(g_hwndHex)
+    {
+        InvalidateRect(g_hwndHex, NULL, TRUE);
+    }
+
+    return;
+}
+
+//
+// ReadThemeColor
+// Reads a color, written as RRGGBB hex digits, from the specified
+// section and key of the theme file. If the key isn't present or
+// isn't a valid color, the color is left as it is.
+//
+void ReadThemeColor(LPCWSTR themeFile, LPCWSTR section, LPCWSTR key, COLORREF * color)
+{
+    WCHAR value[16] = {0};
+    WCHAR * end = NULL;
+    unsigned long rgb;
+
+    if(GetPrivateProfileString(section, key, L"", value, ARRAYSIZE(value), themeFile) != 6)
+    {
+        return;
+    }
+
+    rgb = wcstoul(value, &end, 16);
+    if(end && *end == 0)
+    {
+        *color = RGB((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
+    }
+
+    return;
+}
+
+//
+// LoadThemesFromFile
+// Lets the user define their own light and dark themes in an
+// esnpad.ini file next to the exe. For example:
+//
+//   [Dark]
+//   TextColor=CCCCCC
+//   BackgroundColor=1F1F1F
+//
+// Any colors that aren't in the file keep their defaults.
+//
+void LoadThemesFromFile(void)
+{
+    WCHAR themeFile[MAX_PATH];
+    THEME * themes[] = { &g_lightTheme, &g_darkTheme };
+
+    if(GetModuleFileName(NULL, themeFile, MAX_PATH) == 0 ||
+        !PathRemoveFileSpec(themeFile) ||
+        !PathAppend(themeFile, THEME_FILE_NAME) ||
+        !PathFileExists(themeFile))
+    {
+        // No theme file, so keep the default themes
+        return;
+    }
+
+    for(size_t i = 0; i < ARRAYSIZE(themes); i++)
+    {
+        ReadThemeColor(themeFile, themes[i]->name, L"TextColor", &themes[i]->textColor);
+        ReadThemeColor(themeFile, themes[i]->name, L"BackgroundColor", &themes[i]->backgroundColor);
+    }
+
+    DebugLog(L"Loaded themes from %s\n", themeFile);
+
+    return;
+}
+
+//
+// FreeThemeResources
+// Deletes all of the cached GDI objects.
+// Call this once the edit control has been destroyed.
+//
+void FreeThemeResources(void)
+{
+    if(g_lightTheme.backgroundBrush)
+    {
+        DeleteObject(g_lightTheme.backgroundBrush);
+        g_lightTheme.backgroundBrush = NULL;
+    }
+
+    if(g_darkTheme.backgroundBrush)
+    {
+        DeleteObject(g_darkTheme.backgroundBrush);
+        g_darkTheme.backgroundBrush = NULL;
+    }
+
+    for(int slot = 0; slot < MAX_CACHED_FONTS; slot++)
+    {
+        if(g_cachedFonts[slot])
+        {
+            DeleteObject(g_cachedFonts[slot]);
+            g_cachedFonts[slot] = NULL;
+        }
+    }
+
+    LogGdiObjectCount(L"freeing theme resources");
+}
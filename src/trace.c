@@ -0,0 +1,446 @@
+/* -------------------------------------------------------------
+
+trace.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for timing operations and writing them out as a trace file.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "esncore.h"
+
+// The environment variable that enables tracing, and names the trace file
+#define TRACE_ENV_VAR      L"ESNPAD_TRACE"
+
+// The most distinct operation names that the trace summary reports on
+#define TRACE_MAX_NAMES    32
+
+// One completed, timed operation
+typedef struct _TRACE_EVENT
+{
+    const char * name;
+    LONGLONG start;         // in performance counter ticks
+    LONGLONG duration;      // in performance counter ticks
+    ULONGLONG bytes;        // how much data the operation processed
+    DWORD threadId;
+} TRACE_EVENT;
+
+// The events one thread recorded. Only that thread writes to its ring,
+// so recording an event takes no lock, and no other thread's cache line.
+// The rings are never freed, so they can be written out after their
+// threads have exited.
+typedef struct _TRACE_RING
+{
+    TRACE_EVENT events[TRACE_EVENT_COUNT];
+    volatile LONG eventCount;       // total number of events ever recorded
+    DWORD threadId;
+    struct _TRACE_RING * next;      // the ring of the thread that started tracing before this one
+} TRACE_RING;
+
+//
+// globals
+//
+BOOL g_traceEnabled = FALSE;    // checked by TRACE_BEGIN and TRACE_END
+WCHAR g_traceFile[MAX_PATH] = {0};
+TRACE_RING * volatile g_traceRings = NULL;  // every thread's ring, newest first
+THREAD_LOCAL TRACE_RING * g_traceRing = NULL;   // this thread's ring
+LARGE_INTEGER g_traceFrequency;
+LARGE_INTEGER g_traceStart;
+
+//
+// InitTrace
+// Enables tracing if the ESNPAD_TRACE environment variable is set.
+// Its value is the path of the trace file that WriteTraceFile creates.
+//
+void InitTrace(void)
+{
+    WCHAR traceFile[MAX_PATH];
+    DWORD length = GetEnvironmentVariable(TRACE_ENV_VAR, traceFile, MAX_PATH);
+
+    if(length > 0 && length < MAX_PATH)
+    {
+        StartTrace(traceFile);
+    }
+
+    return;
+}
+
+//
+// StartTrace
+// Enables tracing, with the events written to traceFile by WriteTraceFile
+//
+void StartTrace(LPCWSTR traceFile)
+{
+    size_t length = wcslen(traceFile);
+
+    if(length >= MAX_PATH)
+    {
+        return;
+    }
+
+    CopyMemory(g_traceFile, traceFile, (length + 1) * sizeof(WCHAR));
+    QueryPerformanceFrequency(&g_traceFrequency);
+    QueryPerformanceCounter(&g_traceStart);
+    g_traceEnabled = TRUE;
+
+    return;
+}
+
+//
+// GetTraceRing
+// Returns the calling thread's ring buffer, creating it and adding it
+// to the list of rings the first time the thread records an event.
+// Returns NULL if there isn't memory for one.
+//
+TRACE_RING * GetTraceRing(void)
+{
+    TRACE_RING * ring = g_traceRing;
+
+    if(ring)
+    {
+        return ring;
+    }
+
+    ring = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(TRACE_RING));
+    if(!ring)
+    {
+        return NULL;
+    }
+
+    ring->threadId = GetCurrentThreadId();
+
+    // Push it on the list, without a lock, in case other threads are too
+    do
+    {
+        ring->next = g_traceRings;
+    } while(InterlockedCompareExchangePointer((PVOID volatile *)&g_traceRings, ring, ring->next) != ring->next);
+
+    g_traceRing = ring;
+
+    return ring;
+}
+
+//
+// TraceBegin
+// Starts timing the operation described by scope.
+// Call it through TRACE_BEGIN, which skips the call when tracing is off.
+//
+void TraceBegin(TRACE_SCOPE * scope, const char * name)
+{
+    LARGE_INTEGER now;
+
+    QueryPerformanceCounter(&now);
+    scope->name = name;
+    scope->start = now.QuadPart;
+    scope->bytes = 0;
+
+    return;
+}
+
+//
+// TraceEnd
+// Stops timing the operation described by scope, and records it in
+// the calling thread's ring buffer. The event is filled in before the
+// ring's count is raised to include it, so WriteTraceFile can read the
+// rings while their threads are still recording.
+// Call it through TRACE_END, which skips the call when tracing is off.
+//
+void TraceEnd(TRACE_SCOPE * scope)
+{
+    LARGE_INTEGER now;
+    TRACE_RING * ring;
+    TRACE_EVENT * event;
+
+    QueryPerformanceCounter(&now);
+
+    // If tracing was off when the scope began, there's nothing to record
+    if(scope->name == NULL)
+    {
+        return;
+    }
+
+    ring = GetTraceRing();
+    if(!ring)
+    {
+        return;
+    }
+
+    event = &ring->events[(DWORD)ring->eventCount % TRACE_EVENT_COUNT];
+    event->name = scope->name;
+    event->start = scope->start;
+    event->duration = now.QuadPart - scope->start;
+    event->bytes = scope->bytes;
+    event->threadId = ring->threadId;
+
+    // Only this thread changes the count, so this never waits on another one
+    InterlockedIncrement(&ring->eventCount);
+
+    return;
+}
+
+//
+// CompareTraceEvents
+// qsort comparison function for sorting events by when they started
+//
+int CompareTraceEvents(const void * a, const void * b)
+{
+    LONGLONG x = ((const TRACE_EVENT *)a)->start;
+    LONGLONG y = ((const TRACE_EVENT *)b)->start;
+
+    return (x > y) - (x < y);
+}
+
+//
+// CollectTraceEvents
+// Copies the events in every thread's ring buffer to events, which
+// must hold maxEvents, and sorts them by when they started. A thread
+// can overwrite its oldest events while they're being copied, so those
+// copies are dropped, along with the oldest event of a full ring, since
+// its slot is the next one written. Returns the number of events copied.
+//
+LONG CollectTraceEvents(TRACE_EVENT * events, LONG maxEvents)
+{
+    LONG count = 0;
+    LONG first;
+    LONG last;
+    LONG valid;
+
+    for(TRACE_RING * ring = g_traceRings; ring; ring = ring->next)
+    {
+        // Adding 0 reads the count with a barrier, so the events it covers are all there
+        last = InterlockedExchangeAdd(&ring->eventCount, 0);
+        first = max(last - TRACE_EVENT_COUNT, 0);
+        first = max(first, last - (maxEvents - count));
+
+        for(LONG i = first; i < last; i++)
+        {
+            events[count + i - first] = ring->events[(DWORD)i % TRACE_EVENT_COUNT];
+        }
+
+        valid = InterlockedExchangeAdd(&ring->eventCount, 0) + 1 - TRACE_EVENT_COUNT;
+        valid = min(max(valid, first), last);
+        if(valid > first)
+        {
+            MoveMemory(events + count, events + count + (valid - first), (last - valid) * sizeof(TRACE_EVENT));
+        }
+
+        count += last - valid;
+    }
+
+    qsort(events, count, sizeof(TRACE_EVENT), CompareTraceEvents);
+
+    return count;
+}
+
+//
+// TicksToMicroseconds
+// Converts a performance counter tick count to microseconds
+//
+double TicksToMicroseconds(LONGLONG ticks)
+{
+    return (double)ticks * 1000000.0 / (double)g_traceFrequency.QuadPart;
+}
+
+//
+// CompareDoubles
+// qsort comparison function for sorting doubles in ascending order
+//
+int CompareDoubles(const void * a, const void * b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+//
+// WriteTraceSummary
+// Writes the "otherData" section of the trace file. For each kind of
+// operation in the eventCount events, it reports the count,
+// the 50th and 95th percentile and maximum durations, and the throughput.
+// It also reports how the scratch arena was used, and the peak working
+// set of the process.
+//
+void WriteTraceSummary(HANDLE hFile, const TRACE_EVENT * events, LONG eventCount)
+{
+    const char * names[TRACE_MAX_NAMES];
+    int nameCount = 0;
+    double * durations;
+    char line[CB_BUFFER];
+    DWORD bytesWritten;
+    SCRATCH_STATS scratchStats;
+    int length;
+
+    WriteFile(hFile, "\"otherData\":{\n", 14, &bytesWritten, NULL);
+
+    durations = HeapAlloc(GetProcessHeap(), 0, (eventCount + 1) * sizeof(double));
+    if(durations)
+    {
+        // Find the distinct operation names. Names are string literals,
+        // so comparing the pointers is enough.
+        for(LONG i = 0; i < eventCount; i++)
+        {
+            const char * name = events[i].name;
+            int n;
+
+            for(n = 0; n < nameCount && names[n] != name; n++);
+
+            if(n == nameCount && nameCount < TRACE_MAX_NAMES)
+            {
+                names[nameCount++] = name;
+            }
+        }
+
+        for(int n = 0; n < nameCount; n++)
+        {
+            int count = 0;
+            double totalMicroseconds = 0;
+            ULONGLONG totalBytes = 0;
+
+            for(LONG i = 0; i < eventCount; i++)
+            {
+                const TRACE_EVENT * event = &events[i];
+
+                if(event->name == names[n])
+                {
+                    durations[count] = TicksToMicroseconds(event->duration);
+                    totalMicroseconds += durations[count];
+                    totalBytes += event->bytes;
+                    count++;
+                }
+            }
+
+            qsort(durations, count, sizeof(double), CompareDoubles);
+
+            // Bytes per microsecond is the same as (decimal) MB per second
+            length = _snprintf_s(line, sizeof(line), _TRUNCATE,
+                "\"%s\":{\"count\":%d,\"p50_ms\":%.3f,\"p95_ms\":%.3f,\"max_ms\":%.3f,\"bytes\":%llu,\"mb_per_sec\":%.1f},\n",
+                names[n],
+                count,
+                durations[(count - 1) * 50 / 100] / 1000.0,
+                durations[(count - 1) * 95 / 100] / 1000.0,
+                durations[count - 1] / 1000.0,
+                totalBytes,
+                (totalMicroseconds > 0) ? (double)totalBytes / totalMicroseconds : 0.0);
+
+            if(length > 0)
+            {
+                WriteFile(hFile, line, (DWORD)length, &bytesWritten, NULL);
+            }
+        }
+
+        HeapFree(GetProcessHeap(), 0, durations);
+    }
+
+    GetScratchStats(&scratchStats);
+
+    length = _snprintf_s(line, sizeof(line), _TRUNCATE,
+        "\"scratch\":{\"peak_bytes\":%llu,\"live_bytes\":%llu,\"reserved_bytes\":%llu,\"allocations\":%llu,"
+        "\"blocks_created\":%llu,\"blocks_reused\":%llu,\"reuse_rate\":%.3f},\n",
+        scratchStats.peakBytes,
+        scratchStats.liveBytes,
+        scratchStats.reservedBytes,
+        scratchStats.allocations,
+        scratchStats.blocksCreated,
+        scratchStats.blocksReused,
+        (scratchStats.blocksCreated + scratchStats.blocksReused > 0) ?
+            (double)scratchStats.blocksReused / (double)(scratchStats.blocksCreated + scratchStats.blocksReused) : 0.0);
+
+    if(length > 0)
+    {
+        WriteFile(hFile, line, (DWORD)length, &bytesWritten, NULL);
+    }
+
+    length = _snprintf_s(line, sizeof(line), _TRUNCATE,
+        "\"peak_working_set_bytes\":%llu}\n", GetPeakMemoryUsage());
+
+    if(length > 0)
+    {
+        WriteFile(hFile, line, (DWORD)length, &bytesWritten, NULL);
+    }
+
+    return;
+}
+
+//
+// WriteTraceFile
+// Writes the events in every thread's ring buffer to the trace file, in
+// the Chrome trace event JSON format. Open it with chrome://tracing
+// or https://ui.perfetto.dev to see a timeline. The summary statistics
+// in "otherData" can be compared between runs to catch regressions.
+// It can be called at any time, even while other threads are tracing.
+//
+void WriteTraceFile(void)
+{
+    HANDLE hFile;
+    char line[CB_BUFFER];
+    DWORD bytesWritten;
+    TRACE_EVENT * events;
+    LONG maxEvents = 0;
+    LONG eventCount;
+    int length;
+
+    if(!g_traceEnabled)
+    {
+        return;
+    }
+
+    for(TRACE_RING * ring = g_traceRings; ring; ring = ring->next)
+    {
+        maxEvents += TRACE_EVENT_COUNT;
+    }
+
+    events = HeapAlloc(GetProcessHeap(), 0, max(maxEvents, 1) * sizeof(TRACE_EVENT));
+    if(!events)
+    {
+        return;
+    }
+
+    hFile = CreateFile(g_traceFile, GENERIC_WRITE, 0,
+        NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        DebugLog(L"Couldn't open trace file for writing: %s", g_traceFile);
+        HeapFree(GetProcessHeap(), 0, events);
+        return;
+    }
+
+    // Rings added since they were counted are left out
+    eventCount = CollectTraceEvents(events, maxEvents);
+
+    WriteFile(hFile, "{\"traceEvents\":[\n", 17, &bytesWritten, NULL);
+
+    for(LONG i = 0; i < eventCount; i++)
+    {
+        TRACE_EVENT * event = &events[i];
+
+        length = _snprintf_s(line, sizeof(line), _TRUNCATE,
+            "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%lu,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%llu}}\n",
+            (i == 0) ? "" : ",",
+            event->name,
+            (unsigned long)GetCurrentProcessId(),
+            (unsigned long)event->threadId,
+            TicksToMicroseconds(event->start - g_traceStart.QuadPart),
+            TicksToMicroseconds(event->duration),
+            event->bytes);
+
+        if(length > 0)
+        {
+            WriteFile(hFile, line, (DWORD)length, &bytesWritten, NULL);
+        }
+    }
+
+    WriteFile(hFile, "],\n", 3, &bytesWritten, NULL);
+
+    WriteTraceSummary(hFile, events, eventCount);
+
+    WriteFile(hFile, "}\n", 2, &bytesWritten, NULL);
+
+    CloseHandle(hFile);
+    HeapFree(GetProcessHeap(), 0, events);
+
+    return;
+}
@@ -0,0 +1,489 @@
+/* -------------------------------------------------------------
+
+transform.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Code for edits that rewrite many lines of text at once.
+    Nothing in here touches windows or app globals.
+
+    Lines end with CRLF, like the edit control's text. Each transform
+    reads its input once and writes the whole result to a new buffer,
+    so it can replace the input in a single step.
+
+    Sorting many lines splits them into runs that are sorted on
+    separate threads, then the runs are merged in pairs, also on
+    separate threads, until one is left.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "esncore.h"
+
+// One run of line numbers to sort, or two neighboring runs to merge
+typedef struct _SORT_TASK
+{
+    LPCWSTR text;
+    const DWORD * lineStarts;
+    DWORD * src;
+    DWORD * dst;
+    DWORD start;        // where the run starts in src and dst
+    DWORD leftCount;    // when merging, the length of the first run
+    DWORD count;        // the length of the run, or of both runs when merging
+} SORT_TASK;
+
+//
+// CountTextLines
+// Returns the number of lines in text. Empty text has one empty line.
+//
+DWORD CountTextLines(LPCWSTR text, DWORD textLength)
+{
+    DWORD lineCount = 1;
+
+    for(DWORD i = 1; i < textLength; i++)
+    {
+        if(text[i] == L'\n' && text[i - 1] == L'\r')
+        {
+            lineCount++;
+        }
+    }
+
+    return lineCount;
+}
+
+//
+// FillLineTable
+// Stores the offset where each line of text starts in lineStarts,
+// which must have room for CountTextLines entries, plus one more
+// for the end of the text. So the length of line n, without its
+// line break, is GetLineLength(lineStarts, n, lineCount).
+//
+void FillLineTable(LPCWSTR text, DWORD textLength, DWORD * lineStarts)
+{
+    DWORD line = 0;
+
+    lineStarts[line++] = 0;
+    for(DWORD i = 1; i < textLength; i++)
+    {
+        if(text[i] == L'\n' && text[i - 1] == L'\r')
+        {
+            lineStarts[line++] = i + 1;
+        }
+    }
+
+    // The last line has no line break, so the end of the text
+    // is stored as if one followed it
+    lineStarts[line] = textLength + 2;
+}
+
+//
+// GetLineLength
+// Returns the length of a line in a line table, without its line break
+//
+DWORD GetLineLength(const DWORD * lineStarts, DWORD line)
+{
+    return lineStarts[line + 1] - lineStarts[line] - 2;
+}
+
+//
+// ApplyColumnEdit
+// Rewrites every line in a line table in one pass: width characters
+// starting at column are removed, and insertText is inserted there.
+// Lines that are shorter than column are padded with spaces first,
+// unless there's nothing to insert. The lines are written to output
+// with CRLF between them. Pass NULL for output to get the length the
+// result needs. Returns the length of the result.
+//
+size_t ApplyColumnEdit(LPCWSTR text, const DWORD * lineStarts, DWORD lineCount,
+    DWORD column, DWORD width, LPCWSTR insertText, size_t insertLength, WCHAR * output)
+{
+    size_t outputLength = 0;
+    DWORD lineLength;
+    DWORD keep;
+    DWORD padding;
+    DWORD removed;
+    LPCWSTR line;
+
+    for(DWORD i = 0; i < lineCount; i++)
+    {
+        line = text + lineStarts[i];
+        lineLength = GetLineLength(lineStarts, i);
+
+        keep = min(column, lineLength);
+        padding = (insertLength > 0 && lineLength < column) ? column - lineLength : 0;
+        removed = (lineLength > column) ? min(width, lineLength - column) : 0;
+
+        if(output)
+        {
+            CopyMemory(output + outputLength, line, keep * sizeof(WCHAR));
+            for(DWORD p = 0; p < padding; p++)
+            {
+                output[outputLength + keep + p] = L' ';
+            }
+            CopyMemory(output + outputLength + keep + padding, insertText, insertLength * sizeof(WCHAR));
+            CopyMemory(output + outputLength + keep + padding + insertLength, line + keep + removed,
+                (lineLength - keep - removed) * sizeof(WCHAR));
+        }
+        outputLength += keep + padding + insertLength + (lineLength - keep - removed);
+
+        if(i + 1 < lineCount)
+        {
+            if(output)
+            {
+                output[outputLength] = L'\r';
+                output[outputLength + 1] = L'\n';
+            }
+            outputLength += 2;
+        }
+    }
+
+    return outputLength;
+}
+
+//
+// CompareLines
+// Compares two lines in a line table by their characters' values,
+// like wcscmp. A line that's a prefix of another sorts first.
+//
+int CompareLines(LPCWSTR text, const DWORD * lineStarts, DWORD a, DWORD b)
+{
+    DWORD lengthA = GetLineLength(lineStarts, a);
+    DWORD lengthB = GetLineLength(lineStarts, b);
+    int result = wmemcmp(text + lineStarts[a], text + lineStarts[b], min(lengthA, lengthB));
+
+    if(result != 0)
+    {
+        return result;
+    }
+
+    return (lengthA < lengthB) ? -1 : (lengthA > lengthB);
+}
+
+//
+// MergeLineOrder
+// Merges two sorted runs of line numbers into output.
+// Equal lines keep their order, with the left run's first.
+//
+void MergeLineOrder(LPCWSTR text, const DWORD * lineStarts, const DWORD * left, DWORD leftCount,
+    const DWORD * right, DWORD rightCount, DWORD * output)
+{
+    DWORD l = 0;
+    DWORD r = 0;
+
+    while(l < leftCount && r < rightCount)
+    {
+        if(CompareLines(text, lineStarts, left[l], right[r]) <= 0)
+        {
+            *output++ = left[l++];
+        }
+        else
+        {
+            *output++ = right[r++];
+        }
+    }
+
+    CopyMemory(output, left + l, (leftCount - l) * sizeof(DWORD));
+    CopyMemory(output + (leftCount - l), right + r, (rightCount - r) * sizeof(DWORD));
+}
+
+//
+// SortLineOrder
+// Sorts count line numbers in order by the text of their lines.
+// Only the line numbers move, never the text. The sort is a stable
+// merge sort: short runs are sorted by insertion, then merged back
+// and forth between order and temp, which must hold count entries.
+//
+void SortLineOrder(LPCWSTR text, const DWORD * lineStarts, DWORD * order, DWORD * temp, DWORD count)
+{
+    DWORD * src = order;
+    DWORD * dst = temp;
+    DWORD * swap;
+    DWORD start;
+    DWORD end;
+    DWORD i;
+    DWORD j;
+    DWORD line;
+    DWORD width;
+    DWORD middle;
+
+    for(start = 0; start < count; start += SORT_RUN_LINES)
+    {
+        end = min(start + SORT_RUN_LINES, count);
+        for(i = start + 1; i < end; i++)
+        {
+            line = order[i];
+            for(j = i; j > start && CompareLines(text, lineStarts, order[j - 1], line) > 0; j--)
+            {
+                order[j] = order[j - 1];
+            }
+            order[j] = line;
+        }
+    }
+
+    for(width = SORT_RUN_LINES; width < count; width *= 2)
+    {
+        for(start = 0; start < count; start += 2 * width)
+        {
+            middle = min(start + width, count);
+            end = min(middle + width, count);
+            MergeLineOrder(text, lineStarts, src + start, middle - start, src + middle, end - middle, dst + start);
+        }
+
+        swap = src;
+        src = dst;
+        dst = swap;
+
+        if(width > MAXDWORD / 2)
+        {
+            break;
+        }
+    }
+
+    if(src != order)
+    {
+        CopyMemory(order, src, count * sizeof(DWORD));
+    }
+}
+
+//
+// GetParallelTaskCount
+// Returns how many tasks to split work of the given size into:
+// one for each processor, but none smaller than minSize, and at least one.
+//
+DWORD GetParallelTaskCount(ULONGLONG size, ULONGLONG minSize)
+{
+    ULONGLONG taskCount;
+
+    taskCount = min(GetProcessorCount(), MAX_PARALLEL_TASKS);
+    taskCount = min(taskCount, size / minSize);
+
+    return (DWORD)max(taskCount, 1);
+}
+
+//
+// SortTaskCallback
+// Sorts one run of line numbers in place in dst, using src as scratch space
+//
+void SortTaskCallback(void * context)
+{
+    SORT_TASK * task = (SORT_TASK *)context;
+
+    SortLineOrder(task->text, task->lineStarts, task->dst + task->start,
+        task->src + task->start, task->count);
+}
+
+//
+// MergeTaskCallback
+// Merges two neighboring sorted runs from src into dst
+//
+void MergeTaskCallback(void * context)
+{
+    SORT_TASK * task = (SORT_TASK *)context;
+
+    MergeLineOrder(task->text, task->lineStarts, task->src + task->start, task->leftCount,
+        task->src + task->start + task->leftCount, task->count - task->leftCount, task->dst + task->start);
+}
+
+//
+// SortLinesInTasks
+// Sorts count line numbers like SortLineOrder, as taskCount runs that
+// are sorted at once and then merged in pairs. The order is the same
+// however many tasks there are. temp must hold count entries.
+//
+void SortLinesInTasks(LPCWSTR text, const DWORD * lineStarts, DWORD * order, DWORD * temp, DWORD count,
+    DWORD taskCount)
+{
+    SORT_TASK tasks[MAX_PARALLEL_TASKS];
+    SORT_TASK left;
+    DWORD mergeCount;
+    DWORD * src = order;
+    DWORD * dst = temp;
+    DWORD * swap;
+    DWORD i;
+
+    taskCount = min(taskCount, MAX_PARALLEL_TASKS);
+    if(taskCount <= 1)
+    {
+        SortLineOrder(text, lineStarts, order, temp, count);
+        return;
+    }
+
+    for(i = 0; i < taskCount; i++)
+    {
+        tasks[i].text = text;
+        tasks[i].lineStarts = lineStarts;
+        tasks[i].src = temp;
+        tasks[i].dst = order;
+        tasks[i].start = (DWORD)((ULONGLONG)count * i / taskCount);
+        tasks[i].leftCount = 0;
+        tasks[i].count = (DWORD)((ULONGLONG)count * (i + 1) / taskCount) - tasks[i].start;
+    }
+
+    RunParallelTasks(SortTaskCallback, tasks, sizeof(SORT_TASK), taskCount);
+
+    // Each round merges the runs in pairs, so there are half as many runs
+    // after it. An odd run out is copied through as it is.
+    while(taskCount > 1)
+    {
+        mergeCount = 0;
+        for(i = 0; i < taskCount; i += 2)
+        {
+            left = tasks[i];
+            left.src = src;
+            left.dst = dst;
+            left.leftCount = left.count;
+            if(i + 1 < taskCount)
+            {
+                left.count += tasks[i + 1].count;
+            }
+            tasks[mergeCount++] = left;
+        }
+
+        RunParallelTasks(MergeTaskCallback, tasks, sizeof(SORT_TASK), mergeCount);
+
+        swap = src;
+        src = dst;
+        dst = swap;
+        taskCount = mergeCount;
+    }
+
+    if(src != order)
+    {
+        CopyMemory(order, src, count * sizeof(DWORD));
+    }
+}
+
+//
+// SortLinesInParallel
+// Sorts count line numbers in order by the text of their lines, like
+// SortLineOrder, but splits the work across the processors when there
+// are enough lines. temp must hold count entries.
+//
+void SortLinesInParallel(LPCWSTR text, const DWORD * lineStarts, DWORD * order, DWORD * temp, DWORD count)
+{
+    SortLinesInTasks(text, lineStarts, order, temp, count, GetParallelTaskCount(count, MIN_SORT_TASK_LINES));
+}
+
+//
+// RemoveAdjacentDuplicates
+// Removes each line number in a sorted order whose line is the same
+// as the one before it. Returns the number of line numbers left.
+//
+DWORD RemoveAdjacentDuplicates(LPCWSTR text, const DWORD * lineStarts, DWORD * order, DWORD count)
+{
+    DWORD kept = 0;
+
+    for(DWORD i = 0; i < count; i++)
+    {
+        if(kept == 0 || CompareLines(text, lineStarts, order[kept - 1], order[i]) != 0)
+        {
+            order[kept++] = order[i];
+        }
+    }
+
+    return kept;
+}
+
+//
+// RemoveLaterDuplicates
+// Finds the first of each set of equal lines, using sorted, which
+// must be every line number sorted by SortLineOrder. Since that sort
+// is stable, the first of each run of equal lines in it is the one
+// that comes first in the text. The lines to keep are marked in keep,
+// which must have count entries, and their numbers are written to order
+// in their original order. Returns the number of lines kept.
+//
+DWORD RemoveLaterDuplicates(LPCWSTR text, const DWORD * lineStarts, const DWORD * sorted, DWORD count,
+    BYTE * keep, DWORD * order)
+{
+    DWORD kept = 0;
+    DWORD i;
+
+    for(i = 0; i < count; i++)
+    {
+        keep[sorted[i]] = (i == 0 || CompareLines(text, lineStarts, sorted[i - 1], sorted[i]) != 0);
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        if(keep[i])
+        {
+            order[kept++] = i;
+        }
+    }
+
+    return kept;
+}
+
+//
+// WriteLinesInOrder
+// Writes the lines in order to output, with CRLF between them.
+// Pass NULL for output to get the length the result needs.
+// Returns the length of the result.
+//
+size_t WriteLinesInOrder(LPCWSTR text, const DWORD * lineStarts, const DWORD * order, DWORD count, WCHAR * output)
+{
+    size_t outputLength = 0;
+    DWORD lineLength;
+
+    for(DWORD i = 0; i < count; i++)
+    {
+        lineLength = GetLineLength(lineStarts, order[i]);
+        if(output)
+        {
+            CopyMemory(output + outputLength, text + lineStarts[order[i]], lineLength * sizeof(WCHAR));
+        }
+        outputLength += lineLength;
+
+        if(i + 1 < count)
+        {
+            if(output)
+            {
+                output[outputLength] = L'\r';
+                output[outputLength + 1] = L'\n';
+            }
+            outputLength += 2;
+        }
+    }
+
+    return outputLength;
+}
+
+//
+// TrimTrailingWhitespace
+// Writes every line to output without the spaces and tabs at its end,
+// with CRLF between them. Pass NULL for output to get the length the
+// result needs. Returns the length of the result.
+//
+size_t TrimTrailingWhitespace(LPCWSTR text, const DWORD * lineStarts, DWORD lineCount, WCHAR * output)
+{
+    size_t outputLength = 0;
+    LPCWSTR line;
+    DWORD lineLength;
+
+    for(DWORD i = 0; i < lineCount; i++)
+    {
+        line = text + lineStarts[i];
+        lineLength = GetLineLength(lineStarts, i);
+        while(lineLength > 0 && (line[lineLength - 1] == L' ' || line[lineLength - 1] == L'\t'))
+        {
+            lineLength--;
+        }
+
+        if(output)
+        {
+            CopyMemory(output + outputLength, line, lineLength * sizeof(WCHAR));
+        }
+        outputLength += lineLength;
+
+        if(i + 1 < lineCount)
+        {
+            if(output)
+            {
+                output[outputLength] = L'\r';
+                output[outputLength + 1] = L'\n';
+            }
+            outputLength += 2;
+        }
+    }
+
+    return outputLength;
+}
@@ -11,31 +11,41 @@ by: Matthew Justice
 #include <windows.h>
 #include <stdio.h> 
 #include <stdarg.h>
+#include "esnpad.h"
 
 //
-// DebugLog
-// A printf style logging function for debug builds
+// LogStartupPhase
+// Records the time since the previous call as a trace event named phase,
+// which must be a string literal, and logs the time elapsed since the
+// first call, in milliseconds. The first call should be made as early as
+// possible in WinMain, right after InitTrace. The trace events are in
+// every build when ESNPAD_TRACE is set, while the log is only in debug builds.
 //
-#ifdef DEBUG
-#define DEBUG_LOG_BUFFER_SIZE 1024
-void DebugLog(const WCHAR * format, ...)
+void LogStartupPhase(const char * phase)
 {
-    va_list vaArgs;
-    static WCHAR buffer[DEBUG_LOG_BUFFER_SIZE];
+    static LARGE_INTEGER frequency = {0};
+    static LARGE_INTEGER start = {0};
+    static LARGE_INTEGER previous = {0};
+    LARGE_INTEGER now;
+    TRACE_SCOPE scope;
 
-    va_start(vaArgs, format);
-    if(vswprintf(buffer, DEBUG_LOG_BUFFER_SIZE, format, vaArgs) > 0)
+    QueryPerformanceCounter(&now);
+
+    if(frequency.QuadPart == 0)
     {
-        OutputDebugStringW(buffer);
+        QueryPerformanceFrequency(&frequency);
+        start = now;
+        previous = now;
     }
-    va_end(vaArgs);
-}
-#else /* DEBUG */
-//
-// Do not log in release builds
-//
-void DebugLog(const WCHAR * format, ...)
-{
-    UNREFERENCED_PARAMETER(format);
+
+    // The phase ran from the end of the one before it until now
+    scope.name = phase;
+    scope.start = previous.QuadPart;
+    scope.bytes = 0;
+    TRACE_END(scope);
+
+    DebugLog(L"%S %8.2f ms\n", phase,
+        (double)(now.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart);
+
+    previous = now;
 }
-#endif /* DEBUG */
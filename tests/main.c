@@ -0,0 +1,216 @@
+/* -------------------------------------------------------------
+
+main.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Runs the tests of the portable core. With no arguments every suite
+    runs; otherwise only the suites that are named. Returns non-zero
+    if any check fails.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+
+//
+// globals
+//
+int g_checkCount = 0;
+int g_failureCount = 0;
+
+const TEST_SUITE g_testSuites[] =
+{
+    { "compress", RunCompressTests },
+    { "encoding", RunEncodingTests },
+    { "filesearch", RunFileSearchTests },
+    { "hexformat", RunHexFormatTests },
+    { "lexer", RunLexerTests },
+    { "opencache", RunOpenCacheTests },
+    { "platform", RunPlatformTests },
+    { "saveplan", RunSavePlanTests },
+    { "scratch", RunScratchTests },
+    { "search", RunSearchTests },
+    { "stream", RunStreamTests },
+    { "textdiff", RunTextDiffTests },
+    { "trace", RunTraceTests },
+    { "transform", RunTransformTests },
+};
+
+//
+// CheckCondition
+// Counts a check, and reports it if it failed
+//
+void CheckCondition(BOOL passed, const char * expression, const char * file, int line)
+{
+    g_checkCount++;
+
+    if(!passed)
+    {
+        g_failureCount++;
+        printf("%s(%d): check failed: %s\n", file, line, expression);
+    }
+}
+
+//
+// TextEquals
+// Returns TRUE if text, which is length characters long and doesn't
+// need a terminator, is the same as the null-terminated expected
+//
+BOOL TextEquals(LPCWSTR text, size_t length, LPCWSTR expected)
+{
+    return length == wcslen(expected) && (length == 0 || wmemcmp(text, expected, length) == 0);
+}
+
+//
+// GetWidePath
+// Gets the wide path of a file in a directory. path must hold MAX_PATH characters.
+//
+void GetWidePath(const char * directory, const char * name, WCHAR * path)
+{
+    char narrowPath[MAX_PATH];
+    int length;
+
+    length = _snprintf_s(narrowPath, sizeof(narrowPath), _TRUNCATE, "%s/%s", directory, name);
+    path[0] = 0;
+    if(length > 0)
+    {
+        length = DecodeUtf8((const BYTE *)narrowPath, length, path, MAX_PATH - 1);
+        path[length] = 0;
+    }
+}
+
+//
+// GetTestFilePath
+// Gets the wide path of a file in the sample text directory
+//
+void GetTestFilePath(const char * name, WCHAR * path)
+{
+    GetWidePath(TEST_DATA_DIR, name, path);
+}
+
+//
+// GetTestOutputPath
+// Gets the wide path of a file the tests can create, in the build directory
+//
+void GetTestOutputPath(const char * name, WCHAR * path)
+{
+    GetWidePath(TEST_OUTPUT_DIR, name, path);
+}
+
+//
+// ReadWholeFile
+// Reads a file into memory from the process heap.
+// Returns NULL if it can't be read.
+//
+BYTE * ReadWholeFile(const WCHAR * path, size_t * size)
+{
+    HANDLE hFile;
+    LARGE_INTEGER fileSize;
+    BYTE * data = NULL;
+
+    *size = 0;
+
+    hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    if(GetFileSizeEx(hFile, &fileSize))
+    {
+        data = HeapAlloc(GetProcessHeap(), 0, (size_t)fileSize.QuadPart + 1);
+        if(data && !ReadAllFileBytes(hFile, data, (size_t)fileSize.QuadPart, size))
+        {
+            HeapFree(GetProcessHeap(), 0, data);
+            data = NULL;
+        }
+    }
+
+    CloseHandle(hFile);
+    return data;
+}
+
+//
+// ReadTestFile
+// Reads a sample file into memory from the process heap.
+// Returns NULL if it can't be read.
+//
+BYTE * ReadTestFile(const char * name, size_t * size)
+{
+    WCHAR path[MAX_PATH];
+
+    GetTestFilePath(name, path);
+    return ReadWholeFile(path, size);
+}
+
+//
+// ReadTestOutputFile
+// Reads a file a test created into memory from the process heap.
+// Returns NULL if it can't be read.
+//
+BYTE * ReadTestOutputFile(const char * name, size_t * size)
+{
+    WCHAR path[MAX_PATH];
+
+    GetTestOutputPath(name, path);
+    return ReadWholeFile(path, size);
+}
+
+//
+// CreateTestOutputFile
+// Creates a file in the build directory that holds size bytes of data.
+// Returns it open for reading from the start, or INVALID_HANDLE_VALUE
+// if it can't be written.
+//
+HANDLE CreateTestOutputFile(const char * name, const BYTE * data, size_t size)
+{
+    WCHAR path[MAX_PATH];
+    HANDLE hFile;
+    DWORD bytesWritten = 0;
+    LARGE_INTEGER start = {0};
+
+    GetTestOutputPath(name, path);
+    hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    if(!WriteFile(hFile, data, (DWORD)size, &bytesWritten, NULL) || bytesWritten != size ||
+        !SetFilePointerEx(hFile, start, NULL, FILE_BEGIN))
+    {
+        CloseHandle(hFile);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return hFile;
+}
+
+//
+// main
+//
+int main(int argc, char * argv[])
+{
+    for(size_t i = 0; i < ARRAYSIZE(g_testSuites); i++)
+    {
+        BOOL selected = (argc < 2);
+
+        for(int arg = 1; arg < argc && !selected; arg++)
+        {
+            selected = (strcmp(argv[arg], g_testSuites[i].name) == 0);
+        }
+
+        if(selected)
+        {
+            int failures = g_failureCount;
+
+            g_testSuites[i].run();
+            printf("%-12s %s\n", g_testSuites[i].name, (g_failureCount == failures) ? "passed" : "FAILED");
+        }
+    }
+
+    printf("%d checks, %d failed\n", g_checkCount, g_failureCount);
+
+    return (g_failureCount == 0) ? 0 : 1;
+}
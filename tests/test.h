@@ -0,0 +1,92 @@
+/* -------------------------------------------------------------
+
+test.h
+    Essential Notepad - A basic Notepad implementation for Windows
+    Shared header file for the tests of the portable core
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include "esncore.h"
+
+// Records a failure, with where it happened, if condition is false
+#define CHECK(condition) CheckCondition((condition) != 0, #condition, __FILE__, __LINE__)
+
+// Checks that text, which is length characters long, is expected
+#define CHECK_TEXT(text, length, expected) \
+    CheckCondition(TextEquals((text), (length), (expected)), #text " == " #expected, __FILE__, __LINE__)
+
+// The directory of the sample files, from the build
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "text"
+#endif
+
+// Where the tests create files, from the build
+#ifndef TEST_OUTPUT_DIR
+#define TEST_OUTPUT_DIR "."
+#endif
+
+// A suite of tests, run by name
+typedef struct _TEST_SUITE
+{
+    const char * name;
+    void (*run)(void);
+} TEST_SUITE;
+
+// Function prototypes - main.c
+void CheckCondition(BOOL passed, const char * expression, const char * file, int line);
+BOOL TextEquals(LPCWSTR text, size_t length, LPCWSTR expected);
+BYTE * ReadWholeFile(const WCHAR * path, size_t * size);
+BYTE * ReadTestFile(const char * name, size_t * size);
+BYTE * ReadTestOutputFile(const char * name, size_t * size);
+HANDLE CreateTestOutputFile(const char * name, const BYTE * data, size_t size);
+void GetWidePath(const char * directory, const char * name, WCHAR * path);
+void GetTestFilePath(const char * name, WCHAR * path);
+void GetTestOutputPath(const char * name, WCHAR * path);
+
+// Function prototypes - test_compress.c
+void RunCompressTests(void);
+
+// Function prototypes - test_encoding.c
+void RunEncodingTests(void);
+
+// Function prototypes - test_filesearch.c
+void RunFileSearchTests(void);
+
+// Function prototypes - test_hexformat.c
+void RunHexFormatTests(void);
+
+// Function prototypes - test_lexer.c
+void RunLexerTests(void);
+
+// Function prototypes - test_opencache.c
+void RunOpenCacheTests(void);
+
+// Function prototypes - test_platform.c
+void RunPlatformTests(void);
+
+// Function prototypes - test_saveplan.c
+void RunSavePlanTests(void);
+
+// Function prototypes - test_scratch.c
+void RunScratchTests(void);
+
+// Function prototypes - test_search.c
+void RunSearchTests(void);
+
+// Function prototypes - test_stream.c
+void RunStreamTests(void);
+
+// Function prototypes - test_textdiff.c
+void RunTextDiffTests(void);
+
+// Function prototypes - test_trace.c
+void RunTraceTests(void);
+
+// Function prototypes - test_transform.c
+void RunTransformTests(void);
+
+#endif // _TEST_H_
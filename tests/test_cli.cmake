@@ -0,0 +1,143 @@
+# Runs one of esncli's commands on files this script generates, and
+# checks what it writes and its exit code. ctest runs it as:
+#
+#   cmake -DESNCLI=path -DOPTION=/|- -DCLI_COMMAND=name -DWORK_DIR=dir -P test_cli.cmake
+#
+# OPTION is the character options start with on this platform.
+
+set(LOG_LINES 1000)
+
+# Fails the test, with what the command wrote
+function(fail message)
+    message(FATAL_ERROR "${CLI_COMMAND}: ${message}\noutput:\n${output}\nerrors:\n${errors}")
+endfunction()
+
+# Runs esncli with the args that follow, from WORK_DIR. Sets output,
+# without the carriage returns Windows puts before each line feed,
+# errors, and exitCode in the caller.
+function(run_cli)
+    execute_process(COMMAND ${ESNCLI} ${ARGN}
+        WORKING_DIRECTORY ${WORK_DIR}
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE text
+        ERROR_VARIABLE errorText)
+    string(REPLACE "\r" "" text "${text}")
+    set(output "${text}" PARENT_SCOPE)
+    set(errors "${errorText}" PARENT_SCOPE)
+    set(exitCode "${result}" PARENT_SCOPE)
+endfunction()
+
+# Runs esncli, and checks it exited with expectedExitCode and wrote
+# expected. Sets output, errors and exitCode in the caller too.
+function(expect_cli expectedExitCode expected)
+    run_cli(${ARGN})
+    if(NOT exitCode EQUAL expectedExitCode)
+        fail("${ARGN} exited with ${exitCode}, not ${expectedExitCode}")
+    endif()
+    if(NOT output STREQUAL expected)
+        fail("${ARGN} wrote the wrong output, expected:\n${expected}")
+    endif()
+    set(output "${output}" PARENT_SCOPE)
+    set(errors "${errors}" PARENT_SCOPE)
+    set(exitCode "${exitCode}" PARENT_SCOPE)
+endfunction()
+
+# Makes a log like the benchmarks' in log.txt. Each fourth line is a
+# warning, and the one after it an error. Each line's worker is its
+# number modulo 16.
+function(write_log)
+    set(levels INFO DEBUG WARN ERROR)
+    set(text "")
+    math(EXPR last "${LOG_LINES} - 1")
+    foreach(line RANGE ${last})
+        math(EXPR levelIndex "${line} % 4")
+        math(EXPR worker "${line} % 16")
+        math(EXPR ms "${line} % 97")
+        list(GET levels ${levelIndex} level)
+        string(APPEND text "2024-05-01 12:00:00.000 ${level} [worker-${worker}] request ${line} handled in ${ms} ms\n")
+    endforeach()
+    file(WRITE ${WORK_DIR}/log.txt "${text}")
+endfunction()
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+write_log()
+file(WRITE ${WORK_DIR}/crlf.txt "one\r\ntwo\r\n")
+file(WRITE ${WORK_DIR}/mixed.txt "one\r\ntwo\nthree\n")
+file(WRITE ${WORK_DIR}/empty.txt "")
+
+set(O ${OPTION})
+
+if(CLI_COMMAND STREQUAL "detect")
+    expect_cli(0 "log.txt: UTF-8, LF\n" ${O}detect log.txt)
+    expect_cli(0 "crlf.txt: UTF-8, CRLF\nmixed.txt: UTF-8, mixed line endings (1 CRLF, 2 LF, 0 CR)\nempty.txt: UTF-8, no line breaks\n"
+        ${O}detect crlf.txt mixed.txt empty.txt)
+
+    # The others are still detected when one can't be opened
+    expect_cli(2 "crlf.txt: UTF-8, CRLF\n" ${O}detect missing.txt crlf.txt)
+    if(NOT errors MATCHES "Unable to open missing.txt")
+        fail("a missing file wasn't reported")
+    endif()
+
+    run_cli(${O}detect)
+    if(NOT exitCode EQUAL 2 OR NOT output MATCHES "${O}detect file")
+        fail("a command without files didn't show the usage")
+    endif()
+
+elseif(CLI_COMMAND STREQUAL "convert")
+    # To each encoding and line ending, and back again
+    foreach(encoding utf-16le utf-16be utf-8-bom)
+        expect_cli(0 "" ${O}convert log.txt ${encoding}.txt ${O}encoding:${encoding} ${O}eol:crlf)
+        expect_cli(0 "" ${O}convert ${encoding}.txt back.txt ${O}encoding:utf-8 ${O}eol:lf)
+        file(READ ${WORK_DIR}/back.txt back)
+        file(READ ${WORK_DIR}/log.txt log)
+        if(NOT back STREQUAL log)
+            fail("converting to ${encoding} and back changed the text")
+        endif()
+    endforeach()
+
+    expect_cli(0 "utf-16le.txt: UTF-16 LE, CRLF\nutf-16be.txt: UTF-16 BE, CRLF\nutf-8-bom.txt: UTF-8 with BOM, CRLF\n"
+        ${O}detect utf-16le.txt utf-16be.txt utf-8-bom.txt)
+
+    file(READ ${WORK_DIR}/utf-16be.txt bom LIMIT 4 HEX)
+    if(NOT bom STREQUAL "feff0032")
+        fail("UTF-16 BE starts with ${bom}, not its BOM and a 2")
+    endif()
+
+    # Standard output, and keeping the encoding when none is given
+    expect_cli(0 "one\ntwo\n" ${O}convert crlf.txt - ${O}eol:lf)
+    expect_cli(0 "" ${O}convert empty.txt empty-bom.txt ${O}encoding:utf-8-bom)
+    file(READ ${WORK_DIR}/empty-bom.txt bom HEX)
+    if(NOT bom STREQUAL "efbbbf")
+        fail("an empty file didn't get a BOM")
+    endif()
+
+    expect_cli(2 "" ${O}convert missing.txt out.txt)
+
+elseif(CLI_COMMAND STREQUAL "find")
+    expect_cli(0 "8:2024-05-01 12:00:00.000 ERROR [worker-7] request 7 handled in 7 ms\n"
+        ${O}find "REQUEST 7 H" log.txt)
+    expect_cli(1 "" ${O}find ${O}matchcase "REQUEST 7 H" log.txt)
+    expect_cli(0 "crlf.txt:2:two\n" ${O}find two log.txt crlf.txt)
+    expect_cli(0 "2:two\n" ${O}find two - INPUT_FILE ${WORK_DIR}/crlf.txt)
+
+    run_cli(${O}find ${O}levels log.txt)
+    string(REGEX MATCHALL "\n" lines "${output}")
+    list(LENGTH lines lineCount)
+    if(NOT exitCode EQUAL 0 OR NOT lineCount EQUAL 500 OR output MATCHES "INFO|DEBUG")
+        fail("${O}levels didn't find only the 500 errors and warnings")
+    endif()
+
+    expect_cli(1 "" ${O}find "not in the log" log.txt)
+    expect_cli(2 "" ${O}find text missing.txt)
+
+elseif(CLI_COMMAND STREQUAL "count")
+    expect_cli(0 "63\n" ${O}count "[worker-7]" log.txt)
+    expect_cli(0 "500\n" ${O}count ${O}levels log.txt)
+    expect_cli(0 "log.txt: 1000\ncrlf.txt: 0\n" ${O}count " ms" log.txt crlf.txt)
+    expect_cli(1 "0\n" ${O}count ${O}matchcase "error" log.txt)
+    expect_cli(0 "250\n" ${O}count ${O}matchcase "ERROR" - INPUT_FILE ${WORK_DIR}/log.txt)
+
+else()
+    fail("there's no test of ${CLI_COMMAND}")
+endif()
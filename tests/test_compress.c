@@ -0,0 +1,452 @@
+/* -------------------------------------------------------------
+
+test_compress.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of reading gzip compressed files: recognizing them, each
+    kind of deflate block, headers with every optional field, files
+    of several members, and data that's damaged or cut short
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+// The file the gzip tests read, in the build directory
+#define TEST_GZIP_FILE "compress-test.gz"
+
+// A header CRC, an extra field, a file name and a comment
+#define TEST_GZIP_FLAGS 0x1E
+
+// The most bytes in a stored block
+#define TEST_STORED_BLOCK_MAX 65535
+
+// Enough text for several stored blocks, and several reads of the input
+#define TEST_STORED_TEXT_BYTES (1024 * 1024 + 123)
+
+// The lines in g_gzipDynamic
+#define TEST_GZIP_LINES 40
+
+// The a's in g_gzipLong
+#define TEST_GZIP_LONG_BYTES 100000
+
+//
+// globals
+//
+
+// Made with Python's gzip module, with the time set to 0
+
+// A stored block
+const BYTE g_gzipStored[] =
+{
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x01, 0x0D,
+    0x00, 0xF2, 0xFF, 0x73, 0x74, 0x6F, 0x72, 0x65, 0x64, 0x20, 0x62, 0x6C,
+    0x6F, 0x63, 0x6B, 0x0A, 0x6D, 0x75, 0x88, 0xC5, 0x0D, 0x00, 0x00, 0x00,
+};
+
+// A block with the fixed Huffman codes
+const BYTE g_gzipFixed[] =
+{
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xFF, 0xCB, 0x48,
+    0xCD, 0xC9, 0xC9, 0x57, 0xC8, 0x40, 0x27, 0xB9, 0x00, 0x00, 0x88, 0x59,
+    0x0B, 0x18, 0x00, 0x00, 0x00,
+};
+
+// Log lines, in a block with dynamic Huffman codes
+const BYTE g_gzipDynamic[] =
+{
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xFF, 0x7D, 0xD4,
+    0x4D, 0x4A, 0x04, 0x31, 0x14, 0xC4, 0xF1, 0xBD, 0xA7, 0xC8, 0x05, 0x06,
+    0xF2, 0xEA, 0x25, 0x9D, 0x6E, 0x0F, 0x20, 0xB8, 0xD1, 0x03, 0x88, 0x0B,
+    0x61, 0x1A, 0x14, 0xBF, 0x70, 0x46, 0xF1, 0xFA, 0x0E, 0x6E, 0xA6, 0x0B,
+    0xAB, 0x84, 0x6C, 0xB2, 0xF8, 0x2F, 0x1E, 0xFC, 0x28, 0x54, 0xB4, 0x5D,
+    0xED, 0xBB, 0x1A, 0x25, 0x70, 0x59, 0xEB, 0xE9, 0x95, 0xEB, 0x9B, 0xAB,
+    0xDB, 0x72, 0xF7, 0xFD, 0x7E, 0x78, 0x5E, 0x0F, 0xBB, 0x7A, 0x5F, 0x0E,
+    0xEB, 0xC7, 0xD7, 0x7A, 0xFC, 0x2C, 0xB5, 0x3C, 0x3E, 0xBC, 0xED, 0x5F,
+    0xD6, 0x7D, 0x79, 0x7A, 0x3B, 0x7D, 0x5E, 0x8F, 0x17, 0xF8, 0x53, 0x07,
+    0xD7, 0x71, 0xAE, 0x63, 0x5B, 0x0F, 0x5D, 0x83, 0x6B, 0x9C, 0x6B, 0x6C,
+    0xEB, 0x68, 0x3A, 0x4F, 0xCE, 0xF3, 0x9C, 0xE7, 0x36, 0x47, 0xE8, 0xBC,
+    0xD9, 0xCB, 0x1B, 0xE5, 0xB3, 0xCE, 0xBB, 0x3D, 0xBD, 0x6F, 0xF3, 0xEC,
+    0x3A, 0x9F, 0xEC, 0xED, 0xD3, 0x36, 0x6F, 0xD0, 0xF9, 0xB0, 0xB7, 0x0F,
+    0xCA, 0x17, 0x9D, 0xCF, 0xF6, 0xF6, 0x79, 0x9B, 0xF7, 0x49, 0xE7, 0x8B,
+    0xBD, 0x7D, 0xD9, 0xE6, 0x53, 0xCA, 0x3C, 0xAA, 0xBD, 0x3D, 0x08, 0xDD,
+    0xD0, 0xEA, 0x22, 0xEC, 0xF1, 0xC1, 0xEC, 0xB4, 0xBB, 0x80, 0xBD, 0x3E,
+    0x08, 0xDE, 0xAC, 0xE1, 0x45, 0x7A, 0xF5, 0x24, 0x6F, 0xD1, 0xF2, 0xA2,
+    0xF9, 0xFB, 0x89, 0x9E, 0xC9, 0xBB, 0x3F, 0x9F, 0xE8, 0x69, 0xB8, 0x31,
+    0xF9, 0xEB, 0x89, 0x5E, 0x68, 0xB9, 0x31, 0xFC, 0xF5, 0x64, 0x0F, 0x9A,
+    0x6E, 0xCC, 0xFE, 0x7A, 0xC2, 0x07, 0x6D, 0x37, 0x16, 0x7F, 0x3E, 0xE9,
+    0x4B, 0x8D, 0x17, 0x7E, 0xF1, 0x40, 0xFA, 0x9A, 0xD6, 0x0B, 0xBF, 0x79,
+    0x20, 0x7D, 0x5D, 0xEB, 0xC5, 0x3F, 0xAB, 0x47, 0xFA, 0xBA, 0xD6, 0x0B,
+    0x3F, 0x7B, 0x20, 0x7D, 0x93, 0xD6, 0x0B, 0xBF, 0x7B, 0x20, 0x7D, 0x43,
+    0xF3, 0x83, 0x1F, 0x3E, 0x10, 0xBF, 0xA1, 0xFD, 0xC1, 0x2F, 0x1F, 0xC8,
+    0xDF, 0xAC, 0xFD, 0xC1, 0x4F, 0x1F, 0xC8, 0xDF, 0xA2, 0xFD, 0xC1, 0x6F,
+    0x1F, 0xD8, 0x9F, 0xCE, 0xFD, 0xF6, 0x81, 0xF8, 0x69, 0xBD, 0xE9, 0xB7,
+    0x2F, 0x49, 0x5F, 0x68, 0xBD, 0xE9, 0xB7, 0x2F, 0x49, 0x1F, 0xB4, 0xDE,
+    0xF4, 0xDB, 0x97, 0xA4, 0x2F, 0xB5, 0xDE, 0xF4, 0xDB, 0x97, 0xA4, 0x2F,
+    0xB5, 0xDE, 0xF4, 0xDB, 0x97, 0xA4, 0xAF, 0x69, 0xBD, 0xE9, 0xC7, 0x2F,
+    0x49, 0x5F, 0xD7, 0x7A, 0xD3, 0xAF, 0x5F, 0x92, 0xBE, 0xAE, 0xF5, 0xA6,
+    0x5F, 0xBF, 0x24, 0x7D, 0x93, 0xD6, 0x9B, 0x7E, 0xFD, 0x92, 0xF4, 0x0D,
+    0xCD, 0x2F, 0xFD, 0xFA, 0x25, 0xF1, 0x1B, 0xBF, 0xFE, 0x7E, 0x00, 0x01,
+    0xCB, 0x18, 0x52, 0xF0, 0x09, 0x00, 0x00,
+};
+
+// A header with the original file name
+const BYTE g_gzipNamed[] =
+{
+    0x1F, 0x8B, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x02, 0xFF, 0x61, 0x70,
+    0x70, 0x2E, 0x6C, 0x6F, 0x67, 0x00, 0xCB, 0x4B, 0xCC, 0x4D, 0x4D, 0xE1,
+    0x02, 0x00, 0xDC, 0xF0, 0x7A, 0x41, 0x06, 0x00, 0x00, 0x00,
+};
+
+// 100000 a's, which copy across the whole window many times
+const BYTE g_gzipLong[] =
+{
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xFF, 0xED, 0xC1,
+    0x31, 0x01, 0x00, 0x00, 0x00, 0xC2, 0xA0, 0xAC, 0xEB, 0x5F, 0xC2, 0x1A,
+    0x1E, 0x40, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xAF, 0x06, 0x87, 0xFA, 0xE2, 0x1B, 0xA0, 0x86, 0x01,
+    0x00,
+};
+//
+// GetTestCrc
+// Computes the CRC-32 that gzip uses, a bit at a time
+//
+DWORD GetTestCrc(const BYTE * data, size_t size)
+{
+    DWORD crc = 0xFFFFFFFF;
+
+    for(size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for(int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        }
+    }
+
+    return ~crc;
+}
+
+//
+// PutTestDword
+// Writes value as 4 little-endian bytes
+//
+void PutTestDword(BYTE * data, DWORD value)
+{
+    data[0] = (BYTE)value;
+    data[1] = (BYTE)(value >> 8);
+    data[2] = (BYTE)(value >> 16);
+    data[3] = (BYTE)(value >> 24);
+}
+
+//
+// BuildStoredGzip
+// Compresses text into gzip as stored blocks, with every optional
+// header field. gzip must hold the text plus a few hundred bytes.
+// Returns the size of the gzip data.
+//
+size_t BuildStoredGzip(const BYTE * text, size_t size, BYTE * gzip)
+{
+    static const BYTE header[] = { 0x1F, 0x8B, 0x08, TEST_GZIP_FLAGS, 0, 0, 0, 0, 0, 0xFF };
+    static const BYTE extra[] = { 4, 0, 'E', 'N', 0, 0 };
+    static const char name[] = "big.log";
+    static const char comment[] = "made by the tests";
+    size_t length = 0;
+    size_t offset = 0;
+    DWORD headerCrc;
+
+    memcpy(gzip, header, sizeof(header));
+    length += sizeof(header);
+    memcpy(gzip + length, extra, sizeof(extra));
+    length += sizeof(extra);
+    memcpy(gzip + length, name, sizeof(name));
+    length += sizeof(name);
+    memcpy(gzip + length, comment, sizeof(comment));
+    length += sizeof(comment);
+
+    headerCrc = GetTestCrc(gzip, length);
+    gzip[length++] = (BYTE)headerCrc;
+    gzip[length++] = (BYTE)(headerCrc >> 8);
+
+    do
+    {
+        size_t blockSize = min(size - offset, TEST_STORED_BLOCK_MAX);
+
+        // Each block header is a byte of its own, since stored blocks end on a byte
+        gzip[length++] = (offset + blockSize == size) ? 1 : 0;
+        gzip[length++] = (BYTE)blockSize;
+        gzip[length++] = (BYTE)(blockSize >> 8);
+        gzip[length++] = (BYTE)~blockSize;
+        gzip[length++] = (BYTE)(~blockSize >> 8);
+        memcpy(gzip + length, text + offset, blockSize);
+        length += blockSize;
+        offset += blockSize;
+    } while(offset < size);
+
+    PutTestDword(gzip + length, GetTestCrc(text, size));
+    PutTestDword(gzip + length + 4, (DWORD)size);
+
+    return length + 8;
+}
+
+//
+// FormatGzipLines
+// Formats the log lines in g_gzipDynamic into text, which holds CB_BUFFER
+// bytes a line. Returns their length.
+//
+size_t FormatGzipLines(char * text)
+{
+    size_t length = 0;
+
+    for(unsigned int n = 0; n < TEST_GZIP_LINES; n++)
+    {
+        length += (size_t)_snprintf_s(text + length, CB_BUFFER, _TRUNCATE,
+            "2024-05-01 12:00:%02u INFO [worker-%u] request %u handled in %u ms\n", n % 60, n % 4, n, n * 7 % 97);
+    }
+
+    return length;
+}
+
+//
+// DecompressTestFile
+// Writes gzip to a file and reads it back decompressed. Returns the
+// bytes, from the process heap, or NULL if the file isn't valid.
+//
+BYTE * DecompressTestFile(const BYTE * gzip, size_t gzipSize, size_t * size)
+{
+    HANDLE hFile = CreateTestOutputFile(TEST_GZIP_FILE, gzip, gzipSize);
+    BYTE * data = NULL;
+
+    *size = 0;
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+
+    if(GetFileCompression(hFile) != COMPRESSION_GZIP || !ReadDecompressedFileBytes(hFile, &data, size))
+    {
+        data = NULL;
+    }
+
+    CloseHandle(hFile);
+    return data;
+}
+
+//
+// CheckGzip
+// Checks that gzip decompresses to expected
+//
+void CheckGzip(const BYTE * gzip, size_t gzipSize, const void * expected, size_t expectedSize, int line)
+{
+    size_t size;
+    BYTE * data = DecompressTestFile(gzip, gzipSize, &size);
+
+    CheckCondition(data != NULL, "gzip data decompressed", __FILE__, line);
+    CheckCondition(data && size == expectedSize && memcmp(data, expected, size) == 0,
+        "decompressed == expected", __FILE__, line);
+
+    if(data)
+    {
+        HeapFree(GetProcessHeap(), 0, data);
+    }
+}
+
+//
+// CheckGzipFails
+// Checks that damaged gzip data isn't accepted
+//
+void CheckGzipFails(const BYTE * gzip, size_t gzipSize, int line)
+{
+    size_t size;
+    BYTE * data = DecompressTestFile(gzip, gzipSize, &size);
+
+    CheckCondition(data == NULL, "damaged gzip data is rejected", __FILE__, line);
+
+    if(data)
+    {
+        HeapFree(GetProcessHeap(), 0, data);
+    }
+}
+
+//
+// TestCompressionFormat
+//
+void TestCompressionFormat(void)
+{
+    static const BYTE zstd[] = { 0x28, 0xB5, 0x2F, 0xFD, 0x00 };
+
+    CHECK(GetCompressionFormat(g_gzipStored, sizeof(g_gzipStored)) == COMPRESSION_GZIP);
+    CHECK(GetCompressionFormat(zstd, sizeof(zstd)) == COMPRESSION_ZSTD);
+    CHECK(GetCompressionFormat((const BYTE *)"plain text", 10) == COMPRESSION_NONE);
+
+    // Too short to tell
+    CHECK(GetCompressionFormat(g_gzipStored, 1) == COMPRESSION_NONE);
+    CHECK(GetCompressionFormat(zstd, 3) == COMPRESSION_NONE);
+}
+
+//
+// TestGzipBlocks
+//
+void TestGzipBlocks(void)
+{
+    char * lines = malloc(TEST_GZIP_LINES * CB_BUFFER);
+    BYTE * as = malloc(TEST_GZIP_LONG_BYTES);
+
+    CheckGzip(g_gzipStored, sizeof(g_gzipStored), "stored block\n", 13, __LINE__);
+    CheckGzip(g_gzipFixed, sizeof(g_gzipFixed), "hello hello hello hello\n", 24, __LINE__);
+    CheckGzip(g_gzipNamed, sizeof(g_gzipNamed), "named\n", 6, __LINE__);
+
+    if(lines && as)
+    {
+        CheckGzip(g_gzipDynamic, sizeof(g_gzipDynamic), lines, FormatGzipLines(lines), __LINE__);
+
+        memset(as, 'a', TEST_GZIP_LONG_BYTES);
+        CheckGzip(g_gzipLong, sizeof(g_gzipLong), as, TEST_GZIP_LONG_BYTES, __LINE__);
+    }
+
+    free(lines);
+    free(as);
+}
+
+//
+// TestGzipMembers
+//
+void TestGzipMembers(void)
+{
+    BYTE gzip[sizeof(g_gzipStored) + sizeof(g_gzipFixed) + 16];
+    static const char expected[] = "stored block\nhello hello hello hello\n";
+
+    // Two members decompress one after the other, like gzip does
+    memcpy(gzip, g_gzipStored, sizeof(g_gzipStored));
+    memcpy(gzip + sizeof(g_gzipStored), g_gzipFixed, sizeof(g_gzipFixed));
+    CheckGzip(gzip, sizeof(g_gzipStored) + sizeof(g_gzipFixed), expected, sizeof(expected) - 1, __LINE__);
+
+    // Zeros after the last member, from a log rotated while it was written, are ignored
+    ZeroMemory(gzip + sizeof(g_gzipStored), 16);
+    CheckGzip(gzip, sizeof(g_gzipStored) + 16, "stored block\n", 13, __LINE__);
+}
+
+//
+// TestGzipStoredLarge
+//
+void TestGzipStoredLarge(void)
+{
+    BYTE * text = malloc(TEST_STORED_TEXT_BYTES);
+    BYTE * gzip = malloc(TEST_STORED_TEXT_BYTES + CB_BUFFER);
+
+    if(!text || !gzip)
+    {
+        CHECK(!"out of memory");
+    }
+    else
+    {
+        for(size_t i = 0; i < TEST_STORED_TEXT_BYTES; i++)
+        {
+            text[i] = (i % 64 == 63) ? '\n' : (BYTE)('A' + (i * 7) % 26);
+        }
+
+        CheckGzip(gzip, BuildStoredGzip(text, TEST_STORED_TEXT_BYTES, gzip), text, TEST_STORED_TEXT_BYTES, __LINE__);
+    }
+
+    free(text);
+    free(gzip);
+}
+
+//
+// TestGzipDamaged
+//
+void TestGzipDamaged(void)
+{
+    BYTE gzip[sizeof(g_gzipDynamic)];
+
+    // The CRC in the trailer doesn't match
+    memcpy(gzip, g_gzipDynamic, sizeof(gzip));
+    gzip[sizeof(gzip) - 8] ^= 0x01;
+    CheckGzipFails(gzip, sizeof(gzip), __LINE__);
+
+    // Neither does the size
+    memcpy(gzip, g_gzipDynamic, sizeof(gzip));
+    gzip[sizeof(gzip) - 4] ^= 0x01;
+    CheckGzipFails(gzip, sizeof(gzip), __LINE__);
+
+    // The trailer, or the data, is cut short
+    CheckGzipFails(g_gzipDynamic, sizeof(g_gzipDynamic) - 4, __LINE__);
+    CheckGzipFails(g_gzipDynamic, sizeof(g_gzipDynamic) / 2, __LINE__);
+
+    // A block type that doesn't exist
+    memcpy(gzip, g_gzipStored, sizeof(g_gzipStored));
+    gzip[10] = 0x07;
+    CheckGzipFails(gzip, sizeof(g_gzipStored), __LINE__);
+
+    // A stored block whose length isn't matched by its complement
+    memcpy(gzip, g_gzipStored, sizeof(g_gzipStored));
+    gzip[13] ^= 0x10;
+    CheckGzipFails(gzip, sizeof(g_gzipStored), __LINE__);
+}
+
+//
+// TestGzipStream
+//
+void TestGzipStream(void)
+{
+    char expected[CB_BUFFER];
+    WCHAR wideExpected[CB_BUFFER];
+    BYTE * bytes = malloc(CB_STREAM_CHUNK);
+    WCHAR * text = malloc(CCH_STREAM_TEXT * sizeof(WCHAR));
+    TEXT_STREAM stream;
+    HANDLE hFile;
+    LPCWSTR line;
+    size_t lineLength;
+    int wideLength;
+    BOOL allMatched = TRUE;
+
+    hFile = (bytes && text) ? CreateTestOutputFile(TEST_GZIP_FILE, g_gzipDynamic, sizeof(g_gzipDynamic)) :
+        INVALID_HANDLE_VALUE;
+    CHECK(hFile != INVALID_HANDLE_VALUE);
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        // A stream decompresses the file as it reads its lines
+        InitTextStream(&stream, hFile, bytes, text);
+        while(ReadStreamLine(&stream, &line, &lineLength))
+        {
+            unsigned int n = (unsigned int)stream.lineNumber - 1;
+
+            wideLength = DecodeUtf8((const BYTE *)expected, _snprintf_s(expected, sizeof(expected), _TRUNCATE,
+                "2024-05-01 12:00:%02u INFO [worker-%u] request %u handled in %u ms", n % 60, n % 4, n, n * 7 % 97),
+                wideExpected, CB_BUFFER);
+            allMatched = allMatched && lineLength == (size_t)wideLength &&
+                memcmp(line, wideExpected, lineLength * sizeof(WCHAR)) == 0;
+        }
+
+        CHECK(stream.lineNumber == TEST_GZIP_LINES);
+        CHECK(allMatched);
+        CHECK(!stream.failed);
+        CHECK(stream.compression == COMPRESSION_GZIP);
+        CHECK(CloseTextStream(&stream));
+        CloseHandle(hFile);
+    }
+
+    free(bytes);
+    free(text);
+}
+
+//
+// RunCompressTests
+//
+void RunCompressTests(void)
+{
+    TestCompressionFormat();
+    TestGzipBlocks();
+    TestGzipMembers();
+    TestGzipStoredLarge();
+    TestGzipDamaged();
+    TestGzipStream();
+}
@@ -0,0 +1,486 @@
+/* -------------------------------------------------------------
+
+test_encoding.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of encoding detection, decoding, encoding, line endings
+    and control characters, and of decoding a whole document.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+// The lines of generated text laced with nulls and control characters.
+// The last one ends with a null, and has no line break.
+#define TEST_BINARY_LINES     19999
+
+// Room for one line of that text
+#define CCH_TEST_BINARY_LINE  128
+
+//
+// TestEncodingFromBom
+//
+void TestEncodingFromBom(void)
+{
+    const BYTE utf16Le[] = { 0xFF, 0xFE, 'a', 0 };
+    const BYTE utf16Be[] = { 0xFE, 0xFF, 0, 'a' };
+    const BYTE utf8Bom[] = { 0xEF, 0xBB, 0xBF, 'a' };
+    const BYTE partialBom[] = { 0xEF, 0xBB };
+    const BYTE plain[] = { 'a', 'b' };
+    size_t bomSize = 99;
+
+    CHECK(GetEncodingFromBom(utf16Le, sizeof(utf16Le), &bomSize) == ENCODING_UTF_16_LE && bomSize == 2);
+    CHECK(GetEncodingFromBom(utf16Be, sizeof(utf16Be), &bomSize) == ENCODING_UTF_16_BE && bomSize == 2);
+    CHECK(GetEncodingFromBom(utf8Bom, sizeof(utf8Bom), &bomSize) == ENCODING_UTF_8_BOM && bomSize == 3);
+    CHECK(GetEncodingFromBom(partialBom, sizeof(partialBom), &bomSize) == ENCODING_UTF_8 && bomSize == 0);
+    CHECK(GetEncodingFromBom(plain, sizeof(plain), &bomSize) == ENCODING_UTF_8 && bomSize == 0);
+    CHECK(GetEncodingFromBom(plain, 0, &bomSize) == ENCODING_UTF_8 && bomSize == 0);
+}
+
+//
+// TestDecodeBytes
+//
+void TestDecodeBytes(void)
+{
+    const BYTE utf16Le[] = { 'h', 0, 'i', 0, 'x' };
+    const BYTE utf16Be[] = { 0, 'h', 0x20, 0xAC };
+    const BYTE utf8[] = { 'a', 0xC3, 0xA9, 0xF0, 0x9F, 0x98, 0x80, 0 };
+    const BYTE invalid[] = { 'a', 0xC0, 0x80, 0xED, 0xA0, 0x80, 0xE2, 0x82, 'b' };
+    WCHAR text[16];
+    size_t length;
+
+    // A trailing odd byte is marked, not dropped
+    CHECK(DecodeBytes(utf16Le, sizeof(utf16Le), ENCODING_UTF_16_LE, text, sizeof(text), &length));
+    CHECK_TEXT(text, length, L"hi\xFFFD");
+    CHECK(text[length] == 0);
+
+    CHECK(DecodeBytes(utf16Be, sizeof(utf16Be), ENCODING_UTF_16_BE, text, sizeof(text), &length));
+    CHECK_TEXT(text, length, L"h\x20AC");
+
+    // Nulls are decoded like any other character, and a 4 byte sequence is a surrogate pair
+    CHECK(DecodeBytes(utf8, sizeof(utf8), ENCODING_UTF_8, text, sizeof(text), &length));
+    CHECK(length == 5 && text[0] == L'a' && text[1] == 0xE9 && text[2] == 0xD83D && text[3] == 0xDE00 && text[4] == 0);
+
+    // Overlongs, encoded surrogates and cut off sequences are replaced
+    CHECK(DecodeBytes(invalid, sizeof(invalid), ENCODING_UTF_8, text, sizeof(text), &length));
+    CHECK(length >= 4 && text[0] == L'a' && text[length - 1] == L'b');
+    for(size_t i = 1; i + 1 < length; i++)
+    {
+        CHECK(text[i] == UNICODE_REPLACEMENT_CHAR);
+    }
+
+    // Empty text is fine, but there must be room for the terminator
+    CHECK(DecodeBytes(utf8, 0, ENCODING_UTF_8, text, sizeof(text), &length) && length == 0 && text[0] == 0);
+    CHECK(!DecodeBytes(utf8, sizeof(utf8), ENCODING_UTF_8, text, 5 * sizeof(WCHAR), &length));
+    CHECK(!DecodeBytes(utf16Le, 4, ENCODING_UTF_16_LE, text, 2 * sizeof(WCHAR), &length));
+    CHECK(!DecodeBytes(utf8, sizeof(utf8), ENCODING_UTF_8, text, 0, &length));
+}
+
+//
+// TestSampleFiles
+// The sample files hold the same text in each encoding
+//
+void TestSampleFiles(void)
+{
+    const char * names[] = { "utf-8.txt", "utf-8-bom.txt", "utf-16-le.txt", "utf-16-be.txt" };
+    const int encodings[] = { ENCODING_UTF_8, ENCODING_UTF_8_BOM, ENCODING_UTF_16_LE, ENCODING_UTF_16_BE };
+    WCHAR * expected = NULL;
+    size_t expectedLength = 0;
+
+    for(int i = 0; i < (int)ARRAYSIZE(names); i++)
+    {
+        size_t size;
+        BYTE * data = ReadTestFile(names[i], &size);
+        WCHAR * text;
+        size_t length;
+        int encoding;
+
+        CHECK(data != NULL);
+        if(!data)
+        {
+            continue;
+        }
+
+        text = HeapAlloc(GetProcessHeap(), 0, (size + 1) * sizeof(WCHAR));
+        CHECK(ConvertBytesToString(data, size, text, (size + 1) * sizeof(WCHAR), &length, &encoding));
+        CHECK(encoding == encodings[i]);
+        CHECK(length > 0 && text[0] == L'1');
+
+        if(!expected)
+        {
+            expected = text;
+            expectedLength = length;
+        }
+        else
+        {
+            CHECK(length == expectedLength && wmemcmp(text, expected, length) == 0);
+            HeapFree(GetProcessHeap(), 0, text);
+        }
+
+        HeapFree(GetProcessHeap(), 0, data);
+    }
+
+    HeapFree(GetProcessHeap(), 0, expected);
+}
+
+//
+// TestWholeCharBytes
+//
+void TestWholeCharBytes(void)
+{
+    const BYTE utf8[] = { 'a', 0xE2, 0x82, 0xAC, 0xF0, 0x9F, 0x98, 0x80 };
+    const BYTE utf16Le[] = { 'a', 0, 0x3D, 0xD8, 0x00, 0xDE };
+
+    CHECK(GetWholeCharBytes(utf8, sizeof(utf8), ENCODING_UTF_8) == 8);
+    CHECK(GetWholeCharBytes(utf8, 7, ENCODING_UTF_8) == 4);
+    CHECK(GetWholeCharBytes(utf8, 5, ENCODING_UTF_8) == 4);
+    CHECK(GetWholeCharBytes(utf8, 3, ENCODING_UTF_8) == 1);
+    CHECK(GetWholeCharBytes(utf8, 1, ENCODING_UTF_8) == 1);
+
+    // A high surrogate waits for its pair, and an odd byte for its partner
+    CHECK(GetWholeCharBytes(utf16Le, 6, ENCODING_UTF_16_LE) == 6);
+    CHECK(GetWholeCharBytes(utf16Le, 5, ENCODING_UTF_16_LE) == 2);
+    CHECK(GetWholeCharBytes(utf16Le, 4, ENCODING_UTF_16_LE) == 2);
+    CHECK(GetWholeCharBytes(utf16Le, 3, ENCODING_UTF_16_LE) == 2);
+}
+
+//
+// TestLineEndings
+//
+void TestLineEndings(void)
+{
+    const BYTE bytes[] = "a\r\nb\nc\rd";
+    WCHAR text[32] = L"a\r\nb\nc\rd\n";
+    WCHAR copy[32];
+    LINE_ENDING_COUNTS counts;
+    size_t length = wcslen(text);
+
+    CHECK(CountLineBreakBytes(bytes, sizeof(bytes) - 1) == 4);
+
+    CountLineEndings(text, length, &counts);
+    CHECK(counts.crlf == 1 && counts.lf == 2 && counts.cr == 1);
+    CHECK(HasMixedLineEndings(&counts));
+    CHECK(GetDominantLineEnding(&counts) == LINE_ENDING_LF);
+
+    length = ConvertLineEndingsToCRLF(text, length, &counts);
+    CHECK_TEXT(text, length, L"a\r\nb\r\nc\r\nd\r\n");
+    CHECK(text[length] == 0);
+
+    CountLineEndings(text, length, &counts);
+    CHECK(counts.crlf == 4 && counts.lf == 0 && counts.cr == 0);
+    CHECK(!HasMixedLineEndings(&counts));
+    CHECK(GetDominantLineEnding(&counts) == LINE_ENDING_CRLF);
+
+    CHECK_TEXT(copy, CopyWithLineEnding(text, length, LINE_ENDING_CR, copy), L"a\rb\rc\rd\r");
+    CHECK_TEXT(copy, CopyWithLineEnding(L"x\ny\rz", 5, LINE_ENDING_CRLF, copy), L"x\r\ny\r\nz");
+
+    length = ConvertLineEndingsFromCRLF(text, length, LINE_ENDING_LF);
+    CHECK_TEXT(text, length, L"a\nb\nc\nd\n");
+
+    // A lone CR at the very end still becomes CRLF
+    text[0] = L'x';
+    text[1] = L'\r';
+    text[2] = 0;
+    CountLineEndings(text, 2, &counts);
+    CHECK(counts.cr == 1);
+    CHECK_TEXT(text, ConvertLineEndingsToCRLF(text, 2, &counts), L"x\r\n");
+
+    // Pasted text is copied into memory that held anything, like an LF
+    // after the CR, so it has to be terminated before it's converted
+    for(int i = 0; i < (int)ARRAYSIZE(text); i++)
+    {
+        text[i] = L'\n';
+    }
+    text[0] = L'x';
+    text[1] = L'\r';
+    text[2] = 0;
+    CountLineEndings(text, 2, &counts);
+    CHECK_TEXT(text, ConvertLineEndingsToCRLF(text, 2, &counts), L"x\r\n");
+    CHECK(text[3] == 0);
+}
+
+//
+// TestControlChars
+//
+void TestControlChars(void)
+{
+    WCHAR text[] = { L'a', 0, L'\t', 0x01, L'\r', L'\n', 0x7F, 0 };
+
+    CHECK(ReplaceControlChars(text, 7, FALSE) == 1);
+    CHECK(text[1] == L' ' && text[3] == 0x01 && text[6] == 0x7F);
+
+    text[1] = 0;
+    CHECK(ReplaceControlChars(text, 7, TRUE) == 3);
+    CHECK(text[1] == CONTROL_PICTURE_NULL && text[2] == L'\t' && text[3] == CONTROL_PICTURE_NULL + 1 &&
+        text[4] == L'\r' && text[5] == L'\n' && text[6] == CONTROL_PICTURE_DELETE);
+}
+
+//
+// TestEncodeChunks
+// Encodes text a few bytes at a time, and decodes the result
+//
+void TestEncodeChunks(void)
+{
+    const WCHAR text[] = L"ab\xE9\x20AC\xD83D\xDE00z\xD800!";
+    const int encodings[] = { ENCODING_UTF_8, ENCODING_UTF_16_LE, ENCODING_UTF_16_BE };
+    BYTE encoded[64];
+    WCHAR decoded[64];
+    size_t textLength = wcslen(text);
+
+    for(int e = 0; e < (int)ARRAYSIZE(encodings); e++)
+    {
+        size_t position = 0;
+        size_t byteCount = 0;
+        size_t decodedLength;
+
+        while(position < textLength)
+        {
+            size_t charsEncoded;
+            size_t chunkBytes = EncodeWideTextChunk(text + position, textLength - position, encodings[e],
+                encoded + byteCount, 6, &charsEncoded);
+
+            CHECK(charsEncoded > 0);
+            if(charsEncoded == 0)
+            {
+                break;
+            }
+
+            // A surrogate pair is never split
+            CHECK(!IS_HIGH_SURROGATE(text[position + charsEncoded - 1]) || position + charsEncoded == textLength ||
+                !IS_LOW_SURROGATE(text[position + charsEncoded]));
+
+            position += charsEncoded;
+            byteCount += chunkBytes;
+        }
+
+        CHECK(DecodeBytes(encoded, byteCount, encodings[e], decoded, sizeof(decoded), &decodedLength));
+        if(encodings[e] == ENCODING_UTF_8)
+        {
+            // The lone surrogate can't be UTF-8, so it comes back replaced
+            CHECK_TEXT(decoded, decodedLength, L"ab\xE9\x20AC\xD83D\xDE00z\xFFFD!");
+        }
+        else
+        {
+            CHECK_TEXT(decoded, decodedLength, text);
+        }
+    }
+}
+
+//
+// TestDecodeDocument
+//
+void TestDecodeDocument(void)
+{
+    const BYTE data[] = { 0xEF, 0xBB, 0xBF, 'a', '\n', 'b', 0, '\r', 'c', '\r', '\n' };
+    DOCUMENT_TEXT document;
+
+    CHECK(DecodeDocument(data, sizeof(data), FALSE, NULL, &document));
+    CHECK(document.encoding == ENCODING_UTF_8_BOM);
+    CHECK(document.lineEndings.lf == 1 && document.lineEndings.cr == 1 && document.lineEndings.crlf == 1);
+    CHECK(document.replacedChars == 1);
+    CHECK_TEXT(document.text, document.length, L"a\r\nb \r\nc\r\n");
+    CHECK(document.length < document.capacity && document.text[document.length] == 0);
+    HeapFree(GetProcessHeap(), 0, document.text);
+
+    CHECK(DecodeDocument(data, 0, TRUE, NULL, &document));
+    CHECK(document.text != NULL && document.length == 0 && document.text[0] == 0);
+    HeapFree(GetProcessHeap(), 0, document.text);
+}
+
+//
+// FormatBinaryLine
+// Formats line number of text laced with binary data: a run of nulls,
+// which is long on some lines, a control character, and on every third
+// line a null right before the line break. Returns its length.
+//
+size_t FormatBinaryLine(WCHAR * line, unsigned int number)
+{
+    unsigned int nulls = (number % 11 == 0) ? 64 : number % 4;
+    WCHAR control = (WCHAR)(1 + number % 31);
+    BOOL nullAtEnd = (number % 3 == 0);
+    WCHAR digits[12];
+    size_t digitCount = 0;
+    size_t length = 0;
+
+    for(unsigned int i = 0; i < nulls; i++)
+    {
+        line[length++] = 0;
+    }
+
+    memcpy(line + length, L"record ", 7 * sizeof(WCHAR));
+    length += 7;
+    do
+    {
+        digits[digitCount++] = (WCHAR)(L'0' + number % 10);
+        number /= 10;
+    } while(number > 0);
+    while(digitCount > 0)
+    {
+        line[length++] = digits[--digitCount];
+    }
+
+    // Tabs and line breaks are text, so those lines get a DEL instead
+    line[length++] = (control == L'\t' || control == L'\n' || control == L'\r') ? 0x7F : control;
+    memcpy(line + length, L" caf\x00E9 \xD83D\xDE42", 8 * sizeof(WCHAR));
+    length += 8;
+
+    if(nullAtEnd)
+    {
+        line[length++] = 0;
+    }
+
+    return length;
+}
+
+//
+// GetShownChar
+// Returns the character c is shown as once ReplaceControlChars replaces it
+//
+WCHAR GetShownChar(WCHAR c, BOOL showControlChars)
+{
+    if(!showControlChars)
+    {
+        return (c == 0) ? L' ' : c;
+    }
+
+    if(c == 0x7F)
+    {
+        return CONTROL_PICTURE_DELETE;
+    }
+
+    return (c < 0x20 && c != L'\t' && c != L'\r' && c != L'\n') ? (WCHAR)(CONTROL_PICTURE_NULL + c) : c;
+}
+
+//
+// CheckBinaryDocument
+// Encodes text laced with binary data, and checks that decoding it keeps
+// every character, with each null and control character replaced in
+// place. expected is the text with CRLF line endings.
+//
+void CheckBinaryDocument(int encoding, const WCHAR * text, size_t textLength, const WCHAR * expected,
+    size_t expectedLength, const LINE_ENDING_COUNTS * lineEndings, BYTE * data)
+{
+    const BYTE * bom;
+    size_t dataSize;
+    size_t charsEncoded;
+
+    bom = GetEncodingBom(encoding, &dataSize);
+    if(bom)
+    {
+        memcpy(data, bom, dataSize);
+    }
+    for(size_t encoded = 0; encoded < textLength; encoded += charsEncoded)
+    {
+        dataSize += EncodeWideTextChunk(text + encoded, textLength - encoded, encoding,
+            data + dataSize, CB_WRITE_CHUNK, &charsEncoded);
+    }
+
+    for(int showControlChars = FALSE; showControlChars <= TRUE; showControlChars++)
+    {
+        DOCUMENT_TEXT document;
+        size_t replaced = 0;
+        BOOL allMatched = TRUE;
+
+        for(size_t i = 0; i < expectedLength; i++)
+        {
+            replaced += (GetShownChar(expected[i], showControlChars) != expected[i]);
+        }
+
+        CHECK(DecodeDocument(data, dataSize, showControlChars, NULL, &document));
+        CHECK(document.encoding == encoding);
+        CHECK(document.length == expectedLength && document.text[document.length] == 0);
+        CHECK(memcmp(&document.lineEndings, lineEndings, sizeof(*lineEndings)) == 0);
+        CHECK(document.replacedChars == replaced);
+
+        for(size_t i = 0; i < expectedLength && i < document.length; i++)
+        {
+            allMatched = allMatched && document.text[i] == GetShownChar(expected[i], showControlChars);
+        }
+        CHECK(allMatched);
+
+        HeapFree(GetProcessHeap(), 0, document.text);
+    }
+}
+
+//
+// TestBinaryDocuments
+// Large generated text with runs of nulls and other control characters,
+// in every encoding the decoder detects. Every seventh line ends with an
+// LF, so some line endings are converted around them too.
+//
+void TestBinaryDocuments(void)
+{
+    static const int encodings[] = { ENCODING_UTF_8, ENCODING_UTF_8_BOM, ENCODING_UTF_16_LE, ENCODING_UTF_16_BE };
+    size_t maxChars = (size_t)TEST_BINARY_LINES * (CCH_TEST_BINARY_LINE + 2);
+    WCHAR * text = malloc(maxChars * sizeof(WCHAR));
+    WCHAR * expected = malloc(maxChars * sizeof(WCHAR));
+    BYTE * data = malloc(maxChars * 3 + CB_WRITE_CHUNK);
+    LINE_ENDING_COUNTS lineEndings = {0};
+    size_t textLength = 0;
+    size_t expectedLength = 0;
+
+    CHECK(text && expected && data);
+    if(!text || !expected || !data)
+    {
+        free(text);
+        free(expected);
+        free(data);
+        return;
+    }
+
+    for(unsigned int number = 0; number < TEST_BINARY_LINES; number++)
+    {
+        size_t length = FormatBinaryLine(text + textLength, number);
+
+        memcpy(expected + expectedLength, text + textLength, length * sizeof(WCHAR));
+        textLength += length;
+        expectedLength += length;
+
+        if(number + 1 < TEST_BINARY_LINES)
+        {
+            if(number % 7 == 0)
+            {
+                text[textLength++] = L'\n';
+                lineEndings.lf++;
+            }
+            else
+            {
+                text[textLength++] = L'\r';
+                text[textLength++] = L'\n';
+                lineEndings.crlf++;
+            }
+            expected[expectedLength++] = L'\r';
+            expected[expectedLength++] = L'\n';
+        }
+    }
+
+    // The text starts with a run of nulls, and ends with one
+    CHECK(text[0] == 0 && text[textLength - 1] == 0);
+
+    for(size_t i = 0; i < ARRAYSIZE(encodings); i++)
+    {
+        CheckBinaryDocument(encodings[i], text, textLength, expected, expectedLength, &lineEndings, data);
+    }
+
+    free(text);
+    free(expected);
+    free(data);
+}
+
+//
+// RunEncodingTests
+//
+void RunEncodingTests(void)
+{
+    TestEncodingFromBom();
+    TestDecodeBytes();
+    TestSampleFiles();
+    TestWholeCharBytes();
+    TestLineEndings();
+    TestControlChars();
+    TestEncodeChunks();
+    TestDecodeDocument();
+    TestBinaryDocuments();
+}
@@ -0,0 +1,230 @@
+/* -------------------------------------------------------------
+
+test_filesearch.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of searching the files in a folder: which names match a
+    pattern, and which lines are found in a small tree of files
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+
+// The tree of files the search tests go through, in the build directory
+#define TEST_TREE_FOLDER "filesearch-tree"
+
+// More than the tree has results, so they all fit
+#define TEST_MAX_FILE_RESULTS 16
+
+// A line a file search found
+typedef struct _TEST_FILE_RESULT
+{
+    WCHAR name[MAX_PATH];
+    ULONGLONG line;
+    DWORD column;
+} TEST_FILE_RESULT;
+
+// What a file search found, from any of its tasks
+typedef struct _TEST_FILE_RESULTS
+{
+    volatile LONG count;
+    TEST_FILE_RESULT results[TEST_MAX_FILE_RESULTS];
+} TEST_FILE_RESULTS;
+
+//
+// TestMatchFilePattern
+//
+void TestMatchFilePattern(void)
+{
+    CHECK(MatchFilePattern(L"app.log", L"*.txt;*.log"));
+    CHECK(MatchFilePattern(L"APP.LOG", L"*.log"));
+    CHECK(!MatchFilePattern(L"app.log.1", L"*.log"));
+    CHECK(MatchFilePattern(L"a.txt", L" *.json ; *.txt "));
+    CHECK(!MatchFilePattern(L"a.txt", L""));
+    CHECK(!MatchFilePattern(L"a.txt", L";;"));
+
+    // ? is any one character
+    CHECK(MatchFilePattern(L"data1.csv", L"data?.csv"));
+    CHECK(!MatchFilePattern(L"data10.csv", L"data?.csv"));
+    CHECK(!MatchFilePattern(L"data.csv", L"data?.csv"));
+
+    // A * that matches too little the first time is tried again
+    CHECK(MatchFilePattern(L"abcabd", L"*ab?"));
+    CHECK(MatchFilePattern(L"abc", L"a**c*"));
+    CHECK(!MatchFilePattern(L"abcabe", L"*abd"));
+
+    // *.* matches every name, like * does
+    CHECK(MatchFilePattern(L"README", L"*.*"));
+    CHECK(MatchFilePattern(L"README", L"*"));
+    CHECK(!MatchFilePattern(L"README", L"*.?*"));
+}
+
+//
+// AddTestFileResult
+// Keeps the name of the file, and where the line was found
+//
+void AddTestFileResult(void * context, LPCWSTR path, ULONGLONG line, DWORD column, LPCWSTR text, size_t length)
+{
+    TEST_FILE_RESULTS * found = (TEST_FILE_RESULTS *)context;
+    LONG index = InterlockedIncrement(&found->count) - 1;
+    LPCWSTR name = path;
+
+    UNREFERENCED_PARAMETER(text);
+    UNREFERENCED_PARAMETER(length);
+
+    if(index >= TEST_MAX_FILE_RESULTS)
+    {
+        return;
+    }
+
+    for(LPCWSTR c = path; *c != 0; c++)
+    {
+        if(*c == L'/' || *c == L'\\')
+        {
+            name = c + 1;
+        }
+    }
+
+    CopyMemory(found->results[index].name, name, (wcslen(name) + 1) * sizeof(WCHAR));
+    found->results[index].line = line;
+    found->results[index].column = column;
+}
+
+//
+// FoundTestFileResult
+// Returns TRUE if a search found a line of the file with the given name
+//
+BOOL FoundTestFileResult(const TEST_FILE_RESULTS * found, LPCWSTR name, ULONGLONG line, DWORD column)
+{
+    for(LONG i = 0; i < min(found->count, TEST_MAX_FILE_RESULTS); i++)
+    {
+        if(wcscmp(found->results[i].name, name) == 0 && found->results[i].line == line &&
+            found->results[i].column == column)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+//
+// WriteTestTreeFile
+// Writes a file of the tree that holds text
+//
+void WriteTestTreeFile(const char * name, const char * text)
+{
+    char path[MAX_PATH];
+    HANDLE hFile;
+
+    _snprintf_s(path, sizeof(path), _TRUNCATE, "%s/%s", TEST_TREE_FOLDER, name);
+    hFile = CreateTestOutputFile(path, (const BYTE *)text, strlen(text));
+    CHECK(hFile != INVALID_HANDLE_VALUE);
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hFile);
+    }
+}
+
+//
+// WriteTestTree
+// Writes the tree of files the search tests go through
+//
+void WriteTestTree(void)
+{
+    static const char * folders[] = { "", "/sub", "/sub/deeper" };
+    WCHAR path[MAX_PATH];
+    char name[MAX_PATH];
+
+    for(size_t i = 0; i < ARRAYSIZE(folders); i++)
+    {
+        _snprintf_s(name, sizeof(name), _TRUNCATE, "%s%s", TEST_TREE_FOLDER, folders[i]);
+        GetTestOutputPath(name, path);
+        CHECK(CreateDirectory(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS);
+    }
+
+    WriteTestTreeFile("a.log", "one\r\nneedle here\r\nthree");
+    WriteTestTreeFile("b.txt", "Needle\n");
+    WriteTestTreeFile("c.dat", "needle\n");
+    WriteTestTreeFile("sub/d.log", "x needle and needle\nneedle again\n");
+    WriteTestTreeFile("sub/deeper/e.LOG", "\xEF\xBB\xBFno match\nthe last line is the needle");
+}
+
+//
+// RunTestFileSearch
+// Searches the tree for needle, and returns how many files were searched
+//
+LONG RunTestFileSearch(TEST_FILE_RESULTS * found, BOOL matchCase, BOOL subfolders, LONG maxResults)
+{
+    static FILE_SEARCH search;
+    LONG fileCount;
+    BOOL initialized;
+
+    ZeroMemory(&search, sizeof(search));
+    ZeroMemory(found, sizeof(TEST_FILE_RESULTS));
+    GetTestOutputPath(TEST_TREE_FOLDER "/", search.folder);
+    CopyMemory(search.pattern, L"*.log; *.txt", sizeof(L"*.log; *.txt"));
+    CopyMemory(search.searchText, L"needle", sizeof(L"needle"));
+    search.matchCase = matchCase;
+    search.subfolders = subfolders;
+    search.maxResults = maxResults;
+    search.onMatch = AddTestFileResult;
+    search.context = found;
+
+    initialized = InitFileSearch(&search);
+    CHECK(initialized);
+    if(!initialized)
+    {
+        return 0;
+    }
+
+    RunFileSearch(&search);
+    CHECK(search.folderCount == 0);
+    CHECK(search.resultCount == found->count);
+    fileCount = search.fileCount;
+
+    CloseFileSearch(&search);
+    return fileCount;
+}
+
+//
+// TestFileSearch
+//
+void TestFileSearch(void)
+{
+    static TEST_FILE_RESULTS found;
+
+    WriteTestTree();
+
+    // Each line is found once, at its first match, in the files that match the pattern
+    CHECK(RunTestFileSearch(&found, FALSE, TRUE, 0) == 4);
+    CHECK(found.count == 5);
+    CHECK(FoundTestFileResult(&found, L"a.log", 2, 0));
+    CHECK(FoundTestFileResult(&found, L"b.txt", 1, 0));
+    CHECK(FoundTestFileResult(&found, L"d.log", 1, 2));
+    CHECK(FoundTestFileResult(&found, L"d.log", 2, 0));
+    CHECK(FoundTestFileResult(&found, L"e.LOG", 2, 21));
+
+    CHECK(RunTestFileSearch(&found, TRUE, TRUE, 0) == 4);
+    CHECK(found.count == 4);
+    CHECK(!FoundTestFileResult(&found, L"b.txt", 1, 0));
+
+    CHECK(RunTestFileSearch(&found, FALSE, FALSE, 0) == 2);
+    CHECK(found.count == 2);
+    CHECK(FoundTestFileResult(&found, L"a.log", 2, 0));
+    CHECK(FoundTestFileResult(&found, L"b.txt", 1, 0));
+
+    // The search stops once it has found the most it's asked for
+    RunTestFileSearch(&found, FALSE, TRUE, 2);
+    CHECK(found.count == 2);
+}
+
+//
+// RunFileSearchTests
+//
+void RunFileSearchTests(void)
+{
+    TestMatchFilePattern();
+    TestFileSearch();
+}
@@ -0,0 +1,81 @@
+/* -------------------------------------------------------------
+
+test_hexformat.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of formatting the rows of the hex view
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "test.h"
+
+//
+// TestHexRow
+//
+void TestHexRow(void)
+{
+    static const BYTE bytes[HEX_BYTES_PER_ROW] = { 'H', 'i', 0x00, 0x7F, 0x80, 0xFF, ' ', '~',
+        0x1F, 'z', 0xAB, 0xCD, 0xEF, 0x10, '0', '9' };
+    WCHAR line[CCH_HEX_ROW];
+    int length;
+
+    length = FormatHexRow(line, 0x1230, bytes, ARRAYSIZE(bytes), 8);
+    CHECK(length == 8 + 2 + HEX_BYTES_PER_ROW * 3 + 1 + 1 + HEX_BYTES_PER_ROW);
+    CHECK_TEXT(line, length,
+        L"00001230  48 69 00 7F 80 FF 20 7E  1F 7A AB CD EF 10 30 39  Hi.... ~.z....09");
+}
+
+//
+// TestShortHexRow
+// The last row of a file is padded, so its characters line up with the rows above
+//
+void TestShortHexRow(void)
+{
+    static const BYTE bytes[] = { 'a', 'b', 'c' };
+    WCHAR line[CCH_HEX_ROW];
+    WCHAR fullLine[CCH_HEX_ROW];
+    static const BYTE fullBytes[HEX_BYTES_PER_ROW] = {0};
+    int length;
+    int fullLength;
+
+    length = FormatHexRow(line, 0x20, bytes, ARRAYSIZE(bytes), 8);
+    CHECK_TEXT(line, length,
+        L"00000020  61 62 63                                          abc");
+
+    fullLength = FormatHexRow(fullLine, 0x10, fullBytes, ARRAYSIZE(fullBytes), 8);
+    CHECK(fullLength - HEX_BYTES_PER_ROW == length - (int)ARRAYSIZE(bytes));
+
+    // A row with no bytes is just the offset and padding
+    length = FormatHexRow(line, 0, bytes, 0, 8);
+    CHECK(length == fullLength - HEX_BYTES_PER_ROW);
+}
+
+//
+// TestHexOffsets
+//
+void TestHexOffsets(void)
+{
+    static const BYTE bytes[] = { 0x41 };
+    WCHAR line[CCH_HEX_ROW];
+    int length;
+
+    CHECK(GetHexOffsetDigits(0) == 8);
+    CHECK(GetHexOffsetDigits(0xFFFFFFFF) == 8);
+    CHECK(GetHexOffsetDigits(0x100000000ULL) == 16);
+
+    // Offsets past 4 GB need every digit, and the row fits the longest length
+    length = FormatHexRow(line, 0xFEDCBA9876543210ULL, bytes, ARRAYSIZE(bytes), 16);
+    CHECK(length <= CCH_HEX_ROW);
+    CHECK(TextEquals(line, 16, L"FEDCBA9876543210"));
+    CHECK(line[length - 1] == L'A');
+}
+
+//
+// RunHexFormatTests
+//
+void RunHexFormatTests(void)
+{
+    TestHexRow();
+    TestShortHexRow();
+    TestHexOffsets();
+}
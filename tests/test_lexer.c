@@ -0,0 +1,284 @@
+/* -------------------------------------------------------------
+
+test_lexer.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of the log and JSON lexers, and of the cache of the
+    state each line starts in.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "test.h"
+
+// The number of lines in the generated document
+#define TEST_LINE_COUNT 3000
+
+// A document for the highlight cache, as an array of lines
+typedef struct _TEST_DOCUMENT
+{
+    LPCWSTR lines[TEST_LINE_COUNT];
+    DWORD lineCount;
+    DWORD reads;        // how many times a line's text was asked for
+} TEST_DOCUMENT;
+
+//
+// GetTestLineText
+// The GET_LINE_TEXT callback for a TEST_DOCUMENT
+//
+BOOL GetTestLineText(void * context, DWORD line, const WCHAR ** text, DWORD * length)
+{
+    TEST_DOCUMENT * document = context;
+
+    if(line >= document->lineCount)
+    {
+        return FALSE;
+    }
+
+    document->reads++;
+    *text = document->lines[line];
+    *length = (DWORD)wcslen(document->lines[line]);
+    return TRUE;
+}
+
+//
+// InitTestDocument
+// Fills the document with JSON lines whose nesting goes up and down
+//
+void InitTestDocument(TEST_DOCUMENT * document)
+{
+    static LPCWSTR pattern[] = { L"{", L"\"items\": [", L"1, 2,", L"3]", L"}" };
+
+    for(DWORD i = 0; i < TEST_LINE_COUNT; i++)
+    {
+        document->lines[i] = pattern[i % ARRAYSIZE(pattern)];
+    }
+
+    document->lineCount = TEST_LINE_COUNT;
+    document->reads = 0;
+}
+
+//
+// GetExpectedState
+// Tokenizes every line before line, without the cache
+//
+DWORD GetExpectedState(const TEST_DOCUMENT * document, const LEXER * lexer, DWORD line)
+{
+    DWORD state = LEXER_STATE_INITIAL;
+    DWORD tokenCount;
+
+    for(DWORD i = 0; i < line; i++)
+    {
+        state = lexer->tokenizeLine(document->lines[i], (DWORD)wcslen(document->lines[i]), state, NULL, 0, &tokenCount);
+    }
+
+    return state;
+}
+
+//
+// TestLogLevels
+//
+void TestLogLevels(void)
+{
+    CHECK(GetLogLineLevel(L"2024-01-01 12:00:00 ERROR disk full", 35) == TOKEN_ERROR);
+    CHECK(GetLogLineLevel(L"[WARN] slow", 11) == TOKEN_WARNING);
+    CHECK(GetLogLineLevel(L"INFO: ready", 11) == TOKEN_INFO);
+    CHECK(GetLogLineLevel(L"12:00:01 DEBUG x", 16) == TOKEN_DEBUG);
+    CHECK(GetLogLineLevel(L"ERRORS were counted", 19) == TOKEN_TEXT);
+
+    // The first level word before the payload counts, in any case, but not one in the payload
+    CHECK(GetLogLineLevel(L"request failed with an error", 28) == TOKEN_ERROR);
+    CHECK(GetLogLineLevel(L"request {\"level\": \"error\"}", 27) == TOKEN_TEXT);
+    CHECK(GetLogLineLevel(L"", 0) == TOKEN_TEXT);
+
+    // The length is respected, so a level past it isn't seen
+    CHECK(GetLogLineLevel(L"INFO", 3) == TOKEN_TEXT);
+}
+
+//
+// TestLogTokens
+//
+void TestLogTokens(void)
+{
+    LPCWSTR line = L"2024-01-01T12:00:00Z ERROR {\"code\": 5}";
+    const LEXER * lexer = GetLogLexer();
+    TOKEN tokens[16];
+    DWORD tokenCount;
+    DWORD state;
+    BOOL sawKey = FALSE;
+    BOOL sawNumber = FALSE;
+
+    state = lexer->tokenizeLine(line, (DWORD)wcslen(line), LEXER_STATE_INITIAL, tokens, ARRAYSIZE(tokens), &tokenCount);
+    CHECK(state == LEXER_STATE_INITIAL);
+    CHECK(tokenCount >= 4);
+    CHECK(tokens[0].type == TOKEN_TIMESTAMP && tokens[0].start == 0 && tokens[0].length == 20);
+    CHECK(tokens[1].type == TOKEN_ERROR && tokens[1].start == 21 && tokens[1].length == 5);
+
+    for(DWORD i = 2; i < tokenCount; i++)
+    {
+        sawKey |= (tokens[i].type == TOKEN_KEY);
+        sawNumber |= (tokens[i].type == TOKEN_NUMBER && line[tokens[i].start] == L'5');
+    }
+    CHECK(sawKey && sawNumber);
+
+    // Tokens past maxTokens are dropped, but the state is still right
+    state = lexer->tokenizeLine(L"x {\"a\": [", 9, LEXER_STATE_INITIAL, tokens, 1, &tokenCount);
+    CHECK(tokenCount == 1 && state == 2);
+
+    // A payload left open carries on, until a new timestamp resets it
+    state = lexer->tokenizeLine(L"1]}", 3, state, tokens, ARRAYSIZE(tokens), &tokenCount);
+    CHECK(state == LEXER_STATE_INITIAL);
+    state = lexer->tokenizeLine(L"12:00:00 {", 10, 5, NULL, 0, &tokenCount);
+    CHECK(state == 1);
+}
+
+//
+// TestJsonTokens
+//
+void TestJsonTokens(void)
+{
+    LPCWSTR line = L"{\"name\": \"a\\\"b\", \"ok\": true, \"n\": -1.5e3}";
+    const LEXER * lexer = GetJsonLexer();
+    TOKEN tokens[32];
+    DWORD tokenCount;
+    int counts[TOKEN_TYPE_COUNT] = {0};
+
+    CHECK(lexer->tokenizeLine(line, (DWORD)wcslen(line), LEXER_STATE_INITIAL, tokens, ARRAYSIZE(tokens), &tokenCount) == 0);
+    for(DWORD i = 0; i < tokenCount; i++)
+    {
+        CHECK(tokens[i].start + tokens[i].length <= wcslen(line));
+        counts[tokens[i].type]++;
+    }
+
+    CHECK(counts[TOKEN_KEY] == 3);
+    CHECK(counts[TOKEN_STRING] == 1);
+    CHECK(counts[TOKEN_KEYWORD] == 1);
+    CHECK(counts[TOKEN_NUMBER] == 1);
+
+    // The escaped quote doesn't end the string
+    for(DWORD i = 0; i < tokenCount; i++)
+    {
+        if(tokens[i].type == TOKEN_STRING)
+        {
+            CHECK(tokens[i].length == 6);
+        }
+    }
+
+    // Closing more than is open doesn't go below the initial state
+    CHECK(lexer->tokenizeLine(L"]}}", 3, 1, NULL, 0, &tokenCount) == LEXER_STATE_INITIAL);
+}
+
+//
+// TestHighlightCache
+//
+void TestHighlightCache(void)
+{
+    static TEST_DOCUMENT document;
+    static HIGHLIGHT_CACHE cache;
+    const LEXER * lexer = GetJsonLexer();
+    BOOL allMatch = TRUE;
+
+    InitTestDocument(&document);
+    InitHighlightCache(&cache, lexer);
+
+    // A jump into the document only tokenizes the lines just before it
+    CHECK(GetHighlightLineState(&cache, 500, GetTestLineText, &document) == GetExpectedState(&document, lexer, 500));
+    CHECK(document.reads == HIGHLIGHT_SYNC_LINES);
+
+    // Lines already in the cache aren't tokenized again, even far behind the last one
+    document.reads = 0;
+    CHECK(GetHighlightLineState(&cache, 440, GetTestLineText, &document) == GetExpectedState(&document, lexer, 440));
+    CHECK(GetHighlightLineState(&cache, 470, GetTestLineText, &document) == GetExpectedState(&document, lexer, 470));
+    CHECK(document.reads == 0);
+
+    // A little past the end of the cache, it's extended
+    CHECK(GetHighlightLineState(&cache, 520, GetTestLineText, &document) == GetExpectedState(&document, lexer, 520));
+    CHECK(document.reads == 20);
+
+    // Far past it, the cache starts over
+    document.reads = 0;
+    CHECK(GetHighlightLineState(&cache, 2000, GetTestLineText, &document) == GetExpectedState(&document, lexer, 2000));
+    CHECK(document.reads == HIGHLIGHT_SYNC_LINES);
+    CHECK(cache.firstLine == 2000 - HIGHLIGHT_SYNC_LINES);
+
+    // Before the start, too
+    CHECK(GetHighlightLineState(&cache, 10, GetTestLineText, &document) == GetExpectedState(&document, lexer, 10));
+    CHECK(cache.firstLine == 0);
+
+    // Scrolling through every line slides the window, and each state stays right
+    for(DWORD line = 0; line < TEST_LINE_COUNT; line++)
+    {
+        TOKEN tokens[8];
+
+        if(GetHighlightLineState(&cache, line, GetTestLineText, &document) != GetExpectedState(&document, lexer, line))
+        {
+            allMatch = FALSE;
+        }
+        TokenizeHighlightLine(&cache, line, GetTestLineText, &document, tokens, ARRAYSIZE(tokens));
+        CHECK(cache.stateCount <= HIGHLIGHT_CACHE_LINES);
+    }
+    CHECK(allMatch);
+
+    // Past the last line, the state of the last known line is returned
+    GetHighlightLineState(&cache, TEST_LINE_COUNT + 10, GetTestLineText, &document);
+    CHECK(cache.stateCount <= HIGHLIGHT_CACHE_LINES);
+}
+
+//
+// TestInvalidateCache
+//
+void TestInvalidateCache(void)
+{
+    static TEST_DOCUMENT document;
+    static HIGHLIGHT_CACHE cache;
+    const LEXER * lexer = GetJsonLexer();
+    DWORD lastChanged;
+
+    InitTestDocument(&document);
+    InitHighlightCache(&cache, lexer);
+    GetHighlightLineState(&cache, 200, GetTestLineText, &document);
+
+    // An edit that leaves the nesting alone changes no states after the line
+    document.lines[152] = L"4,";
+    lastChanged = InvalidateHighlightCache(&cache, 152, 152, 0, GetTestLineText, &document);
+    CHECK(lastChanged == 152);
+
+    // One that opens an array changes every state after it, to the end of the cache
+    document.lines[152] = L"[";
+    lastChanged = InvalidateHighlightCache(&cache, 152, 152, 0, GetTestLineText, &document);
+    CHECK(lastChanged == HIGHLIGHT_ALL_LINES);
+    CHECK(GetHighlightLineState(&cache, 200, GetTestLineText, &document) == GetExpectedState(&document, lexer, 200));
+
+    // Closing it again puts back every state after it
+    document.lines[153] = L"3]]";
+    lastChanged = InvalidateHighlightCache(&cache, 153, 153, 0, GetTestLineText, &document);
+    CHECK(lastChanged == HIGHLIGHT_ALL_LINES);
+    CHECK(GetHighlightLineState(&cache, 200, GetTestLineText, &document) == GetExpectedState(&document, lexer, 200));
+
+    // An edit spanning lines converges on the line after the last one
+    document.lines[156] = L"[";
+    document.lines[157] = L"1,";
+    lastChanged = InvalidateHighlightCache(&cache, 156, 157, 0, GetTestLineText, &document);
+    CHECK(lastChanged == 157);
+    CHECK(GetHighlightLineState(&cache, 200, GetTestLineText, &document) == GetExpectedState(&document, lexer, 200));
+
+    // Lines inserted or removed drop the states after the edit
+    lastChanged = InvalidateHighlightCache(&cache, 160, 161, 1, GetTestLineText, &document);
+    CHECK(lastChanged == HIGHLIGHT_ALL_LINES && cache.firstLine + cache.stateCount == 161);
+
+    // An edit before the cache empties it
+    GetHighlightLineState(&cache, 1000, GetTestLineText, &document);
+    CHECK(InvalidateHighlightCache(&cache, 5, 5, 0, GetTestLineText, &document) == HIGHLIGHT_ALL_LINES);
+    CHECK(cache.stateCount == 0);
+}
+
+//
+// RunLexerTests
+//
+void RunLexerTests(void)
+{
+    TestLogLevels();
+    TestLogTokens();
+    TestJsonTokens();
+    TestHighlightCache();
+    TestInvalidateCache();
+}
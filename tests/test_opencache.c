@@ -0,0 +1,471 @@
+/* -------------------------------------------------------------
+
+test_opencache.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of the open cache: which changes to a file make it forget
+    what it knew, reading and writing its file, and decoding a
+    document with what it knows.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+
+// The files the tests create, in the build directory
+#define TEST_CACHE_FILE     "open-cache-test.bin"
+#define TEST_OPENED_FILE    "open-cache-test.log"
+
+// Long enough that the three fingerprint blocks don't overlap
+#define TEST_OPENED_BYTES   (4 * CB_FINGERPRINT_BLOCK)
+
+//
+// GetTestFingerprint
+// Makes up the fingerprint of a file, different for each seed
+//
+void GetTestFingerprint(DWORD seed, FILE_FINGERPRINT * fingerprint)
+{
+    ZeroMemory(fingerprint, sizeof(*fingerprint));
+    fingerprint->size = 1000000 + seed;
+    fingerprint->lastWriteTime.dwLowDateTime = seed * 7;
+    fingerprint->lastWriteTime.dwHighDateTime = 30000000;
+    for(int i = 0; i < FINGERPRINT_BLOCK_COUNT; i++)
+    {
+        fingerprint->blockHashes[i] = seed * 31 + i;
+    }
+}
+
+//
+// GetTestInfo
+// Makes up what decoding a file found out, different for each seed
+//
+void GetTestInfo(DWORD seed, DOCUMENT_INFO * info)
+{
+    ZeroMemory(info, sizeof(*info));
+    info->encoding = ENCODING_UTF_8;
+    info->length = 2000000 + seed;
+    info->crlf = seed;
+    info->lf = 5;
+}
+
+//
+// GetNumberedPath
+// Builds the path "file<number>.log"
+//
+void GetNumberedPath(DWORD number, WCHAR * path)
+{
+    WCHAR digits[10];
+    int digitCount = 0;
+
+    do
+    {
+        digits[digitCount++] = (WCHAR)(L'0' + number % 10);
+        number /= 10;
+    } while(number > 0);
+
+    *path++ = L'f';
+    *path++ = L'i';
+    *path++ = L'l';
+    *path++ = L'e';
+    while(digitCount > 0)
+    {
+        *path++ = digits[--digitCount];
+    }
+    memcpy(path, L".log", sizeof(L".log"));
+}
+
+//
+// WriteOpenedFile
+// Writes size bytes of data to the file the tests open, and returns its fingerprint
+//
+BOOL WriteOpenedFile(const BYTE * data, DWORD size, FILE_FINGERPRINT * fingerprint)
+{
+    WCHAR path[MAX_PATH];
+    HANDLE hFile;
+    DWORD bytesWritten = 0;
+    BOOL success;
+
+    GetTestOutputPath(TEST_OPENED_FILE, path);
+    hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    success = WriteFile(hFile, data, size, &bytesWritten, NULL) && bytesWritten == size &&
+        GetFileFingerprint(hFile, fingerprint);
+
+    CloseHandle(hFile);
+    return success;
+}
+
+//
+// TestOpenCacheKey
+// Only the same path, in any case, with the same fingerprint is found
+//
+void TestOpenCacheKey(void)
+{
+    static OPEN_CACHE cache;
+    FILE_FINGERPRINT fingerprint;
+    FILE_FINGERPRINT changed;
+    DOCUMENT_INFO info;
+    DOCUMENT_INFO found;
+
+    InitOpenCache(&cache);
+    GetTestFingerprint(1, &fingerprint);
+    GetTestInfo(1, &info);
+
+    CHECK(!FindOpenCacheEntry(&cache, L"C:\\logs\\app.log", &fingerprint, &found));
+    AddOpenCacheEntry(&cache, L"C:\\logs\\app.log", &fingerprint, &info);
+    CHECK(FindOpenCacheEntry(&cache, L"C:\\logs\\app.log", &fingerprint, &found));
+    CHECK(memcmp(&found, &info, sizeof(info)) == 0);
+    CHECK(FindOpenCacheEntry(&cache, L"c:\\LOGS\\App.log", &fingerprint, &found));
+    CHECK(!FindOpenCacheEntry(&cache, L"C:\\logs\\app.log.1", &fingerprint, &found));
+
+    // Any part of the fingerprint changing means the file did
+    changed = fingerprint;
+    changed.size++;
+    CHECK(!FindOpenCacheEntry(&cache, L"C:\\logs\\app.log", &changed, &found));
+
+    changed = fingerprint;
+    changed.lastWriteTime.dwLowDateTime++;
+    CHECK(!FindOpenCacheEntry(&cache, L"C:\\logs\\app.log", &changed, &found));
+
+    for(int i = 0; i < FINGERPRINT_BLOCK_COUNT; i++)
+    {
+        changed = fingerprint;
+        changed.blockHashes[i] ^= 1;
+        CHECK(!FindOpenCacheEntry(&cache, L"C:\\logs\\app.log", &changed, &found));
+    }
+
+    // Adding the path again replaces what was known about it
+    GetTestInfo(2, &info);
+    AddOpenCacheEntry(&cache, L"C:\\Logs\\App.log", &changed, &info);
+    CHECK(cache.entryCount == 1);
+    CHECK(!FindOpenCacheEntry(&cache, L"C:\\logs\\app.log", &fingerprint, &found));
+    CHECK(FindOpenCacheEntry(&cache, L"C:\\logs\\app.log", &changed, &found) && found.length == info.length);
+}
+
+//
+// TestOpenCacheEviction
+// A full cache forgets the file that was used longest ago
+//
+void TestOpenCacheEviction(void)
+{
+    static OPEN_CACHE cache;
+    WCHAR path[32];
+    FILE_FINGERPRINT fingerprint;
+    DOCUMENT_INFO info;
+    BOOL allFound = TRUE;
+
+    InitOpenCache(&cache);
+    GetTestInfo(0, &info);
+    GetTestFingerprint(0, &fingerprint);
+
+    for(DWORD i = 0; i < OPEN_CACHE_ENTRIES; i++)
+    {
+        GetNumberedPath(i, path);
+        AddOpenCacheEntry(&cache, path, &fingerprint, &info);
+    }
+    CHECK(cache.entryCount == OPEN_CACHE_ENTRIES);
+
+    // The first file is used again, so the second one is the oldest
+    CHECK(FindOpenCacheEntry(&cache, L"file0.log", &fingerprint, &info));
+    AddOpenCacheEntry(&cache, L"new.log", &fingerprint, &info);
+    CHECK(cache.entryCount == OPEN_CACHE_ENTRIES);
+    CHECK(FindOpenCacheEntry(&cache, L"new.log", &fingerprint, &info));
+    CHECK(FindOpenCacheEntry(&cache, L"file0.log", &fingerprint, &info));
+    CHECK(!FindOpenCacheEntry(&cache, L"file1.log", &fingerprint, &info));
+
+    for(DWORD i = 2; i < OPEN_CACHE_ENTRIES; i++)
+    {
+        GetNumberedPath(i, path);
+        allFound = allFound && FindOpenCacheEntry(&cache, path, &fingerprint, &info);
+    }
+    CHECK(allFound);
+}
+
+//
+// TestOpenCacheFile
+// The cache survives being written and read back, and a cache file
+// that's damaged, or from another version, is ignored
+//
+void TestOpenCacheFile(void)
+{
+    static OPEN_CACHE cache;
+    static OPEN_CACHE readBack;
+    WCHAR path[MAX_PATH];
+    FILE_FINGERPRINT fingerprint;
+    DOCUMENT_INFO info;
+    HANDLE hFile;
+    DWORD bytesDone;
+    LARGE_INTEGER position;
+    OPEN_CACHE_HEADER header;
+    BYTE byte;
+
+    GetTestOutputPath(TEST_CACHE_FILE, path);
+    DeleteFile(path);
+    CHECK(!ReadOpenCache(path, &readBack) && readBack.entryCount == 0);
+
+    InitOpenCache(&cache);
+    for(DWORD i = 0; i < 3; i++)
+    {
+        WCHAR name[32];
+
+        GetNumberedPath(i, name);
+        GetTestFingerprint(i, &fingerprint);
+        GetTestInfo(i, &info);
+        AddOpenCacheEntry(&cache, name, &fingerprint, &info);
+    }
+
+    CHECK(WriteOpenCache(path, &cache));
+    CHECK(ReadOpenCache(path, &readBack));
+    CHECK(readBack.entryCount == 3 && readBack.useCount == cache.useCount);
+    CHECK(memcmp(readBack.entries, cache.entries, 3 * sizeof(OPEN_CACHE_ENTRY)) == 0);
+
+    GetTestFingerprint(2, &fingerprint);
+    CHECK(FindOpenCacheEntry(&readBack, L"file2.log", &fingerprint, &info) && info.crlf == 2);
+
+    // A changed byte in an entry doesn't match the checksum
+    hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    CHECK(hFile != INVALID_HANDLE_VALUE);
+    position.QuadPart = sizeof(OPEN_CACHE_HEADER) + 10;
+    CHECK(SetFilePointerEx(hFile, position, NULL, FILE_BEGIN));
+    CHECK(ReadFile(hFile, &byte, 1, &bytesDone, NULL) && bytesDone == 1);
+    byte ^= 0xFF;
+    CHECK(SetFilePointerEx(hFile, position, NULL, FILE_BEGIN));
+    CHECK(WriteFile(hFile, &byte, 1, &bytesDone, NULL) && bytesDone == 1);
+    CloseHandle(hFile);
+    CHECK(!ReadOpenCache(path, &readBack) && readBack.entryCount == 0);
+
+    // So does one that ends early
+    CHECK(WriteOpenCache(path, &cache));
+    hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    position.QuadPart = sizeof(OPEN_CACHE_HEADER) + sizeof(OPEN_CACHE_ENTRY);
+    CHECK(SetFilePointerEx(hFile, position, NULL, FILE_BEGIN) && SetEndOfFile(hFile));
+    CloseHandle(hFile);
+    CHECK(!ReadOpenCache(path, &readBack));
+
+    // A cache from another version of the app has another layout
+    CHECK(WriteOpenCache(path, &cache));
+    hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    CHECK(ReadFile(hFile, &header, sizeof(header), &bytesDone, NULL) && bytesDone == sizeof(header));
+    header.version++;
+    position.QuadPart = 0;
+    CHECK(SetFilePointerEx(hFile, position, NULL, FILE_BEGIN));
+    CHECK(WriteFile(hFile, &header, sizeof(header), &bytesDone, NULL));
+    CloseHandle(hFile);
+    CHECK(!ReadOpenCache(path, &readBack));
+
+    DeleteFile(path);
+}
+
+//
+// TestOpenCacheFileChanges
+// The fingerprint of a real file changes whenever its contents do
+//
+void TestOpenCacheFileChanges(void)
+{
+    static OPEN_CACHE cache;
+    static BYTE data[TEST_OPENED_BYTES + 100];
+    FILE_FINGERPRINT fingerprint;
+    FILE_FINGERPRINT reopened;
+    DOCUMENT_INFO info;
+    DOCUMENT_INFO found;
+
+    for(size_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (BYTE)((i % 80 == 79) ? '\n' : 'a' + i % 26);
+    }
+
+    InitOpenCache(&cache);
+    GetTestInfo(1, &info);
+    CHECK(WriteOpenedFile(data, TEST_OPENED_BYTES, &fingerprint));
+    AddOpenCacheEntry(&cache, L"opened.log", &fingerprint, &info);
+
+    // The same bytes again are found, even if the file was written again
+    CHECK(WriteOpenedFile(data, TEST_OPENED_BYTES, &reopened));
+    CHECK(reopened.size == fingerprint.size && reopened.blockHashes[1] == fingerprint.blockHashes[1]);
+    reopened.lastWriteTime = fingerprint.lastWriteTime;
+    CHECK(FindOpenCacheEntry(&cache, L"opened.log", &reopened, &found));
+
+    // A change to the head, the middle or the tail, with the size and
+    // time the same, is still a different file
+    for(int block = 0; block < FINGERPRINT_BLOCK_COUNT; block++)
+    {
+        size_t offset = (block == 0) ? 10 : (block == 1) ? TEST_OPENED_BYTES / 2 : TEST_OPENED_BYTES - 10;
+
+        data[offset] ^= 0x20;
+        CHECK(WriteOpenedFile(data, TEST_OPENED_BYTES, &reopened));
+        reopened.lastWriteTime = fingerprint.lastWriteTime;
+        CHECK(!FindOpenCacheEntry(&cache, L"opened.log", &reopened, &found));
+        data[offset] ^= 0x20;
+    }
+
+    // More lines logged to the end change its size
+    CHECK(WriteOpenedFile(data, sizeof(data), &reopened));
+    CHECK(!FindOpenCacheEntry(&cache, L"opened.log", &reopened, &found));
+}
+
+//
+// CheckKnownDecode
+// Decodes data, first the usual way and then with what that found
+// out, and checks both give the same document
+//
+void CheckKnownDecode(const BYTE * data, size_t dataSize, BOOL showControlChars, int line)
+{
+    DOCUMENT_TEXT cold;
+    DOCUMENT_TEXT warm;
+    DOCUMENT_INFO info;
+    DOCUMENT_INFO warmInfo;
+
+    CheckCondition(DecodeDocument(data, dataSize, showControlChars, NULL, &cold), "cold decode", __FILE__, line);
+    GetDocumentInfo(&cold, showControlChars, &info);
+
+    CheckCondition(DecodeKnownDocument(data, dataSize, showControlChars, &info, &warm), "known decode", __FILE__, line);
+    GetDocumentInfo(&warm, showControlChars, &warmInfo);
+    CheckCondition(warm.capacity == cold.length + 1, "known capacity", __FILE__, line);
+    CheckCondition(TextEquals(warm.text, warm.length, cold.text), "known text == cold text", __FILE__, line);
+    CheckCondition(memcmp(&info, &warmInfo, sizeof(info)) == 0, "known info == cold info", __FILE__, line);
+
+    HeapFree(GetProcessHeap(), 0, cold.text);
+    HeapFree(GetProcessHeap(), 0, warm.text);
+}
+
+//
+// TestDecodeKnownDocument
+//
+void TestDecodeKnownDocument(void)
+{
+    static const BYTE mixed[] = "one\r\ntwo\nthree\rfour\0five\x01six";
+    static const BYTE utf16[] = { 0xFF, 0xFE, 'a', 0, '\n', 0, 'b', 0, 0, 0 };
+    BYTE bom[] = { 0xEF, 0xBB, 0xBF, 'x', '\r' };
+    DOCUMENT_TEXT document;
+    DOCUMENT_INFO info;
+
+    CheckKnownDecode(mixed, sizeof(mixed) - 1, FALSE, __LINE__);
+    CheckKnownDecode(mixed, sizeof(mixed) - 1, TRUE, __LINE__);
+    CheckKnownDecode(utf16, sizeof(utf16), FALSE, __LINE__);
+    CheckKnownDecode(bom, sizeof(bom), FALSE, __LINE__);
+    CheckKnownDecode(bom, 0, FALSE, __LINE__);
+
+    // Text with no nulls has none to replace, but can have other control
+    // characters to show, which weren't counted
+    CHECK(DecodeDocument(mixed + 22, 6, FALSE, NULL, &document) && document.replacedChars == 0);
+    GetDocumentInfo(&document, FALSE, &info);
+    HeapFree(GetProcessHeap(), 0, document.text);
+    CHECK(DecodeKnownDocument(mixed + 22, 6, TRUE, &info, &document));
+    CHECK(document.replacedChars == 1);
+    CHECK_TEXT(document.text, document.length, L"ve\x2401six");
+    HeapFree(GetProcessHeap(), 0, document.text);
+
+    // Data that doesn't decode to the known length, or has another BOM,
+    // isn't decoded with what's known, but DecodeDocument still decodes it
+    CHECK(DecodeDocument(mixed, sizeof(mixed) - 1, FALSE, NULL, &document));
+    GetDocumentInfo(&document, FALSE, &info);
+    HeapFree(GetProcessHeap(), 0, document.text);
+
+    CHECK(!DecodeKnownDocument(mixed, sizeof(mixed) - 2, FALSE, &info, &document));
+    CHECK(document.text == NULL && document.encoding == ENCODING_UNSPECIFIED);
+    CHECK(DecodeDocument(mixed, sizeof(mixed) - 2, FALSE, &info, &document));
+    CHECK_TEXT(document.text, document.length, L"one\r\ntwo\r\nthree\r\nfour five\x01si");
+    HeapFree(GetProcessHeap(), 0, document.text);
+
+    info.length += 100;
+    CHECK(!DecodeKnownDocument(mixed, sizeof(mixed) - 1, FALSE, &info, &document));
+    info.length -= 100;
+    info.encoding = ENCODING_UTF_16_LE;
+    CHECK(!DecodeKnownDocument(mixed, sizeof(mixed) - 1, FALSE, &info, &document));
+
+    // More lone line endings than there are characters can't be right
+    info.encoding = ENCODING_UTF_8;
+    info.lf = info.length + 1;
+    CHECK(!DecodeKnownDocument(mixed, sizeof(mixed) - 1, FALSE, &info, &document));
+}
+
+//
+// CheckTamperedDecode
+// Decodes data with an open cache entry that's wrong about it, and
+// checks that it's decoded the usual way instead
+//
+void CheckTamperedDecode(const BYTE * data, size_t dataSize, const DOCUMENT_INFO * tampered,
+    const DOCUMENT_TEXT * cold, int line)
+{
+    DOCUMENT_TEXT document;
+
+    CheckCondition(!DecodeKnownDocument(data, dataSize, FALSE, tampered, &document),
+        "a tampered entry isn't used", __FILE__, line);
+    CheckCondition(DecodeDocument(data, dataSize, FALSE, tampered, &document), "decode", __FILE__, line);
+    CheckCondition(TextEquals(document.text, document.length, cold->text), "text == cold text", __FILE__, line);
+    CheckCondition(memcmp(&document.lineEndings, &cold->lineEndings, sizeof(cold->lineEndings)) == 0 &&
+        document.replacedChars == cold->replacedChars, "counts == cold counts", __FILE__, line);
+
+    HeapFree(GetProcessHeap(), 0, document.text);
+}
+
+//
+// TestTamperedOpenCache
+// An entry that still matches the fingerprint, but not the file, as if
+// the file changed without its size or time changing
+//
+void TestTamperedOpenCache(void)
+{
+    static OPEN_CACHE cache;
+    static const BYTE data[] = "one\r\ntwo\nthree\rfour\nfive\0six\r\n";
+    WCHAR path[MAX_PATH];
+    FILE_FINGERPRINT fingerprint;
+    DOCUMENT_TEXT cold;
+    DOCUMENT_INFO info;
+    DOCUMENT_INFO tampered;
+
+    GetTestOutputPath(TEST_CACHE_FILE, path);
+    CHECK(WriteOpenedFile(data, sizeof(data) - 1, &fingerprint));
+    CHECK(DecodeDocument(data, sizeof(data) - 1, FALSE, NULL, &cold));
+    GetDocumentInfo(&cold, FALSE, &info);
+
+    InitOpenCache(&cache);
+    AddOpenCacheEntry(&cache, L"opened.log", &fingerprint, &info);
+    CHECK(WriteOpenCache(path, &cache));
+    CHECK(ReadOpenCache(path, &cache));
+    CHECK(FindOpenCacheEntry(&cache, L"opened.log", &fingerprint, &tampered));
+    CheckKnownDecode(data, sizeof(data) - 1, FALSE, __LINE__);
+
+    // The lone line endings swapped, which leaves the length the same
+    tampered.lf = info.cr;
+    tampered.cr = info.lf;
+    CheckTamperedDecode(data, sizeof(data) - 1, &tampered, &cold, __LINE__);
+
+    // A CRLF counted as a lone LF, and the length grown to match
+    tampered = info;
+    tampered.crlf--;
+    tampered.lf++;
+    tampered.length++;
+    CheckTamperedDecode(data, sizeof(data) - 1, &tampered, &cold, __LINE__);
+
+    // No lone line endings, with the length made to match
+    tampered = info;
+    tampered.length -= info.lf + info.cr;
+    tampered.lf = 0;
+    tampered.cr = 0;
+    CheckTamperedDecode(data, sizeof(data) - 1, &tampered, &cold, __LINE__);
+
+    // No nulls, so they wouldn't be replaced
+    tampered = info;
+    tampered.replacedChars = 0;
+    CheckTamperedDecode(data, sizeof(data) - 1, &tampered, &cold, __LINE__);
+
+    HeapFree(GetProcessHeap(), 0, cold.text);
+}
+
+//
+// RunOpenCacheTests
+//
+void RunOpenCacheTests(void)
+{
+    TestOpenCacheKey();
+    TestOpenCacheEviction();
+    TestOpenCacheFile();
+    TestOpenCacheFileChanges();
+    TestDecodeKnownDocument();
+    TestTamperedOpenCache();
+}
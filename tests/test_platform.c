@@ -0,0 +1,172 @@
+/* -------------------------------------------------------------
+
+test_platform.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of the platform layer: UTF-8 conversion, files, pipes
+    and threads behave the way the core expects from Windows.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "test.h"
+
+//
+// TestUtf8Conversion
+//
+void TestUtf8Conversion(void)
+{
+    const BYTE utf8[] = { 'a', 0xC3, 0xA9, 0xE2, 0x82, 0xAC, 0xF0, 0x9F, 0x98, 0x80 };
+    const BYTE truncated[] = { 'a', 0xF0, 0x9F, 0x98 };
+    const BYTE tooHigh[] = { 0xF4, 0x90, 0x80, 0x80 };
+    const WCHAR wide[] = { L'a', 0xE9, 0x20AC, 0xD83D, 0xDE00 };
+    const WCHAR lone[] = { 0xDC00, L'b', 0xD800 };
+    WCHAR text[8];
+    BYTE bytes[16];
+
+    CHECK(DecodeUtf8(utf8, sizeof(utf8), text, ARRAYSIZE(text)) == 5);
+    CHECK(wmemcmp(text, wide, 5) == 0);
+
+    // Too little room fails, rather than returning part of the text
+    CHECK(DecodeUtf8(utf8, sizeof(utf8), text, 4) == 0);
+    CHECK(EncodeUtf8(wide, ARRAYSIZE(wide), bytes, 9) == 0);
+
+    CHECK(EncodeUtf8(wide, ARRAYSIZE(wide), bytes, sizeof(bytes)) == sizeof(utf8));
+    CHECK(memcmp(bytes, utf8, sizeof(utf8)) == 0);
+
+    // A cut off sequence is one replacement, as is each byte of a code point past U+10FFFF
+    CHECK(DecodeUtf8(truncated, sizeof(truncated), text, ARRAYSIZE(text)) == 2);
+    CHECK(text[0] == L'a' && text[1] == UNICODE_REPLACEMENT_CHAR);
+    CHECK(DecodeUtf8(tooHigh, sizeof(tooHigh), text, ARRAYSIZE(text)) == 4);
+    CHECK(text[0] == UNICODE_REPLACEMENT_CHAR && text[3] == UNICODE_REPLACEMENT_CHAR);
+
+    // Lone surrogates can't be UTF-8
+    CHECK(EncodeUtf8(lone, ARRAYSIZE(lone), bytes, sizeof(bytes)) == 7);
+    CHECK(bytes[0] == 0xEF && bytes[1] == 0xBF && bytes[2] == 0xBD && bytes[3] == 'b');
+}
+
+//
+// TestFiles
+//
+void TestFiles(void)
+{
+    WCHAR path[MAX_PATH];
+    WCHAR movedPath[MAX_PATH];
+    HANDLE hFile;
+    BYTE buffer[16];
+    DWORD bytesDone;
+    LARGE_INTEGER size;
+    LARGE_INTEGER position;
+    FILETIME writeTime;
+    size_t bytesRead;
+
+    GetTestOutputPath("platform-test.tmp", path);
+    GetTestOutputPath("platform-test-moved.tmp", movedPath);
+    DeleteFile(path);
+    DeleteFile(movedPath);
+
+    hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    CHECK(hFile != INVALID_HANDLE_VALUE);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    CHECK(WriteFile(hFile, "hello world", 11, &bytesDone, NULL) && bytesDone == 11);
+    CHECK(GetFileSizeEx(hFile, &size) && size.QuadPart == 11);
+    CHECK(GetFileTime(hFile, NULL, NULL, &writeTime) && writeTime.dwHighDateTime != 0);
+
+    // Truncate at the current position
+    position.QuadPart = 5;
+    CHECK(SetFilePointerEx(hFile, position, NULL, FILE_BEGIN));
+    CHECK(SetEndOfFile(hFile));
+    CHECK(GetFileSizeEx(hFile, &size) && size.QuadPart == 5);
+
+    position.QuadPart = 0;
+    CHECK(SetFilePointerEx(hFile, position, NULL, FILE_BEGIN));
+    CHECK(ReadAllFileBytes(hFile, buffer, sizeof(buffer), &bytesRead) && bytesRead == 5);
+    CHECK(memcmp(buffer, "hello", 5) == 0);
+    CHECK(ReadFile(hFile, buffer, sizeof(buffer), &bytesDone, NULL) && bytesDone == 0);
+    CloseHandle(hFile);
+
+    // Creating a file that's there, and opening one that isn't, fail like Windows
+    CHECK(CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL) == INVALID_HANDLE_VALUE);
+    CHECK(GetLastError() == ERROR_FILE_EXISTS);
+    CHECK(CreateFile(movedPath, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL) == INVALID_HANDLE_VALUE);
+    CHECK(GetLastError() == ERROR_FILE_NOT_FOUND);
+
+    CHECK(MoveFileEx(path, movedPath, MOVEFILE_REPLACE_EXISTING));
+    CHECK(DeleteFile(movedPath));
+    CHECK(!DeleteFile(movedPath));
+}
+
+//
+// PipeWriterProc
+// Writes to a pipe until the reader closes it
+//
+DWORD WINAPI PipeWriterProc(LPVOID param)
+{
+    HANDLE hWrite = param;
+    DWORD bytesWritten;
+    DWORD total = 0;
+
+    while(WriteFile(hWrite, "0123456789", 10, &bytesWritten, NULL))
+    {
+        total += bytesWritten;
+    }
+
+    CloseHandle(hWrite);
+    return (GetLastError() == ERROR_BROKEN_PIPE && total >= 100) ? 7 : 1;
+}
+
+//
+// TestPipesAndThreads
+//
+void TestPipesAndThreads(void)
+{
+    HANDLE hRead;
+    HANDLE hWrite;
+    HANDLE hThread;
+    BYTE buffer[100];
+    DWORD bytesRead;
+    DWORD total = 0;
+    DWORD exitCode = 0;
+
+    CHECK(CreatePipe(&hRead, &hWrite, NULL, 0));
+
+    hThread = CreateThread(NULL, 0, PipeWriterProc, hWrite, 0, NULL);
+    CHECK(hThread != NULL);
+    if(!hThread)
+    {
+        return;
+    }
+
+    while(total < sizeof(buffer) && ReadFile(hRead, buffer, sizeof(buffer) - total, &bytesRead, NULL))
+    {
+        total += bytesRead;
+    }
+    CHECK(total == sizeof(buffer) && buffer[0] == '0');
+
+    // Closing the read end makes the writer's next write fail
+    CloseHandle(hRead);
+    CHECK(WaitForSingleObject(hThread, INFINITE) == WAIT_OBJECT_0);
+    CHECK(GetExitCodeThread(hThread, &exitCode) && exitCode == 7);
+    CloseHandle(hThread);
+
+    // Reading after the write end closes ends with ERROR_BROKEN_PIPE
+    CHECK(CreatePipe(&hRead, &hWrite, NULL, 0));
+    CHECK(WriteFile(hWrite, "ab", 2, &bytesRead, NULL));
+    CloseHandle(hWrite);
+    CHECK(ReadFile(hRead, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead == 2);
+    CHECK(!ReadFile(hRead, buffer, sizeof(buffer), &bytesRead, NULL) && GetLastError() == ERROR_BROKEN_PIPE);
+    CloseHandle(hRead);
+}
+
+//
+// RunPlatformTests
+//
+void RunPlatformTests(void)
+{
+    TestUtf8Conversion();
+    TestFiles();
+    TestPipesAndThreads();
+}
@@ -0,0 +1,289 @@
+/* -------------------------------------------------------------
+
+test_saveplan.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of planning a save: finding the first changed chunk, and
+    choosing between rewriting a file in place and a full copy.
+    Also interrupts saves in place and recovers them from the journal.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+// The size of the generated file, a few chunks long
+#define TEST_SAVE_CHARS (3 * CB_WRITE_CHUNK + 1000)
+
+// ASCII text is encoded as UTF-8 this many characters to a chunk
+#define TEST_CHUNK_CHARS (CB_WRITE_CHUNK / 3)
+
+// The start of the last chunk of the generated file
+#define TEST_LAST_CHUNK ((TEST_SAVE_CHARS / TEST_CHUNK_CHARS) * TEST_CHUNK_CHARS)
+
+// The files of the interrupted save tests
+#define TEST_SAVED_FILE   "saved.txt"
+#define TEST_JOURNAL_FILE "saved.txt.esnpad-save"
+
+//
+// TestFirstChangedChunk
+//
+void TestFirstChangedChunk(void)
+{
+    WCHAR * text = malloc((TEST_SAVE_CHARS + 1) * sizeof(WCHAR));
+    BYTE * original = malloc(TEST_SAVE_CHARS + UTF8_BOM_BYTES);
+    BYTE * chunk = malloc(CB_WRITE_CHUNK);
+    size_t charsSame;
+    size_t bomSize;
+    const BYTE * bom = GetEncodingBom(ENCODING_UTF_8_BOM, &bomSize);
+
+    if(!text || !original || !chunk)
+    {
+        CHECK(!"out of memory");
+        free(text);
+        free(original);
+        free(chunk);
+        return;
+    }
+
+    // ASCII, so the UTF-8 bytes line up with the characters
+    for(size_t i = 0; i < TEST_SAVE_CHARS; i++)
+    {
+        text[i] = (WCHAR)(L'a' + i % 26);
+        original[i] = (BYTE)('a' + i % 26);
+    }
+
+    // Nothing changed, so everything is the same, to the end
+    CHECK(FindFirstChangedChunk(text, TEST_SAVE_CHARS, ENCODING_UTF_8,
+        original, TEST_SAVE_CHARS, chunk, &charsSame) == TEST_SAVE_CHARS);
+    CHECK(charsSame == TEST_SAVE_CHARS);
+
+    // Text added to the end, within the last chunk, rewrites only that chunk
+    CHECK(FindFirstChangedChunk(text, TEST_SAVE_CHARS, ENCODING_UTF_8,
+        original, TEST_SAVE_CHARS - 10, chunk, &charsSame) == TEST_LAST_CHUNK);
+
+    // A change in the second chunk keeps only the first one
+    text[TEST_CHUNK_CHARS + 5] = L'#';
+    CHECK(FindFirstChangedChunk(text, TEST_SAVE_CHARS, ENCODING_UTF_8,
+        original, TEST_SAVE_CHARS, chunk, &charsSame) == TEST_CHUNK_CHARS);
+    CHECK(charsSame == TEST_CHUNK_CHARS);
+
+    // A change to the encoding's BOM keeps nothing
+    CHECK(FindFirstChangedChunk(text, TEST_SAVE_CHARS, ENCODING_UTF_8_BOM,
+        original, TEST_SAVE_CHARS, chunk, &charsSame) == 0);
+    CHECK(charsSame == 0);
+
+    // With the BOM in the file, the offsets count it
+    memmove(original + bomSize, original, TEST_SAVE_CHARS);
+    memcpy(original, bom, bomSize);
+    CHECK(FindFirstChangedChunk(text, TEST_SAVE_CHARS, ENCODING_UTF_8_BOM,
+        original, TEST_SAVE_CHARS + bomSize, chunk, &charsSame) == TEST_CHUNK_CHARS + bomSize);
+
+    free(text);
+    free(original);
+    free(chunk);
+}
+
+//
+// TestIncrementalSaveChoice
+//
+void TestIncrementalSaveChoice(void)
+{
+    ULONGLONG large = 1024ULL * CB_WRITE_CHUNK;
+
+    // Small files always get a full copy
+    CHECK(!IsIncrementalSaveWorthwhile(CB_INCREMENTAL_SAVE_MIN - 1, CB_INCREMENTAL_SAVE_MIN - 1));
+
+    // A small tail is rewritten in place, even when it's most of the file
+    CHECK(IsIncrementalSaveWorthwhile(CB_INCREMENTAL_SAVE_MIN, 0));
+    CHECK(IsIncrementalSaveWorthwhile(large, large - CB_INCREMENTAL_SAVE_TAIL));
+
+    // A large tail only is when that writes fewer bytes than a copy
+    CHECK(IsIncrementalSaveWorthwhile(large, large / 2));
+    CHECK(!IsIncrementalSaveWorthwhile(large, large / 2 - 1));
+    CHECK(!IsIncrementalSaveWorthwhile(large, 0));
+
+    CHECK(!IsIncrementalSaveWorthwhile(large, large + 1));
+}
+
+//
+// IsTestFileSame
+// Checks whether the file a test created holds exactly size bytes of data
+//
+BOOL IsTestFileSame(const char * name, const BYTE * data, size_t size)
+{
+    size_t fileSize;
+    BYTE * file = ReadTestOutputFile(name, &fileSize);
+    BOOL same = file && fileSize == size && memcmp(file, data, size) == 0;
+
+    if(file)
+    {
+        HeapFree(GetProcessHeap(), 0, file);
+    }
+
+    return same;
+}
+
+//
+// InterruptTestSave
+// Starts a save of the test file in place from offset, the way
+// SaveIncremental does, and stops it like a crash would: after
+// charsWritten of the new text, or after all of it, with the
+// journal still there. The new text is longer than the original.
+//
+BOOL InterruptTestSave(const BYTE * original, ULONGLONG offset, size_t charsWritten, BYTE * chunk)
+{
+    WCHAR path[MAX_PATH];
+    WCHAR journalPath[MAX_PATH];
+    WCHAR * newText;
+    size_t newLength = TEST_SAVE_CHARS + CB_WRITE_CHUNK - (size_t)offset;
+    size_t bytesWritten = 0;
+    HANDLE hFile;
+    BOOL success = FALSE;
+
+    GetTestOutputPath(TEST_SAVED_FILE, path);
+    GetTestOutputPath(TEST_JOURNAL_FILE, journalPath);
+
+    newText = malloc(newLength * sizeof(WCHAR));
+    hFile = CreateTestOutputFile(TEST_SAVED_FILE, original, TEST_SAVE_CHARS);
+    if(newText && hFile != INVALID_HANDLE_VALUE)
+    {
+        for(size_t i = 0; i < newLength; i++)
+        {
+            newText[i] = (WCHAR)(L'A' + i % 26);
+        }
+
+        if(WriteSaveJournal(journalPath, original, offset, TEST_SAVE_CHARS))
+        {
+            if(charsWritten < newLength)
+            {
+                // Stopped partway, without cutting the file off
+                LARGE_INTEGER position;
+
+                position.QuadPart = (LONGLONG)offset;
+                success = SetFilePointerEx(hFile, position, NULL, FILE_BEGIN) &&
+                    WriteEncodedText(hFile, newText, charsWritten, ENCODING_UTF_8, chunk, &bytesWritten);
+            }
+            else
+            {
+                // Stopped just before the journal was deleted
+                success = RewriteFileTail(hFile, offset, newText, newLength, ENCODING_UTF_8, chunk, &bytesWritten) &&
+                    bytesWritten == newLength;
+            }
+        }
+    }
+
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hFile);
+    }
+
+    free(newText);
+    return success;
+}
+
+//
+// TestInterruptedSave
+//
+void TestInterruptedSave(void)
+{
+    BYTE * original = malloc(TEST_SAVE_CHARS);
+    BYTE * chunk = malloc(CB_WRITE_CHUNK);
+    WCHAR path[MAX_PATH];
+    WCHAR journalPath[MAX_PATH];
+    HANDLE hJournal;
+    LARGE_INTEGER journalEnd;
+    BYTE * interrupted;
+    size_t interruptedSize;
+
+    if(!original || !chunk)
+    {
+        CHECK(!"out of memory");
+        free(original);
+        free(chunk);
+        return;
+    }
+
+    for(size_t i = 0; i < TEST_SAVE_CHARS; i++)
+    {
+        original[i] = (BYTE)('a' + i % 26);
+    }
+
+    GetTestOutputPath(TEST_SAVED_FILE, path);
+    GetTestOutputPath(TEST_JOURNAL_FILE, journalPath);
+
+    // Without a journal there's nothing to recover
+    DeleteFile(journalPath);
+    CHECK(RestoreFromSaveJournal(path, journalPath));
+
+    // Stopped partway through the first chunk it rewrote,
+    // in the middle of the file, or after the new end was written
+    CHECK(InterruptTestSave(original, TEST_CHUNK_CHARS, 1000, chunk));
+    CHECK(!IsTestFileSame(TEST_SAVED_FILE, original, TEST_SAVE_CHARS));
+    CHECK(RestoreFromSaveJournal(path, journalPath));
+    CHECK(IsTestFileSame(TEST_SAVED_FILE, original, TEST_SAVE_CHARS));
+    CHECK(CreateFile(journalPath, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL) == INVALID_HANDLE_VALUE);
+
+    CHECK(InterruptTestSave(original, TEST_CHUNK_CHARS, CB_WRITE_CHUNK + 7, chunk));
+    CHECK(RestoreFromSaveJournal(path, journalPath));
+    CHECK(IsTestFileSame(TEST_SAVED_FILE, original, TEST_SAVE_CHARS));
+
+    CHECK(InterruptTestSave(original, TEST_LAST_CHUNK, (size_t)-1, chunk));
+    CHECK(!IsTestFileSame(TEST_SAVED_FILE, original, TEST_SAVE_CHARS));
+    CHECK(RestoreFromSaveJournal(path, journalPath));
+    CHECK(IsTestFileSame(TEST_SAVED_FILE, original, TEST_SAVE_CHARS));
+
+    CHECK(InterruptTestSave(original, 0, (size_t)-1, chunk));
+    CHECK(RestoreFromSaveJournal(path, journalPath));
+    CHECK(IsTestFileSame(TEST_SAVED_FILE, original, TEST_SAVE_CHARS));
+
+    // A journal that was cut short was still being written, so the file
+    // wasn't touched yet. Its bytes must not be copied back.
+    CHECK(InterruptTestSave(original, TEST_CHUNK_CHARS, 1000, chunk));
+    hJournal = CreateFile(journalPath, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    CHECK(hJournal != INVALID_HANDLE_VALUE);
+    if(hJournal != INVALID_HANDLE_VALUE)
+    {
+        journalEnd.QuadPart = sizeof(SAVE_JOURNAL_HEADER) + 100;
+        CHECK(SetFilePointerEx(hJournal, journalEnd, NULL, FILE_BEGIN) && SetEndOfFile(hJournal));
+        CloseHandle(hJournal);
+    }
+
+    interrupted = ReadTestOutputFile(TEST_SAVED_FILE, &interruptedSize);
+    CHECK(interrupted != NULL);
+    CHECK(RestoreFromSaveJournal(path, journalPath));
+    CHECK(interrupted && IsTestFileSame(TEST_SAVED_FILE, interrupted, interruptedSize));
+    CHECK(CreateFile(journalPath, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL) == INVALID_HANDLE_VALUE);
+
+    // A complete journal is kept when the file can't be restored
+    CHECK(InterruptTestSave(original, TEST_CHUNK_CHARS, 1000, chunk));
+    DeleteFile(path);
+    CHECK(!RestoreFromSaveJournal(path, journalPath));
+    hJournal = CreateFile(journalPath, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    CHECK(hJournal != INVALID_HANDLE_VALUE);
+    if(hJournal != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hJournal);
+    }
+
+    DeleteFile(journalPath);
+
+    if(interrupted)
+    {
+        HeapFree(GetProcessHeap(), 0, interrupted);
+    }
+
+    free(original);
+    free(chunk);
+}
+
+//
+// RunSavePlanTests
+//
+void RunSavePlanTests(void)
+{
+    TestFirstChangedChunk();
+    TestIncrementalSaveChoice();
+    TestInterruptedSave();
+}
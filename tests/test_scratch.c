@@ -0,0 +1,113 @@
+/* -------------------------------------------------------------
+
+test_scratch.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of the scratch arena: alignment, freeing back to a mark,
+    nested operations, and reusing blocks
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+
+// Larger than the blocks the arena asks the OS for, so it gets a block of its own
+#define TEST_SCRATCH_LARGE (3 * 1024 * 1024)
+
+//
+// TestScratchAlloc
+//
+void TestScratchAlloc(void)
+{
+    SCRATCH_STATS before;
+    SCRATCH_STATS after;
+    SCRATCH_MARK mark;
+    BYTE * first;
+    BYTE * second;
+
+    GetScratchStats(&before);
+    mark = ScratchBegin();
+
+    // Each allocation is rounded up to keep the next one aligned
+    first = ScratchAlloc(10);
+    second = ScratchAlloc(1);
+    CHECK(first != NULL && second != NULL);
+    CHECK(((size_t)first % 16) == 0);
+    CHECK(second == first + 16);
+
+    GetScratchStats(&after);
+    CHECK(after.liveBytes == before.liveBytes + 32);
+    CHECK(after.allocations == before.allocations + 2);
+    CHECK(after.peakBytes >= after.liveBytes);
+
+    ScratchEnd(mark);
+    GetScratchStats(&after);
+    CHECK(after.liveBytes == before.liveBytes);
+}
+
+//
+// TestScratchNesting
+//
+void TestScratchNesting(void)
+{
+    SCRATCH_MARK outer = ScratchBegin();
+    SCRATCH_MARK inner;
+    BYTE * kept = ScratchAlloc(100);
+    BYTE * next;
+
+    CHECK(kept != NULL);
+    memset(kept, 0x5A, 100);
+
+    // An inner operation that needs more blocks, like a find during a save
+    inner = ScratchBegin();
+    CHECK(ScratchAlloc(TEST_SCRATCH_LARGE) != NULL);
+    CHECK(ScratchAlloc(TEST_SCRATCH_LARGE) != NULL);
+    ScratchEnd(inner);
+
+    // The outer allocation survives, and the arena continues right after it
+    CHECK(kept[0] == 0x5A && kept[99] == 0x5A);
+    next = ScratchAlloc(1);
+    CHECK(next == kept + 112);
+
+    ScratchEnd(outer);
+}
+
+//
+// TestScratchReuse
+//
+void TestScratchReuse(void)
+{
+    SCRATCH_STATS before;
+    SCRATCH_STATS after;
+    SCRATCH_MARK mark;
+    BYTE * first;
+    BYTE * second;
+
+    mark = ScratchBegin();
+    first = ScratchAlloc(TEST_SCRATCH_LARGE);
+    ScratchEnd(mark);
+
+    // The block is kept, so the next operation gets it back from the arena
+    GetScratchStats(&before);
+    CHECK(before.retainedBytes >= TEST_SCRATCH_LARGE);
+
+    mark = ScratchBegin();
+    second = ScratchAlloc(TEST_SCRATCH_LARGE);
+    GetScratchStats(&after);
+    ScratchEnd(mark);
+
+    CHECK(second != NULL && second == first);
+    CHECK(after.blocksCreated == before.blocksCreated);
+    CHECK(after.blocksReused == before.blocksReused + 1);
+    CHECK(after.retainedBytes < before.retainedBytes);
+}
+
+//
+// RunScratchTests
+//
+void RunScratchTests(void)
+{
+    TestScratchAlloc();
+    TestScratchNesting();
+    TestScratchReuse();
+}
@@ -0,0 +1,155 @@
+/* -------------------------------------------------------------
+
+test_search.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of finding text, and of filtering lines
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include "test.h"
+
+//
+// TestFindText
+//
+void TestFindText(void)
+{
+    LPCWSTR text = L"one Two one TWO";
+    DWORD length = (DWORD)wcslen(text);
+
+    CHECK(FindTextInBuffer(text, length, L"one", TRUE, TRUE, 0) == 0);
+    CHECK(FindTextInBuffer(text, length, L"one", TRUE, TRUE, 1) == 8);
+    CHECK(FindTextInBuffer(text, length, L"one", TRUE, TRUE, 9) == FIND_NOT_FOUND);
+    CHECK(FindTextInBuffer(text, length, L"two", TRUE, TRUE, 0) == FIND_NOT_FOUND);
+    CHECK(FindTextInBuffer(text, length, L"two", FALSE, TRUE, 0) == 4);
+    CHECK(FindTextInBuffer(text, length, L"two", FALSE, TRUE, 5) == 12);
+
+    // Upwards, a start past the last possible match is moved back to it
+    CHECK(FindTextInBuffer(text, length, L"two", FALSE, FALSE, length) == 12);
+    CHECK(FindTextInBuffer(text, length, L"two", FALSE, FALSE, 11) == 4);
+    CHECK(FindTextInBuffer(text, length, L"one", TRUE, FALSE, 7) == 0);
+    CHECK(FindTextInBuffer(text, length, L"Two", TRUE, FALSE, 3) == FIND_NOT_FOUND);
+
+    // A match right at the end, and searches that can't match
+    CHECK(FindTextInBuffer(text, length, L"TWO", TRUE, TRUE, 0) == length - 3);
+    CHECK(FindTextInBuffer(text, length, L"", TRUE, TRUE, 0) == FIND_NOT_FOUND);
+    CHECK(FindTextInBuffer(text, 2, L"one", TRUE, TRUE, 0) == FIND_NOT_FOUND);
+}
+
+//
+// TestNextLineStart
+//
+void TestNextLineStart(void)
+{
+    LPCWSTR text = L"ab\r\ncd\ref\r\n";
+    DWORD length = (DWORD)wcslen(text);
+
+    CHECK(FindNextLineStart(text, length, 0) == 4);
+    CHECK(FindNextLineStart(text, length, 3) == 4);
+    CHECK(FindNextLineStart(text, length, 5) == length);
+    CHECK(FindNextLineStart(text, length, length) == length);
+}
+
+//
+// TestFilterChunk
+// Filters text in two chunks, like the filter view does on two threads
+//
+void TestFilterChunk(void)
+{
+    LPCWSTR text = L"INFO start\r\nERROR disk full\r\nwarn: retry\r\n"
+        L"debug ok\r\n2024-01-01 12:00:00 WARNING slow\r\nerror in text, not a level\r\nlast ERROR";
+    DWORD length = (DWORD)wcslen(text);
+    FILTER levels = { FILTER_LEVELS, NULL, FALSE };
+    FILTER find = { FILTER_TEXT, L"error", FALSE };
+    FILTER findCase = { FILTER_TEXT, L"error", TRUE };
+    FILTER_CHUNK chunks[2];
+    DWORD middle = FindNextLineStart(text, length, length / 2);
+
+    ZeroMemory(chunks, sizeof(chunks));
+    chunks[0].text = text;
+    chunks[0].start = 0;
+    chunks[0].end = middle;
+    chunks[0].filter = &levels;
+    chunks[1] = chunks[0];
+    chunks[1].start = middle;
+    chunks[1].end = length;
+
+    CHECK(FilterTextChunk(&chunks[0]) && FilterTextChunk(&chunks[1]));
+    CHECK(chunks[0].lineCount + chunks[1].lineCount == 7);
+
+    // Only lines that start with a level, after any timestamp, are errors or warnings
+    CHECK(chunks[0].matchCount + chunks[1].matchCount >= 2);
+    CHECK(chunks[0].matchCount > 0 && chunks[0].matches[0].line == 1 && chunks[0].matches[0].offset == 12);
+    for(int c = 0; c < 2; c++)
+    {
+        for(DWORD m = 0; m < chunks[c].matchCount; m++)
+        {
+            LPCWSTR line = text + chunks[c].matches[m].offset;
+
+            CHECK(chunks[c].matches[m].offset == 0 || line[-1] == L'\n');
+            CHECK(wcsncmp(line, L"INFO", 4) != 0 && wcsncmp(line, L"debug", 5) != 0);
+        }
+        HeapFree(GetProcessHeap(), 0, chunks[c].matches);
+    }
+
+    ZeroMemory(chunks, sizeof(chunks));
+    chunks[0].text = text;
+    chunks[0].end = length;
+    chunks[0].filter = &find;
+    CHECK(FilterTextChunk(&chunks[0]));
+    CHECK(chunks[0].matchCount == 3 && chunks[0].lineCount == 7);
+    CHECK(chunks[0].matches[2].line == 6);
+    HeapFree(GetProcessHeap(), 0, chunks[0].matches);
+
+    ZeroMemory(chunks, sizeof(chunks));
+    chunks[0].text = text;
+    chunks[0].end = length;
+    chunks[0].filter = &findCase;
+    CHECK(FilterTextChunk(&chunks[0]));
+    CHECK(chunks[0].matchCount == 1 && chunks[0].matches[0].line == 5);
+    HeapFree(GetProcessHeap(), 0, chunks[0].matches);
+}
+
+//
+// TestFilterGrowth
+// Enough matches to grow the match array more than once
+//
+void TestFilterGrowth(void)
+{
+    DWORD lineCount = 3000;
+    WCHAR * text = HeapAlloc(GetProcessHeap(), 0, lineCount * 4 * sizeof(WCHAR));
+    FILTER find = { FILTER_TEXT, L"x", TRUE };
+    FILTER_CHUNK chunk;
+
+    for(DWORD i = 0; i < lineCount; i++)
+    {
+        text[i * 4] = (i % 2) ? L'x' : L'y';
+        text[i * 4 + 1] = L'.';
+        text[i * 4 + 2] = L'\r';
+        text[i * 4 + 3] = L'\n';
+    }
+
+    ZeroMemory(&chunk, sizeof(chunk));
+    chunk.text = text;
+    chunk.end = lineCount * 4;
+    chunk.filter = &find;
+    CHECK(FilterTextChunk(&chunk));
+    CHECK(chunk.lineCount == lineCount && chunk.matchCount == lineCount / 2);
+    CHECK(chunk.matchCapacity >= chunk.matchCount);
+    CHECK(chunk.matches[chunk.matchCount - 1].line == lineCount - 1);
+    CHECK(chunk.matches[chunk.matchCount - 1].offset == (lineCount - 1) * 4);
+
+    HeapFree(GetProcessHeap(), 0, chunk.matches);
+    HeapFree(GetProcessHeap(), 0, text);
+}
+
+//
+// RunSearchTests
+//
+void RunSearchTests(void)
+{
+    TestFindText();
+    TestNextLineStart();
+    TestFilterChunk();
+    TestFilterGrowth();
+}
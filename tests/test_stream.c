@@ -0,0 +1,297 @@
+/* -------------------------------------------------------------
+
+test_stream.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of reading text a line at a time: line endings, every
+    encoding with pieces that split characters and CRLFs, lines too
+    long to read at once, and empty files
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+// The file the stream tests read, in the build directory
+#define TEST_STREAM_FILE "stream-test.txt"
+
+// Enough lines of generated text to fill several reads
+#define TEST_STREAM_LINES 30000
+
+// Room for one line of the generated text
+#define CCH_TEST_STREAM_LINE 32
+
+// A line longer than a stream can hold, so it comes in pieces
+#define TEST_LONG_LINE_CHARS (CCH_STREAM_TEXT + 1000)
+
+//
+// OpenTestStream
+// Writes data to TEST_STREAM_FILE, and sets up stream to read it.
+// Returns the file, which the caller closes, or INVALID_HANDLE_VALUE.
+//
+HANDLE OpenTestStream(TEXT_STREAM * stream, const BYTE * data, size_t size, BYTE * bytes, WCHAR * text)
+{
+    HANDLE hFile = CreateTestOutputFile(TEST_STREAM_FILE, data, size);
+
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        InitTextStream(stream, hFile, bytes, text);
+    }
+
+    return hFile;
+}
+
+//
+// FormatStreamLine
+// Formats line number of the generated text, and returns its length.
+// It has a surrogate pair and an accent, so reads split them, and its
+// length changes with the number, so the splits move around.
+//
+size_t FormatStreamLine(WCHAR * line, unsigned int number)
+{
+    WCHAR digits[12];
+    size_t length = 0;
+    size_t digitCount = 0;
+
+    // The POSIX platform has no wide printf, so the number is formatted here
+    do
+    {
+        digits[digitCount++] = (WCHAR)(L'0' + number % 10);
+        number /= 10;
+    } while(number > 0);
+
+    memcpy(line, L"line ", 5 * sizeof(WCHAR));
+    length = 5;
+    while(digitCount > 0)
+    {
+        line[length++] = digits[--digitCount];
+    }
+    memcpy(line + length, L" \xD83D\xDE42 caf\x00E9", 8 * sizeof(WCHAR));
+
+    return length + 8;
+}
+
+//
+// TestStreamLineEndings
+//
+void TestStreamLineEndings(void)
+{
+    static const char data[] = "one\r\ntwo\nthree\rfour";
+    BYTE * bytes = malloc(CB_STREAM_CHUNK);
+    WCHAR * text = malloc(CCH_STREAM_TEXT * sizeof(WCHAR));
+    TEXT_STREAM stream;
+    HANDLE hFile;
+    LPCWSTR line;
+    size_t lineLength;
+
+    hFile = (bytes && text) ? OpenTestStream(&stream, (const BYTE *)data, strlen(data), bytes, text) : INVALID_HANDLE_VALUE;
+    CHECK(hFile != INVALID_HANDLE_VALUE);
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        CHECK(ReadStreamLine(&stream, &line, &lineLength));
+        CHECK_TEXT(line, lineLength, L"one");
+        CHECK(stream.lineNumber == 1);
+        CHECK(stream.encoding == ENCODING_UTF_8);
+
+        CHECK(ReadStreamLine(&stream, &line, &lineLength));
+        CHECK_TEXT(line, lineLength, L"two");
+        CHECK(ReadStreamLine(&stream, &line, &lineLength));
+        CHECK_TEXT(line, lineLength, L"three");
+
+        // The last line has no line break
+        CHECK(ReadStreamLine(&stream, &line, &lineLength));
+        CHECK_TEXT(line, lineLength, L"four");
+        CHECK(stream.lineNumber == 4);
+
+        CHECK(!ReadStreamLine(&stream, &line, &lineLength));
+        CHECK(!stream.failed);
+        CHECK(CloseTextStream(&stream));
+        CloseHandle(hFile);
+    }
+
+    free(bytes);
+    free(text);
+}
+
+//
+// CheckStreamEncoding
+// Writes TEST_STREAM_LINES lines in an encoding, with CRLF line breaks,
+// and checks that a stream reads back each one with its number
+//
+void CheckStreamEncoding(int encoding, WCHAR * wideText, BYTE * data, BYTE * bytes, WCHAR * text)
+{
+    WCHAR expected[CCH_TEST_STREAM_LINE];
+    size_t textLength = 0;
+    size_t dataSize;
+    size_t charsEncoded;
+    const BYTE * bom;
+    TEXT_STREAM stream;
+    HANDLE hFile;
+    LPCWSTR line;
+    size_t lineLength;
+    unsigned int number = 0;
+    BOOL allMatched = TRUE;
+
+    for(unsigned int i = 1; i <= TEST_STREAM_LINES; i++)
+    {
+        textLength += FormatStreamLine(wideText + textLength, i);
+        wideText[textLength++] = L'\r';
+        wideText[textLength++] = L'\n';
+    }
+
+    bom = GetEncodingBom(encoding, &dataSize);
+    if(bom)
+    {
+        memcpy(data, bom, dataSize);
+    }
+    for(size_t encoded = 0; encoded < textLength; encoded += charsEncoded)
+    {
+        dataSize += EncodeWideTextChunk(wideText + encoded, textLength - encoded, encoding,
+            data + dataSize, CB_WRITE_CHUNK, &charsEncoded);
+    }
+
+    hFile = OpenTestStream(&stream, data, dataSize, bytes, text);
+    CHECK(hFile != INVALID_HANDLE_VALUE);
+    if(hFile == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    while(ReadStreamLine(&stream, &line, &lineLength))
+    {
+        size_t expectedLength = FormatStreamLine(expected, ++number);
+
+        allMatched = allMatched && stream.lineNumber == number && lineLength == expectedLength &&
+            memcmp(line, expected, lineLength * sizeof(WCHAR)) == 0;
+    }
+
+    CHECK(number == TEST_STREAM_LINES);
+    CHECK(allMatched);
+    CHECK(!stream.failed);
+    CHECK(stream.encoding == encoding);
+
+    CloseTextStream(&stream);
+    CloseHandle(hFile);
+}
+
+//
+// TestStreamEncodings
+//
+void TestStreamEncodings(void)
+{
+    static const int encodings[] = { ENCODING_UTF_8, ENCODING_UTF_8_BOM, ENCODING_UTF_16_LE, ENCODING_UTF_16_BE };
+    size_t maxChars = (size_t)TEST_STREAM_LINES * CCH_TEST_STREAM_LINE;
+    WCHAR * wideText = malloc(maxChars * sizeof(WCHAR));
+    BYTE * data = malloc(maxChars * 3 + CB_WRITE_CHUNK);
+    BYTE * bytes = malloc(CB_STREAM_CHUNK);
+    WCHAR * text = malloc(CCH_STREAM_TEXT * sizeof(WCHAR));
+
+    CHECK(wideText && data && bytes && text);
+    for(size_t i = 0; wideText && data && bytes && text && i < ARRAYSIZE(encodings); i++)
+    {
+        CheckStreamEncoding(encodings[i], wideText, data, bytes, text);
+    }
+
+    free(wideText);
+    free(data);
+    free(bytes);
+    free(text);
+}
+
+//
+// TestStreamLongLine
+//
+void TestStreamLongLine(void)
+{
+    size_t dataSize = TEST_LONG_LINE_CHARS + 5;
+    BYTE * data = malloc(dataSize);
+    BYTE * bytes = malloc(CB_STREAM_CHUNK);
+    WCHAR * text = malloc(CCH_STREAM_TEXT * sizeof(WCHAR));
+    TEXT_STREAM stream;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    LPCWSTR line;
+    size_t lineLength;
+    size_t longLength = 0;
+    int pieces = 0;
+    BOOL allX = TRUE;
+
+    if(data && bytes && text)
+    {
+        memset(data, 'x', TEST_LONG_LINE_CHARS);
+        memcpy(data + TEST_LONG_LINE_CHARS, "\nend\n", 5);
+        hFile = OpenTestStream(&stream, data, dataSize, bytes, text);
+    }
+
+    CHECK(hFile != INVALID_HANDLE_VALUE);
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        // The long line comes in pieces, all with the same number
+        while(longLength < TEST_LONG_LINE_CHARS && ReadStreamLine(&stream, &line, &lineLength))
+        {
+            CHECK(stream.lineNumber == 1);
+            for(size_t i = 0; i < lineLength; i++)
+            {
+                allX = allX && line[i] == L'x';
+            }
+            longLength += lineLength;
+            pieces++;
+        }
+
+        CHECK(longLength == TEST_LONG_LINE_CHARS);
+        CHECK(pieces > 1);
+        CHECK(allX);
+
+        CHECK(ReadStreamLine(&stream, &line, &lineLength));
+        CHECK_TEXT(line, lineLength, L"end");
+        CHECK(stream.lineNumber == 2);
+        CHECK(!ReadStreamLine(&stream, &line, &lineLength));
+        CHECK(!stream.failed);
+
+        CloseTextStream(&stream);
+        CloseHandle(hFile);
+    }
+
+    free(data);
+    free(bytes);
+    free(text);
+}
+
+//
+// TestStreamEmpty
+//
+void TestStreamEmpty(void)
+{
+    BYTE * bytes = malloc(CB_STREAM_CHUNK);
+    WCHAR * text = malloc(CCH_STREAM_TEXT * sizeof(WCHAR));
+    TEXT_STREAM stream;
+    HANDLE hFile;
+    LPCWSTR line;
+    size_t lineLength;
+
+    hFile = (bytes && text) ? OpenTestStream(&stream, (const BYTE *)"", 0, bytes, text) : INVALID_HANDLE_VALUE;
+    CHECK(hFile != INVALID_HANDLE_VALUE);
+    if(hFile != INVALID_HANDLE_VALUE)
+    {
+        CHECK(!ReadStreamLine(&stream, &line, &lineLength));
+        CHECK(!stream.failed);
+        CHECK(stream.lineNumber == 0);
+
+        CloseTextStream(&stream);
+        CloseHandle(hFile);
+    }
+
+    free(bytes);
+    free(text);
+}
+
+//
+// RunStreamTests
+//
+void RunStreamTests(void)
+{
+    TestStreamLineEndings();
+    TestStreamEncodings();
+    TestStreamLongLine();
+    TestStreamEmpty();
+}
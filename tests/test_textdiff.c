@@ -0,0 +1,233 @@
+/* -------------------------------------------------------------
+
+test_textdiff.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of finding what changed in a text, both by comparing all
+    of it and by tracking edits as they're made
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+
+// The most characters a test's text has
+#define TEST_DIFF_CHARS 4096
+
+// The number of edits made to the text, and how often they're compared
+#define TEST_DIFF_EDITS 5000
+#define TEST_DIFF_TICK  7
+
+// A text being edited, like the edit control holds it
+typedef struct _TEST_EDIT_TEXT
+{
+    WCHAR text[TEST_DIFF_CHARS];
+    size_t length;
+    size_t selStart;
+    size_t selEnd;
+} TEST_EDIT_TEXT;
+
+//
+// CheckChangedRange
+// Checks that FindChangedRange finds the change from oldText to newText,
+// or that there isn't one, when all of the text is compared
+//
+void CheckChangedRange(LPCWSTR oldText, LPCWSTR newText, BOOL changed, size_t prefix, size_t suffix)
+{
+    DIRTY_RANGE dirty;
+    size_t foundPrefix;
+    size_t foundSuffix;
+
+    MarkAllDirty(&dirty);
+    CHECK(FindChangedRange(oldText, wcslen(oldText), newText, wcslen(newText),
+        &dirty, &foundPrefix, &foundSuffix) == changed);
+    CHECK(foundPrefix == prefix);
+    CHECK(foundSuffix == suffix);
+}
+
+//
+// TestChangedRange
+//
+void TestChangedRange(void)
+{
+    CheckChangedRange(L"", L"", FALSE, 0, 0);
+    CheckChangedRange(L"same", L"same", FALSE, 4, 0);
+    CheckChangedRange(L"", L"new", TRUE, 0, 0);
+    CheckChangedRange(L"gone", L"", TRUE, 0, 0);
+    CheckChangedRange(L"one two", L"one and two", TRUE, 4, 3);
+    CheckChangedRange(L"one two", L"on two", TRUE, 2, 4);
+    CheckChangedRange(L"abc", L"xbc", TRUE, 0, 2);
+    CheckChangedRange(L"abc", L"abx", TRUE, 2, 0);
+
+    // A repeated character can be matched at either end, but not both
+    CheckChangedRange(L"aaa", L"aaaa", TRUE, 3, 0);
+    CheckChangedRange(L"aaaa", L"aa", TRUE, 2, 0);
+}
+
+//
+// TestDirtyRange
+//
+void TestDirtyRange(void)
+{
+    LPCWSTR oldText = L"first line\r\nsecond line\r\nthird line";
+    LPCWSTR newText = L"first line\r\nsecond, changed line\r\nthird line";
+    DIRTY_RANGE dirty;
+    size_t prefix;
+    size_t suffix;
+
+    // Typing ", changed" after "second" one character at a time
+    ClearDirtyRange(&dirty);
+    for(size_t typed = 0; typed < 9; typed++)
+    {
+        AddDirtyEdit(&dirty, wcslen(oldText) + typed, 18 + typed, 18 + typed,
+            wcslen(oldText) + typed + 1, 19 + typed, 19 + typed);
+    }
+
+    CHECK(dirty.sameStart == 18);
+    CHECK(dirty.sameEnd == wcslen(oldText) - 18);
+    CHECK(FindChangedRange(oldText, wcslen(oldText), newText, wcslen(newText), &dirty, &prefix, &suffix));
+    CHECK(prefix == 18 && suffix == wcslen(oldText) - 18);
+
+    // Where the edits were is trusted, so a change outside them isn't found
+    ClearDirtyRange(&dirty);
+    AddDirtyEdit(&dirty, 3, 0, 0, 3, 1, 1);
+    CHECK(!FindChangedRange(L"abc", 3, L"abx", 3, &dirty, &prefix, &suffix));
+
+    // Without any edits, nothing is compared
+    ClearDirtyRange(&dirty);
+    CHECK(!FindChangedRange(L"abc", 3, L"xyz", 3, &dirty, &prefix, &suffix));
+    CHECK(prefix == 3 && suffix == 0);
+}
+
+//
+// ReplaceTestSelection
+// Replaces the selection with insertLength characters of insert,
+// and puts the caret after them, like typing and pasting do
+//
+void ReplaceTestSelection(TEST_EDIT_TEXT * edit, LPCWSTR insert, size_t insertLength)
+{
+    memmove(edit->text + edit->selStart + insertLength, edit->text + edit->selEnd,
+        (edit->length - edit->selEnd) * sizeof(WCHAR));
+    if(insertLength > 0)
+    {
+        memcpy(edit->text + edit->selStart, insert, insertLength * sizeof(WCHAR));
+    }
+
+    edit->length = edit->length - (edit->selEnd - edit->selStart) + insertLength;
+    edit->selStart += insertLength;
+    edit->selEnd = edit->selStart;
+}
+
+//
+// MakeTestEdit
+// Makes a random edit the way the edit control would, at the selection
+//
+void MakeTestEdit(TEST_EDIT_TEXT * edit, DWORD random)
+{
+    static const WCHAR pasted[] = L"ab\r\nba\r\n";
+    WCHAR typed = (WCHAR)(L'a' + (random >> 8) % 3);
+    size_t pastedLength = 1 + (random >> 12) % (ARRAYSIZE(pasted) - 1);
+
+    switch(random % 5)
+    {
+    case 0:
+        // Type a character over the selection. Only a few different
+        // ones, so the edits often match the text around them.
+        if(edit->length < TEST_DIFF_CHARS - 1)
+        {
+            ReplaceTestSelection(edit, &typed, 1);
+        }
+        break;
+    case 1:
+        // Backspace deletes the selection, or the character before the caret
+        if(edit->selStart == edit->selEnd && edit->selStart > 0)
+        {
+            edit->selStart--;
+        }
+        ReplaceTestSelection(edit, NULL, 0);
+        break;
+    case 2:
+        // Delete deletes the selection, or the character after the caret
+        if(edit->selStart == edit->selEnd && edit->selEnd < edit->length)
+        {
+            edit->selEnd++;
+        }
+        ReplaceTestSelection(edit, NULL, 0);
+        edit->selEnd = edit->selStart;
+        break;
+    case 3:
+        if(edit->length < TEST_DIFF_CHARS - pastedLength)
+        {
+            ReplaceTestSelection(edit, pasted, pastedLength);
+        }
+        break;
+    default:
+        // Select somewhere else
+        edit->selStart = (random >> 4) % (edit->length + 1);
+        edit->selEnd = min(edit->selStart + (random >> 20) % 5, edit->length);
+        break;
+    }
+}
+
+//
+// TestTrackedEdits
+//
+void TestTrackedEdits(void)
+{
+    static TEST_EDIT_TEXT edit;
+    static WCHAR copy[TEST_DIFF_CHARS];
+    size_t copyLength;
+    DIRTY_RANGE dirty;
+    DWORD seed = 4321;
+    size_t prefix;
+    size_t suffix;
+    BOOL matched = TRUE;
+
+    edit.length = 0;
+    for(; edit.length < TEST_DIFF_CHARS / 2; edit.length++)
+    {
+        edit.text[edit.length] = (WCHAR)(L'a' + edit.length % 3);
+    }
+
+    edit.selStart = edit.selEnd = edit.length / 2;
+    memcpy(copy, edit.text, edit.length * sizeof(WCHAR));
+    copyLength = edit.length;
+    ClearDirtyRange(&dirty);
+
+    for(int i = 0; i < TEST_DIFF_EDITS && matched; i++)
+    {
+        size_t oldLength = edit.length;
+        size_t oldStart = edit.selStart;
+        size_t oldEnd = edit.selEnd;
+
+        seed = seed * 1103515245 + 12345;
+        MakeTestEdit(&edit, seed);
+        AddDirtyEdit(&dirty, oldLength, oldStart, oldEnd, edit.length, edit.selStart, edit.selEnd);
+
+        // Catch the copy up with the text, like an autosave does
+        if(i % TEST_DIFF_TICK == 0)
+        {
+            if(FindChangedRange(copy, copyLength, edit.text, edit.length, &dirty, &prefix, &suffix))
+            {
+                memmove(copy + edit.length - suffix, copy + copyLength - suffix, suffix * sizeof(WCHAR));
+                memcpy(copy + prefix, edit.text + prefix, (edit.length - prefix - suffix) * sizeof(WCHAR));
+                copyLength = edit.length;
+            }
+
+            matched = (copyLength == edit.length && memcmp(copy, edit.text, edit.length * sizeof(WCHAR)) == 0);
+            ClearDirtyRange(&dirty);
+        }
+    }
+
+    CHECK(matched);
+}
+
+//
+// RunTextDiffTests
+//
+void RunTextDiffTests(void)
+{
+    TestChangedRange();
+    TestDirtyRange();
+    TestTrackedEdits();
+}
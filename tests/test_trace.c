@@ -0,0 +1,215 @@
+/* -------------------------------------------------------------
+
+test_trace.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of the trace layer: events recorded on several threads at
+    once, each in its own ring buffer, and written out as a trace file.
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+// The threads that record events at once, and how many each records
+#define TEST_TRACE_THREADS  4
+#define TEST_THREAD_EVENTS  1000
+
+// The trace file the tests write, in the build directory
+#define TEST_TRACE_FILE     "trace-test.json"
+
+//
+// TraceWorkerProc
+// Records TEST_THREAD_EVENTS events, each with the thread's number as its bytes
+//
+DWORD WINAPI TraceWorkerProc(LPVOID param)
+{
+    ULONGLONG number = (ULONGLONG)(size_t)param;
+
+    for(int i = 0; i < TEST_THREAD_EVENTS; i++)
+    {
+        TRACE_SCOPE scope = {0};
+
+        TRACE_BEGIN(scope, "worker");
+        TRACE_BYTES(scope, number);
+        TRACE_END(scope);
+    }
+
+    return 0;
+}
+
+//
+// ReadTraceFile
+// Writes the trace file, and reads it back as a null-terminated string
+// from the process heap. Returns NULL if it can't be read.
+//
+char * ReadTraceFile(void)
+{
+    BYTE * data;
+    size_t size;
+
+    WriteTraceFile();
+
+    data = ReadTestOutputFile(TEST_TRACE_FILE, &size);
+    if(data)
+    {
+        data[size] = 0;
+    }
+
+    return (char *)data;
+}
+
+//
+// CountTraceEvents
+// Returns the number of events named name in the trace file text
+//
+int CountTraceEvents(const char * trace, const char * name)
+{
+    char pattern[64];
+    int count = 0;
+
+    _snprintf_s(pattern, sizeof(pattern), _TRUNCATE, "{\"name\":\"%s\",", name);
+    for(const char * found = strstr(trace, pattern); found; found = strstr(found + 1, pattern))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+//
+// TestTraceDisabled
+// With tracing off, a scope records nothing, and isn't even started
+//
+void TestTraceDisabled(void)
+{
+    TRACE_SCOPE scope = {0};
+
+    CHECK(!g_traceEnabled);
+    TRACE_BEGIN(scope, "disabled");
+    TRACE_BYTES(scope, 10);
+    TRACE_END(scope);
+    CHECK(scope.name == NULL);
+}
+
+//
+// TestTraceThreads
+// Threads record events into their own rings while the trace file is written
+//
+void TestTraceThreads(void)
+{
+    HANDLE threads[TEST_TRACE_THREADS];
+    char * trace;
+    const char * found;
+    double lastStart = -1;
+    BOOL ordered = TRUE;
+    DWORD threadIds[TEST_TRACE_THREADS];
+    int threadCount = 0;
+
+    for(size_t i = 0; i < TEST_TRACE_THREADS; i++)
+    {
+        threads[i] = CreateThread(NULL, 0, TraceWorkerProc, (LPVOID)i, 0, NULL);
+        CHECK(threads[i] != NULL);
+    }
+
+    // Writing the file while the threads record is safe, if incomplete
+    trace = ReadTraceFile();
+    CHECK(trace != NULL);
+    HeapFree(GetProcessHeap(), 0, trace);
+
+    for(size_t i = 0; i < TEST_TRACE_THREADS; i++)
+    {
+        if(threads[i])
+        {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    }
+
+    // Once they're done, every event is there, with its thread
+    trace = ReadTraceFile();
+    CHECK(trace != NULL);
+    if(!trace)
+    {
+        return;
+    }
+
+    CHECK(CountTraceEvents(trace, "worker") == TEST_TRACE_THREADS * TEST_THREAD_EVENTS);
+    CHECK(CountTraceEvents(trace, "disabled") == 0);
+    CHECK(strstr(trace, "\"worker\":{\"count\":4000,") != NULL);
+
+    for(found = strstr(trace, "\"tid\":"); found; found = strstr(found + 1, "\"tid\":"))
+    {
+        DWORD threadId = (DWORD)strtoul(found + 6, NULL, 10);
+        double start = strtod(strstr(found, "\"ts\":") + 5, NULL);
+        int t;
+
+        // The events from all of the threads are merged in the order they started
+        if(start < lastStart)
+        {
+            ordered = FALSE;
+        }
+        lastStart = start;
+
+        for(t = 0; t < threadCount && threadIds[t] != threadId; t++);
+        if(t == threadCount && threadCount < TEST_TRACE_THREADS)
+        {
+            threadIds[threadCount++] = threadId;
+        }
+    }
+
+    CHECK(ordered);
+    CHECK(threadCount == TEST_TRACE_THREADS);
+
+    HeapFree(GetProcessHeap(), 0, trace);
+}
+
+//
+// TestTraceWrap
+// A thread that records more events than its ring holds keeps the newest
+//
+void TestTraceWrap(void)
+{
+    char * trace;
+
+    for(int i = 0; i < TRACE_EVENT_COUNT + 100; i++)
+    {
+        TRACE_SCOPE scope = {0};
+
+        TRACE_BEGIN(scope, "wrap");
+        TRACE_END(scope);
+    }
+
+    trace = ReadTraceFile();
+    CHECK(trace != NULL);
+    if(!trace)
+    {
+        return;
+    }
+
+    // The oldest event of a full ring is in the slot written next, so it's left out
+    CHECK(CountTraceEvents(trace, "wrap") == TRACE_EVENT_COUNT - 1);
+
+    // The other threads' events are still all there
+    CHECK(CountTraceEvents(trace, "worker") == TEST_TRACE_THREADS * TEST_THREAD_EVENTS);
+
+    HeapFree(GetProcessHeap(), 0, trace);
+}
+
+//
+// RunTraceTests
+//
+void RunTraceTests(void)
+{
+    WCHAR path[MAX_PATH];
+
+    TestTraceDisabled();
+
+    GetTestOutputPath(TEST_TRACE_FILE, path);
+    StartTrace(path);
+    CHECK(g_traceEnabled);
+
+    TestTraceThreads();
+    TestTraceWrap();
+}
@@ -0,0 +1,262 @@
+/* -------------------------------------------------------------
+
+test_transform.c
+    Essential Notepad - A basic Notepad implementation for Windows
+    Tests of the line transforms: the line table, column edits,
+    sorting, removing duplicates and trimming
+
+by: Matthew Justice
+
+---------------------------------------------------------------*/
+#include <string.h>
+#include "test.h"
+
+// The most lines a test's text has
+#define TEST_MAX_LINES 16
+
+// The number of lines sorted, enough for several merge passes
+#define TEST_SORT_LINES 2000
+
+// The number of tasks the lines are sorted in, which is odd so a run
+// is copied through a round of merging
+#define TEST_SORT_TASKS 5
+
+//
+// TestLineTable
+//
+void TestLineTable(void)
+{
+    LPCWSTR text = L"one\r\n\r\nthree\rstill three\r\n";
+    DWORD length = (DWORD)wcslen(text);
+    DWORD lineStarts[TEST_MAX_LINES];
+
+    // Only CRLF ends a line, and the text after the last one is a line too
+    CHECK(CountTextLines(text, length) == 4);
+    FillLineTable(text, length, lineStarts);
+    CHECK(lineStarts[0] == 0 && GetLineLength(lineStarts, 0) == 3);
+    CHECK(lineStarts[1] == 5 && GetLineLength(lineStarts, 1) == 0);
+    CHECK(lineStarts[2] == 7 && GetLineLength(lineStarts, 2) == 17);
+    CHECK(lineStarts[3] == length && GetLineLength(lineStarts, 3) == 0);
+
+    CHECK(CountTextLines(L"", 0) == 1);
+    FillLineTable(L"", 0, lineStarts);
+    CHECK(GetLineLength(lineStarts, 0) == 0);
+}
+
+//
+// CheckColumnEdit
+// Applies a column edit to every line of text, and checks the result
+// and the length it was measured as
+//
+void CheckColumnEdit(LPCWSTR text, DWORD column, DWORD width, LPCWSTR insertText, LPCWSTR expected, int line)
+{
+    DWORD length = (DWORD)wcslen(text);
+    DWORD lineCount = CountTextLines(text, length);
+    DWORD lineStarts[TEST_MAX_LINES];
+    WCHAR output[256];
+    size_t measured;
+    size_t written;
+
+    FillLineTable(text, length, lineStarts);
+    measured = ApplyColumnEdit(text, lineStarts, lineCount, column, width, insertText, wcslen(insertText), NULL);
+    written = ApplyColumnEdit(text, lineStarts, lineCount, column, width, insertText, wcslen(insertText), output);
+
+    CheckCondition(measured == written, "measured == written", __FILE__, line);
+    CheckCondition(TextEquals(output, written, expected), "column edit == expected", __FILE__, line);
+}
+
+//
+// TestColumnEdit
+//
+void TestColumnEdit(void)
+{
+    // Insert, replace and delete at a column
+    CheckColumnEdit(L"abcd\r\nefgh", 2, 0, L"--", L"ab--cd\r\nef--gh", __LINE__);
+    CheckColumnEdit(L"abcd\r\nefgh", 1, 2, L"X", L"aXd\r\neXh", __LINE__);
+    CheckColumnEdit(L"abcd\r\nefgh", 1, 2, L"", L"ad\r\neh", __LINE__);
+
+    // Short lines are padded to the column, but only if there's text to insert
+    CheckColumnEdit(L"abcd\r\nx\r\n", 3, 0, L"|", L"abc|d\r\nx  |\r\n   |", __LINE__);
+    CheckColumnEdit(L"abcd\r\nx", 3, 5, L"", L"abc\r\nx", __LINE__);
+
+    // A width past the end of a line only removes what's there
+    CheckColumnEdit(L"abcdef\r\nab", 1, 100, L"Z", L"aZ\r\naZ", __LINE__);
+}
+
+//
+// TestColumnEditSpan
+// Edits only the lines of a span in a larger text, like the column
+// edit does with the selected lines
+//
+void TestColumnEditSpan(void)
+{
+    LPCWSTR text = L"skip\r\n12345\r\n678\r\nskip";
+    DWORD spanStart = 6;
+    DWORD spanEnd = 16;
+    DWORD lineStarts[TEST_MAX_LINES];
+    DWORD lineCount = CountTextLines(text + spanStart, spanEnd - spanStart);
+    WCHAR output[64];
+    size_t outputLength;
+
+    CHECK(lineCount == 2);
+    FillLineTable(text + spanStart, spanEnd - spanStart, lineStarts);
+    outputLength = ApplyColumnEdit(text + spanStart, lineStarts, lineCount, 4, 1, L"#", 1, output);
+    CHECK_TEXT(output, outputLength, L"1234#\r\n678 #");
+}
+
+//
+// CheckWrittenLines
+// Writes the lines of text in order, and checks the result
+//
+void CheckWrittenLines(LPCWSTR text, const DWORD * lineStarts, const DWORD * order, DWORD count,
+    LPCWSTR expected, int line)
+{
+    WCHAR output[256];
+    size_t outputLength;
+
+    CheckCondition(WriteLinesInOrder(text, lineStarts, order, count, NULL) == wcslen(expected),
+        "measured == expected length", __FILE__, line);
+    outputLength = WriteLinesInOrder(text, lineStarts, order, count, output);
+    CheckCondition(TextEquals(output, outputLength, expected), "lines == expected", __FILE__, line);
+}
+
+//
+// TestSortLines
+//
+void TestSortLines(void)
+{
+    LPCWSTR text = L"pear\r\napple\r\nPear\r\n\r\napple\r\napp";
+    DWORD length = (DWORD)wcslen(text);
+    DWORD lineCount = CountTextLines(text, length);
+    DWORD lineStarts[TEST_MAX_LINES];
+    DWORD order[TEST_MAX_LINES];
+    DWORD temp[TEST_MAX_LINES];
+
+    FillLineTable(text, length, lineStarts);
+    for(DWORD i = 0; i < lineCount; i++)
+    {
+        order[i] = i;
+    }
+
+    // By character value, so capitals first, and a prefix before the longer line.
+    // Equal lines keep their order.
+    SortLineOrder(text, lineStarts, order, temp, lineCount);
+    CheckWrittenLines(text, lineStarts, order, lineCount, L"\r\nPear\r\napp\r\napple\r\napple\r\npear", __LINE__);
+    CHECK(order[3] == 1 && order[4] == 4);
+
+    CHECK(RemoveAdjacentDuplicates(text, lineStarts, order, lineCount) == 5);
+    CheckWrittenLines(text, lineStarts, order, 5, L"\r\nPear\r\napp\r\napple\r\npear", __LINE__);
+}
+
+//
+// TestSortManyLines
+// Sorts enough lines to merge runs, and checks the order is sorted and
+// stable, and the same when they're sorted in tasks on several threads
+//
+void TestSortManyLines(void)
+{
+    static WCHAR text[TEST_SORT_LINES * 8];
+    static DWORD lineStarts[TEST_SORT_LINES + 1];
+    static DWORD order[TEST_SORT_LINES];
+    static DWORD taskOrder[TEST_SORT_LINES];
+    static DWORD temp[TEST_SORT_LINES];
+    DWORD length = 0;
+    DWORD seed = 12345;
+    BOOL sorted = TRUE;
+
+    // Three digit keys, so many lines are equal
+    for(DWORD i = 0; i < TEST_SORT_LINES; i++)
+    {
+        DWORD key;
+
+        seed = seed * 1103515245 + 12345;
+        key = (seed >> 16) % 500;
+        text[length++] = (WCHAR)(L'0' + key / 100);
+        text[length++] = (WCHAR)(L'0' + key / 10 % 10);
+        text[length++] = (WCHAR)(L'0' + key % 10);
+        if(i + 1 < TEST_SORT_LINES)
+        {
+            text[length++] = L'\r';
+            text[length++] = L'\n';
+        }
+        order[i] = i;
+        taskOrder[i] = i;
+    }
+
+    CHECK(CountTextLines(text, length) == TEST_SORT_LINES);
+    FillLineTable(text, length, lineStarts);
+    SortLineOrder(text, lineStarts, order, temp, TEST_SORT_LINES);
+    SortLinesInTasks(text, lineStarts, taskOrder, temp, TEST_SORT_LINES, TEST_SORT_TASKS);
+    CHECK(memcmp(order, taskOrder, sizeof(order)) == 0);
+
+    for(DWORD i = 1; i < TEST_SORT_LINES; i++)
+    {
+        int result = CompareLines(text, lineStarts, order[i - 1], order[i]);
+        if(result > 0 || (result == 0 && order[i - 1] > order[i]))
+        {
+            sorted = FALSE;
+        }
+    }
+    CHECK(sorted);
+}
+
+//
+// TestRemoveLaterDuplicates
+//
+void TestRemoveLaterDuplicates(void)
+{
+    LPCWSTR text = L"b\r\na\r\nb\r\nc\r\na";
+    DWORD length = (DWORD)wcslen(text);
+    DWORD lineCount = CountTextLines(text, length);
+    DWORD lineStarts[TEST_MAX_LINES];
+    DWORD sortedOrder[TEST_MAX_LINES];
+    DWORD temp[TEST_MAX_LINES];
+    DWORD order[TEST_MAX_LINES];
+    BYTE keep[TEST_MAX_LINES];
+    DWORD kept;
+
+    FillLineTable(text, length, lineStarts);
+    for(DWORD i = 0; i < lineCount; i++)
+    {
+        sortedOrder[i] = i;
+    }
+    SortLineOrder(text, lineStarts, sortedOrder, temp, lineCount);
+
+    // The first of each line is kept, in the order of the text
+    kept = RemoveLaterDuplicates(text, lineStarts, sortedOrder, lineCount, keep, order);
+    CHECK(kept == 3);
+    CheckWrittenLines(text, lineStarts, order, kept, L"b\r\na\r\nc", __LINE__);
+}
+
+//
+// TestTrimWhitespace
+//
+void TestTrimWhitespace(void)
+{
+    LPCWSTR text = L"a  \r\n \t\r\n\tb c\t \r\nd";
+    DWORD length = (DWORD)wcslen(text);
+    DWORD lineCount = CountTextLines(text, length);
+    DWORD lineStarts[TEST_MAX_LINES];
+    WCHAR output[64];
+    size_t outputLength;
+
+    // Only the whitespace at the end of a line goes, and blank lines stay
+    FillLineTable(text, length, lineStarts);
+    CHECK(TrimTrailingWhitespace(text, lineStarts, lineCount, NULL) == 12);
+    outputLength = TrimTrailingWhitespace(text, lineStarts, lineCount, output);
+    CHECK_TEXT(output, outputLength, L"a\r\n\r\n\tb c\r\nd");
+}
+
+//
+// RunTransformTests
+//
+void RunTransformTests(void)
+{
+    TestLineTable();
+    TestColumnEdit();
+    TestColumnEditSpan();
+    TestSortLines();
+    TestSortManyLines();
+    TestRemoveLaterDuplicates();
+    TestTrimWhitespace();
+}